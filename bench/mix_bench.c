@@ -0,0 +1,135 @@
+// microbenchmark of layer mixing, build and run with ./nob bench
+// compares scalar mix that clipped after every layer (what mixer did before gain ramps)
+// against ramped mix_audio and clipping once in mix_audio_finish
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "ffmpeg_helper.h"
+
+#define BENCH_FRAMES 1024
+#define BENCH_LAYERS 8
+#define BENCH_TARGET_NANOS 200000000ull
+
+static uint64_t bench_time_nanos(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// constant gain per channel and clip after every add, same loop old mix_audio ran for mono and stereo
+static void scalar_mix_clip(uint8_t** base, uint8_t** added, size_t nb_samples, size_t num_channels, enum AVSampleFormat sample_fmt, const float* gains){
+    if (sample_fmt == AV_SAMPLE_FMT_FLTP) {
+        for (size_t ch = 0; ch < num_channels; ch++) {
+            float* dst = (float*)base[ch];
+            const float* src = (const float*)added[ch];
+            for (size_t i = 0; i < nb_samples; i++) {
+                float mixed = dst[i] + src[i]*gains[ch];
+                if (mixed > 1.0f)  mixed = 1.0f;
+                if (mixed < -1.0f) mixed = -1.0f;
+                dst[i] = mixed;
+            }
+        }
+        return;
+    }
+    float* dst = (float*)base[0];
+    const float* src = (const float*)added[0];
+    for (size_t i = 0; i < nb_samples; i++) {
+        for (size_t ch = 0; ch < num_channels; ch++) {
+            size_t e = i*num_channels + ch;
+            float mixed = dst[e] + src[e]*gains[ch];
+            if (mixed > 1.0f)  mixed = 1.0f;
+            if (mixed < -1.0f) mixed = -1.0f;
+            dst[e] = mixed;
+        }
+    }
+}
+
+typedef enum {
+    BENCH_SCALAR_CLIP = 0,
+    BENCH_RAMP,
+    BENCH_RAMP_FINISH,
+    BENCH_KIND_COUNT,
+} BenchKind;
+
+static const char* bench_kind_names[BENCH_KIND_COUNT] = {
+    [BENCH_SCALAR_CLIP] = "scalar mix + clip",
+    [BENCH_RAMP]        = "ramped mix",
+    [BENCH_RAMP_FINISH] = "ramped mix + finish",
+};
+
+static float bench_sink = 0;
+
+// one iteration mixes BENCH_LAYERS layers into bus like mix_all_layers does, returns ns per output frame
+static double bench_run(BenchKind kind, size_t channels, enum AVSampleFormat fmt, uint8_t** bus, uint8_t** layer){
+    float gainStart[MIX_AUDIO_MAX_CHANNELS], gainEnd[MIX_AUDIO_MAX_CHANNELS];
+    for (size_t ch = 0; ch < channels; ch++) {
+        gainStart[ch] = 0.5f / BENCH_LAYERS;
+        gainEnd[ch] = 0.6f / BENCH_LAYERS;
+    }
+
+    size_t iterations = 0;
+    uint64_t start = bench_time_nanos();
+    uint64_t elapsed = 0;
+    while (elapsed < BENCH_TARGET_NANOS) {
+        for (size_t i = 0; i < 64; i++, iterations++) {
+            av_samples_set_silence(bus, 0, BENCH_FRAMES, channels, fmt);
+            for (size_t l = 0; l < BENCH_LAYERS; l++) {
+                if (kind == BENCH_SCALAR_CLIP) scalar_mix_clip(bus, layer, BENCH_FRAMES, channels, fmt, gainStart);
+                else mix_audio(bus, layer, BENCH_FRAMES, channels, fmt, gainStart, gainEnd);
+            }
+            if (kind == BENCH_RAMP_FINISH) mix_audio_finish(bus, BENCH_FRAMES, channels, fmt, 0.9f);
+            bench_sink += ((float*)bus[0])[iterations % BENCH_FRAMES];
+        }
+        elapsed = bench_time_nanos() - start;
+    }
+    return (double)elapsed / (double)(iterations * BENCH_FRAMES);
+}
+
+int main(void){
+    static const size_t channelCounts[] = {1, 2, 6, 8};
+    static const char* channelNames[] = {"mono", "stereo", "5.1", "7.1"};
+    static const enum AVSampleFormat formats[] = {AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_FLT};
+
+    printf("%d frames, %d layers per buffer, ns per output frame\n", BENCH_FRAMES, BENCH_LAYERS);
+    printf("%-8s %-5s", "layout", "fmt");
+    for (size_t k = 0; k < BENCH_KIND_COUNT; k++) printf(" %20s", bench_kind_names[k]);
+    printf("\n");
+
+    for (size_t c = 0; c < sizeof(channelCounts)/sizeof(channelCounts[0]); c++) {
+        for (size_t f = 0; f < sizeof(formats)/sizeof(formats[0]); f++) {
+            size_t channels = channelCounts[c];
+            enum AVSampleFormat fmt = formats[f];
+
+            uint8_t** bus = NULL;
+            uint8_t** layer = NULL;
+            if (av_samples_alloc_array_and_samples(&bus, NULL, channels, BENCH_FRAMES, fmt, 0) < 0 ||
+                av_samples_alloc_array_and_samples(&layer, NULL, channels, BENCH_FRAMES, fmt, 0) < 0) {
+                fprintf(stderr, "Couldn't allocate bench buffers\n");
+                return 1;
+            }
+
+            // noise in [-1, 1] so clipping branches aren't trivially predicted
+            int planes = av_sample_fmt_is_planar(fmt) ? (int)channels : 1;
+            size_t perPlane = av_sample_fmt_is_planar(fmt) ? BENCH_FRAMES : BENCH_FRAMES*channels;
+            srand(1234);
+            for (int p = 0; p < planes; p++) {
+                float* samples = (float*)layer[p];
+                for (size_t i = 0; i < perPlane; i++) samples[i] = (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+            }
+
+            printf("%-8s %-5s", channelNames[c], av_get_sample_fmt_name(fmt));
+            for (size_t k = 0; k < BENCH_KIND_COUNT; k++) printf(" %20.2f", bench_run((BenchKind)k, channels, fmt, bus, layer));
+            printf("\n");
+
+            av_freep(&bus[0]);
+            av_freep(&bus);
+            av_freep(&layer[0]);
+            av_freep(&layer);
+        }
+    }
+
+    // keeps compiler from dropping mixing whose result is never read
+    if (bench_sink == 12345.0f) printf("\n");
+    return 0;
+}
@@ -30,7 +30,7 @@ const char* vulkanSDKPathINC;
                               "-Wno-deprecated-declarations", "-LC:/ffmpeg/lib", "-LC:/freetype/lib",
 #else
 #define PLATFORM_COMPILER_ARGS "-I/usr/include/freetype2", "-I/usr/include/libpng16", "-I/usr/local/include",
-#define PLATFORM_LINKER_FLAGS "-lvulkan", "-lX11", "-lXrandr", "-lshaderc", "-lc", "-lm", "-L/usr/local/ffmpeg/lib", 
+#define PLATFORM_LINKER_FLAGS "-lvulkan", "-lX11", "-lXrandr", "-lshaderc", "-lc", "-lm", "-lpthread", "-L/usr/local/ffmpeg/lib", 
 #endif
 
 #ifdef _WIN32
@@ -522,6 +522,36 @@ int build_example(bool debug,
     return build_c_proj_single_file(true, debug, source_filepath, output_filename, cmd, sb, deps);
 }
 
+// mixer microbenchmark, always optimized since debug numbers say nothing
+int build_bench(
+    const char* output_filename,
+    Nob_Cmd* cmd,
+    Nob_String_Builder* sb,
+    Nob_File_Paths* deps
+){
+    Nob_File_Paths c_files = {
+        .capacity = 0,
+        .count = 2,
+        .items = (const char**)(const char*[]){
+            "bench/mix_bench.c",
+            "src/ffmpeg_helper.c",
+        }
+    };
+
+    bool needsRebuild;
+    int e = build_needed_c_files_and_check_if_rebuild_needed(false, false, &needsRebuild, &c_files, cmd, sb, deps);
+    if(e != 0) return e;
+
+    if (needsRebuild || !file_exists(output_filename)) {
+        if (!link_files_core(cmd, output_filename, &c_files, false, false)) {
+            nob_log(NOB_ERROR, "Linking failed");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
 int main(int argc, char** argv) {
     NOB_GO_REBUILD_URSELF(argc, argv);
 
@@ -554,6 +584,7 @@ int main(int argc, char** argv) {
     bool debug = true;
     bool run_after = false;
     bool clean = false;
+    bool bench = false;
 
     File_Paths argsToPass = {0};
     bool collectingArgs = false;
@@ -569,6 +600,7 @@ int main(int argc, char** argv) {
         if (strcmp(arg, "release") == 0) debug = false;
         else if (strcmp(arg, "run") == 0) run_after = true;
         else if (strcmp(arg, "clean") == 0) clean = true;
+        else if (strcmp(arg, "bench") == 0) bench = true;
         else if (strcmp(arg, "--") == 0) {
             collectingArgs = true;
             continue;
@@ -584,6 +616,33 @@ int main(int argc, char** argv) {
         return 0;
     }
 
+    if (bench) {
+        const char* bench_filename = nob_temp_sprintf("%smix_bench%s", BUILD_PATH(false),
+#ifdef _WIN32
+            ".exe"
+#else
+            ""
+#endif
+        );
+        Nob_Cmd cmd = {0};
+        Nob_String_Builder sb = {0};
+        Nob_File_Paths deps = {0};
+        int e = build_bench(bench_filename, &cmd, &sb, &deps);
+        if(e != 0) return e;
+
+        cmd.count = 0;
+        nob_cmd_append(&cmd, bench_filename);
+        if (!nob_cmd_run_sync(cmd)) {
+            nob_log(NOB_ERROR, "Failed to run the benchmark");
+            return 1;
+        }
+
+        nob_da_free(deps);
+        nob_sb_free(sb);
+        nob_cmd_free(cmd);
+        return 0;
+    }
+
     const char* output_filename = nob_temp_sprintf(
         "%s%s%s", 
         BUILD_PATH(debug), 
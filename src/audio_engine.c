@@ -0,0 +1,247 @@
+#include "audio_engine.h"
+#include "engine/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// how far ahead of playback cursor engine thread mixes and how much has to be queued before playback (re)starts
+#define AUDIO_ENGINE_LEAD_MS 60
+#define AUDIO_ENGINE_PREBUFFER_MS 40
+// per layer ring, producer decodes this far ahead so main loop stalls shorter than that are never heard
+#define AUDIO_ENGINE_LAYER_RING_MS 500
+
+bool audio_ring_init(AudioRing* ring, size_t capacityFrames, size_t channels){
+    size_t capacity = 1;
+    while(capacity < capacityFrames) capacity <<= 1;
+
+    ring->samples = calloc(capacity*channels, sizeof(float));
+    if(ring->samples == NULL) return false;
+    ring->channels = channels;
+    ring->capacity = capacity;
+    atomic_init(&ring->writePos, 0);
+    atomic_init(&ring->readPos, 0);
+    return true;
+}
+
+void audio_ring_free(AudioRing* ring){
+    free(ring->samples);
+    memset(ring, 0, sizeof(*ring));
+}
+
+size_t audio_ring_readable(AudioRing* ring){
+    size_t read = atomic_load_explicit(&ring->readPos, memory_order_acquire);
+    size_t write = atomic_load_explicit(&ring->writePos, memory_order_acquire);
+    return write - read;
+}
+
+size_t audio_ring_writable(AudioRing* ring){
+    return ring->capacity - audio_ring_readable(ring);
+}
+
+size_t audio_ring_write(AudioRing* ring, const float* frames, size_t count){
+    size_t write = atomic_load_explicit(&ring->writePos, memory_order_relaxed);
+    size_t read = atomic_load_explicit(&ring->readPos, memory_order_acquire);
+    size_t space = ring->capacity - (write - read);
+    if(count > space) count = space;
+    if(count == 0) return 0;
+
+    size_t start = write & (ring->capacity - 1);
+    size_t first = ring->capacity - start;
+    if(first > count) first = count;
+    memcpy(ring->samples + start*ring->channels, frames, first*ring->channels*sizeof(float));
+    memcpy(ring->samples, frames + first*ring->channels, (count - first)*ring->channels*sizeof(float));
+
+    atomic_store_explicit(&ring->writePos, write + count, memory_order_release);
+    return count;
+}
+
+size_t audio_ring_read(AudioRing* ring, float* frames, size_t count){
+    size_t read = atomic_load_explicit(&ring->readPos, memory_order_relaxed);
+    size_t write = atomic_load_explicit(&ring->writePos, memory_order_acquire);
+    size_t available = write - read;
+    if(count > available) count = available;
+    if(count == 0) return 0;
+
+    size_t start = read & (ring->capacity - 1);
+    size_t first = ring->capacity - start;
+    if(first > count) first = count;
+    memcpy(frames, ring->samples + start*ring->channels, first*ring->channels*sizeof(float));
+    memcpy(frames + first*ring->channels, ring->samples, (count - first)*ring->channels*sizeof(float));
+
+    atomic_store_explicit(&ring->readPos, read + count, memory_order_release);
+    return count;
+}
+
+void audio_ring_discard(AudioRing* ring){
+    size_t write = atomic_load_explicit(&ring->writePos, memory_order_acquire);
+    atomic_store_explicit(&ring->readPos, write, memory_order_release);
+}
+
+// mixes one block into output, returns false when there is nothing to do yet
+static bool audio_engine_mix_block(AudioEngine* engine){
+    size_t block = engine->blockFrames;
+    size_t channels = engine->channels;
+
+    // output queued before last flush still has to be dropped by playback callback first
+    if(atomic_load(&engine->seenGeneration) != atomic_load(&engine->outputGeneration)) return false;
+    if(audio_ring_readable(&engine->output) >= engine->leadFrames) return false;
+    if(audio_ring_writable(&engine->output) < block) return false;
+
+    // layers still playing have to have whole block ready, otherwise they would get silence mixed in mid stream
+    for(size_t i = 0; i < engine->layersCount; i++){
+        AudioEngineLayer* layer = &engine->layers[i];
+        if(atomic_load(&layer->ended)) continue;
+        if(audio_ring_readable(&layer->ring) < block) return false;
+    }
+
+    memset(engine->mixBuf, 0, block*channels*sizeof(float));
+    audio_graph_begin(engine->graph, block);
+    for(size_t i = 0; i < engine->layersCount; i++){
+        AudioEngineLayer* layer = &engine->layers[i];
+        size_t read = audio_ring_read(&layer->ring, engine->layerBuf, block);
+        memset(engine->layerBuf + read*channels, 0, (block - read)*channels*sizeof(float));
+
+        // ended layers still go through graph so filter and compressor state stays continuous, same as when rendering
+        float targetGains[MIX_AUDIO_MAX_CHANNELS];
+        mix_audio_gains(atomic_load(&layer->volume), atomic_load(&layer->pan), &engine->graph->ch_layout, targetGains);
+        if(!layer->mixGainsSet){
+            memcpy(layer->mixGains, targetGains, sizeof(targetGains));
+            layer->mixGainsSet = true;
+        }
+        audio_graph_mix_layer(engine->graph, i, (uint8_t**)&engine->mixBuf, (uint8_t**)&engine->layerBuf, block, layer->mixGains, targetGains);
+        memcpy(layer->mixGains, targetGains, sizeof(targetGains));
+    }
+    audio_graph_finish(engine->graph, (uint8_t**)&engine->mixBuf, block, atomic_load(&engine->masterGain));
+
+    audio_ring_write(&engine->output, engine->mixBuf, block);
+    return true;
+}
+
+static int audio_engine_thread(void* arg){
+    AudioEngine* engine = arg;
+
+    while(atomic_load(&engine->running)){
+        unsigned request = atomic_load(&engine->flushRequest);
+        if(request != atomic_load(&engine->flushAck)){
+            for(size_t i = 0; i < engine->layersCount; i++){
+                audio_ring_discard(&engine->layers[i].ring);
+                engine->layers[i].mixGainsSet = false;
+                // seek can bring finished layers back, producer says again which ones have nothing left
+                atomic_store(&engine->layers[i].ended, false);
+            }
+            engine->producer.seek(engine->producer.arg, engine, engine->flushTime);
+            audio_graph_reset(engine->graph);
+            atomic_fetch_add(&engine->outputGeneration, 1);
+            atomic_store(&engine->flushAck, request);
+        }
+
+        // output comes first, decoding ahead only fills time until playback needs next block
+        bool worked = false;
+        while(audio_engine_mix_block(engine)) worked = true;
+        if(engine->producer.produce(engine->producer.arg, engine)) worked = true;
+        if(!worked) platform_sleep(1);
+    }
+
+    return 0;
+}
+
+static void audio_engine_free(AudioEngine* engine){
+    if(engine->layers){
+        for(size_t i = 0; i < engine->layersCount; i++) audio_ring_free(&engine->layers[i].ring);
+        free(engine->layers);
+    }
+    audio_ring_free(&engine->output);
+    free(engine->mixBuf);
+    free(engine->layerBuf);
+    memset(engine, 0, sizeof(*engine));
+}
+
+bool audio_engine_start(AudioEngine* engine, AudioGraph* graph, size_t sampleRate, size_t blockFrames, AudioEngineProducer producer){
+    memset(engine, 0, sizeof(*engine));
+    if(graph->sample_fmt != AV_SAMPLE_FMT_FLT || graph->maxFrames < blockFrames){
+        fprintf(stderr, "[FVFX] Audio graph doesn't match audio engine\n");
+        return false;
+    }
+    size_t layersCount = graph->layersCount;
+    size_t channels = graph->channels;
+
+    engine->graph = graph;
+    engine->producer = producer;
+    engine->layersCount = layersCount;
+    engine->channels = channels;
+    engine->blockFrames = blockFrames;
+    engine->prebufferFrames = sampleRate*AUDIO_ENGINE_PREBUFFER_MS/1000;
+    engine->leadFrames = sampleRate*AUDIO_ENGINE_LEAD_MS/1000;
+    if(engine->leadFrames < engine->prebufferFrames + blockFrames) engine->leadFrames = engine->prebufferFrames + blockFrames;
+
+    engine->layers = calloc(layersCount ? layersCount : 1, sizeof(*engine->layers));
+    engine->mixBuf = malloc(blockFrames*channels*sizeof(float));
+    engine->layerBuf = malloc(blockFrames*channels*sizeof(float));
+    if(engine->layers == NULL || engine->mixBuf == NULL || engine->layerBuf == NULL) goto fail;
+
+    size_t layerRingFrames = sampleRate*AUDIO_ENGINE_LAYER_RING_MS/1000;
+    if(layerRingFrames < blockFrames*2) layerRingFrames = blockFrames*2;
+    for(size_t i = 0; i < layersCount; i++){
+        AudioEngineLayer* layer = &engine->layers[i];
+        if(!audio_ring_init(&layer->ring, layerRingFrames, channels)) goto fail;
+        atomic_init(&layer->volume, 1.0f);
+        atomic_init(&layer->pan, 0.0f);
+        atomic_init(&layer->ended, false);
+    }
+    if(!audio_ring_init(&engine->output, engine->leadFrames + blockFrames, channels)) goto fail;
+
+    atomic_init(&engine->masterGain, 1.0f);
+    atomic_init(&engine->paused, false);
+    atomic_init(&engine->flushRequest, 0);
+    atomic_init(&engine->flushAck, 0);
+    atomic_init(&engine->outputGeneration, 0);
+    atomic_init(&engine->seenGeneration, 0);
+    engine->prebuffering = true;
+
+    atomic_init(&engine->running, true);
+    engine->thread = platform_thread_create(audio_engine_thread, engine);
+    if(engine->thread == NULL){
+        fprintf(stderr, "[FVFX] Couldn't start audio engine thread\n");
+        goto fail;
+    }
+
+    return true;
+fail:
+    audio_engine_free(engine);
+    return false;
+}
+
+void audio_engine_stop(AudioEngine* engine){
+    if(engine->thread){
+        atomic_store(&engine->running, false);
+        platform_thread_join(engine->thread);
+    }
+    audio_engine_free(engine);
+}
+
+void audio_engine_flush(AudioEngine* engine, double time){
+    if(engine->thread == NULL) return;
+    engine->flushTime = time;
+    unsigned request = atomic_fetch_add(&engine->flushRequest, 1) + 1;
+    while(atomic_load(&engine->flushAck) != request) platform_sleep(1);
+}
+
+void audio_engine_pull(AudioEngine* engine, float* out, size_t frames){
+    size_t got = 0;
+
+    if(engine->thread){
+        unsigned generation = atomic_load(&engine->outputGeneration);
+        if(generation != atomic_load_explicit(&engine->seenGeneration, memory_order_relaxed)){
+            audio_ring_discard(&engine->output);
+            engine->prebuffering = true;
+            atomic_store(&engine->seenGeneration, generation);
+        }
+
+        if(!atomic_load(&engine->paused)){
+            if(engine->prebuffering && audio_ring_readable(&engine->output) >= engine->prebufferFrames) engine->prebuffering = false;
+            if(!engine->prebuffering) got = audio_ring_read(&engine->output, out, frames);
+        }
+    }
+
+    memset(out + got*engine->channels, 0, (frames - got)*engine->channels*sizeof(float));
+}
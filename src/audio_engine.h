@@ -0,0 +1,93 @@
+#ifndef FVFX_AUDIO_ENGINE
+#define FVFX_AUDIO_ENGINE
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "ffmpeg_helper.h"
+#include "audio_graph.h"
+
+// single producer single consumer ring of interleaved float frames, neither side ever blocks or locks
+typedef struct{
+    float* samples;
+    size_t channels;
+    size_t capacity;           // in frames, power of two
+    _Atomic size_t writePos;   // frames written since init, only producer stores it
+    _Atomic size_t readPos;    // frames read since init, only consumer stores it
+} AudioRing;
+
+bool audio_ring_init(AudioRing* ring, size_t capacityFrames, size_t channels);
+void audio_ring_free(AudioRing* ring);
+size_t audio_ring_readable(AudioRing* ring);
+size_t audio_ring_writable(AudioRing* ring);
+// both return how many frames were actually moved
+size_t audio_ring_write(AudioRing* ring, const float* frames, size_t count);
+size_t audio_ring_read(AudioRing* ring, float* frames, size_t count);
+// consumer side only, drops everything written so far
+void audio_ring_discard(AudioRing* ring);
+
+// layer as seen by engine thread, producer feeds its ring with decoded samples on engine thread too
+typedef struct{
+    AudioRing ring;
+    _Atomic float volume; // published by main thread
+    _Atomic float pan;
+    _Atomic bool ended; // set by producer, no more samples until next flush, mixed as silence instead of waited for
+
+    // engine thread only
+    float mixGains[MIX_AUDIO_MAX_CHANNELS];
+    bool mixGainsSet;
+} AudioEngineLayer;
+
+typedef struct AudioEngine AudioEngine;
+
+// decodes layer audio on engine thread so stalls of main loop never starve mixing
+typedef struct{
+    // tops layer rings up, returns false when it had nothing to do
+    bool (*produce)(void* arg, AudioEngine* engine);
+    // starts layers over from time passed to audio_engine_flush
+    void (*seek)(void* arg, AudioEngine* engine, double time);
+    void* arg;
+} AudioEngineProducer;
+
+// mixes layers on its own thread into output ring ahead of playback cursor,
+// playback callback only ever copies out of output ring
+struct AudioEngine{
+    AudioEngineLayer* layers;
+    size_t layersCount;
+    AudioRing output;
+    size_t channels;
+    size_t blockFrames;     // frames mixed at once
+    size_t leadFrames;      // output is kept filled up to this many frames
+    size_t prebufferFrames; // playback waits for this much after start/flush so short main loop stalls don't underrun
+
+    _Atomic float masterGain;
+    _Atomic bool paused;
+    _Atomic bool running;
+    _Atomic unsigned flushRequest;
+    _Atomic unsigned flushAck;
+    double flushTime; // written before flushRequest is bumped
+    _Atomic unsigned outputGeneration; // bumped by engine thread whenever queued output became stale
+
+    _Atomic unsigned seenGeneration;   // stored by playback callback once it dropped stale output, engine waits for it
+
+    // playback callback only
+    bool prebuffering;
+
+    // engine thread only
+    AudioGraph* graph;
+    AudioEngineProducer producer;
+    float* mixBuf;
+    float* layerBuf;
+
+    void* thread;
+};
+
+// graph has one layer per engine layer and is only touched by engine thread until stop, same goes for whatever producer decodes from
+bool audio_engine_start(AudioEngine* engine, AudioGraph* graph, size_t sampleRate, size_t blockFrames, AudioEngineProducer producer);
+void audio_engine_stop(AudioEngine* engine);
+// main thread, drops everything queued and waits until engine thread did the same and producer moved to time (after seeks)
+void audio_engine_flush(AudioEngine* engine, double time);
+// playback callback, always fills whole out buffer
+void audio_engine_pull(AudioEngine* engine, float* out, size_t frames);
+
+#endif
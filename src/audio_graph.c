@@ -0,0 +1,402 @@
+#include "audio_graph.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define AUDIO_GRAPH_LIMITER_LOOKAHEAD_MS 5
+#define AUDIO_GRAPH_LIMITER_RELEASE_MS 100
+#define AUDIO_GRAPH_LIMITER_CEILING_DB -1.0
+
+static float db_to_gain(double db){
+    return (float)pow(10.0, db / 20.0);
+}
+
+// one pole smoothing coefficient reaching ~63% of the way in ms
+static float time_coef(double ms, double sampleRate){
+    if(ms <= 0) return 0;
+    return (float)exp(-1.0 / (ms * sampleRate / 1000.0));
+}
+
+// first sample of channel and distance between its samples
+static float* channel_samples(uint8_t** buf, enum AVSampleFormat sample_fmt, size_t channels, size_t ch, size_t* stride){
+    if(sample_fmt == AV_SAMPLE_FMT_FLTP){
+        *stride = 1;
+        return (float*)buf[ch];
+    }
+    *stride = channels;
+    return (float*)buf[0] + ch;
+}
+
+// rbj cookbook biquads
+static bool effect_init_eq(AudioGraphEffect* effect, const AudioEffect* desc, double sampleRate){
+    double frequency = desc->as.eq.frequency;
+    if(frequency < 10) frequency = 10;
+    if(frequency > sampleRate*0.49) frequency = sampleRate*0.49;
+    double q = desc->as.eq.q > 0 ? desc->as.eq.q : M_SQRT1_2;
+
+    double w0 = 2*M_PI*frequency/sampleRate;
+    double cosw = cos(w0);
+    double alpha = sin(w0)/(2*q);
+    double A = pow(10.0, desc->as.eq.gainDb/40.0);
+    double sqrtA2alpha = 2*sqrt(A)*alpha;
+
+    double b0, b1, b2, a0, a1, a2;
+    switch(desc->type){
+        case AUDIO_EFFECT_EQ_PEAK:
+            b0 = 1 + alpha*A;
+            b1 = -2*cosw;
+            b2 = 1 - alpha*A;
+            a0 = 1 + alpha/A;
+            a1 = -2*cosw;
+            a2 = 1 - alpha/A;
+            break;
+        case AUDIO_EFFECT_EQ_LOW_SHELF:
+            b0 = A*((A+1) - (A-1)*cosw + sqrtA2alpha);
+            b1 = 2*A*((A-1) - (A+1)*cosw);
+            b2 = A*((A+1) - (A-1)*cosw - sqrtA2alpha);
+            a0 = (A+1) + (A-1)*cosw + sqrtA2alpha;
+            a1 = -2*((A-1) + (A+1)*cosw);
+            a2 = (A+1) + (A-1)*cosw - sqrtA2alpha;
+            break;
+        case AUDIO_EFFECT_EQ_HIGH_SHELF:
+            b0 = A*((A+1) + (A-1)*cosw + sqrtA2alpha);
+            b1 = -2*A*((A-1) + (A+1)*cosw);
+            b2 = A*((A+1) + (A-1)*cosw - sqrtA2alpha);
+            a0 = (A+1) - (A-1)*cosw + sqrtA2alpha;
+            a1 = 2*((A-1) - (A+1)*cosw);
+            a2 = (A+1) - (A-1)*cosw - sqrtA2alpha;
+            break;
+        case AUDIO_EFFECT_EQ_LOW_CUT:
+            b0 = (1 + cosw)/2;
+            b1 = -(1 + cosw);
+            b2 = (1 + cosw)/2;
+            a0 = 1 + alpha;
+            a1 = -2*cosw;
+            a2 = 1 - alpha;
+            break;
+        case AUDIO_EFFECT_EQ_HIGH_CUT:
+            b0 = (1 - cosw)/2;
+            b1 = 1 - cosw;
+            b2 = (1 - cosw)/2;
+            a0 = 1 + alpha;
+            a1 = -2*cosw;
+            a2 = 1 - alpha;
+            break;
+        default:
+            return false;
+    }
+
+    effect->b0 = (float)(b0/a0);
+    effect->b1 = (float)(b1/a0);
+    effect->b2 = (float)(b2/a0);
+    effect->a1 = (float)(a1/a0);
+    effect->a2 = (float)(a2/a0);
+    return true;
+}
+
+static bool effect_init(AudioGraphEffect* effect, const AudioEffect* desc, double sampleRate){
+    memset(effect, 0, sizeof(*effect));
+    effect->type = desc->type;
+    effect->gain = 1.0f;
+
+    switch(desc->type){
+        case AUDIO_EFFECT_GAIN:
+            effect->gain = db_to_gain(desc->as.gain.db);
+            return true;
+        case AUDIO_EFFECT_EQ_PEAK:
+        case AUDIO_EFFECT_EQ_LOW_SHELF:
+        case AUDIO_EFFECT_EQ_HIGH_SHELF:
+        case AUDIO_EFFECT_EQ_LOW_CUT:
+        case AUDIO_EFFECT_EQ_HIGH_CUT:
+            return effect_init_eq(effect, desc, sampleRate);
+        case AUDIO_EFFECT_COMPRESSOR:
+            if(desc->as.compressor.ratio < 1){
+                fprintf(stderr, "[FVFX] Compressor ratio has to be at least 1, got %f\n", desc->as.compressor.ratio);
+                return false;
+            }
+            effect->gain = db_to_gain(desc->as.compressor.makeupDb);
+            effect->threshold = db_to_gain(desc->as.compressor.thresholdDb);
+            effect->slope = (float)(1.0 - 1.0/desc->as.compressor.ratio);
+            effect->attackCoef = time_coef(desc->as.compressor.attackMs, sampleRate);
+            effect->releaseCoef = time_coef(desc->as.compressor.releaseMs, sampleRate);
+            return true;
+        default:
+            fprintf(stderr, "[FVFX] Unknown audio effect type %d\n", (int)desc->type);
+            return false;
+    }
+}
+
+static bool chain_init(AudioGraphChain* chain, AudioEffectInstance* effects, double sampleRate){
+    chain->effectsCount = 0;
+    for(AudioEffectInstance* effect = effects; effect != NULL; effect = effect->next) chain->effectsCount++;
+    if(chain->effectsCount == 0) return true;
+
+    chain->effects = calloc(chain->effectsCount, sizeof(*chain->effects));
+    if(chain->effects == NULL) return false;
+
+    size_t i = 0;
+    for(AudioEffectInstance* effect = effects; effect != NULL; effect = effect->next, i++){
+        if(!effect_init(&chain->effects[i], &effect->effect, sampleRate)) return false;
+    }
+    return true;
+}
+
+static void process_biquad(AudioGraphEffect* effect, AudioGraph* graph, uint8_t** buf, size_t frames){
+    // recursive per channel, so it stays scalar, channels run one after another
+    for(size_t ch = 0; ch < graph->channels; ch++){
+        size_t stride;
+        float* samples = channel_samples(buf, graph->sample_fmt, graph->channels, ch, &stride);
+        float z1 = effect->z1[ch];
+        float z2 = effect->z2[ch];
+        for(size_t i = 0; i < frames; i++){
+            float x = samples[i*stride];
+            float y = effect->b0*x + z1;
+            z1 = effect->b1*x - effect->a1*y + z2;
+            z2 = effect->b2*x - effect->a2*y;
+            samples[i*stride] = y;
+        }
+        // keeps silent tails from decaying into denormals
+        effect->z1[ch] = fabsf(z1) < 1e-15f ? 0 : z1;
+        effect->z2[ch] = fabsf(z2) < 1e-15f ? 0 : z2;
+    }
+}
+
+static void process_compressor(AudioGraphEffect* effect, AudioGraph* graph, uint8_t** buf, size_t frames){
+    float* samples[MIX_AUDIO_MAX_CHANNELS];
+    size_t stride = 1;
+    for(size_t ch = 0; ch < graph->channels; ch++) samples[ch] = channel_samples(buf, graph->sample_fmt, graph->channels, ch, &stride);
+
+    float envelope = effect->envelope;
+    for(size_t i = 0; i < frames; i++){
+        float level = 0;
+        for(size_t ch = 0; ch < graph->channels; ch++){
+            float v = fabsf(samples[ch][i*stride]);
+            if(v > level) level = v;
+        }
+        float coef = level > envelope ? effect->attackCoef : effect->releaseCoef;
+        envelope = level + (envelope - level)*coef;
+
+        // pow only runs while compressor is actually reducing gain
+        float gain = effect->gain;
+        if(envelope > effect->threshold) gain *= powf(envelope / effect->threshold, -effect->slope);
+        for(size_t ch = 0; ch < graph->channels; ch++) samples[ch][i*stride] *= gain;
+    }
+    effect->envelope = envelope < 1e-15f ? 0 : envelope;
+}
+
+static void chain_process(AudioGraphChain* chain, AudioGraph* graph, uint8_t** buf, size_t frames){
+    for(size_t i = 0; i < chain->effectsCount; i++){
+        AudioGraphEffect* effect = &chain->effects[i];
+        switch(effect->type){
+            case AUDIO_EFFECT_GAIN:
+                mix_audio_scale(buf, frames, graph->channels, graph->sample_fmt, effect->gain);
+                break;
+            case AUDIO_EFFECT_COMPRESSOR:
+                process_compressor(effect, graph, buf, frames);
+                break;
+            default:
+                process_biquad(effect, graph, buf, frames);
+                break;
+        }
+    }
+}
+
+static void chain_reset(AudioGraphChain* chain){
+    for(size_t i = 0; i < chain->effectsCount; i++){
+        AudioGraphEffect* effect = &chain->effects[i];
+        memset(effect->z1, 0, sizeof(effect->z1));
+        memset(effect->z2, 0, sizeof(effect->z2));
+        effect->envelope = 0;
+    }
+}
+
+static void limiter_reset(AudioGraphLimiter* limiter, size_t channels){
+    memset(limiter->delay, 0, limiter->lookahead*channels*sizeof(float));
+    for(size_t i = 0; i < limiter->lookahead; i++) limiter->held[i] = 1.0f;
+    limiter->heldSum = (double)limiter->lookahead;
+    limiter->release = 1.0f;
+    limiter->dequeHead = 0;
+    limiter->dequeCount = 0;
+    limiter->pos = 0;
+    limiter->frame = 0;
+}
+
+// applied gain of frame t is average of held gains over the lookahead frames that follow it,
+// every one of them is a minimum over a window containing t, so output never goes above ceiling
+static void limiter_process(AudioGraphLimiter* limiter, AudioGraph* graph, uint8_t** buf, size_t frames){
+    size_t channels = graph->channels;
+    size_t lookahead = limiter->lookahead;
+    float* samples[MIX_AUDIO_MAX_CHANNELS];
+    size_t stride = 1;
+    for(size_t ch = 0; ch < channels; ch++) samples[ch] = channel_samples(buf, graph->sample_fmt, channels, ch, &stride);
+
+    for(size_t i = 0; i < frames; i++){
+        float peak = 0;
+        for(size_t ch = 0; ch < channels; ch++){
+            float v = fabsf(samples[ch][i*stride]);
+            if(v > peak) peak = v;
+        }
+        float required = peak > limiter->ceiling ? limiter->ceiling / peak : 1.0f;
+
+        // sliding minimum of required gain over last lookahead frames
+        if(limiter->dequeCount > 0 && limiter->dequeFrames[limiter->dequeHead] + lookahead <= limiter->frame){
+            limiter->dequeHead = (limiter->dequeHead + 1) % lookahead;
+            limiter->dequeCount--;
+        }
+        while(limiter->dequeCount > 0){
+            size_t back = (limiter->dequeHead + limiter->dequeCount - 1) % lookahead;
+            if(limiter->dequeValues[back] < required) break;
+            limiter->dequeCount--;
+        }
+        size_t slot = (limiter->dequeHead + limiter->dequeCount) % lookahead;
+        limiter->dequeValues[slot] = required;
+        limiter->dequeFrames[slot] = limiter->frame;
+        limiter->dequeCount++;
+        float held = limiter->dequeValues[limiter->dequeHead];
+
+        // attack is instant here and smoothed by averaging below, release recovers slowly
+        if(held > limiter->release) held = held + (limiter->release - held)*limiter->releaseCoef;
+        limiter->release = held;
+
+        float gain = (float)(limiter->heldSum / (double)lookahead);
+        float* delayed = limiter->delay + limiter->pos*channels;
+        for(size_t ch = 0; ch < channels; ch++){
+            float in = samples[ch][i*stride];
+            samples[ch][i*stride] = delayed[ch]*gain;
+            delayed[ch] = in;
+        }
+
+        limiter->heldSum += held - limiter->held[limiter->pos];
+        limiter->held[limiter->pos] = held;
+        limiter->pos = (limiter->pos + 1) % lookahead;
+        limiter->frame++;
+    }
+
+    // running sum drifts over hours of audio, resummed once per block
+    limiter->heldSum = 0;
+    for(size_t i = 0; i < lookahead; i++) limiter->heldSum += limiter->held[i];
+}
+
+bool audio_graph_init(AudioGraph* graph, Project* project, MyProject* myProject, const AVChannelLayout* ch_layout, double sampleRate, enum AVSampleFormat sample_fmt, size_t maxFrames){
+    memset(graph, 0, sizeof(*graph));
+    size_t channels = ch_layout->nb_channels;
+    if(channels == 0 || channels > MIX_AUDIO_MAX_CHANNELS){
+        fprintf(stderr, "[FVFX] Audio graph doesn't support %zu channels\n", channels);
+        return false;
+    }
+    if(sample_fmt != AV_SAMPLE_FMT_FLT && sample_fmt != AV_SAMPLE_FMT_FLTP){
+        fprintf(stderr, "[FVFX] Audio graph only supports float samples, got %s\n", av_get_sample_fmt_name(sample_fmt));
+        return false;
+    }
+    graph->ch_layout = *ch_layout;
+    graph->channels = channels;
+    graph->sample_fmt = sample_fmt;
+    graph->maxFrames = maxFrames;
+
+    for(AudioBus* bus = project->audioBuses; bus != NULL; bus = bus->next) graph->busesCount++;
+    graph->buses = calloc(graph->busesCount ? graph->busesCount : 1, sizeof(*graph->buses));
+    if(graph->buses == NULL) goto fail;
+    size_t busIndex = 0;
+    for(AudioBus* bus = project->audioBuses; bus != NULL; bus = bus->next, busIndex++){
+        AudioGraphBus* graphBus = &graph->buses[busIndex];
+        graphBus->volume = (float)bus->volume;
+        if(av_samples_alloc_array_and_samples(&graphBus->buf, NULL, channels, maxFrames, sample_fmt, 0) < 0) goto fail;
+        if(!chain_init(&graphBus->chain, bus->effects, sampleRate)) goto fail;
+    }
+
+    for(MyLayer* myLayer = myProject->myLayers; myLayer != NULL; myLayer = myLayer->next){
+        if(myLayer->audioFifo) graph->layersCount++;
+    }
+    graph->layers = calloc(graph->layersCount ? graph->layersCount : 1, sizeof(*graph->layers));
+    if(graph->layers == NULL) goto fail;
+    size_t layerIndex = 0;
+    Layer* layer = project->layers;
+    for(MyLayer* myLayer = myProject->myLayers; myLayer != NULL; myLayer = myLayer->next, layer = layer->next){
+        if(!myLayer->audioFifo) continue;
+        AudioGraphLayer* graphLayer = &graph->layers[layerIndex++];
+        if(layer->audioBus != AUDIO_BUS_MASTER && layer->audioBus >= graph->busesCount){
+            fprintf(stderr, "[FVFX] Audio bus %zu doesnt exist\n", layer->audioBus);
+            goto fail;
+        }
+        graphLayer->bus = layer->audioBus;
+        if(!chain_init(&graphLayer->chain, layer->audioEffects, sampleRate)) goto fail;
+    }
+
+    AudioGraphLimiter* limiter = &graph->limiter;
+    limiter->lookahead = (size_t)(sampleRate*AUDIO_GRAPH_LIMITER_LOOKAHEAD_MS/1000);
+    if(limiter->lookahead == 0) limiter->lookahead = 1;
+    limiter->ceiling = db_to_gain(AUDIO_GRAPH_LIMITER_CEILING_DB);
+    limiter->releaseCoef = time_coef(AUDIO_GRAPH_LIMITER_RELEASE_MS, sampleRate);
+    limiter->delay = malloc(limiter->lookahead*channels*sizeof(float));
+    limiter->held = malloc(limiter->lookahead*sizeof(float));
+    limiter->dequeValues = malloc(limiter->lookahead*sizeof(float));
+    limiter->dequeFrames = malloc(limiter->lookahead*sizeof(size_t));
+    if(limiter->delay == NULL || limiter->held == NULL || limiter->dequeValues == NULL || limiter->dequeFrames == NULL) goto fail;
+    limiter_reset(limiter, channels);
+
+    return true;
+fail:
+    audio_graph_uninit(graph);
+    return false;
+}
+
+void audio_graph_uninit(AudioGraph* graph){
+    if(graph->buses){
+        for(size_t i = 0; i < graph->busesCount; i++){
+            AudioGraphBus* bus = &graph->buses[i];
+            if(bus->buf){
+                av_freep(&bus->buf[0]);
+                av_freep(&bus->buf);
+            }
+            free(bus->chain.effects);
+        }
+        free(graph->buses);
+    }
+    if(graph->layers){
+        for(size_t i = 0; i < graph->layersCount; i++) free(graph->layers[i].chain.effects);
+        free(graph->layers);
+    }
+    free(graph->limiter.delay);
+    free(graph->limiter.held);
+    free(graph->limiter.dequeValues);
+    free(graph->limiter.dequeFrames);
+    memset(graph, 0, sizeof(*graph));
+}
+
+void audio_graph_reset(AudioGraph* graph){
+    for(size_t i = 0; i < graph->busesCount; i++) chain_reset(&graph->buses[i].chain);
+    for(size_t i = 0; i < graph->layersCount; i++) chain_reset(&graph->layers[i].chain);
+    limiter_reset(&graph->limiter, graph->channels);
+}
+
+void audio_graph_begin(AudioGraph* graph, size_t frames){
+    for(size_t i = 0; i < graph->busesCount; i++){
+        av_samples_set_silence(graph->buses[i].buf, 0, frames, graph->channels, graph->sample_fmt);
+    }
+}
+
+void audio_graph_mix_layer(AudioGraph* graph, size_t layerIndex, uint8_t** out, uint8_t** layerBuf, size_t frames, const float* gainStart, const float* gainEnd){
+    if(layerIndex >= graph->layersCount) return;
+    AudioGraphLayer* layer = &graph->layers[layerIndex];
+    chain_process(&layer->chain, graph, layerBuf, frames);
+    uint8_t** dst = layer->bus == AUDIO_BUS_MASTER ? out : graph->buses[layer->bus].buf;
+    mix_audio(dst, layerBuf, frames, graph->channels, graph->sample_fmt, gainStart, gainEnd);
+}
+
+void audio_graph_finish(AudioGraph* graph, uint8_t** out, size_t frames, float masterGain){
+    for(size_t i = 0; i < graph->busesCount; i++){
+        AudioGraphBus* bus = &graph->buses[i];
+        chain_process(&bus->chain, graph, bus->buf, frames);
+        float gains[MIX_AUDIO_MAX_CHANNELS];
+        for(size_t ch = 0; ch < graph->channels; ch++) gains[ch] = bus->volume;
+        mix_audio(out, bus->buf, frames, graph->channels, graph->sample_fmt, gains, gains);
+    }
+    limiter_process(&graph->limiter, graph, out, frames);
+    // limiter already keeps everything under ceiling, clipping only catches masterGain above 1
+    mix_audio_finish(out, frames, graph->channels, graph->sample_fmt, masterGain);
+}
+
+size_t audio_graph_latency(AudioGraph* graph){
+    return graph->limiter.lookahead;
+}
@@ -0,0 +1,85 @@
+#ifndef FVFX_AUDIO_GRAPH
+#define FVFX_AUDIO_GRAPH
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "myProject.h"
+#include "ffmpeg_helper.h"
+
+// runtime state of one insert effect, coefficients are computed once at init
+typedef struct{
+    AudioEffectType type;
+    float gain;
+    // eq
+    float b0, b1, b2, a1, a2;
+    float z1[MIX_AUDIO_MAX_CHANNELS];
+    float z2[MIX_AUDIO_MAX_CHANNELS];
+    // compressor
+    float threshold;
+    float slope;
+    float attackCoef;
+    float releaseCoef;
+    float envelope;
+} AudioGraphEffect;
+
+typedef struct{
+    AudioGraphEffect* effects;
+    size_t effectsCount;
+} AudioGraphChain;
+
+typedef struct{
+    AudioGraphChain chain;
+    size_t bus; // AUDIO_BUS_MASTER or index into buses
+} AudioGraphLayer;
+
+typedef struct{
+    AudioGraphChain chain;
+    float volume;
+    uint8_t** buf;
+} AudioGraphBus;
+
+// brickwall limiter, gain reduction starts lookahead frames before the peak so it never has to clip
+typedef struct{
+    size_t lookahead;
+    float ceiling;
+    float releaseCoef;
+    float release;       // gain after release smoothing of last frame
+    float* delay;        // lookahead frames of input
+    float* held;         // lookahead gains averaged into the applied gain
+    double heldSum;
+    float* dequeValues;  // sliding minimum of required gain over lookahead
+    size_t* dequeFrames;
+    size_t dequeHead;
+    size_t dequeCount;
+    size_t pos;
+    size_t frame;
+} AudioGraphLimiter;
+
+// layers -> insert chains -> buses -> bus chains -> master -> limiter,
+// everything is allocated at init so processing a block never allocates
+typedef struct{
+    AudioGraphLayer* layers; // one for every layer with audio, in layer order
+    size_t layersCount;
+    AudioGraphBus* buses;
+    size_t busesCount;
+    AudioGraphLimiter limiter;
+    AVChannelLayout ch_layout; // speaker of every channel, pan law depends on it
+    size_t channels;
+    enum AVSampleFormat sample_fmt;
+    size_t maxFrames;
+} AudioGraph;
+
+bool audio_graph_init(AudioGraph* graph, Project* project, MyProject* myProject, const AVChannelLayout* ch_layout, double sampleRate, enum AVSampleFormat sample_fmt, size_t maxFrames);
+void audio_graph_uninit(AudioGraph* graph);
+// forgets filter and limiter history, after seeks
+void audio_graph_reset(AudioGraph* graph);
+// frames of every block have to be at most maxFrames
+void audio_graph_begin(AudioGraph* graph, size_t frames);
+// runs layer effects on layerBuf in place, then mixes it into its bus (or out for master) with ramped gains
+void audio_graph_mix_layer(AudioGraph* graph, size_t layerIndex, uint8_t** out, uint8_t** layerBuf, size_t frames, const float* gainStart, const float* gainEnd);
+// sums buses into out and limits it, masterGain is applied after limiter so it doesn't change how mix is limited
+void audio_graph_finish(AudioGraph* graph, uint8_t** out, size_t frames, float masterGain);
+// output is delayed by this much because of limiter lookahead, renders skip it at the start
+size_t audio_graph_latency(AudioGraph* graph);
+
+#endif
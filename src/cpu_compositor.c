@@ -0,0 +1,447 @@
+#include "cpu_compositor.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// rows processed by single thread pool job
+#define CPU_COMPOSITOR_TILE_ROWS 32
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPU_COMPOSITOR_SSE2
+#endif
+
+// one pixel as 4 floats in 0..1, same space fragment shaders work in
+#ifdef CPU_COMPOSITOR_SSE2
+#include <emmintrin.h>
+
+typedef __m128 CpuColor;
+
+static inline CpuColor color_load(uint32_t pixel){
+    __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_cvtsi32_si128((int)pixel);
+    v = _mm_unpacklo_epi8(v, zero);
+    v = _mm_unpacklo_epi16(v, zero);
+    return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f/255.0f));
+}
+
+static inline uint32_t color_store(CpuColor c){
+    c = _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    __m128i v = _mm_cvtps_epi32(_mm_mul_ps(c, _mm_set1_ps(255.0f)));
+    v = _mm_packs_epi32(v, v);
+    v = _mm_packus_epi16(v, v);
+    return (uint32_t)_mm_cvtsi128_si32(v);
+}
+
+static inline CpuColor color_zero(void){ return _mm_setzero_ps(); }
+static inline CpuColor color_splat(float f){ return _mm_set1_ps(f); }
+static inline CpuColor color_set(const float v[4]){ return _mm_loadu_ps(v); }
+static inline void color_get(CpuColor c, float v[4]){ _mm_storeu_ps(v, c); }
+static inline CpuColor color_add(CpuColor a, CpuColor b){ return _mm_add_ps(a, b); }
+static inline CpuColor color_sub(CpuColor a, CpuColor b){ return _mm_sub_ps(a, b); }
+static inline CpuColor color_mul(CpuColor a, CpuColor b){ return _mm_mul_ps(a, b); }
+static inline CpuColor color_alpha(CpuColor c){ return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3)); }
+static inline CpuColor color_rrra(CpuColor c){ return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 0, 0)); }
+
+// rgb taken from first argument, alpha from second
+static inline CpuColor color_merge_alpha(CpuColor rgb, CpuColor alpha){
+    __m128 mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    return _mm_or_ps(_mm_and_ps(mask, rgb), _mm_andnot_ps(mask, alpha));
+}
+#else
+typedef struct{
+    float v[4];
+} CpuColor;
+
+static inline CpuColor color_load(uint32_t pixel){
+    CpuColor c;
+    for(int i = 0; i < 4; i++) c.v[i] = (float)((pixel >> (i*8)) & 0xFF) * (1.0f/255.0f);
+    return c;
+}
+
+static inline uint32_t color_store(CpuColor c){
+    uint32_t pixel = 0;
+    for(int i = 0; i < 4; i++){
+        float f = c.v[i] < 0.0f ? 0.0f : (c.v[i] > 1.0f ? 1.0f : c.v[i]);
+        pixel |= (uint32_t)(f*255.0f + 0.5f) << (i*8);
+    }
+    return pixel;
+}
+
+static inline CpuColor color_zero(void){ return (CpuColor){0}; }
+static inline CpuColor color_splat(float f){ return (CpuColor){{f, f, f, f}}; }
+static inline CpuColor color_set(const float v[4]){ return (CpuColor){{v[0], v[1], v[2], v[3]}}; }
+static inline void color_get(CpuColor c, float v[4]){ memcpy(v, c.v, sizeof(c.v)); }
+static inline CpuColor color_add(CpuColor a, CpuColor b){ for(int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+static inline CpuColor color_sub(CpuColor a, CpuColor b){ for(int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+static inline CpuColor color_mul(CpuColor a, CpuColor b){ for(int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+static inline CpuColor color_alpha(CpuColor c){ return color_splat(c.v[3]); }
+static inline CpuColor color_rrra(CpuColor c){ return (CpuColor){{c.v[0], c.v[0], c.v[0], c.v[3]}}; }
+
+static inline CpuColor color_merge_alpha(CpuColor rgb, CpuColor alpha){
+    rgb.v[3] = alpha.v[3];
+    return rgb;
+}
+#endif
+
+static inline CpuColor color_lerp(CpuColor a, CpuColor b, float t){
+    return color_add(a, color_mul(color_sub(b, a), color_splat(t)));
+}
+
+// same equation as blend state of every vfx pipeline:
+// color = src*src.a + dst*(1 - src.a), alpha = src.a*src.a + dst.a*dst.a
+static inline CpuColor color_blend(CpuColor src, CpuColor dst){
+    CpuColor srcAlpha = color_alpha(src);
+    CpuColor srcWeighted = color_mul(src, srcAlpha);
+    CpuColor rgb = color_add(srcWeighted, color_mul(dst, color_sub(color_splat(1.0f), srcAlpha)));
+    CpuColor alpha = color_add(srcWeighted, color_mul(dst, color_alpha(dst)));
+    return color_merge_alpha(rgb, alpha);
+}
+
+// VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT
+static inline size_t mirror_coord(int64_t i, size_t size){
+    int64_t period = 2*(int64_t)size;
+    int64_t t = i % period;
+    if(t < 0) t += period;
+    return t < (int64_t)size ? (size_t)t : (size_t)(period - 1 - t);
+}
+
+static CpuColor sample_linear(const CpuImage* image, float u, float v){
+    float x = u*image->width - 0.5f;
+    float y = v*image->height - 0.5f;
+    float x0f = floorf(x);
+    float y0f = floorf(y);
+    float tx = x - x0f;
+    float ty = y - y0f;
+    int64_t x0 = (int64_t)x0f;
+    int64_t y0 = (int64_t)y0f;
+
+    size_t xa = mirror_coord(x0, image->width);
+    size_t xb = mirror_coord(x0 + 1, image->width);
+    const uint32_t* rowA = image->pixels + mirror_coord(y0, image->height)*image->width;
+    const uint32_t* rowB = image->pixels + mirror_coord(y0 + 1, image->height)*image->width;
+
+    CpuColor top = color_lerp(color_load(rowA[xa]), color_load(rowA[xb]), tx);
+    CpuColor bottom = color_lerp(color_load(rowB[xa]), color_load(rowB[xb]), tx);
+    return color_lerp(top, bottom, ty);
+}
+
+typedef struct{
+    CpuVfxKind kind;
+    float renderArea[2];
+    float mediaArea[2];
+    float offset[2];
+    float scale[2];
+    float color[4];
+    const SpirvProgram* program;
+    const void* pushConstants;
+    size_t pushConstantsSize;
+} CpuVfxParams;
+
+struct CpuPassTile{
+    const CpuImage* src;
+    CpuImage* dst;
+    const CpuVfxParams* params;
+    SpirvState* spirvState;
+    bool blendOverDst; // false means dst counts as cleared to transparent black
+    size_t rowStart;
+    size_t rowEnd;
+    size_t colStart;
+    size_t colEnd;
+};
+
+// ports of uv math from addons, returns false where shader outputs transparent black
+static bool remap_uv(const CpuVfxParams* params, float* u, float* v){
+    switch(params->kind){
+        case CPU_VFX_FIT: {
+            float renderAspect = params->renderArea[0] / params->renderArea[1];
+            float mediaAspect = params->mediaArea[0] / params->mediaArea[1];
+            float cx = *u * 2.0f - 1.0f;
+            float cy = *v * 2.0f - 1.0f;
+            if(mediaAspect > renderAspect){
+                float scale = params->renderArea[0] / params->mediaArea[0];
+                cy /= params->mediaArea[1] * scale / params->renderArea[1];
+            }else{
+                float scale = params->renderArea[1] / params->mediaArea[1];
+                cx /= params->mediaArea[0] * scale / params->renderArea[0];
+            }
+            *u = (cx + 1.0f) * 0.5f;
+            *v = (cy + 1.0f) * 0.5f;
+            break;
+        }
+        case CPU_VFX_TRANSLATE:
+            *u = (*u - 0.5f) / params->scale[0] + 0.5f - params->offset[0];
+            *v = (*v - 0.5f) / params->scale[1] + 0.5f + params->offset[1];
+            break;
+        default:
+            return true;
+    }
+    return !(*u < 0.0f || *v < 0.0f || *u > 1.0f || *v > 1.0f);
+}
+
+static inline CpuColor shade(const CpuVfxParams* params, CpuColor color){
+    switch(params->kind){
+        case CPU_VFX_GRAYSCALE: return color_rrra(color);
+        case CPU_VFX_COLORING: return color_mul(color, color_set(params->color));
+        default: return color;
+    }
+}
+
+static void cpu_texture_sample(void* user, float u, float v, float rgbaOut[4]){
+    color_get(sample_linear(user, u, v), rgbaOut);
+}
+
+static void cpu_texture_fetch(void* user, int32_t x, int32_t y, float rgbaOut[4]){
+    const CpuImage* image = user;
+    x = x < 0 ? 0 : (x >= (int32_t)image->width ? (int32_t)image->width - 1 : x);
+    y = y < 0 ? 0 : (y >= (int32_t)image->height ? (int32_t)image->height - 1 : y);
+    color_get(color_load(image->pixels[(size_t)y*image->width + x]), rgbaOut);
+}
+
+// interpreted addon, shades 4x2 pixel blocks so derivatives have neighbours,
+// lanes outside of tile still run like gpu helper invocations but are never written
+static void cpu_spirv_tile(CpuPassTile* tile){
+    const CpuImage* src = tile->src;
+    CpuImage* dst = tile->dst;
+    const CpuVfxParams* params = tile->params;
+    SpirvTexture texture = {
+        .user = (void*)src,
+        .width = src->width,
+        .height = src->height,
+        .sample = cpu_texture_sample,
+        .fetch = cpu_texture_fetch,
+    };
+    spirv_state_begin(tile->spirvState, params->pushConstants, params->pushConstantsSize, &texture);
+
+    float invWidth = 1.0f / dst->width;
+    float invHeight = 1.0f / dst->height;
+    float fragCoord[2][SPIRV_LANES];
+    float uv[2][SPIRV_LANES];
+    float color[4][SPIRV_LANES];
+
+    for(size_t y = tile->rowStart; y < tile->rowEnd; y += SPIRV_BLOCK_HEIGHT){
+        for(size_t x = tile->colStart; x < tile->colEnd; x += SPIRV_BLOCK_WIDTH){
+            for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                fragCoord[0][l] = (float)(x + l % SPIRV_BLOCK_WIDTH) + 0.5f;
+                fragCoord[1][l] = (float)(y + l / SPIRV_BLOCK_WIDTH) + 0.5f;
+                uv[0][l] = fragCoord[0][l] * invWidth;
+                uv[1][l] = fragCoord[1][l] * invHeight;
+            }
+
+            uint32_t written = spirv_run(tile->spirvState, fragCoord, uv, color);
+
+            for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                size_t px = x + l % SPIRV_BLOCK_WIDTH;
+                size_t py = y + l / SPIRV_BLOCK_WIDTH;
+                if(px >= tile->colEnd || py >= tile->rowEnd) continue;
+                uint32_t* pixel = &dst->pixels[py*dst->width + px];
+                CpuColor under = tile->blendOverDst ? color_load(*pixel) : color_zero();
+                if(!((written >> l) & 1)){
+                    // discarded fragment leaves target untouched
+                    *pixel = color_store(under);
+                    continue;
+                }
+                float rgba[4] = {color[0][l], color[1][l], color[2][l], color[3][l]};
+                *pixel = color_store(color_blend(color_set(rgba), under));
+            }
+        }
+    }
+}
+
+static void cpu_pass_tile(void* arg){
+    CpuPassTile* tile = arg;
+    const CpuImage* src = tile->src;
+    CpuImage* dst = tile->dst;
+    const CpuVfxParams* params = tile->params;
+
+    if(params->kind == CPU_VFX_SPIRV){
+        cpu_spirv_tile(tile);
+        return;
+    }
+
+    // same sized source with untouched uv lands exactly on texel centers so filtering can be skipped
+    bool direct = src->width == dst->width && src->height == dst->height &&
+        params->kind != CPU_VFX_FIT && params->kind != CPU_VFX_TRANSLATE;
+    float invWidth = 1.0f / dst->width;
+    float invHeight = 1.0f / dst->height;
+
+    for(size_t y = tile->rowStart; y < tile->rowEnd; y++){
+        uint32_t* dstRow = dst->pixels + y*dst->width;
+        const uint32_t* srcRow = src->pixels + y*src->width;
+        float v = (y + 0.5f) * invHeight;
+        for(size_t x = tile->colStart; x < tile->colEnd; x++){
+            CpuColor color;
+            if(direct){
+                color = color_load(srcRow[x]);
+            }else{
+                float su = (x + 0.5f) * invWidth;
+                float sv = v;
+                color = remap_uv(params, &su, &sv) ? sample_linear(src, su, sv) : color_zero();
+            }
+            color = shade(params, color);
+            dstRow[x] = color_store(color_blend(color, tile->blendOverDst ? color_load(dstRow[x]) : color_zero()));
+        }
+    }
+}
+
+static bool CpuCompositor_run_pass(CpuCompositor* compositor, const CpuImage* src, CpuImage* dst, const CpuVfxParams* params, bool blendOverDst, const CpuRect* rect){
+    CpuRect area = rect != NULL ? *rect : (CpuRect){.width = dst->width, .height = dst->height};
+    size_t tilesCount = (area.height + CPU_COMPOSITOR_TILE_ROWS - 1) / CPU_COMPOSITOR_TILE_ROWS;
+    if(params->kind == CPU_VFX_SPIRV){
+        for(size_t i = 0; i < tilesCount; i++){
+            if(!spirv_state_reserve(&compositor->spirvStates[i], params->program)) return false;
+        }
+    }
+
+    for(size_t i = 0; i < tilesCount; i++){
+        size_t rowEnd = area.y + (i + 1)*CPU_COMPOSITOR_TILE_ROWS;
+        compositor->tiles[i] = (CpuPassTile){
+            .src = src,
+            .dst = dst,
+            .params = params,
+            .spirvState = compositor->spirvStates[i],
+            .blendOverDst = blendOverDst,
+            .rowStart = area.y + i*CPU_COMPOSITOR_TILE_ROWS,
+            .rowEnd = rowEnd < area.y + area.height ? rowEnd : area.y + area.height,
+            .colStart = area.x,
+            .colEnd = area.x + area.width,
+        };
+        thread_pool_push(compositor->threadPool, cpu_pass_tile, &compositor->tiles[i]);
+    }
+    thread_pool_wait(compositor->threadPool);
+    return true;
+}
+
+typedef struct{
+    const char* filename;
+    CpuVfxKind kind;
+    VfxInputType inputs[2];
+    size_t inputsCount;
+} CpuVfxBuiltin;
+
+static const CpuVfxBuiltin builtins[] = {
+    {.filename = "fit.fvfx", .kind = CPU_VFX_FIT},
+    {.filename = "translate.fvfx", .kind = CPU_VFX_TRANSLATE, .inputs = {VFX_VEC2, VFX_VEC2}, .inputsCount = 2},
+    {.filename = "grayscale.fvfx", .kind = CPU_VFX_GRAYSCALE},
+    {.filename = "coloring.fvfx", .kind = CPU_VFX_COLORING, .inputs = {VFX_VEC4}, .inputsCount = 1},
+};
+
+CpuVfxKind cpu_vfx_kind_from_module(VfxModule* module){
+    const char* filename = module->filepath;
+    for(const char* c = module->filepath; *c; c++){
+        if(*c == '/' || *c == '\\') filename = c + 1;
+    }
+
+    for(size_t i = 0; i < sizeof(builtins)/sizeof(builtins[0]); i++){
+        const CpuVfxBuiltin* builtin = &builtins[i];
+        if(strcmp(builtin->filename, filename) != 0) continue;
+
+        size_t inputIndex = 0;
+        for(VfxInput* input = module->inputs; input != NULL; input = input->next, inputIndex++){
+            if(inputIndex >= builtin->inputsCount || input->type != builtin->inputs[inputIndex]) return CPU_VFX_NONE;
+        }
+        if(inputIndex != builtin->inputsCount) return CPU_VFX_NONE;
+        return builtin->kind;
+    }
+
+    return CPU_VFX_NONE;
+}
+
+static bool CpuImage_alloc(CpuImage* image, size_t width, size_t height){
+    image->width = width;
+    image->height = height;
+    image->pixels = calloc(width*height, sizeof(uint32_t));
+    return image->pixels != NULL;
+}
+
+bool CpuCompositor_init(CpuCompositor* compositor, size_t width, size_t height, ThreadPool* threadPool){
+    *compositor = (CpuCompositor){0};
+    compositor->threadPool = threadPool;
+    compositor->width = width;
+    compositor->height = height;
+
+    if(!CpuImage_alloc(&compositor->targets[0], width, height)) return false;
+    if(!CpuImage_alloc(&compositor->targets[1], width, height)) return false;
+    if(!CpuImage_alloc(&compositor->composed, width, height)) return false;
+
+    compositor->tilesCount = (height + CPU_COMPOSITOR_TILE_ROWS - 1) / CPU_COMPOSITOR_TILE_ROWS;
+    compositor->tiles = calloc(compositor->tilesCount, sizeof(*compositor->tiles));
+    compositor->spirvStates = calloc(compositor->tilesCount, sizeof(*compositor->spirvStates));
+    return compositor->tiles != NULL && compositor->spirvStates != NULL;
+}
+
+void CpuCompositor_uninit(CpuCompositor* compositor){
+    free(compositor->targets[0].pixels);
+    free(compositor->targets[1].pixels);
+    free(compositor->composed.pixels);
+    free(compositor->passes.items);
+    free(compositor->tiles);
+    if(compositor->spirvStates != NULL){
+        for(size_t i = 0; i < compositor->tilesCount; i++) spirv_state_free(compositor->spirvStates[i]);
+    }
+    free(compositor->spirvStates);
+    free(compositor->pushConstants);
+    *compositor = (CpuCompositor){0};
+}
+
+void CpuCompositor_clear(CpuCompositor* compositor){
+    memset(compositor->composed.pixels, 0, compositor->width*compositor->height*sizeof(uint32_t));
+}
+
+bool CpuCompositor_compose_layer(CpuCompositor* compositor, VideoFrame* frameIn, CpuRect composeRect){
+    if(frameIn->data == NULL || frameIn->width == 0 || frameIn->height == 0) return false;
+
+    CpuImage media = {
+        .pixels = frameIn->data,
+        .width = frameIn->width,
+        .height = frameIn->height,
+    };
+
+    // default pipeline stretching media over whole output
+    CpuVfxParams params = {.kind = CPU_VFX_NONE};
+    CpuImage* current = &compositor->targets[0];
+    if(!CpuCompositor_run_pass(compositor, &media, current, &params, false, NULL)) return false;
+
+    for(size_t i = 0; i < compositor->passes.count; i++){
+        CpuVfxPass* pass = &compositor->passes.items[i];
+        params = (CpuVfxParams){
+            .kind = pass->kind,
+            .renderArea = {compositor->width, compositor->height},
+            .mediaArea = {frameIn->width, frameIn->height},
+            .scale = {1.0f, 1.0f},
+            .color = {1.0f, 1.0f, 1.0f, 1.0f},
+            .program = pass->program,
+        };
+        if(pass->kind == CPU_VFX_SPIRV){
+            // same push constant block gpu pipeline gets
+            size_t size = sizeof(params.renderArea) + sizeof(params.mediaArea) + pass->push_constants_size;
+            if(compositor->pushConstantsCapacity < size){
+                uint8_t* pushConstants = realloc(compositor->pushConstants, size);
+                if(pushConstants == NULL) return false;
+                compositor->pushConstants = pushConstants;
+                compositor->pushConstantsCapacity = size;
+            }
+            memcpy(compositor->pushConstants, params.renderArea, sizeof(params.renderArea));
+            memcpy(compositor->pushConstants + sizeof(params.renderArea), params.mediaArea, sizeof(params.mediaArea));
+            if(pass->push_constants_size > 0) memcpy(compositor->pushConstants + sizeof(params.renderArea) + sizeof(params.mediaArea), pass->push_constants_data, pass->push_constants_size);
+            params.pushConstants = compositor->pushConstants;
+            params.pushConstantsSize = size;
+        }else if(pass->push_constants_data != NULL){
+            if(pass->kind == CPU_VFX_TRANSLATE){
+                memcpy(params.offset, pass->push_constants_data, sizeof(params.offset));
+                memcpy(params.scale, (const uint8_t*)pass->push_constants_data + sizeof(params.offset), sizeof(params.scale));
+            }else if(pass->kind == CPU_VFX_COLORING){
+                memcpy(params.color, pass->push_constants_data, sizeof(params.color));
+            }
+        }
+
+        CpuImage* next = current == &compositor->targets[0] ? &compositor->targets[1] : &compositor->targets[0];
+        if(!CpuCompositor_run_pass(compositor, current, next, &params, false, NULL)) return false;
+        current = next;
+    }
+
+    params = (CpuVfxParams){.kind = CPU_VFX_NONE};
+    if(!CpuCompositor_run_pass(compositor, current, &compositor->composed, &params, true, &composeRect)) return false;
+
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef FVFX_CPU_COMPOSITOR
+#define FVFX_CPU_COMPOSITOR
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "ffmpeg_media.h"
+#include "project_module.h"
+#include "thread_pool.h"
+#include "spirv_interpreter.h"
+
+// addons that have a built in cpu implementation, matched by file name
+typedef enum{
+    CPU_VFX_NONE = 0,
+    CPU_VFX_FIT,
+    CPU_VFX_TRANSLATE,
+    CPU_VFX_GRAYSCALE,
+    CPU_VFX_COLORING,
+    CPU_VFX_SPIRV, // any other addon, its compiled spirv gets interpreted
+    CPU_VFX_COUNT
+} CpuVfxKind;
+
+typedef struct{
+    CpuVfxKind kind;
+    const void* push_constants_data; // same bytes that gpu version gets after renderArea/mediaArea
+    size_t push_constants_size;
+    const SpirvProgram* program; // only for CPU_VFX_SPIRV
+} CpuVfxPass;
+
+typedef struct{
+    CpuVfxPass* items;
+    size_t count;
+    size_t capacity;
+} CpuVfxPasses;
+
+// RGBA8 pixels laid out the same way as decoded frames
+typedef struct{
+    uint32_t* pixels;
+    size_t width;
+    size_t height;
+} CpuImage;
+
+// pixels a pass touches, everything outside stays as it was
+typedef struct{
+    size_t x;
+    size_t y;
+    size_t width;
+    size_t height;
+} CpuRect;
+
+typedef struct CpuPassTile CpuPassTile;
+
+// software version of default copy/composite path, every pass is split into row tiles over thread pool
+typedef struct{
+    ThreadPool* threadPool;
+    size_t width;
+    size_t height;
+    CpuImage targets[2];
+    CpuImage composed;
+    CpuVfxPasses passes; // filled by caller before CpuCompositor_compose_layer
+    CpuPassTile* tiles;
+    SpirvState** spirvStates; // one per tile so interpreted passes don't share registers
+    size_t tilesCount;
+    uint8_t* pushConstants; // renderArea, mediaArea and inputs of interpreted pass
+    size_t pushConstantsCapacity;
+} CpuCompositor;
+
+// returns CPU_VFX_NONE when module has no cpu implementation or its inputs don't match the built in one
+CpuVfxKind cpu_vfx_kind_from_module(VfxModule* module);
+
+bool CpuCompositor_init(CpuCompositor* compositor, size_t width, size_t height, ThreadPool* threadPool);
+void CpuCompositor_uninit(CpuCompositor* compositor);
+// has to be called at the start of every output frame
+void CpuCompositor_clear(CpuCompositor* compositor);
+// draws frame, runs compositor->passes on it and blends result over composeRect of composed image
+bool CpuCompositor_compose_layer(CpuCompositor* compositor, VideoFrame* frameIn, CpuRect composeRect);
+
+#endif
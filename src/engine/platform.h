@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 
 void platform_create_window(const char* title, size_t width, size_t height);
 bool platform_window_handle_events();
@@ -22,5 +23,21 @@ bool platform_free_dynamic_library(void* dll);
 void* platform_load_dynamic_library(const char* dll);
 void* platform_load_dynamic_function(void* dll, const char* funName);
 
+typedef int (*PlatformThreadProc)(void* arg);
+void* platform_thread_create(PlatformThreadProc proc, void* arg);
+void platform_thread_join(void* thread);
+size_t platform_get_cpu_count();
+
+void* platform_mutex_create();
+void platform_mutex_lock(void* mutex);
+void platform_mutex_unlock(void* mutex);
+void platform_mutex_destroy(void* mutex);
+
+void* platform_cond_create();
+void platform_cond_wait(void* cond, void* mutex);
+void platform_cond_signal(void* cond);
+void platform_cond_broadcast(void* cond);
+void platform_cond_destroy(void* cond);
+
 extern bool platform_window_minimized;
 #endif
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <X11/extensions/Xrandr.h>
 #include <X11/Xutil.h>
 #include <dlfcn.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <stdint.h>
@@ -372,4 +373,65 @@ void* platform_load_dynamic_function(void* dll, const char* funName){
     void* proc = dlsym(dll, funName);
 
     return proc;
-}
\ No newline at end of file
+}
+
+typedef struct{
+    PlatformThreadProc proc;
+    void* arg;
+} PlatformThreadStart;
+
+static void* platform_thread_entry(void* arg){
+    PlatformThreadStart start = *(PlatformThreadStart*)arg;
+    free(arg);
+    return (void*)(intptr_t)start.proc(start.arg);
+}
+
+void* platform_thread_create(PlatformThreadProc proc, void* arg){
+    PlatformThreadStart* start = malloc(sizeof(*start));
+    if(start == NULL) return NULL;
+    start->proc = proc;
+    start->arg = arg;
+
+    pthread_t* thread = malloc(sizeof(*thread));
+    if(thread == NULL || pthread_create(thread, NULL, platform_thread_entry, start) != 0){
+        free(thread);
+        free(start);
+        return NULL;
+    }
+    return thread;
+}
+
+void platform_thread_join(void* thread){
+    pthread_join(*(pthread_t*)thread, NULL);
+    free(thread);
+}
+
+size_t platform_get_cpu_count(){
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+}
+
+void* platform_mutex_create(){
+    pthread_mutex_t* mutex = malloc(sizeof(*mutex));
+    if(mutex) pthread_mutex_init(mutex, NULL);
+    return mutex;
+}
+void platform_mutex_lock(void* mutex){ pthread_mutex_lock(mutex); }
+void platform_mutex_unlock(void* mutex){ pthread_mutex_unlock(mutex); }
+void platform_mutex_destroy(void* mutex){
+    pthread_mutex_destroy(mutex);
+    free(mutex);
+}
+
+void* platform_cond_create(){
+    pthread_cond_t* cond = malloc(sizeof(*cond));
+    if(cond) pthread_cond_init(cond, NULL);
+    return cond;
+}
+void platform_cond_wait(void* cond, void* mutex){ pthread_cond_wait(cond, mutex); }
+void platform_cond_signal(void* cond){ pthread_cond_signal(cond); }
+void platform_cond_broadcast(void* cond){ pthread_cond_broadcast(cond); }
+void platform_cond_destroy(void* cond){
+    pthread_cond_destroy(cond);
+    free(cond);
+}
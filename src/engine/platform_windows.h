@@ -464,6 +464,61 @@ void* platform_load_dynamic_function(void* dll, const char* funName)
   return (void*)proc;
 }
 
+typedef struct{
+    PlatformThreadProc proc;
+    void* arg;
+} PlatformThreadStart;
+
+static DWORD WINAPI platform_thread_entry(LPVOID arg){
+    PlatformThreadStart start = *(PlatformThreadStart*)arg;
+    free(arg);
+    return (DWORD)start.proc(start.arg);
+}
+
+void* platform_thread_create(PlatformThreadProc proc, void* arg){
+    PlatformThreadStart* start = malloc(sizeof(*start));
+    if(start == NULL) return NULL;
+    start->proc = proc;
+    start->arg = arg;
+
+    HANDLE thread = CreateThread(NULL, 0, platform_thread_entry, start, 0, NULL);
+    if(thread == NULL){
+        free(start);
+        return NULL;
+    }
+    return thread;
+}
+
+void platform_thread_join(void* thread){
+    WaitForSingleObject((HANDLE)thread, INFINITE);
+    CloseHandle((HANDLE)thread);
+}
+
+size_t platform_get_cpu_count(){
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (size_t)info.dwNumberOfProcessors : 1;
+}
+
+void* platform_mutex_create(){
+    SRWLOCK* mutex = malloc(sizeof(*mutex));
+    if(mutex) InitializeSRWLock(mutex);
+    return mutex;
+}
+void platform_mutex_lock(void* mutex){ AcquireSRWLockExclusive((SRWLOCK*)mutex); }
+void platform_mutex_unlock(void* mutex){ ReleaseSRWLockExclusive((SRWLOCK*)mutex); }
+void platform_mutex_destroy(void* mutex){ free(mutex); }
+
+void* platform_cond_create(){
+    CONDITION_VARIABLE* cond = malloc(sizeof(*cond));
+    if(cond) InitializeConditionVariable(cond);
+    return cond;
+}
+void platform_cond_wait(void* cond, void* mutex){ SleepConditionVariableSRW((CONDITION_VARIABLE*)cond, (SRWLOCK*)mutex, INFINITE, 0); }
+void platform_cond_signal(void* cond){ WakeConditionVariable((CONDITION_VARIABLE*)cond); }
+void platform_cond_broadcast(void* cond){ WakeAllConditionVariable((CONDITION_VARIABLE*)cond); }
+void platform_cond_destroy(void* cond){ free(cond); }
+
 #ifndef DEBUG
 
 int main();
@@ -2,9 +2,17 @@
 #define TRIEX_VULKAN_COMPILE_SHADER
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <vulkan/vulkan.h>
 #include "shaderc/shaderc.h"
 
 bool vkCompileShader(VkDevice device, const char* inputText, shaderc_shader_kind shaderKind, VkShaderModule* outShader);
 
-#endif
\ No newline at end of file
+// safe to call from multiple threads, each thread keeps its own shaderc compiler alive
+// spirvOut has to be freed by the caller
+bool vkCompileShaderToSpirv(const char* inputText, shaderc_shader_kind shaderKind, const char* inputName, uint32_t** spirvOut, size_t* spirvSizeOut);
+// frees compiler of calling thread, threads that compiled have to call it before exiting
+void vkReleaseThreadCompiler();
+bool vkCreateShaderModuleFromSpirv(VkDevice device, const uint32_t* spirv, size_t spirvSize, VkShaderModule* outShader);
+
+#endif
@@ -10,41 +10,75 @@
 
 #include "vulkan_compileShader.h"
 
-bool vkCompileShader(VkDevice device, const char* inputText, shaderc_shader_kind shaderKind, VkShaderModule* outShader){
-    shaderc_compiler_t compiler = shaderc_compiler_initialize();
+// initializing shaderc is way more expensive than compiling a small shader so every thread keeps its compiler around
+static _Thread_local shaderc_compiler_t threadCompiler = NULL;
+
+static shaderc_compiler_t getThreadCompiler(){
+    if(threadCompiler == NULL) threadCompiler = shaderc_compiler_initialize();
+    return threadCompiler;
+}
+
+void vkReleaseThreadCompiler(){
+    if(threadCompiler == NULL) return;
+    shaderc_compiler_release(threadCompiler);
+    threadCompiler = NULL;
+}
+
+bool vkCompileShaderToSpirv(const char* inputText, shaderc_shader_kind shaderKind, const char* inputName, uint32_t** spirvOut, size_t* spirvSizeOut){
+    shaderc_compiler_t compiler = getThreadCompiler();
+    if(compiler == NULL){
+        printf("ERROR: Couldn't initialize shaderc compiler\n");
+        return false;
+    }
 
-    shaderc_compilation_result_t result = shaderc_compile_into_spv( compiler, inputText, strlen(inputText), shaderKind, "internalVert", "main", NULL);
+    shaderc_compilation_result_t result = shaderc_compile_into_spv(compiler, inputText, strlen(inputText), shaderKind, inputName, "main", NULL);
 
     shaderc_compilation_status status = shaderc_result_get_compilation_status(result);
     if(status != shaderc_compilation_status_success){
         const char* errors = shaderc_result_get_error_message(result);
-        printf("ERROR (compiling shader): \n%s\n---------------------------\n%s\n", inputText,errors);
-        
+        printf("ERROR (compiling shader %s): \n%s\n---------------------------\n%s\n", inputName, inputText, errors);
+
         shaderc_result_release(result);
-        shaderc_compiler_release(compiler);
 
         return false;
     }
 
-    const char* compiledShader = shaderc_result_get_bytes(result);
     size_t compiledSize = shaderc_result_get_length(result);
+    uint32_t* spirv = malloc(compiledSize);
+    if(spirv == NULL){
+        shaderc_result_release(result);
+        return false;
+    }
+    memcpy(spirv, shaderc_result_get_bytes(result), compiledSize);
+    shaderc_result_release(result);
+
+    *spirvOut = spirv;
+    *spirvSizeOut = compiledSize;
+    return true;
+}
 
+bool vkCreateShaderModuleFromSpirv(VkDevice device, const uint32_t* spirv, size_t spirvSize, VkShaderModule* outShader){
     VkShaderModuleCreateInfo shaderModuleCreateInfo = {0};
     shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     shaderModuleCreateInfo.pNext = NULL;
     shaderModuleCreateInfo.flags = 0;
-    shaderModuleCreateInfo.codeSize = compiledSize;
-    shaderModuleCreateInfo.pCode = (uint32_t*)compiledShader;
+    shaderModuleCreateInfo.codeSize = spirvSize;
+    shaderModuleCreateInfo.pCode = spirv;
 
-    VkResult vresult = vkCreateShaderModule(device, &shaderModuleCreateInfo, NULL, outShader);
-
-    shaderc_result_release(result);
-    shaderc_compiler_release(compiler);
-
-    if(vresult != VK_SUCCESS){
+    if(vkCreateShaderModule(device, &shaderModuleCreateInfo, NULL, outShader) != VK_SUCCESS){
         printf("ERROR: Couldn't create shader module\n");
         return false;
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+bool vkCompileShader(VkDevice device, const char* inputText, shaderc_shader_kind shaderKind, VkShaderModule* outShader){
+    uint32_t* spirv;
+    size_t spirvSize;
+    if(!vkCompileShaderToSpirv(inputText, shaderKind, "internalVert", &spirv, &spirvSize)) return false;
+
+    bool result = vkCreateShaderModuleFromSpirv(device, spirv, spirvSize, outShader);
+    free(spirv);
+    return result;
+}
@@ -204,7 +204,7 @@ bool vkCreateGraphicPipeline_opts(CreateGraphicsPipelineARGS args){
     graphicsPipelineCreateInfo.basePipelineIndex = -1;    // OPTIONAL
     
 
-    result = vkCreateGraphicsPipelines(device,NULL,1,&graphicsPipelineCreateInfo,NULL,args.pipelineOUT);
+    result = vkCreateGraphicsPipelines(device,args.pipelineCache,1,&graphicsPipelineCreateInfo,NULL,args.pipelineOUT);
 
     if(result != VK_SUCCESS){
         printf("ERROR: Couldn't create graphics pipeline\n");
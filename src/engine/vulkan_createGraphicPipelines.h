@@ -19,6 +19,7 @@ typedef struct {
     bool depthTest;
     VkPrimitiveTopology topology;
     VkFormat outColorFormat;
+    VkPipelineCache pipelineCache;
 } CreateGraphicsPipelineARGS;
 
 bool vkCreateGraphicPipeline_opts(CreateGraphicsPipelineARGS args);
@@ -10,6 +10,10 @@ extern VkFormat swapchainImageFormat;
 extern VkExtent2D swapchainExtent;
 extern VkQueue graphicsQueue;
 extern VkQueue presentQueue;
+// same as graphicsQueue when device has no transfer only family
+extern VkQueue transferQueue;
+extern uint32_t graphicsQueueFamily;
+extern uint32_t transferQueueFamily;
 
 typedef struct {
     VkImage* items;
@@ -27,6 +31,7 @@ extern VkImages swapchainImages;
 extern VkImageViews swapchainImageViews;
 
 extern VkCommandPool commandPool;
+extern VkCommandPool transferCommandPool;
 extern VkDescriptorPool descriptorPool;
 
 #endif
\ No newline at end of file
@@ -2,20 +2,82 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+#define NOB_STRIP_PREFIX
+#include "nob.h"
+
 #include "vulkan/vulkan.h"
 
 #include "vulkan_globals.h"
 #include "vulkan_helpers.h"
 
-VkCommandBuffer vkCmdBeginSingleTime() {
+// every queue signals its own timeline, values have to grow in submission order which isn't the case across queues
+typedef struct{
+    VkCommandBuffer cmd;
+    uint64_t value;
+} SingleTimeSubmitted;
+
+typedef struct{
+    VkQueue* queue;
+    VkCommandPool* pool;
+    VkSemaphore timeline;
+    uint64_t value; // last signaled by submissions
+    VkCommandBuffer batch; // open until vkSubmitBatch
+    struct{
+        SingleTimeSubmitted* items;
+        size_t count;
+        size_t capacity;
+    } submitted; // command buffers freed once timeline passes their value
+} SingleTimeQueue;
+
+static SingleTimeQueue graphicsSingleTime = {.queue = &graphicsQueue, .pool = &commandPool};
+static SingleTimeQueue transferSingleTime = {.queue = &transferQueue, .pool = &transferCommandPool};
+
+static bool singleTimeQueueInit(SingleTimeQueue* q){
+    if(q->timeline != NULL) return true;
+    VkResult result = vkCreateSemaphore(device, &(VkSemaphoreCreateInfo){
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &(VkSemaphoreTypeCreateInfo){
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+        },
+    }, NULL, &q->timeline);
+    if(result != VK_SUCCESS){
+        printf("ERROR: Couldn't create single time timeline semaphore\n");
+        return false;
+    }
+    return true;
+}
+
+static void singleTimeQueueCollect(SingleTimeQueue* q){
+    if(q->submitted.count == 0) return;
+    uint64_t completed = 0;
+    if(vkGetSemaphoreCounterValue(device, q->timeline, &completed) != VK_SUCCESS) return;
+
+    size_t kept = 0;
+    for(size_t i = 0; i < q->submitted.count; i++){
+        SingleTimeSubmitted* submitted = &q->submitted.items[i];
+        if(submitted->value <= completed){
+            vkFreeCommandBuffers(device, *q->pool, 1, &submitted->cmd);
+        }else{
+            q->submitted.items[kept++] = *submitted;
+        }
+    }
+    q->submitted.count = kept;
+}
+
+static VkCommandBuffer singleTimeQueueBegin(SingleTimeQueue* q){
+    if(!singleTimeQueueInit(q)) return NULL;
+    singleTimeQueueCollect(q);
+
     VkCommandBufferAllocateInfo allocInfo = {0};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
+    allocInfo.commandPool = *q->pool;
     allocInfo.commandBufferCount = 1;
 
     VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+    if(vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) return NULL;
 
     VkCommandBufferBeginInfo beginInfo = {0};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -26,18 +88,89 @@ VkCommandBuffer vkCmdBeginSingleTime() {
     return commandBuffer;
 }
 
-void vkCmdEndSingleTime(VkCommandBuffer commandBuffer) {
+// waitPoint semaphore can be NULL, returns point of this submission
+static TimelinePoint singleTimeQueueSubmit(SingleTimeQueue* q, VkCommandBuffer commandBuffer, TimelinePoint waitPoint){
     vkEndCommandBuffer(commandBuffer);
 
-    VkSubmitInfo submitInfo = {0};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
+    uint64_t signalValue = q->value + 1;
+    bool waits = waitPoint.semaphore != NULL;
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkResult result = vkQueueSubmit(*q->queue, 1, &(VkSubmitInfo){
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &(VkTimelineSemaphoreSubmitInfo){
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .waitSemaphoreValueCount = waits ? 1 : 0,
+            .pWaitSemaphoreValues = &waitPoint.value,
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &signalValue,
+        },
+        .waitSemaphoreCount = waits ? 1 : 0,
+        .pWaitSemaphores = &waitPoint.semaphore,
+        .pWaitDstStageMask = &waitStage,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &q->timeline,
+    }, VK_NULL_HANDLE);
+
+    if(result != VK_SUCCESS){
+        printf("ERROR: Couldn't submit single time commands\n");
+        vkFreeCommandBuffers(device, *q->pool, 1, &commandBuffer);
+        return (TimelinePoint){0};
+    }
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+    q->value = signalValue;
+    da_append(&q->submitted, ((SingleTimeSubmitted){.cmd = commandBuffer, .value = signalValue}));
+    return (TimelinePoint){.semaphore = q->timeline, .value = signalValue};
+}
 
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+VkCommandBuffer vkCmdBeginSingleTime() {
+    return singleTimeQueueBegin(&graphicsSingleTime);
+}
+
+void vkCmdEndSingleTime(VkCommandBuffer commandBuffer) {
+    if(commandBuffer == NULL) return;
+    vkWaitTimelinePoint(singleTimeQueueSubmit(&graphicsSingleTime, commandBuffer, (TimelinePoint){0}));
+    singleTimeQueueCollect(&graphicsSingleTime);
+}
+
+VkCommandBuffer vkGetBatchTransferCmd(){
+    if(transferSingleTime.batch == NULL) transferSingleTime.batch = singleTimeQueueBegin(&transferSingleTime);
+    return transferSingleTime.batch;
+}
+
+VkCommandBuffer vkGetBatchGraphicsCmd(){
+    if(graphicsSingleTime.batch == NULL) graphicsSingleTime.batch = singleTimeQueueBegin(&graphicsSingleTime);
+    return graphicsSingleTime.batch;
+}
+
+TimelinePoint vkSubmitBatch(){
+    TimelinePoint point = {0};
+    if(transferSingleTime.batch != NULL){
+        point = singleTimeQueueSubmit(&transferSingleTime, transferSingleTime.batch, point);
+        transferSingleTime.batch = NULL;
+    }
+    if(graphicsSingleTime.batch != NULL){
+        point = singleTimeQueueSubmit(&graphicsSingleTime, graphicsSingleTime.batch, point);
+        graphicsSingleTime.batch = NULL;
+    }
+    return point;
+}
+
+bool vkWaitTimelinePoint(TimelinePoint point){
+    if(point.semaphore == NULL) return true;
+    VkResult result = vkWaitSemaphores(device, &(VkSemaphoreWaitInfo){
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &point.semaphore,
+        .pValues = &point.value,
+    }, UINT64_MAX);
+    if(result != VK_SUCCESS){
+        printf("ERROR: Couldn't wait for timeline semaphore\n");
+        return false;
+    }
+    return true;
 }
 
 void vkCmdBeginRenderingEX_opt(VkCommandBuffer commandBuffer, BeginRenderingEX args){
@@ -68,7 +201,7 @@ void vkCmdBeginRenderingEX_opt(VkCommandBuffer commandBuffer, BeginRenderingEX a
 
     VkRenderingInfo renderingInfo = {0};
     renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
-    renderingInfo.renderArea.offset = (VkOffset2D){0};
+    renderingInfo.renderArea.offset = args.renderOffset;
     renderingInfo.renderArea.extent = args.renderArea;
     renderingInfo.layerCount = 1;
     renderingInfo.colorAttachmentCount = args.colorAttachment != NULL ? 1 : 0;
@@ -2,10 +2,26 @@
 #define TRIEX_VULKAN_HELPERS
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "vulkan/vulkan.h"
 VkCommandBuffer vkCmdBeginSingleTime();
+// submits on graphics queue and waits only for this submission
 void vkCmdEndSingleTime(VkCommandBuffer commandBuffer);
+
+// value a timeline semaphore reaches once submitted work finishes, semaphore NULL means there was nothing to wait for
+typedef struct{
+    VkSemaphore semaphore;
+    uint64_t value;
+} TimelinePoint;
+
+// one-off work of many resources recorded into shared command buffers and sent with single vkSubmitBatch
+// transfer batch runs on transferQueue, resources written there have to be released to graphicsQueueFamily
+// when families differ, graphics batch waits for transfer batch before starting
+VkCommandBuffer vkGetBatchTransferCmd();
+VkCommandBuffer vkGetBatchGraphicsCmd();
+TimelinePoint vkSubmitBatch();
+bool vkWaitTimelinePoint(TimelinePoint point);
 void vkCmdTransitionImage(VkCommandBuffer cmd, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkImageAspectFlags aspectMask);
 
 typedef struct {
@@ -20,6 +36,7 @@ typedef struct{
     Color clearColor;
     bool clearBackground;
     VkImageView depthAttachment;
+    VkOffset2D renderOffset;
     VkExtent2D renderArea;
 } BeginRenderingEX;
 
@@ -10,6 +10,10 @@
 #include "vulkan_internal.h"
 
 bool vkCreateImageViewEX(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkImageView* out){
+    return vkCreateImageViewMipsEX(device, image, format, aspectFlags, 1, out);
+}
+
+bool vkCreateImageViewMipsEX(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkImageView* out){
     VkImageViewCreateInfo imageViewCreateInfo = {0};
     imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     imageViewCreateInfo.pNext = NULL;
@@ -19,7 +23,7 @@ bool vkCreateImageViewEX(VkDevice device, VkImage image, VkFormat format, VkImag
     imageViewCreateInfo.format = format;
     imageViewCreateInfo.subresourceRange.aspectMask = aspectFlags;
     imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-    imageViewCreateInfo.subresourceRange.levelCount = 1;
+    imageViewCreateInfo.subresourceRange.levelCount = mipLevels;
     imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
     imageViewCreateInfo.subresourceRange.layerCount = 1;
 
@@ -34,13 +38,27 @@ bool vkCreateImageViewEX(VkDevice device, VkImage image, VkFormat format, VkImag
 }
 
 bool vkCreateImageEX(VkDevice device, size_t width, size_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags memoryProperties, VkImage* image, VkDeviceMemory* imageMemory){
+    return vkCreateImageMipsEX(device, width, height, 1, format, tiling, usage, memoryProperties, image, imageMemory);
+}
+
+uint32_t vkGetMipLevelsCount(size_t width, size_t height){
+    size_t biggest = width > height ? width : height;
+    uint32_t levels = 1;
+    while(biggest > 1){
+        biggest /= 2;
+        levels++;
+    }
+    return levels;
+}
+
+bool vkCreateImageMipsEX(VkDevice device, size_t width, size_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags memoryProperties, VkImage* image, VkDeviceMemory* imageMemory){
     VkImageCreateInfo imageCreateInfo = {0};
     imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
     imageCreateInfo.extent.width = width;
     imageCreateInfo.extent.height = height;
     imageCreateInfo.extent.depth = 1;
-    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.mipLevels = mipLevels;
     imageCreateInfo.arrayLayers = 1;
     imageCreateInfo.format = format;
     imageCreateInfo.tiling = tiling;
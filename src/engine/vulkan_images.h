@@ -5,7 +5,10 @@
 #include <vulkan/vulkan.h>
 
 bool vkCreateImageViewEX(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkImageView* out);
+bool vkCreateImageViewMipsEX(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkImageView* out);
 bool vkCreateImageEX(VkDevice device, size_t width, size_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags memoryProperties, VkImage* image, VkDeviceMemory* imageMemory);
+bool vkCreateImageMipsEX(VkDevice device, size_t width, size_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags memoryProperties, VkImage* image, VkDeviceMemory* imageMemory);
+uint32_t vkGetMipLevelsCount(size_t width, size_t height);
 size_t vkGetImageStride(VkDevice device, VkImage image);
 
 #endif
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include "vulkan_internal.h"
 
 VkCommandPool commandPool;
+VkCommandPool transferCommandPool;
 
 bool initCommandPool(){
     
@@ -30,5 +31,13 @@ bool initCommandPool(){
         return false;
     }
 
+    // own pool even when transfer queue is the graphics one so batches never share command buffers with frames
+    commandPoolInfo.queueFamilyIndex = transferQueueFamily;
+    result = vkCreateCommandPool(device,&commandPoolInfo,NULL,&transferCommandPool);
+    if(result != VK_SUCCESS){
+        printf("ERROR: Couldn't create transfer command pool\n");
+        return false;
+    }
+
     return true;
 }
\ No newline at end of file
@@ -15,6 +15,9 @@ VkPhysicalDevice physicalDevice;
 VkPhysicalDeviceLimits physicalDeviceLimits;
 VkQueue graphicsQueue;
 VkQueue presentQueue;
+VkQueue transferQueue;
+uint32_t graphicsQueueFamily;
+uint32_t transferQueueFamily;
 VkPhysicalDeviceMemoryProperties physicalMemoryProperties;
 MultipleVkQueueFamilyProperties multipleQueueFamilyProperties;
 
@@ -108,6 +111,16 @@ bool initDevice(){
         printf("ERROR: Couldn't find graphics queue\n");
     }
 
+    // family with transfer only (usually dma engine) lets uploads run next to rendering, graphics queue is used otherwise
+    int transferQueueFamilyIndex = -1;
+    for(size_t i = 0; i < multipleQueueFamilyProperties.count; i++){
+        VkQueueFlags flags = multipleQueueFamilyProperties.items[i].queueFlags;
+        if((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))){
+            transferQueueFamilyIndex = i;
+            break;
+        }
+    }
+
     // if(presentQueueFamilyIndex == -1){
     //     printf("ERROR: Couldn't find present queue\n");
     //     return false;
@@ -131,6 +144,7 @@ bool initDevice(){
 
     // If present queue familly is different from graphics queue one we repeat the process
     if(presentQueueFamilyIndex != -1 && graphicsQueueFamilyIndex != presentQueueFamilyIndex){
+        vkQueuePriorities = (VkQueuePriorities){0};
         for(size_t j = 0; j < multipleQueueFamilyProperties.items[presentQueueFamilyIndex].queueCount; j++){
             da_append(&vkQueuePriorities, 1.0);
         }
@@ -145,6 +159,18 @@ bool initDevice(){
         da_append(&queueCreateInfos, queueCreateInfo);
     }
 
+    // single queue is enough for uploads
+    static float transferQueuePriority = 1.0f;
+    if(transferQueueFamilyIndex != -1 && transferQueueFamilyIndex != presentQueueFamilyIndex){
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.pNext = NULL;
+        queueCreateInfo.flags = 0;
+        queueCreateInfo.queueFamilyIndex = transferQueueFamilyIndex;
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfo.pQueuePriorities = &transferQueuePriority;
+        da_append(&queueCreateInfos, queueCreateInfo);
+    }
+
     if(queueCreateInfos.count == 0){
         printf("ERROR: Your physical device doesn't have any Of needed queues\n");
         return false;
@@ -162,7 +188,21 @@ bool initDevice(){
         // ... add other features you need
     };
 
+    // core since 1.2, used for tracking gpu progress without fences
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        .timelineSemaphore = VK_TRUE,
+    };
+
+    // core since 1.3, lets barriers carry only stages and accesses that are actually involved
+    VkPhysicalDeviceSynchronization2Features synchronization2Features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES,
+        .synchronization2 = VK_TRUE,
+    };
+
     dynamicRenderingFeature.pNext = &indexingFeatures;
+    indexingFeatures.pNext = &timelineSemaphoreFeatures;
+    timelineSemaphoreFeatures.pNext = &synchronization2Features;
 
     VkDeviceCreateInfo deviceInfo = {0};
     deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -192,5 +232,15 @@ bool initDevice(){
 
     vkGetDeviceQueue(device, graphicsQueueFamilyIndex, 0, &graphicsQueue);
     if(presentQueueFamilyIndex != -1) vkGetDeviceQueue(device, presentQueueFamilyIndex, 0, &presentQueue);
+
+    graphicsQueueFamily = graphicsQueueFamilyIndex;
+    if(transferQueueFamilyIndex != -1){
+        transferQueueFamily = transferQueueFamilyIndex;
+        vkGetDeviceQueue(device, transferQueueFamily, 0, &transferQueue);
+        printf("INFO: Using dedicated transfer queue family %u\n", transferQueueFamily);
+    }else{
+        transferQueueFamily = graphicsQueueFamily;
+        transferQueue = graphicsQueue;
+    }
     return true;
 }
\ No newline at end of file
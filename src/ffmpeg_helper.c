@@ -4,123 +4,258 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
-void mix_audio(uint8_t** base, uint8_t** added,size_t nb_samples, size_t num_channels,enum AVSampleFormat sample_fmt,double volume, double panning)
-{
-    if (sample_fmt != AV_SAMPLE_FMT_FLTP && sample_fmt != AV_SAMPLE_FMT_FLT) {
-        assert(0 && "Unsupported sample format");
-        return;
-    }
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIX_AUDIO_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MIX_AUDIO_NEON
+#include <arm_neon.h>
+#endif
 
-    if (num_channels != 1 && num_channels != 2) {
-        assert(0 && "Only mono and stereo supported");
-        return;
+// -1 for speakers on the left, 1 on the right, 0 for center ones and lfe
+static int mix_audio_channel_side(enum AVChannel channel)
+{
+    switch (channel) {
+        case AV_CHAN_FRONT_LEFT:
+        case AV_CHAN_BACK_LEFT:
+        case AV_CHAN_SIDE_LEFT:
+        case AV_CHAN_FRONT_LEFT_OF_CENTER:
+        case AV_CHAN_WIDE_LEFT:
+        case AV_CHAN_SURROUND_DIRECT_LEFT:
+        case AV_CHAN_TOP_FRONT_LEFT:
+        case AV_CHAN_TOP_BACK_LEFT:
+            return -1;
+        case AV_CHAN_FRONT_RIGHT:
+        case AV_CHAN_BACK_RIGHT:
+        case AV_CHAN_SIDE_RIGHT:
+        case AV_CHAN_FRONT_RIGHT_OF_CENTER:
+        case AV_CHAN_WIDE_RIGHT:
+        case AV_CHAN_SURROUND_DIRECT_RIGHT:
+        case AV_CHAN_TOP_FRONT_RIGHT:
+        case AV_CHAN_TOP_BACK_RIGHT:
+            return 1;
+        default:
+            return 0;
     }
+}
 
+void mix_audio_gains(double volume, double panning, const AVChannelLayout* ch_layout, float* gainsOut)
+{
     // Clamp panning to [-1, 1]
     if (panning < -1.0) panning = -1.0;
     if (panning >  1.0) panning =  1.0;
 
-    // Compute left/right gain based on panning
-    // Equal power panning law (keeps perceived loudness constant)
-    float left_gain, right_gain;
-    if (num_channels == 1) {
-        left_gain = right_gain = 1.0f; // irrelevant, mono only
-    } else {
+    size_t num_channels = ch_layout->nb_channels;
+    if (num_channels == 2) {
+        // Equal power panning law (keeps perceived loudness constant)
         float angle = (float)((panning + 1.0) * M_PI_4); // maps [-1,1] -> [0, π/2]
-        left_gain  = cosf(angle);
-        right_gain = sinf(angle);
+        gainsOut[0] = (float)volume * cosf(angle);
+        gainsOut[1] = (float)volume * sinf(angle);
+        return;
     }
 
-    if (sample_fmt == AV_SAMPLE_FMT_FLTP) {
-        // Planar float
-        for (size_t ch = 0; ch < num_channels; ch++) {
-            float *base_ch  = (float*) base[ch];
-            float *added_ch = (float*) added[ch];
+    // centered surround layer keeps every speaker at volume so its own mix stays intact,
+    // panning fades opposite side out along the same quarter cosine
+    float left = panning > 0 ? cosf((float)(panning * M_PI_2)) : 1.0f;
+    float right = panning < 0 ? cosf((float)(-panning * M_PI_2)) : 1.0f;
+    for (size_t ch = 0; ch < num_channels && ch < MIX_AUDIO_MAX_CHANNELS; ch++) {
+        int side = num_channels == 1 ? 0 : mix_audio_channel_side(av_channel_layout_channel_from_index(ch_layout, ch));
+        gainsOut[ch] = (float)volume * (side < 0 ? left : side > 0 ? right : 1.0f);
+    }
+}
 
-            float ch_gain = 1.0f;
-            if (num_channels == 2) {
-                ch_gain = (ch == 0) ? left_gain : right_gain;
+// dst[e] += src[e] * gain, element e is frame e/stride of channel e%stride
+// gain of channel c at frame i is gainStart[c] + gainStep[c]*i
+static void mix_ramp(float* dst, const float* src, size_t count, size_t stride, const float* gainStart, const float* gainStep)
+{
+    size_t e = 0;
+
+#if defined(MIX_AUDIO_SSE) || defined(MIX_AUDIO_NEON)
+    // lane gains repeat every whole number of frames that is also a multiple of 4 lanes,
+    // at least 8 elements so mono and stereo still get two vectors per iteration
+    size_t period = stride;
+    while (period % 4 != 0 || period < 8) period += stride;
+    size_t vectors = period / 4;
+    float frames = (float)(period / stride);
+    float lanes[MIX_AUDIO_MAX_CHANNELS * 4], lanesStep[MIX_AUDIO_MAX_CHANNELS * 4];
+    if (stride <= MIX_AUDIO_MAX_CHANNELS) {
+        for (size_t l = 0; l < period; l++) {
+            size_t ch = l % stride;
+            lanes[l] = gainStart[ch] + gainStep[ch] * (float)(l / stride);
+            lanesStep[l] = gainStep[ch] * frames;
+        }
+#ifdef MIX_AUDIO_SSE
+        __m128 gain[MIX_AUDIO_MAX_CHANNELS], step[MIX_AUDIO_MAX_CHANNELS];
+        for (size_t v = 0; v < vectors; v++) {
+            gain[v] = _mm_loadu_ps(lanes + v*4);
+            step[v] = _mm_loadu_ps(lanesStep + v*4);
+        }
+        for (; e + period <= count; e += period) {
+            for (size_t v = 0; v < vectors; v++) {
+                float* d = dst + e + v*4;
+                _mm_storeu_ps(d, _mm_add_ps(_mm_loadu_ps(d), _mm_mul_ps(_mm_loadu_ps(src + e + v*4), gain[v])));
+                gain[v] = _mm_add_ps(gain[v], step[v]);
             }
+        }
+#else
+        float32x4_t gain[MIX_AUDIO_MAX_CHANNELS], step[MIX_AUDIO_MAX_CHANNELS];
+        for (size_t v = 0; v < vectors; v++) {
+            gain[v] = vld1q_f32(lanes + v*4);
+            step[v] = vld1q_f32(lanesStep + v*4);
+        }
+        for (; e + period <= count; e += period) {
+            for (size_t v = 0; v < vectors; v++) {
+                float* d = dst + e + v*4;
+                vst1q_f32(d, vmlaq_f32(vld1q_f32(d), vld1q_f32(src + e + v*4), gain[v]));
+                gain[v] = vaddq_f32(gain[v], step[v]);
+            }
+        }
+#endif
+    }
+#endif
 
-            for (size_t i = 0; i < nb_samples; i++) {
-                float mixed = base_ch[i] + (added_ch[i] * (float)volume * ch_gain);
+    for (; e < count; e++) {
+        size_t ch = e % stride;
+        dst[e] += src[e] * (gainStart[ch] + gainStep[ch] * (float)(e / stride));
+    }
+}
 
-                if (mixed > 1.0f)  mixed = 1.0f;
-                if (mixed < -1.0f) mixed = -1.0f;
+void mix_audio(uint8_t** base, uint8_t** added, size_t nb_samples, size_t num_channels, enum AVSampleFormat sample_fmt, const float* gainStart, const float* gainEnd)
+{
+    if (sample_fmt != AV_SAMPLE_FMT_FLTP && sample_fmt != AV_SAMPLE_FMT_FLT) {
+        assert(0 && "Unsupported sample format");
+        return;
+    }
 
-                base_ch[i] = mixed;
-            }
+    if (num_channels == 0 || num_channels > MIX_AUDIO_MAX_CHANNELS || nb_samples == 0) return;
+
+    // ramp ends exactly at gainEnd on the first frame of the next buffer
+    float gainStep[MIX_AUDIO_MAX_CHANNELS];
+    for (size_t ch = 0; ch < num_channels; ch++) {
+        gainStep[ch] = (gainEnd[ch] - gainStart[ch]) / (float)nb_samples;
+    }
+
+    if (sample_fmt == AV_SAMPLE_FMT_FLTP) {
+        for (size_t ch = 0; ch < num_channels; ch++) {
+            mix_ramp((float*)base[ch], (const float*)added[ch], nb_samples, 1, &gainStart[ch], &gainStep[ch]);
         }
+    } else {
+        mix_ramp((float*)base[0], (const float*)added[0], nb_samples * num_channels, num_channels, gainStart, gainStep);
+    }
+}
+
+static void mix_scale(float* buf, size_t count, float gain)
+{
+    size_t i = 0;
+#if defined(MIX_AUDIO_SSE)
+    __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+    }
+#elif defined(MIX_AUDIO_NEON)
+    float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(buf + i, vmulq_f32(vld1q_f32(buf + i), g));
+    }
+#endif
+    for (; i < count; i++) buf[i] *= gain;
+}
 
+void mix_audio_scale(uint8_t** buf, size_t nb_samples, size_t num_channels, enum AVSampleFormat sample_fmt, float gain)
+{
+    if (sample_fmt == AV_SAMPLE_FMT_FLTP) {
+        for (size_t ch = 0; ch < num_channels; ch++) mix_scale((float*)buf[ch], nb_samples, gain);
     } else if (sample_fmt == AV_SAMPLE_FMT_FLT) {
-        // Interleaved float
-        float *base_packed  = (float*) base[0];
-        float *added_packed = (float*) added[0];
-
-        for (size_t i = 0; i < nb_samples; i++) {
-            if (num_channels == 1) {
-                // Mono
-                float mixed = base_packed[i] + (added_packed[i] * (float)volume);
-
-                if (mixed > 1.0f)  mixed = 1.0f;
-                if (mixed < -1.0f) mixed = -1.0f;
-
-                base_packed[i] = mixed;
-            } else {
-                // Stereo: L = even index, R = odd index
-                size_t li = i * 2;
-                size_t ri = li + 1;
-
-                float left_mixed  = base_packed[li] + (added_packed[li] * (float)volume * left_gain);
-                float right_mixed = base_packed[ri] + (added_packed[ri] * (float)volume * right_gain);
-
-                if (left_mixed > 1.0f)  left_mixed = 1.0f;
-                if (left_mixed < -1.0f) left_mixed = -1.0f;
-                if (right_mixed > 1.0f)  right_mixed = 1.0f;
-                if (right_mixed < -1.0f) right_mixed = -1.0f;
-
-                base_packed[li] = left_mixed;
-                base_packed[ri] = right_mixed;
-            }
-        }
+        mix_scale((float*)buf[0], nb_samples * num_channels, gain);
+    } else {
+        assert(0 && "Unsupported sample format");
+    }
+}
+
+static void mix_finish(float* buf, size_t count, float gain)
+{
+    size_t i = 0;
+#if defined(MIX_AUDIO_SSE)
+    __m128 g = _mm_set1_ps(gain);
+    __m128 hi = _mm_set1_ps(1.0f);
+    __m128 lo = _mm_set1_ps(-1.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(buf + i), g);
+        _mm_storeu_ps(buf + i, _mm_min_ps(_mm_max_ps(v, lo), hi));
+    }
+#elif defined(MIX_AUDIO_NEON)
+    float32x4_t g = vdupq_n_f32(gain);
+    float32x4_t hi = vdupq_n_f32(1.0f);
+    float32x4_t lo = vdupq_n_f32(-1.0f);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t v = vmulq_f32(vld1q_f32(buf + i), g);
+        vst1q_f32(buf + i, vminq_f32(vmaxq_f32(v, lo), hi));
+    }
+#endif
+    for (; i < count; i++) {
+        float v = buf[i] * gain;
+        if (v > 1.0f)  v = 1.0f;
+        if (v < -1.0f) v = -1.0f;
+        buf[i] = v;
     }
 }
 
+void mix_audio_finish(uint8_t** buf, size_t nb_samples, size_t num_channels, enum AVSampleFormat sample_fmt, float gain)
+{
+    if (sample_fmt == AV_SAMPLE_FMT_FLTP) {
+        for (size_t ch = 0; ch < num_channels; ch++) mix_finish((float*)buf[ch], nb_samples, gain);
+    } else if (sample_fmt == AV_SAMPLE_FMT_FLT) {
+        mix_finish((float*)buf[0], nb_samples * num_channels, gain);
+    } else {
+        assert(0 && "Unsupported sample format");
+    }
+}
+
+void audio_silence_free(AudioSilence* silence)
+{
+    free(silence->data);
+    *silence = (AudioSilence){0};
+}
+
 int av_audio_fifo_add_silence(AVAudioFifo *af,
                               enum AVSampleFormat sample_fmt,
                               const AVChannelLayout *ch_layout,
-                              int nb_samples)
+                              int nb_samples,
+                              AudioSilence* silence)
 {
-    if (!af || !ch_layout || nb_samples <= 0)
+    if (!af || !ch_layout || !silence || nb_samples <= 0)
         return AVERROR(EINVAL);
 
     int nb_channels = ch_layout->nb_channels;
-    int ret;
-
-    uint8_t **data = NULL;
-    ret = av_samples_alloc_array_and_samples(&data, NULL,
-                                             nb_channels,
-                                             nb_samples,
-                                             sample_fmt,
-                                             0);
-    if (ret < 0)
-        return ret;
-
-    ret = av_samples_set_silence(data,
-                                 0,
-                                 nb_samples,
-                                 nb_channels,
-                                 sample_fmt);
-    if (ret < 0) {
-        av_freep(&data[0]);
-        av_freep(&data);
-        return ret;
-    }
-
-    ret = av_audio_fifo_write(af, (void **)data, nb_samples);
-
-    av_freep(&data[0]);
-    av_freep(&data);
-    return ret;
-}
\ No newline at end of file
+    int bytes_per_sample = av_get_bytes_per_sample(sample_fmt);
+    if (nb_channels <= 0 || nb_channels > MIX_AUDIO_MAX_FIFO_CHANNELS || bytes_per_sample <= 0)
+        return AVERROR(EINVAL);
+
+    bool planar = av_sample_fmt_is_planar(sample_fmt);
+    size_t size = (size_t)nb_samples * bytes_per_sample * (planar ? 1 : nb_channels);
+
+    // written once and only ever read afterwards, every plane of planar write can point at the same memory
+    if (size > silence->size || sample_fmt != silence->fmt) {
+        if (size > silence->size) {
+            uint8_t* grown = realloc(silence->data, size);
+            if (!grown)
+                return AVERROR(ENOMEM);
+            silence->data = grown;
+            silence->size = size;
+        }
+        // unsigned 8 bit is the only format whose silence isn't all zero bytes
+        bool u8 = sample_fmt == AV_SAMPLE_FMT_U8 || sample_fmt == AV_SAMPLE_FMT_U8P;
+        memset(silence->data, u8 ? 0x80 : 0, silence->size);
+        silence->fmt = sample_fmt;
+    }
+
+    void* data[MIX_AUDIO_MAX_FIFO_CHANNELS];
+    for (int ch = 0; ch < nb_channels; ch++) data[ch] = silence->data;
+
+    return av_audio_fifo_write(af, data, nb_samples);
+}
@@ -8,7 +8,32 @@
 #include <libswresample/swresample.h>
 #include <libavutil/audio_fifo.h>
 
-void mix_audio(uint8_t** base, uint8_t** added,size_t nb_samples, size_t num_channels,enum AVSampleFormat sample_fmt,double volume, double panning);
-int av_audio_fifo_add_silence(AVAudioFifo *af, enum AVSampleFormat sample_fmt, const AVChannelLayout *ch_layout, int nb_samples);
+// 7.1
+#define MIX_AUDIO_MAX_CHANNELS 8
+
+// per channel gains of layer volume and pan, stereo uses equal power pan,
+// surround layouts balance left against right speakers and leave center and lfe alone
+void mix_audio_gains(double volume, double panning, const AVChannelLayout* ch_layout, float* gainsOut);
+// adds added*gain to base, gain of every channel moves linearly from gainStart to gainEnd over the buffer
+// so automation changing between buffers doesn't click, nothing gets clipped here
+void mix_audio(uint8_t** base, uint8_t** added, size_t nb_samples, size_t num_channels, enum AVSampleFormat sample_fmt, const float* gainStart, const float* gainEnd);
+// multiplies buffer by gain in place, no clipping
+void mix_audio_scale(uint8_t** buf, size_t nb_samples, size_t num_channels, enum AVSampleFormat sample_fmt, float gain);
+// master gain and clipping to [-1, 1], done once on the final bus after every layer is summed
+void mix_audio_finish(uint8_t** buf, size_t nb_samples, size_t num_channels, enum AVSampleFormat sample_fmt, float gain);
+// planes of a single fifo write, far above any channel layout ffmpeg decodes
+#define MIX_AUDIO_MAX_FIFO_CHANNELS 64
+
+// silence written into a fifo, grows to the largest write and is reused after that,
+// keep one per fifo so it is only touched by whoever writes that fifo
+typedef struct{
+    uint8_t* data;
+    size_t size;
+    enum AVSampleFormat fmt;
+} AudioSilence;
+
+void audio_silence_free(AudioSilence* silence);
+// writes from preallocated silence so calling it every frame doesn't allocate
+int av_audio_fifo_add_silence(AVAudioFifo *af, enum AVSampleFormat sample_fmt, const AVChannelLayout *ch_layout, int nb_samples, AudioSilence* silence);
 
 #endif
\ No newline at end of file
@@ -3,11 +3,15 @@
 #include <string.h>
 #include <math.h>
 #include <malloc.h>
+#include <stdatomic.h>
 #include "ffmpeg_media.h"
+#include "engine/platform.h"
+#include <libavutil/opt.h>
 #include <assert.h>
 
 static bool initializeMediaContext(Media* media, const char* filename);
-static bool initializeDecoder(Media* media, size_t desiredSampleRate, bool desiredStereo, enum AVSampleFormat desiredFormat);
+static bool initializeDecoder(Media* media, size_t desiredSampleRate, const AVChannelLayout* desiredLayout, enum AVSampleFormat desiredFormat, const MediaResampleOptions* resample);
+static bool initializeAudioContext(Media* media, const char* filename);
 
 static inline bool mediaIsAnImage(Media* media){
     if(media->audioCodecContext) return false;
@@ -16,12 +20,150 @@ static inline bool mediaIsAnImage(Media* media){
     return true;
 }
 
-bool ffmpegMediaInit(const char* filename, size_t desiredSampleRate, bool desiredStereo, enum AVSampleFormat desiredFormat, Media* media) 
+// idle resamplers are kept around, swr_init on one with unchanged rates and filter options keeps its filter bank
+// so media reopened on hot reload or by waveform builder don't compute it again
+#define RESAMPLER_POOL_SIZE 16
+
+struct MediaResampler{
+    struct SwrContext* swr;
+    AVChannelLayout inLayout;
+    enum AVSampleFormat inFormat;
+    int inRate;
+    AVChannelLayout outLayout;
+    enum AVSampleFormat outFormat;
+    int outRate;
+    MediaResampleOptions options;
+    MediaResampler* next;
+};
+
+static MediaResampler* resamplerPool = NULL;
+static size_t resamplerPoolCount = 0;
+// media get opened from main and waveform thread
+static void* resamplerPoolMutex = NULL;
+static atomic_bool soxrMissingReported = false;
+
+static bool resamplerMatches(MediaResampler* resampler, const AVChannelLayout* inLayout, enum AVSampleFormat inFormat, int inRate, const AVChannelLayout* outLayout, enum AVSampleFormat outFormat, int outRate, const MediaResampleOptions* options){
+    return resampler->inFormat == inFormat && resampler->inRate == inRate &&
+           resampler->outFormat == outFormat && resampler->outRate == outRate &&
+           resampler->options.filterLength == options->filterLength && resampler->options.soxr == options->soxr &&
+           av_channel_layout_compare(&resampler->inLayout, inLayout) == 0 &&
+           av_channel_layout_compare(&resampler->outLayout, outLayout) == 0;
+}
+
+static void resamplerFree(MediaResampler* resampler){
+    swr_free(&resampler->swr);
+    av_channel_layout_uninit(&resampler->inLayout);
+    av_channel_layout_uninit(&resampler->outLayout);
+    free(resampler);
+}
+
+static MediaResampler* resamplerAcquire(const AVChannelLayout* inLayout, enum AVSampleFormat inFormat, int inRate, const AVChannelLayout* outLayout, enum AVSampleFormat outFormat, int outRate, const MediaResampleOptions* options){
+    MediaResampler* resampler = NULL;
+    platform_mutex_lock(resamplerPoolMutex);
+    for (MediaResampler** it = &resamplerPool; *it != NULL; it = &(*it)->next) {
+        if (!resamplerMatches(*it, inLayout, inFormat, inRate, outLayout, outFormat, outRate, options)) continue;
+        resampler = *it;
+        *it = resampler->next;
+        resamplerPoolCount--;
+        break;
+    }
+    platform_mutex_unlock(resamplerPoolMutex);
+
+    if (resampler) {
+        // drops history of previous stream, filter bank stays
+        if (swr_init(resampler->swr) < 0) {
+            resamplerFree(resampler);
+            return NULL;
+        }
+        resampler->next = NULL;
+        return resampler;
+    }
+
+    resampler = calloc(1, sizeof(*resampler));
+    if (!resampler) return NULL;
+    resampler->inFormat = inFormat;
+    resampler->inRate = inRate;
+    resampler->outFormat = outFormat;
+    resampler->outRate = outRate;
+    resampler->options = *options;
+    if (av_channel_layout_copy(&resampler->inLayout, inLayout) < 0 || av_channel_layout_copy(&resampler->outLayout, outLayout) < 0) {
+        resamplerFree(resampler);
+        return NULL;
+    }
+
+    // swr derives up/downmix matrix from the two layouts: center and surrounds fold into fronts at -3 dB, lfe is dropped,
+    // and upmixing only fills matching speakers so stereo in a 5.1 mix stays in front left and right
+    if (swr_alloc_set_opts2(&resampler->swr, outLayout, outFormat, outRate, inLayout, inFormat, inRate, 0, NULL) < 0) {
+        fprintf(stderr, "Couldn't set ops for resampler\n");
+        resamplerFree(resampler);
+        return NULL;
+    }
+    if (options->filterLength) av_opt_set_int(resampler->swr, "filter_size", options->filterLength, 0);
+    if (options->soxr) av_opt_set_int(resampler->swr, "resampler", SWR_ENGINE_SOXR, 0);
+
+    if (swr_init(resampler->swr) < 0) {
+        if (!options->soxr) {
+            fprintf(stderr, "Couldn't initialize resampler\n");
+            resamplerFree(resampler);
+            return NULL;
+        }
+        if (!atomic_exchange(&soxrMissingReported, true)) fprintf(stderr, "soxr resampler is not available in this ffmpeg build, using swr\n");
+        av_opt_set_int(resampler->swr, "resampler", SWR_ENGINE_SWR, 0);
+        if (swr_init(resampler->swr) < 0) {
+            fprintf(stderr, "Couldn't initialize resampler\n");
+            resamplerFree(resampler);
+            return NULL;
+        }
+    }
+
+    return resampler;
+}
+
+static void resamplerRelease(MediaResampler* resampler){
+    platform_mutex_lock(resamplerPoolMutex);
+    bool pooled = resamplerPoolCount < RESAMPLER_POOL_SIZE;
+    if (pooled) {
+        resampler->next = resamplerPool;
+        resamplerPool = resampler;
+        resamplerPoolCount++;
+    }
+    platform_mutex_unlock(resamplerPoolMutex);
+    if (!pooled) resamplerFree(resampler);
+}
+
+bool ffmpegMediaResamplerPoolInit(void){
+    resamplerPoolMutex = platform_mutex_create();
+    if (!resamplerPoolMutex) {
+        fprintf(stderr, "Couldn't create resampler pool mutex\n");
+        return false;
+    }
+    return true;
+}
+
+void ffmpegMediaResamplerPoolFree(void){
+    if (!resamplerPoolMutex) return;
+    platform_mutex_lock(resamplerPoolMutex);
+    MediaResampler* resampler = resamplerPool;
+    resamplerPool = NULL;
+    resamplerPoolCount = 0;
+    platform_mutex_unlock(resamplerPoolMutex);
+
+    while (resampler) {
+        MediaResampler* next = resampler->next;
+        resamplerFree(resampler);
+        resampler = next;
+    }
+    platform_mutex_destroy(resamplerPoolMutex);
+    resamplerPoolMutex = NULL;
+}
+
+bool ffmpegMediaInit(const char* filename, size_t desiredSampleRate, const AVChannelLayout* desiredLayout, enum AVSampleFormat desiredFormat, const MediaResampleOptions* resample, Media* media) 
 {
     memset(media, 0, sizeof(Media));
     
     if (!initializeMediaContext(media, filename)) goto error;
-    if (!initializeDecoder(media, desiredSampleRate, desiredStereo, desiredFormat)) goto error;
+    if (!initializeDecoder(media, desiredSampleRate, desiredLayout, desiredFormat, resample)) goto error;
+    if (media->videoStream && media->audioStream && !initializeAudioContext(media, filename)) goto error;
 
     bool isImage = mediaIsAnImage(media);
     if(isImage) {
@@ -44,66 +186,126 @@ bool ffmpegMediaGetFrame(Media* media, Frame* frame) {
         frame->video = media->tempFrame.video;
         return true;
     }
+    if(!media->videoStream) return ffmpegMediaGetAudioFrame(media, frame);
+
     av_frame_unref(media->videoFrame);
     av_packet_unref(media->packet);
     int response;
+    // audio stream is discarded here, it has its own demuxer
     while (av_read_frame(media->formatContext, media->packet) >= 0) {
-        if (media->audioStream && media->packet->stream_index == media->audioStream->index) {
-            response = avcodec_send_packet(media->audioCodecContext, media->packet);
-            if (response >= 0) {
-                response = avcodec_receive_frame(media->audioCodecContext, media->audioFrame);
-                if (response >= 0) {
-                    media->tempFrame.audio.nb_samples = swr_convert(media->swrContext, media->tempFrame.audio.data, media->tempFrame.audio.count, (const uint8_t* const *)media->audioFrame->data, media->audioFrame->nb_samples);
-
-                    if(frame){
-                        frame->type = FRAME_TYPE_AUDIO;
-                        frame->pts = media->audioFrame->pts;
-                        frame->audio = media->tempFrame.audio;
-                    }
-                    return true;
-                }
-            }
+        if (media->packet->stream_index != media->videoStream->index) {
             av_packet_unref(media->packet);
             continue;
         }
 
-        if (media->videoStream && media->packet->stream_index == media->videoStream->index) {
-            response = avcodec_send_packet(media->videoCodecContext, media->packet);
-            if (response < 0) {
-                av_packet_unref(media->packet);
-                continue;
-            }
-    
-            response = avcodec_receive_frame(media->videoCodecContext, media->videoFrame);
-            if (response == AVERROR(EAGAIN) || response == AVERROR_EOF) {
-                av_packet_unref(media->packet);
-                continue;
-            } 
-            else if (response < 0) {
-                av_packet_unref(media->packet);
-                return false;
-            }
-    
-            // Convert frame to RGB
-            uint8_t* dest[4] = {(uint8_t*)media->tempFrame.video.data, NULL, NULL, NULL};
-            int dest_linesize[4] = {media->videoFrame->width * sizeof(uint32_t), 0, 0, 0};
-            sws_scale(media->swsContext, 
-                (const uint8_t* const*)media->videoFrame->data, 
-                media->videoFrame->linesize, 
-                0, 
-                media->videoFrame->height, 
-                dest, 
-                dest_linesize);
+        response = avcodec_send_packet(media->videoCodecContext, media->packet);
+        if (response < 0) {
+            av_packet_unref(media->packet);
+            continue;
+        }
+
+        response = avcodec_receive_frame(media->videoCodecContext, media->videoFrame);
+        if (response == AVERROR(EAGAIN) || response == AVERROR_EOF) {
+            av_packet_unref(media->packet);
+            continue;
+        } 
+        else if (response < 0) {
+            av_packet_unref(media->packet);
+            return false;
+        }
+
+        // Convert frame to RGB
+        uint8_t* dest[4] = {(uint8_t*)media->tempFrame.video.data, NULL, NULL, NULL};
+        int dest_linesize[4] = {media->videoFrame->width * sizeof(uint32_t), 0, 0, 0};
+        sws_scale(media->swsContext, 
+            (const uint8_t* const*)media->videoFrame->data, 
+            media->videoFrame->linesize, 
+            0, 
+            media->videoFrame->height, 
+            dest, 
+            dest_linesize);
+        
+        if(frame){
+            frame->type = FRAME_TYPE_VIDEO;
+            frame->video = media->tempFrame.video;
+            frame->pts = media->videoFrame->pts;
+        }
             
-            if(frame){
-                frame->type = FRAME_TYPE_VIDEO;
-                frame->video = media->tempFrame.video;
-                frame->pts = media->videoFrame->pts;
-            }
-                
-            return true;
+        return true;
+    }
+
+    return false;
+}
+
+// receives next decoded audio frame into media->audioFrame, reading packets from audio demuxer as needed
+static bool decodeAudioFrame(Media* media) {
+    AVFormatContext* formatContext = media->audioFormatContext ? media->audioFormatContext : media->formatContext;
+    while (true) {
+        int response = avcodec_receive_frame(media->audioCodecContext, media->audioFrame);
+        if (response >= 0) return true;
+        if (response != AVERROR(EAGAIN)) return false;
+
+        if (av_read_frame(formatContext, media->audioPacket) < 0) {
+            // drains what decoder still holds, receive returns AVERROR_EOF after that
+            if (avcodec_send_packet(media->audioCodecContext, NULL) < 0) return false;
+            continue;
         }
+        if (media->audioPacket->stream_index == media->audioStream->index) avcodec_send_packet(media->audioCodecContext, media->audioPacket);
+        av_packet_unref(media->audioPacket);
+    }
+}
+
+bool ffmpegMediaGetAudioFrame(Media* media, Frame* frame) {
+    if (!media->audioStream) return false;
+
+    if (media->audioFramePending) media->audioFramePending = false;
+    else if (!decodeAudioFrame(media)) return false;
+
+    AudioFrame audio;
+    if (media->resampler) {
+        int converted = swr_convert(media->resampler->swr, media->tempFrame.audio.data, media->tempFrame.audio.count, (const uint8_t* const *)media->audioFrame->extended_data, media->audioFrame->nb_samples);
+        if (converted < 0) return false;
+        media->tempFrame.audio.nb_samples = converted;
+        audio = media->tempFrame.audio;
+    } else {
+        // decoder output already matches, handed out as is until next decode
+        audio = (AudioFrame){
+            .data = media->audioFrame->extended_data,
+            .nb_samples = media->audioFrame->nb_samples,
+            .count = media->audioFrame->nb_samples,
+        };
+    }
+
+    if(frame){
+        frame->type = FRAME_TYPE_AUDIO;
+        frame->pts = media->audioFrame->pts;
+        frame->audio = audio;
+    }
+    return true;
+}
+
+bool ffmpegMediaSeekAudio(Media* media, double time_seconds) {
+    if (!media || !media->audioStream) return false;
+    AVFormatContext* formatContext = media->audioFormatContext ? media->audioFormatContext : media->formatContext;
 
+    media->audioFramePending = false;
+    av_packet_unref(media->audioPacket);
+
+    int ret = av_seek_frame(formatContext, -1, (int64_t)(time_seconds * AV_TIME_BASE), AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+        printf("Audio seek failed: %s\n", av_err2str(ret));
+        return false;
+    }
+    avcodec_flush_buffers(media->audioCodecContext);
+
+    // frames ending before target are dropped, first one reaching past it is kept for next ffmpegMediaGetAudioFrame
+    double timeBase = av_q2d(media->audioStream->time_base);
+    while (decodeAudioFrame(media)) {
+        double end = media->audioFrame->pts * timeBase + (double)media->audioFrame->nb_samples / media->audioFrame->sample_rate;
+        if (end > time_seconds) {
+            media->audioFramePending = true;
+            return true;
+        }
     }
 
     return false;
@@ -112,11 +314,19 @@ bool ffmpegMediaGetFrame(Media* media, Frame* frame) {
 bool ffmpegMediaSeek(Media* media, double time_seconds) {
     if (!media || !media->formatContext) return false;
     if(media->isImage) return true;
+    if(!media->videoCodecContext) return ffmpegMediaSeekAudio(media, time_seconds);
+
+    // audio ending before target is fine, ffmpegMediaGetAudioFrame just has nothing more to return
+    if(media->audioFormatContext) ffmpegMediaSeekAudio(media, time_seconds);
+
+    return ffmpegMediaSeekVideo(media, time_seconds);
+}
+
+bool ffmpegMediaSeekVideo(Media* media, double time_seconds) {
+    if (!media || !media->formatContext) return false;
+    if(media->isImage || !media->videoCodecContext) return true;
 
-    if (media->videoCodecContext)
-        avcodec_flush_buffers(media->videoCodecContext);
-    if (media->audioCodecContext)
-        avcodec_flush_buffers(media->audioCodecContext);
+    avcodec_flush_buffers(media->videoCodecContext);
 
     int64_t seek_target = (int64_t)(time_seconds * AV_TIME_BASE);
 
@@ -126,10 +336,7 @@ bool ffmpegMediaSeek(Media* media, double time_seconds) {
         return false;
     }
 
-    if (media->videoCodecContext)
-        avcodec_flush_buffers(media->videoCodecContext);
-    if (media->audioCodecContext)
-        avcodec_flush_buffers(media->audioCodecContext);
+    avcodec_flush_buffers(media->videoCodecContext);
 
     if (media->videoFrame)
         av_frame_unref(media->videoFrame);
@@ -137,38 +344,19 @@ bool ffmpegMediaSeek(Media* media, double time_seconds) {
         av_packet_unref(media->packet);
 
     while (av_read_frame(media->formatContext, media->packet) >= 0) {
-        AVStream* stream = media->formatContext->streams[media->packet->stream_index];
-
-        if (media->videoCodecContext && media->packet->stream_index == media->videoStream->index) {
-            ret = avcodec_send_packet(media->videoCodecContext, media->packet);
+        if (media->packet->stream_index != media->videoStream->index) {
             av_packet_unref(media->packet);
-            if (ret < 0) continue;
-
-            ret = avcodec_receive_frame(media->videoCodecContext, media->videoFrame);
-            if (ret == 0) {
-                double pts_time = media->videoFrame->pts * av_q2d(media->videoStream->time_base);
-                if (pts_time >= time_seconds) return true;
-            }
-        }
-        else if (!media->videoCodecContext &&
-                 media->audioCodecContext &&
-                 media->packet->stream_index == media->audioStream->index) {
-            ret = avcodec_send_packet(media->audioCodecContext, media->packet);
-            av_packet_unref(media->packet);
-            if (ret < 0) continue;
-
-            AVFrame* audioFrame = av_frame_alloc();
-            ret = avcodec_receive_frame(media->audioCodecContext, audioFrame);
-            if (ret == 0) {
-                double pts_time = audioFrame->pts * av_q2d(media->audioStream->time_base);
-                av_frame_free(&audioFrame);
-                if (pts_time >= time_seconds) return true;
-            } else {
-                av_frame_free(&audioFrame);
-            }
+            continue;
         }
-        else {
-            av_packet_unref(media->packet);
+
+        ret = avcodec_send_packet(media->videoCodecContext, media->packet);
+        av_packet_unref(media->packet);
+        if (ret < 0) continue;
+
+        ret = avcodec_receive_frame(media->videoCodecContext, media->videoFrame);
+        if (ret == 0) {
+            double pts_time = media->videoFrame->pts * av_q2d(media->videoStream->time_base);
+            if (pts_time >= time_seconds) return true;
         }
     }
 
@@ -199,7 +387,9 @@ void ffmpegMediaUninit(Media* media) {
         avformat_close_input(&media->formatContext);
         avformat_free_context(media->formatContext);
     }
-    if (media->swrContext) swr_free(&media->swrContext);
+    if (media->resampler) resamplerRelease(media->resampler);
+    if (media->audioPacket) av_packet_free(&media->audioPacket);
+    if (media->audioFormatContext) avformat_close_input(&media->audioFormatContext);
 
     memset(media, 0, sizeof(Media));
 }
@@ -219,7 +409,7 @@ static bool initializeMediaContext(Media* media, const char* filename) {
     return true;
 }
 
-static bool initializeDecoder(Media* media, size_t desiredSampleRate, bool desiredStereo, enum AVSampleFormat desiredFormat) {
+static bool initializeDecoder(Media* media, size_t desiredSampleRate, const AVChannelLayout* desiredLayout, enum AVSampleFormat desiredFormat, const MediaResampleOptions* resample) {
     media->videoStream = NULL;
     for (int i = 0; i < media->formatContext->nb_streams; i++) {
         AVStream* stream = media->formatContext->streams[i];
@@ -273,9 +463,9 @@ static bool initializeDecoder(Media* media, size_t desiredSampleRate, bool desir
 
             if (avcodec_open2(media->audioCodecContext, codec, NULL) < 0) return false;
 
-            if(media->audioCodecContext->ch_layout.nb_channels > 2){
-                fprintf(stderr, "more than 2 audio channels is not supported\n");
-                return false;
+            // channels without known speaker positions (raw pcm, some wav) get default layout of their count so they can be rematrixed
+            if(media->audioCodecContext->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC){
+                av_channel_layout_default(&media->audioCodecContext->ch_layout, media->audioCodecContext->ch_layout.nb_channels);
             }
             break;
         }
@@ -283,39 +473,24 @@ static bool initializeDecoder(Media* media, size_t desiredSampleRate, bool desir
 
     if(media->audioStream != NULL) {
         media->audioFrame = av_frame_alloc();
-
-        media->swrContext = swr_alloc();
-        if(!media->swrContext){
-            fprintf(stderr, "Couldn't allocate resampler\n");
-            return false;
-        }
-
-        if(swr_alloc_set_opts2(&media->swrContext,
-            desiredStereo ? &(AVChannelLayout)AV_CHANNEL_LAYOUT_STEREO
-                          : &(AVChannelLayout)AV_CHANNEL_LAYOUT_MONO,
-            desiredFormat,
-            desiredSampleRate,
-            &media->audioCodecContext->ch_layout,
-            media->audioCodecContext->sample_fmt,
-            media->audioCodecContext->sample_rate,
-            0,
-            NULL
-        ) < 0) {
-            fprintf(stderr, "Couldn't set ops for resampler\n");
-            return false;
-        }
-
-        if(swr_init(media->swrContext) < 0) {
-            fprintf(stderr, "Couldn't initialize resampler\n");
-            return false;
-        }
-
-        media->tempFrame.audio.nb_samples = 0;
-        media->tempFrame.audio.count = media->audioCodecContext->frame_size*4;
-        if(media->tempFrame.audio.count == 0) media->tempFrame.audio.count = media->audioCodecContext->sample_rate / 4;
-        if(av_samples_alloc_array_and_samples(&media->tempFrame.audio.data,&media->tempFrame.audio.capacity, desiredStereo ? 2 : 1, media->tempFrame.audio.count, desiredFormat, 1) < 0){
-            fprintf(stderr, "Couldn't alloc space for audio sample\n");
-            return false;
+        media->audioPacket = av_packet_alloc();
+        if(!media->audioFrame || !media->audioPacket) return false;
+
+        AVCodecContext* codecContext = media->audioCodecContext;
+        // decoded frames already in desired format are passed through without resampler
+        bool passthrough = codecContext->sample_fmt == desiredFormat && codecContext->sample_rate == (int)desiredSampleRate && av_channel_layout_compare(&codecContext->ch_layout, desiredLayout) == 0;
+        if(!passthrough){
+            MediaResampleOptions defaultOptions = {0};
+            media->resampler = resamplerAcquire(&codecContext->ch_layout, codecContext->sample_fmt, codecContext->sample_rate, desiredLayout, desiredFormat, desiredSampleRate, resample ? resample : &defaultOptions);
+            if(!media->resampler) return false;
+
+            media->tempFrame.audio.nb_samples = 0;
+            media->tempFrame.audio.count = media->audioCodecContext->frame_size*4;
+            if(media->tempFrame.audio.count == 0) media->tempFrame.audio.count = media->audioCodecContext->sample_rate / 4;
+            if(av_samples_alloc_array_and_samples(&media->tempFrame.audio.data,&media->tempFrame.audio.capacity, desiredLayout->nb_channels, media->tempFrame.audio.count, desiredFormat, 1) < 0){
+                fprintf(stderr, "Couldn't alloc space for audio sample\n");
+                return false;
+            }
         }
     }
     
@@ -323,6 +498,23 @@ static bool initializeDecoder(Media* media, size_t desiredSampleRate, bool desir
     return media->packet;
 }
 
+// opens file second time and keeps only audio stream there, main context stops demuxing audio
+static bool initializeAudioContext(Media* media, const char* filename) {
+    if (avformat_open_input(&media->audioFormatContext, filename, NULL, NULL) < 0) return false;
+    if (avformat_find_stream_info(media->audioFormatContext, NULL) < 0) return false;
+    if (media->audioFormatContext->nb_streams != media->formatContext->nb_streams) {
+        fprintf(stderr, "Audio demuxer sees different streams than main one\n");
+        return false;
+    }
+
+    for (unsigned int i = 0; i < media->audioFormatContext->nb_streams; i++) {
+        media->audioFormatContext->streams[i]->discard = (int)i == media->audioStream->index ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+    media->audioStream->discard = AVDISCARD_ALL;
+
+    return true;
+}
+
 double ffmpegMediaDuration(Media* media){
     if(media->isImage) return 0;
     if(media->videoStream){
@@ -35,6 +35,15 @@ typedef struct{
     AudioFrame audio;
 } Frame;
 
+// zeroed options give ffmpeg defaults
+typedef struct{
+    size_t filterLength; // taps of swr filter, 0 means ffmpeg default
+    bool soxr;           // soxr engine when ffmpeg was built with it, swr otherwise
+} MediaResampleOptions;
+
+// pooled resampler, media with same formats reuse its filter bank instead of computing it again
+typedef struct MediaResampler MediaResampler;
+
 typedef struct {
     AVFormatContext* formatContext;
     AVPacket* packet;
@@ -49,13 +58,30 @@ typedef struct {
     AVStream* audioStream;
     AVCodecContext* audioCodecContext;
     AVFrame* audioFrame;
-    struct SwrContext* swrContext;
+    MediaResampler* resampler; // NULL when decoded audio already is in desired format
+
+    // media with both streams demuxes audio on its own so it never has to wait for video decoding,
+    // audio only media reads from formatContext instead
+    AVFormatContext* audioFormatContext;
+    AVPacket* audioPacket;
+    bool audioFramePending; // audioFrame holds first frame after seek that wasn't returned yet
 } Media;
 
-bool ffmpegMediaInit(const char* filename, size_t desiredSampleRate, bool desiredStereo, enum AVSampleFormat desiredFormat, Media* media);
+// pool of idle resamplers shared by every media, init before opening any media and free after all are closed
+bool ffmpegMediaResamplerPoolInit(void);
+void ffmpegMediaResamplerPoolFree(void);
+// audio is up or downmixed to desiredLayout, resample can be NULL for default options
+bool ffmpegMediaInit(const char* filename, size_t desiredSampleRate, const AVChannelLayout* desiredLayout, enum AVSampleFormat desiredFormat, const MediaResampleOptions* resample, Media* media);
 void ffmpegMediaUninit(Media* media);
+// returns next video frame, or audio frame for audio only media
 bool ffmpegMediaGetFrame(Media* media, Frame* frame);
+// returns next audio frame without touching video stream
+bool ffmpegMediaGetAudioFrame(Media* media, Frame* frame);
+// seeks video and audio
 bool ffmpegMediaSeek(Media* media, double time_seconds);
+bool ffmpegMediaSeekAudio(Media* media, double time_seconds);
+// leaves audio demuxer alone so another thread can keep decoding audio of same media
+bool ffmpegMediaSeekVideo(Media* media, double time_seconds);
 double ffmpegMediaDuration(Media* media);
 
 #endif
\ No newline at end of file
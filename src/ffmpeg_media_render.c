@@ -5,7 +5,63 @@
 
 #include "ffmpeg_media_render.h"
 
-bool ffmpegMediaRenderInit(const char* filename, size_t width, size_t height, double fps, size_t sampleRate, bool stereo, bool hasAudio, MediaRenderContext* render){
+// layout encoder will take, requested one if codec lists it or has no list, otherwise listed one with same channel count
+static bool pickChannelLayout(const AVCodec* audioCodec, const AVChannelLayout* ch_layout, AVChannelLayout* out){
+    if (!audioCodec->ch_layouts) return av_channel_layout_copy(out, ch_layout) == 0;
+    const AVChannelLayout* sameCount = NULL;
+    for (const AVChannelLayout* layout = audioCodec->ch_layouts; layout->nb_channels; layout++) {
+        if (av_channel_layout_compare(layout, ch_layout) == 0) return av_channel_layout_copy(out, layout) == 0;
+        if (!sameCount && layout->nb_channels == ch_layout->nb_channels) sameCount = layout;
+    }
+    if (sameCount) return av_channel_layout_copy(out, sameCount) == 0;
+
+    char name[64];
+    av_channel_layout_describe(ch_layout, name, sizeof(name));
+    fprintf(stderr, "%s encoder doesn't support %s audio\n", audioCodec->name, name);
+    return false;
+}
+
+static bool initAudioStream(MediaRenderContext* render, const AVCodec* audioCodec, size_t sampleRate, const AVChannelLayout* ch_layout){
+    render->audioStream = avformat_new_stream(render->formatContext, NULL);
+    if (!render->audioStream) return false;
+
+    render->audioCodecContext = avcodec_alloc_context3(audioCodec);
+    if (!render->audioCodecContext) return false;
+
+    render->audioCodecContext->sample_rate = sampleRate;
+    if (!pickChannelLayout(audioCodec, ch_layout, &render->audioCodecContext->ch_layout)) return false;
+    render->audioCodecContext->sample_fmt = audioCodec->sample_fmts[0];
+    render->audioCodecContext->time_base = (AVRational){1, (int)sampleRate};
+
+    render->audioStream->time_base = render->audioCodecContext->time_base;
+
+    if (render->formatContext->oformat->flags & AVFMT_GLOBALHEADER) {
+        render->audioCodecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if (avcodec_open2(render->audioCodecContext, audioCodec, NULL) < 0) return false;
+    if (avcodec_parameters_from_context(render->audioStream->codecpar, render->audioCodecContext) < 0) return false;
+
+    render->audioFrame = av_frame_alloc();
+    render->audioFrame->format = render->audioCodecContext->sample_fmt;
+    render->audioFrame->ch_layout = render->audioCodecContext->ch_layout;
+    render->audioFrame->sample_rate = render->audioCodecContext->sample_rate;
+    render->audioPacket = av_packet_alloc();
+
+    return true;
+}
+
+static bool openOutput(MediaRenderContext* render, const char* filename){
+    if (!(render->formatContext->oformat->flags & AVFMT_NOFILE)) {
+        if (avio_open(&render->formatContext->pb, filename, AVIO_FLAG_WRITE) < 0) return false;
+    }
+
+    if (avformat_write_header(render->formatContext, NULL) < 0) return false;
+
+    return true;
+}
+
+bool ffmpegMediaRenderInit(const char* filename, size_t width, size_t height, double fps, size_t sampleRate, const AVChannelLayout* ch_layout, bool hasAudio, MediaRenderContext* render){
     memset(render, 0, sizeof(MediaRenderContext));
 
     avformat_alloc_output_context2(&render->formatContext, NULL, NULL, filename);
@@ -54,72 +110,96 @@ bool ffmpegMediaRenderInit(const char* filename, size_t width, size_t height, do
     if (hasAudio) {
         const AVCodec* audioCodec = avcodec_find_encoder(AV_CODEC_ID_AAC);
         if (!audioCodec) return false;
+        if (!initAudioStream(render, audioCodec, sampleRate, ch_layout)) return false;
+    }
 
-        render->audioStream = avformat_new_stream(render->formatContext, NULL);
-        if (!render->audioStream) return false;
-
-        render->audioCodecContext = avcodec_alloc_context3(audioCodec);
-        if (!render->audioCodecContext) return false;
+    return openOutput(render, filename);
+}
 
-        render->audioCodecContext->sample_rate = sampleRate;
-        av_channel_layout_default(&render->audioCodecContext->ch_layout, stereo ? 2 : 1);
-        render->audioCodecContext->sample_fmt = audioCodec->sample_fmts[0];
-        render->audioCodecContext->time_base = (AVRational){1, (int)sampleRate};
+bool ffmpegMediaRenderInitAudio(const char* filename, size_t sampleRate, const AVChannelLayout* ch_layout, MediaRenderContext* render){
+    memset(render, 0, sizeof(MediaRenderContext));
 
-        render->audioStream->time_base = render->audioCodecContext->time_base;
+    avformat_alloc_output_context2(&render->formatContext, NULL, NULL, filename);
+    if (!render->formatContext) return false;
 
-        if (render->formatContext->oformat->flags & AVFMT_GLOBALHEADER) {
-            render->audioCodecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
-        }
+    // container picks codec, .wav gets pcm, .flac flac, .m4a aac and so on
+    enum AVCodecID codecId = av_guess_codec(render->formatContext->oformat, NULL, filename, NULL, AVMEDIA_TYPE_AUDIO);
+    const AVCodec* audioCodec = codecId == AV_CODEC_ID_NONE ? NULL : avcodec_find_encoder(codecId);
+    if (!audioCodec) {
+        fprintf(stderr, "No audio encoder for %s\n", filename);
+        return false;
+    }
 
-        if (avcodec_open2(render->audioCodecContext, audioCodec, NULL) < 0) return false;
-        if (avcodec_parameters_from_context(render->audioStream->codecpar, render->audioCodecContext) < 0) return false;
+    render->packet = av_packet_alloc();
+    if (!render->packet) return false;
+    if (!initAudioStream(render, audioCodec, sampleRate, ch_layout)) return false;
 
-        render->audioFrame = av_frame_alloc();
-        render->audioFrame->format = render->audioCodecContext->sample_fmt;
-        render->audioFrame->ch_layout = render->audioCodecContext->ch_layout;
-        render->audioFrame->sample_rate = render->audioCodecContext->sample_rate;
-        render->audioPacket = av_packet_alloc();
+    return openOutput(render, filename);
+}
 
-        if(render->audioCodecContext->ch_layout.nb_channels > 2){
-            fprintf(stderr, "more than 2 audio channels is not supported\n");
-            return false;
-        }
+static bool encodeAudio(MediaRenderContext* render, uint8_t** data, size_t samples){
+    // planar formats have plane per channel, packed ones just one
+    int planes = av_sample_fmt_is_planar(render->audioCodecContext->sample_fmt) ? render->audioCodecContext->ch_layout.nb_channels : 1;
+    for (int plane = 0; plane < planes && plane < AV_NUM_DATA_POINTERS; plane++) {
+        render->audioFrame->data[plane] = data[plane];
     }
-
-    if (!(render->formatContext->oformat->flags & AVFMT_NOFILE)) {
-        if (avio_open(&render->formatContext->pb, filename, AVIO_FLAG_WRITE) < 0) return false;
+    render->audioFrame->extended_data = render->audioFrame->data;
+    render->audioFrame->nb_samples = samples;
+    render->audioFrame->pts = render->audioFrameCount;
+    render->audioFrameCount += render->audioFrame->nb_samples;
+
+    if (avcodec_send_frame(render->audioCodecContext, render->audioFrame) < 0)
+        return false;
+
+    while (avcodec_receive_packet(render->audioCodecContext, render->audioPacket) == 0) {
+        render->audioPacket->stream_index = render->audioStream->index;
+        av_packet_rescale_ts(render->audioPacket,
+                            render->audioCodecContext->time_base,
+                            render->audioStream->time_base);
+        av_interleaved_write_frame(render->formatContext, render->audioPacket);
+        av_packet_unref(render->audioPacket);
     }
 
-    if (avformat_write_header(render->formatContext, NULL) < 0) return false;
+    return true;
+}
+
+static size_t audioChunkSize(MediaRenderContext* render){
+    return render->audioCodecContext->frame_size > 0 ? (size_t)render->audioCodecContext->frame_size : 1024;
+}
+
+bool ffmpegMediaRenderSkipAudio(MediaRenderContext* render, size_t frames){
+    if (!render->audioCodecContext || frames == 0) return true;
 
+    AVCodecContext* ctx = render->audioCodecContext;
+    if (!render->audioFifo) {
+        render->audioFifo = av_audio_fifo_alloc(ctx->sample_fmt, ctx->ch_layout.nb_channels, audioChunkSize(render));
+        if (!render->audioFifo) return false;
+        if (av_samples_alloc_array_and_samples(&render->audioChunk, NULL, ctx->ch_layout.nb_channels, audioChunkSize(render), ctx->sample_fmt, 0) < 0) {
+            fprintf(stderr, "Couldn't allocate audio chunk\n");
+            return false;
+        }
+    }
+    render->audioSkip += frames;
     return true;
 }
 
 bool ffmpegMediaRenderPassFrame(MediaRenderContext* render, const RenderFrame* frame) {
     if (frame->type == RENDER_FRAME_TYPE_AUDIO) {
-        render->audioFrame->data[0] = ((uint8_t**)frame->data)[0];
-        render->audioFrame->data[1] = ((uint8_t**)frame->data)[1];
-        render->audioFrame->data[2] = ((uint8_t**)frame->data)[2];
-        render->audioFrame->data[3] = ((uint8_t**)frame->data)[3];
-        render->audioFrame->data[4] = ((uint8_t**)frame->data)[4];
-        render->audioFrame->data[5] = ((uint8_t**)frame->data)[5];
-        render->audioFrame->data[6] = ((uint8_t**)frame->data)[6];
-        render->audioFrame->data[7] = ((uint8_t**)frame->data)[7];
-        render->audioFrame->nb_samples = frame->size;
-        render->audioFrame->pts = render->audioFrameCount;
-        render->audioFrameCount += render->audioFrame->nb_samples;
-
-        if (avcodec_send_frame(render->audioCodecContext, render->audioFrame) < 0)
+        if (!render->audioFifo) return encodeAudio(render, (uint8_t**)frame->data, frame->size);
+
+        if (av_audio_fifo_write(render->audioFifo, frame->data, frame->size) < (int)frame->size)
             return false;
 
-        while (avcodec_receive_packet(render->audioCodecContext, render->audioPacket) == 0) {
-            render->audioPacket->stream_index = render->audioStream->index;
-            av_packet_rescale_ts(render->audioPacket,
-                                render->audioCodecContext->time_base,
-                                render->audioStream->time_base);
-            av_interleaved_write_frame(render->formatContext, render->audioPacket);
-            av_packet_unref(render->audioPacket);
+        size_t skip = FFMIN(render->audioSkip, (size_t)av_audio_fifo_size(render->audioFifo));
+        if (skip) {
+            av_audio_fifo_drain(render->audioFifo, skip);
+            render->audioSkip -= skip;
+        }
+
+        size_t chunk = audioChunkSize(render);
+        while ((size_t)av_audio_fifo_size(render->audioFifo) >= chunk) {
+            av_audio_fifo_read(render->audioFifo, (void**)render->audioChunk, chunk);
+            if (!encodeAudio(render, render->audioChunk, chunk)) return false;
         }
 
         return true;
@@ -157,14 +237,36 @@ bool ffmpegMediaRenderPassFrame(MediaRenderContext* render, const RenderFrame* f
 void ffmpegMediaRenderFinish(MediaRenderContext* render) {
     int ret;
 
-    avcodec_send_frame(render->videoCodecContext, NULL);
-    while ((ret = avcodec_receive_packet(render->videoCodecContext, render->packet)) == 0) {
-        render->packet->stream_index = render->videoStream->index;
-        av_packet_rescale_ts(render->packet,
-                             render->videoCodecContext->time_base,
-                             render->videoStream->time_base);
-        av_interleaved_write_frame(render->formatContext, render->packet);
-        av_packet_unref(render->packet);
+    if (render->videoCodecContext) {
+        avcodec_send_frame(render->videoCodecContext, NULL);
+        while ((ret = avcodec_receive_packet(render->videoCodecContext, render->packet)) == 0) {
+            render->packet->stream_index = render->videoStream->index;
+            av_packet_rescale_ts(render->packet,
+                                 render->videoCodecContext->time_base,
+                                 render->videoStream->time_base);
+            av_interleaved_write_frame(render->formatContext, render->packet);
+            av_packet_unref(render->packet);
+        }
+    }
+
+    // encoders like aac hold back samples until they are told stream ended
+    if (render->audioCodecContext) {
+        // last frame is the only one allowed to be short
+        int left = render->audioFifo ? av_audio_fifo_size(render->audioFifo) : 0;
+        if (left > 0) {
+            av_audio_fifo_read(render->audioFifo, (void**)render->audioChunk, left);
+            encodeAudio(render, render->audioChunk, left);
+        }
+
+        avcodec_send_frame(render->audioCodecContext, NULL);
+        while ((ret = avcodec_receive_packet(render->audioCodecContext, render->audioPacket)) == 0) {
+            render->audioPacket->stream_index = render->audioStream->index;
+            av_packet_rescale_ts(render->audioPacket,
+                                 render->audioCodecContext->time_base,
+                                 render->audioStream->time_base);
+            av_interleaved_write_frame(render->formatContext, render->audioPacket);
+            av_packet_unref(render->audioPacket);
+        }
     }
 
     av_write_trailer(render->formatContext);
@@ -173,15 +275,20 @@ void ffmpegMediaRenderFinish(MediaRenderContext* render) {
         avio_closep(&render->formatContext->pb);
     }
 
-    avcodec_free_context(&render->videoCodecContext);
-    av_frame_free(&render->videoFrame);
-    av_packet_free(&render->packet);
-    sws_freeContext(render->swsContext);
+    if (render->videoCodecContext) avcodec_free_context(&render->videoCodecContext);
+    if (render->videoFrame) av_frame_free(&render->videoFrame);
+    if (render->packet) av_packet_free(&render->packet);
+    if (render->swsContext) sws_freeContext(render->swsContext);
     avformat_free_context(render->formatContext);
 
     if (render->audioCodecContext) avcodec_free_context(&render->audioCodecContext);
     if (render->audioFrame) av_frame_free(&render->audioFrame);
     if (render->audioPacket) av_packet_free(&render->audioPacket);
+    if (render->audioFifo) av_audio_fifo_free(render->audioFifo);
+    if (render->audioChunk) {
+        av_freep(&render->audioChunk[0]);
+        av_freep(&render->audioChunk);
+    }
 
     memset(render, 0, sizeof(MediaRenderContext));
 }
@@ -24,6 +24,11 @@ typedef struct {
     AVFrame* audioFrame;
     AVPacket* audioPacket;
 
+    // holds output back so leading samples can be dropped and encoder still gets whole frames
+    AVAudioFifo* audioFifo;
+    uint8_t** audioChunk;
+    size_t audioSkip;
+
     size_t videoFrameCount;
     size_t audioFrameCount;
 } MediaRenderContext;
@@ -40,7 +45,11 @@ typedef struct {
     size_t size; // in case of audio it means number of samples
 } RenderFrame;
 
-bool ffmpegMediaRenderInit(const char* filename, size_t width, size_t height, double fps, size_t sampleRate, bool stereo, bool hasAudio, MediaRenderContext* render);
+bool ffmpegMediaRenderInit(const char* filename, size_t width, size_t height, double fps, size_t sampleRate, const AVChannelLayout* ch_layout, bool hasAudio, MediaRenderContext* render);
+// output with audio stream only, its codec is picked from filename extension
+bool ffmpegMediaRenderInitAudio(const char* filename, size_t sampleRate, const AVChannelLayout* ch_layout, MediaRenderContext* render);
+// drops first frames of audio passed in later, used to cancel out latency of the mix
+bool ffmpegMediaRenderSkipAudio(MediaRenderContext* render, size_t frames);
 bool ffmpegMediaRenderPassFrame(MediaRenderContext* render, const RenderFrame* frame);
 void ffmpegMediaRenderFinish(MediaRenderContext* render);
 
@@ -1,6 +1,7 @@
 #include "fvfx_helper.h"
 #include "ffmpeg_helper.h"
 #include "ll.h"
+#include <string.h>
 
 void mix_all_layers(
     uint8_t** composedAudioBuf,   // [out] output buffer (already cleared)
@@ -8,12 +9,18 @@ void mix_all_layers(
     MyLayer* myLayers,            // linked list of layers
     int out_audio_frame_size,     // number of frames to produce this iteration
     enum AVSampleFormat out_audio_format, // output sample format
-    Project* project              // holds global mix settings (e.g., stereo flag)
+    AudioGraph* graph,            // layer effects, buses and master limiter, also holds channel layout
+    float masterGain              // applied on the final bus after limiter
 ) {
+    size_t channels = graph->channels;
+    size_t graphLayer = 0;
+
+    audio_graph_begin(graph, out_audio_frame_size);
     for (MyLayer* myLayer = myLayers; myLayer != NULL; myLayer = myLayer->next) {
 
         if (!myLayer->audioFifo)
             continue;
+        size_t layerIndex = graphLayer++;
 
         int available = av_audio_fifo_size(myLayer->audioFifo);
         int toRead = FFMIN(available, out_audio_frame_size);
@@ -22,7 +29,7 @@ void mix_all_layers(
             tempAudioBuf,
             0,
             out_audio_frame_size,
-            project->settings.stereo ? 2 : 1,
+            channels,
             out_audio_format
         );
 
@@ -43,17 +50,28 @@ void mix_all_layers(
             (myLayer->args.currentMediaIndex == EMPTY_MEDIA) ||
             (myLayer->args.currentMediaIndex != EMPTY_MEDIA && !myMedia->hasAudio);
 
-        mix_audio(
+        // volume/pan are evaluated once per video frame, ramping between them keeps automation from stepping
+        float targetGains[MIX_AUDIO_MAX_CHANNELS];
+        mix_audio_gains(myLayer->volume, myLayer->pan, &graph->ch_layout, targetGains);
+        if (!myLayer->mixGainsSet) {
+            memcpy(myLayer->mixGains, targetGains, sizeof(targetGains));
+            myLayer->mixGainsSet = true;
+        }
+
+        audio_graph_mix_layer(
+            graph,
+            layerIndex,
             composedAudioBuf,
             tempAudioBuf,
             read,
-            project->settings.stereo ? 2 : 1,
-            out_audio_format,
-            myLayer->volume,
-            myLayer->pan
+            myLayer->mixGains,
+            targetGains
         );
+        memcpy(myLayer->mixGains, targetGains, sizeof(targetGains));
 
         if (conditionalMix)
             continue;
     }
+
+    audio_graph_finish(graph, composedAudioBuf, out_audio_frame_size, masterGain);
 }
\ No newline at end of file
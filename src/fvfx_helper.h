@@ -5,6 +5,7 @@
 #include <libavutil/samplefmt.h>
 #include "myProject.h"
 #include "project.h"
+#include "audio_graph.h"
 
 void mix_all_layers(
     uint8_t** composedAudioBuf,   // [out] output buffer (already cleared)
@@ -12,6 +13,7 @@ void mix_all_layers(
     MyLayer* myLayers,            // linked list of layers
     int out_audio_frame_size,     // number of frames to produce this iteration
     enum AVSampleFormat out_audio_format, // output sample format
-    Project* project              // holds global mix settings (e.g., stereo flag)
+    AudioGraph* graph,            // layer effects, buses and master limiter, also holds channel layout
+    float masterGain              // applied on the final bus after limiter
 );
 #endif
\ No newline at end of file
@@ -31,6 +31,7 @@ Layer* project_create_and_add_layer(Project* project, double initial_volume, dou
     Layer* out = ll_push(&project->layers, ((Layer){
         .volume = initial_volume,
         .pan = initial_panning,
+        .audioBus = AUDIO_BUS_MASTER,
     }), arena_alloc_func, project->aa);
     return out;
 }
@@ -47,12 +48,27 @@ void layer_add_slice(Project* project, Layer* layer, size_t media_index, double
         .media_index = media_index,
         .offset = media_start_from,
         .duration = slice_duration,
+        .speed = 1,
+        .speedEnd = 1,
+        .preservePitch = true,
+    }), arena_alloc_func, project->aa);
+}
+void layer_add_slice_speed(Project* project, Layer* layer, size_t media_index, double media_start_from, double slice_duration, double speed_start, double speed_end, bool preserve_pitch){
+    ll_push(&layer->slices, ((Slice){
+        .media_index = media_index,
+        .offset = media_start_from,
+        .duration = slice_duration,
+        .speed = speed_start,
+        .speedEnd = speed_end,
+        .preservePitch = preserve_pitch,
     }), arena_alloc_func, project->aa);
 }
 void layer_add_empty(Project* project, Layer* layer, double empty_duration){
     ll_push(&layer->slices, ((Slice){
         .media_index = EMPTY_MEDIA,
         .duration = empty_duration,
+        .speed = 1,
+        .speedEnd = 1,
     }), arena_alloc_func, project->aa);
 }
 VfxInstance* layer_create_and_add_vfx_instance(Project* project, Layer* layer, size_t vfx_index, double instance_when, double instance_duration){
@@ -119,6 +135,44 @@ size_t vfx_get_input_index(Project* project, size_t vfx_index, const char* input
     return -1;
 }
 
+bool vfx_instance_set_render_scale(Project* project, VfxInstance* vfx_instance, double render_scale){
+    (void)project;
+    if(!(render_scale > 0.0 && render_scale <= 1.0)){
+        fprintf(stderr, "Render scale has to be in (0, 1] range got %g\n", render_scale);
+        return false;
+    }
+    vfx_instance->renderScale = render_scale;
+    return true;
+}
+
+size_t project_add_audio_bus(Project* project, double volume){
+    ll_push(&project->audioBuses, ((AudioBus){
+        .volume = volume,
+    }), arena_alloc_func, project->aa);
+    size_t count = 0;
+    for(AudioBus* bus = project->audioBuses; bus != NULL; bus = bus->next) count++;
+    return count - 1;
+}
+
+void layer_set_audio_bus(Project* project, Layer* layer, size_t bus_index){
+    (void)project;
+    layer->audioBus = bus_index;
+}
+
+void layer_add_audio_effect(Project* project, Layer* layer, AudioEffect effect){
+    ll_push(&layer->audioEffects, ((AudioEffectInstance){
+        .effect = effect,
+    }), arena_alloc_func, project->aa);
+}
+
+void audio_bus_add_effect(Project* project, size_t bus_index, AudioEffect effect){
+    AudioBus* bus = ll_at(project->audioBuses, bus_index);
+    if(bus == NULL) return;
+    ll_push(&bus->effects, ((AudioEffectInstance){
+        .effect = effect,
+    }), arena_alloc_func, project->aa);
+}
+
 bool project_loader_load(Project* project, const char* filename, int argc, const char** argv, ArenaAllocator* aa){
     project->aa = aa;
 
@@ -151,6 +205,12 @@ bool project_loader_load(Project* project, const char* filename, int argc, const
         .vfx_instance_set_arg = vfx_instance_set_arg,
         .vfx_instance_add_automation_key = vfx_instance_add_automation_key,
         .vfx_get_input_index = vfx_get_input_index,
+        .vfx_instance_set_render_scale = vfx_instance_set_render_scale,
+        .project_add_audio_bus = project_add_audio_bus,
+        .layer_set_audio_bus = layer_set_audio_bus,
+        .layer_add_audio_effect = layer_add_audio_effect,
+        .audio_bus_add_effect = audio_bus_add_effect,
+        .layer_add_slice_speed = layer_add_slice_speed,
     }, argc, argv)) {
         platform_free_dynamic_library(dll);
         return false;
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <assert.h>
 #include "arena_alloc.h"
+#include "ffmpeg_media.h"
 
 enum {
     MODE_NONE = 0,
@@ -17,8 +18,16 @@ enum {
 int main(int argc, const char** argv){
     const char* filename = argv[0];
 
+    // render --audio-only skips vulkan, vfx and video encoding
+    bool audioOnly = argc > 2 && strcmp(argv[1], "render") == 0 && strcmp(argv[2], "--audio-only") == 0;
+    if(audioOnly){
+        argv[2] = argv[1];
+        argv++;
+        argc--;
+    }
+
     if(argc < 3){
-        fprintf(stderr, "Usage: %s (render|preview) (project filepath) [aditional args for project]\n", filename);
+        fprintf(stderr, "Usage: %s (render [--audio-only]|preview) (project filepath) [aditional args for project]\n", filename);
         return 1;
     }
 
@@ -43,11 +52,16 @@ int main(int argc, const char** argv){
         return 1;
     }
 
+    if(!ffmpegMediaResamplerPoolInit()) return 1;
+
+    int result = 1;
     if(mode == MODE_RENDER){
-        return render(&project, &aa);
+        if(audioOnly) result = render_audio_only(&project, &aa);
+        else result = render(&project, &aa);
     }else if(mode == MODE_PREVIEW){
-        return preview(&project, proj_filename, proj_argc, proj_argv, &aa);
+        result = preview(&project, proj_filename, proj_argc, proj_argv, &aa);
     }else assert(false && "UNREACHABLE");
 
-    return 1;
+    ffmpegMediaResamplerPoolFree();
+    return result;
 }
\ No newline at end of file
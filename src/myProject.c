@@ -3,6 +3,7 @@
 #include "ffmpeg_helper.h"
 
 #include "ll.h"
+#include <math.h>
 
 static double VfxLayerSoundParameter_Evaluate(const VfxLayerSoundParameter* volume, double localTime) {
     double result = volume->initialValue;
@@ -102,56 +103,178 @@ static void VfxInstance_Update(MyVfx* myVfxs, VfxInstance* instance, double curr
     }
 }
 
-static bool updateSlice(MyMedia* medias, Slice* slices, size_t currentSlice, size_t* currentMediaIndex,double* checkDuration){
+static bool slice_is_stretched(const Slice* slice){
+    return slice->speed != 1 || slice->speedEnd != 1;
+}
+
+static double slice_speed_at(const Slice* slice, double localTime){
+    if(slice->duration <= 0) return slice->speed;
+    return slice->speed + (slice->speedEnd - slice->speed) * localTime / slice->duration;
+}
+
+double slice_media_time(const Slice* slice, double localTime){
+    if(slice->duration <= 0) return localTime * slice->speed;
+    return localTime * (slice->speed + (slice->speedEnd - slice->speed) * localTime / (2*slice->duration));
+}
+
+double slice_local_time(const Slice* slice, double mediaTime){
+    // root of slice_media_time written so constant speed doesn't divide by zero
+    double a = slice->duration > 0 ? (slice->speedEnd - slice->speed) / (2*slice->duration) : 0;
+    double discriminant = slice->speed*slice->speed + 4*a*mediaTime;
+    if(discriminant < 0) discriminant = 0;
+    return 2*mediaTime / (slice->speed + sqrt(discriminant));
+}
+
+// stretched audio starts over from mediaTime after every slice change or seek
+static void resetSliceAudio(GetVideoFrameArgs* args, const Slice* slice, double mediaTime){
+    args->audioMediaTime = mediaTime;
+    time_stretch_reset(&args->timeStretch, slice->preservePitch);
+}
+
+// audio has its own demuxer so either side can be positioned without touching the other one
+static bool seekMedia(MyMedia* myMedia, double time_seconds, bool seekVideo, bool seekAudio){
+    if(seekVideo && seekAudio) return ffmpegMediaSeek(&myMedia->media, time_seconds);
+    if(seekVideo) return !myMedia->hasVideo || ffmpegMediaSeekVideo(&myMedia->media, time_seconds);
+    if(seekAudio) return !myMedia->hasAudio || ffmpegMediaSeekAudio(&myMedia->media, time_seconds);
+    return true;
+}
+
+// audio only cursors position only audio demuxer so video never gets decoded, detached video ones only video demuxer
+static bool updateSlice(MyMedia* medias, Slice* slices, size_t currentSlice, size_t* currentMediaIndex,double* checkDuration, bool seekVideo, bool seekAudio){
     *currentMediaIndex = ((Slice*)ll_at(slices,currentSlice))->media_index;
     *checkDuration = ((Slice*)ll_at(slices,currentSlice))->duration;
     if(*currentMediaIndex == EMPTY_MEDIA) return true;
     MyMedia* media = ll_at(medias,*currentMediaIndex);
     assert(checkDuration > 0 && "You fucked up");
-    ffmpegMediaSeek(&media->media, ((Slice*)ll_at(slices,currentSlice))->offset);
+    seekMedia(media, ((Slice*)ll_at(slices,currentSlice))->offset, seekVideo, seekAudio);
+    return true;
+}
+
+// decoded audio is in media time and goes through time stretch, what comes out of it is in timeline time
+static bool getStretchedAudioUntil(Project* project, Slice* slice, MyMedia* myMedia, AVAudioFifo* audioFifo, GetVideoFrameArgs* args, double untilLocalTime){
+    TimeStretch* timeStretch = &args->timeStretch;
+    double sampleRate = project->settings.sampleRate;
+    double hop = (double)timeStretch->hop / sampleRate;
+
+    Frame audioFrame;
+    while(args->audioLocalTime < untilLocalTime){
+        size_t want = (size_t)((untilLocalTime - args->audioLocalTime) * sampleRate + 0.5);
+        if(want == 0) break;
+
+        // speed averaged over hop that would be made next keeps stretch input exactly on slice ramp
+        double hopStart = args->audioLocalTime + (double)(timeStretch->outputCount - timeStretch->outputRead) / sampleRate;
+        timeStretch->speed = (slice_media_time(slice, hopStart + hop) - slice_media_time(slice, hopStart)) / hop;
+
+        uint8_t** data;
+        size_t frames = time_stretch_pull(timeStretch, want, &data);
+        if(frames > 0){
+            av_audio_fifo_write(audioFifo, (void**)data, frames);
+            args->audioLocalTime += (double)frames / sampleRate;
+            continue;
+        }
+
+        if(timeStretch->inputEnded) return false;
+        if(!ffmpegMediaGetAudioFrame(&myMedia->media, &audioFrame)){
+            if(!time_stretch_end(timeStretch)) return false;
+            continue;
+        }
+
+        // seeks land on frame boundaries, anything before where stretch input starts was already played
+        double frameStart = audioFrame.pts * av_q2d(myMedia->media.audioStream->time_base) - slice->offset;
+        size_t skip = 0;
+        if(frameStart < args->audioMediaTime) skip = (size_t)((args->audioMediaTime - frameStart) * sampleRate + 0.5);
+        if(!time_stretch_push(timeStretch, audioFrame.audio.data, audioFrame.audio.nb_samples, skip)) return false;
+        double frameEnd = frameStart + (double)audioFrame.audio.nb_samples / sampleRate;
+        if(frameEnd > args->audioMediaTime) args->audioMediaTime = frameEnd;
+    }
+    return true;
+}
+
+// decodes layer audio up to untilLocalTime without touching video stream, returns false when media has no more audio to give
+static bool getAudioUntil(Project* project, Slice* slice, MyMedia* myMedia, AVAudioFifo* audioFifo, GetVideoFrameArgs* args, double untilLocalTime){
+    if(!myMedia->hasAudio || !audioFifo) return false;
+    if(untilLocalTime > args->checkDuration) untilLocalTime = args->checkDuration;
+    if(slice_is_stretched(slice)) return getStretchedAudioUntil(project, slice, myMedia, audioFifo, args, untilLocalTime);
+
+    Frame audioFrame;
+    while(args->audioLocalTime < untilLocalTime){
+        if(!ffmpegMediaGetAudioFrame(&myMedia->media, &audioFrame)) return false;
+        double frameStart = audioFrame.pts * av_q2d(myMedia->media.audioStream->time_base) - slice->offset;
+
+        // last frame of slice is cut so slices don't drift apart from video over time
+        size_t samples = audioFrame.audio.nb_samples;
+        double room = (args->checkDuration - frameStart) * project->settings.sampleRate;
+        if(room < (double)samples) samples = room > 0 ? (size_t)room : 0;
+
+        args->audioLocalTime = frameStart + (double)samples / project->settings.sampleRate;
+        if(samples > 0) av_audio_fifo_write(audioFifo, (void**)audioFrame.audio.data, samples);
+    }
     return true;
 }
 
-static int getVideoFrame(VkCommandBuffer cmd, Vulkanizer* vulkanizer, Project* project, Slice* slice, MyMedia* myMedias, VulkanizerVfxInstances* vulkanizerVfxInstances, Frame* frame, AVAudioFifo* audioFifo, GetVideoFrameArgs* args, VkImageView composedOutView){
+// fills layer fifo with silence up to untilLocalTime
+static void padAudioSilence(Project* project, MyProject* myProject, MyLayer* myLayer, GetVideoFrameArgs* args, double untilLocalTime){
+    if(args->audioLocalTime >= untilLocalTime) return;
+    size_t samples = (size_t)((untilLocalTime - args->audioLocalTime) * project->settings.sampleRate + 0.5);
+    if(samples > 0) av_audio_fifo_add_silence(myLayer->audioFifo, myProject->myLayers_fifo_fmt, &myProject->myLayers_fifo_ch_layout, samples, &myLayer->audioSilence);
+    args->audioLocalTime += (double)samples / project->settings.sampleRate;
+}
+
+// audio of video media that ends before its video is padded so layer keeps feeding mixer
+static void getVideoFrameAudio(Project* project, MyProject* myProject, MyLayer* myLayer, Slice* slice, MyMedia* myMedia, double untilLocalTime){
+    if(myProject->audioDetached || !myLayer->audioFifo || !myMedia->hasAudio) return;
+    if(untilLocalTime > myLayer->args.checkDuration) untilLocalTime = myLayer->args.checkDuration;
+    if(!getAudioUntil(project, slice, myMedia, myLayer->audioFifo, &myLayer->args, untilLocalTime)) padAudioSilence(project, myProject, myLayer, &myLayer->args, untilLocalTime);
+}
+
+static int getVideoFrame(VkCommandBuffer cmd, Vulkanizer* vulkanizer, Project* project, MyProject* myProject, MyLayer* myLayer, Slice* slice, MyMedia* myMedias, VulkanizerVfxInstances* vulkanizerVfxInstances, Frame* frame, GetVideoFrameArgs* args, VulkanizerLayerCache* layerCache, VkImageView composedOutView){
     MyMedia* myMedia = ll_at(myMedias, args->currentMediaIndex);
     assert(myMedia->hasVideo && "You used wrong function!");
     while(true){
-        if(args->localTime >= args->checkDuration) return -GET_FRAME_NEXT_MEDIA;
+        if(args->localTime >= args->checkDuration) {
+            getVideoFrameAudio(project, myProject, myLayer, slice, myMedia, args->checkDuration);
+            return -GET_FRAME_NEXT_MEDIA;
+        }
     
         
         if(args->times_to_catch_up_target_framerate > 0){
-            if(!Vulkanizer_apply_vfx_on_frame_and_compose(cmd, vulkanizer, vulkanizerVfxInstances, myMedia->mediaImageView, myMedia->mediaImageData, myMedia->mediaImageStride, myMedia->mediaDescriptorSet, frame, composedOutView)) return -GET_FRAME_ERR;
+            if(!Vulkanizer_apply_vfx_on_frame_and_compose(cmd, vulkanizer, vulkanizerVfxInstances, myMedia->mediaImageView, myMedia->mediaImageData, myMedia->mediaImageStride, &myMedia->mediaMips, myMedia->mediaDescriptorSet, frame, frame->pts, layerCache, composedOutView)) return -GET_FRAME_ERR;
             args->times_to_catch_up_target_framerate--;
             return 0;
         }
 
-        if(!ffmpegMediaGetFrame(&myMedia->media, frame)) {args->localTime = args->checkDuration; return -GET_FRAME_NEXT_MEDIA;};
-        
-        if(frame->type == FRAME_TYPE_VIDEO){
-            args->localTime = frame->pts * av_q2d(myMedia->media.videoStream->time_base)  - slice->offset;
-            if(args->video_skip_count > 0){
-                args->video_skip_count--;
-                return -GET_FRAME_SKIP;
-            }
-    
-            double framerate = 1.0 / ((double)(frame->pts - args->lastVideoPts) * av_q2d(myMedia->media.videoStream->time_base));
-            args->lastVideoPts = frame->pts;
-    
-            args->times_to_catch_up_target_framerate = 1;
-            if(framerate < project->settings.fps){
-                args->times_to_catch_up_target_framerate = (size_t)(project->settings.fps/framerate);
-                if(args->times_to_catch_up_target_framerate == 0) args->times_to_catch_up_target_framerate = 1;
-            }else if(framerate > project->settings.fps){
-                args->video_skip_count = (size_t)(framerate / project->settings.fps);
-            }
-    
-            if(!Vulkanizer_apply_vfx_on_frame_and_compose(cmd, vulkanizer, vulkanizerVfxInstances, myMedia->mediaImageView, myMedia->mediaImageData, myMedia->mediaImageStride, myMedia->mediaDescriptorSet, frame, composedOutView)) return -GET_FRAME_ERR;
-            args->times_to_catch_up_target_framerate--;
-            return 0;
-        }else{
-            args->localTime = frame->pts * av_q2d(myMedia->media.audioStream->time_base)  - slice->offset;
-            av_audio_fifo_write(audioFifo, (void**)frame->audio.data, frame->audio.nb_samples);
+        if(!ffmpegMediaGetFrame(&myMedia->media, frame)) {
+            args->localTime = args->checkDuration;
+            getVideoFrameAudio(project, myProject, myLayer, slice, myMedia, args->checkDuration);
+            return -GET_FRAME_NEXT_MEDIA;
         }
+        assert(frame->type == FRAME_TYPE_VIDEO && "Audio is demuxed separately");
+
+        args->localTime = slice_local_time(slice, frame->pts * av_q2d(myMedia->media.videoStream->time_base)  - slice->offset);
+        if(args->video_skip_count > 0){
+            args->video_skip_count--;
+            getVideoFrameAudio(project, myProject, myLayer, slice, myMedia, args->localTime);
+            return -GET_FRAME_SKIP;
+        }
+
+        // rate frames come at on timeline, so slow slices repeat frames and fast ones skip them
+        double framerate = slice_speed_at(slice, args->localTime) / ((double)(frame->pts - args->lastVideoPts) * av_q2d(myMedia->media.videoStream->time_base));
+        args->lastVideoPts = frame->pts;
+
+        args->times_to_catch_up_target_framerate = 1;
+        if(framerate < project->settings.fps){
+            args->times_to_catch_up_target_framerate = (size_t)(project->settings.fps/framerate);
+            if(args->times_to_catch_up_target_framerate == 0) args->times_to_catch_up_target_framerate = 1;
+        }else if(framerate > project->settings.fps){
+            args->video_skip_count = (size_t)(framerate / project->settings.fps);
+        }
+
+        // audio has to cover every output frame this video frame is shown for
+        getVideoFrameAudio(project, myProject, myLayer, slice, myMedia, args->localTime + (double)args->times_to_catch_up_target_framerate / project->settings.fps);
+
+        if(!Vulkanizer_apply_vfx_on_frame_and_compose(cmd, vulkanizer, vulkanizerVfxInstances, myMedia->mediaImageView, myMedia->mediaImageData, myMedia->mediaImageStride, &myMedia->mediaMips, myMedia->mediaDescriptorSet, frame, frame->pts, layerCache, composedOutView)) return -GET_FRAME_ERR;
+        args->times_to_catch_up_target_framerate--;
+        return 0;
     }
 
     return -GET_FRAME_ERR;
@@ -166,10 +289,13 @@ static int getAudioFrame(Vulkanizer* vulkanizer, Project* project, Slice* slice,
     if(args->localTime < args->checkDuration){
         args->times_to_catch_up_target_framerate = (slice->duration - args->localTime) / (1/project->settings.fps);
     }
+    if(slice_is_stretched(slice) && args->localTime < args->checkDuration){
+        getAudioUntil(project, slice, myMedia, audioFifo, args, args->checkDuration);
+        args->localTime = args->checkDuration;
+    }
     while(args->localTime < args->checkDuration){    
 
-        if(!ffmpegMediaGetFrame(&myMedia->media, frame)) {args->localTime = args->checkDuration; return -GET_FRAME_NEXT_MEDIA;};
-        assert(frame->type == FRAME_TYPE_AUDIO && "You fucked up");
+        if(!ffmpegMediaGetAudioFrame(&myMedia->media, frame)) {args->localTime = args->checkDuration; return -GET_FRAME_NEXT_MEDIA;};
         
         args->localTime = frame->pts * av_q2d(myMedia->media.audioStream->time_base)  - slice->offset;
         av_audio_fifo_write(audioFifo, (void**)frame->audio.data, frame->audio.nb_samples);
@@ -183,7 +309,7 @@ static int getAudioFrame(Vulkanizer* vulkanizer, Project* project, Slice* slice,
     return -GET_FRAME_NEXT_MEDIA;
 }
 
-static int getImageFrame(VkCommandBuffer cmd, Vulkanizer* vulkanizer, Project* project, Slice* slice, MyMedia* myMedias, VulkanizerVfxInstances* vulkanizerVfxInstances, Frame* frame, GetVideoFrameArgs* args, VkImageView composedOutView){
+static int getImageFrame(VkCommandBuffer cmd, Vulkanizer* vulkanizer, Project* project, Slice* slice, MyMedia* myMedias, VulkanizerVfxInstances* vulkanizerVfxInstances, Frame* frame, GetVideoFrameArgs* args, VulkanizerLayerCache* layerCache, VkImageView composedOutView){
     if(args->localTime < args->checkDuration){
         args->times_to_catch_up_target_framerate = (slice->duration - args->localTime) / (1/project->settings.fps);
         args->localTime = args->checkDuration;
@@ -194,7 +320,7 @@ static int getImageFrame(VkCommandBuffer cmd, Vulkanizer* vulkanizer, Project* p
         args->times_to_catch_up_target_framerate--;
         if(!ffmpegMediaGetFrame(&myMedia->media, frame)) {args->localTime = args->checkDuration; return -GET_FRAME_NEXT_MEDIA;};
         assert(frame->type == FRAME_TYPE_VIDEO && "You used wrong function");
-        if(!Vulkanizer_apply_vfx_on_frame_and_compose(cmd, vulkanizer, vulkanizerVfxInstances, myMedia->mediaImageView, myMedia->mediaImageData, myMedia->mediaImageStride, myMedia->mediaDescriptorSet, frame, composedOutView)) return -GET_FRAME_ERR;
+        if(!Vulkanizer_apply_vfx_on_frame_and_compose(cmd, vulkanizer, vulkanizerVfxInstances, myMedia->mediaImageView, NULL, 0, NULL, myMedia->mediaDescriptorSet, frame, 0, layerCache, composedOutView)) return -GET_FRAME_ERR;
         return 0;
     }
 
@@ -215,7 +341,7 @@ static int getEmptyFrame(Vulkanizer* vulkanizer, Project* project, Slice* slice,
     return -GET_FRAME_NEXT_MEDIA;
 }
 
-static int getFrame(VkCommandBuffer cmd, Vulkanizer* vulkanizer, Project* project, Slice* slices, MyMedia* myMedias, VulkanizerVfxInstances* vulkanizerVfxInstances, Frame* frame, AVAudioFifo* audioFifo, GetVideoFrameArgs* args, VkImageView composedOutView){
+static int getFrame(VkCommandBuffer cmd, Vulkanizer* vulkanizer, Project* project, MyProject* myProject, MyLayer* myLayer, Slice* slices, MyMedia* myMedias, VulkanizerVfxInstances* vulkanizerVfxInstances, Frame* frame, GetVideoFrameArgs* args, VulkanizerLayerCache* layerCache, VkImageView composedOutView){
     int e;
     MyMedia* myMedia = ll_at(myMedias, args->currentMediaIndex);
     Slice* current_slice = ll_at(slices, args->currentSlice);
@@ -226,9 +352,11 @@ static int getFrame(VkCommandBuffer cmd, Vulkanizer* vulkanizer, Project* projec
         if(args->currentMediaIndex == EMPTY_MEDIA){
             e = getEmptyFrame(vulkanizer,project,current_slice,myMedias,args);
         }else{
-            if(myMedia->media.isImage) e = getImageFrame(cmd, vulkanizer,project,current_slice,myMedias,vulkanizerVfxInstances,frame,args,composedOutView);
-            else if(myMedia->hasVideo) e = getVideoFrame(cmd, vulkanizer,project,current_slice,myMedias,vulkanizerVfxInstances,frame,audioFifo,args,composedOutView);
-            else if(myMedia->hasAudio && !myMedia->hasVideo) e = getAudioFrame(vulkanizer,project,current_slice,myMedias,frame, audioFifo, args);
+            if(myMedia->media.isImage) e = getImageFrame(cmd, vulkanizer,project,current_slice,myMedias,vulkanizerVfxInstances,frame,args,layerCache,composedOutView);
+            else if(myMedia->hasVideo) e = getVideoFrame(cmd, vulkanizer,project,myProject,myLayer,current_slice,myMedias,vulkanizerVfxInstances,frame,args,layerCache,composedOutView);
+            // detached audio only media has nothing left for video path but keeping time
+            else if(myMedia->hasAudio && !myMedia->hasVideo && myProject->audioDetached) e = getEmptyFrame(vulkanizer,project,current_slice,myMedias,args);
+            else if(myMedia->hasAudio && !myMedia->hasVideo) e = getAudioFrame(vulkanizer,project,current_slice,myMedias,frame, myLayer->audioFifo, args);
             else assert(false && "Unreachable");
         }
 
@@ -238,9 +366,11 @@ static int getFrame(VkCommandBuffer cmd, Vulkanizer* vulkanizer, Project* projec
             if(current_slice == NULL) return -GET_FRAME_FINISHED;
             printf("[FVFX] Processing Layer %s Slice %zu!\n", hrp_name(args),args->currentSlice+1);
             args->localTime = 0;
+            args->audioLocalTime = 0;
             args->video_skip_count = 0;
             args->times_to_catch_up_target_framerate = 0;
-            if(!updateSlice(myMedias,slices, args->currentSlice, &args->currentMediaIndex, &args->checkDuration)) return -GET_FRAME_ERR;
+            if(!updateSlice(myMedias,slices, args->currentSlice, &args->currentMediaIndex, &args->checkDuration, true, !myProject->audioDetached)) return -GET_FRAME_ERR;
+            resetSliceAudio(args, current_slice, 0);
             if(args->currentMediaIndex == EMPTY_MEDIA) continue;
             myMedia = ll_at(myMedias, args->currentMediaIndex);
             if(myMedia->hasVideo) args->lastVideoPts = current_slice->offset / av_q2d(myMedia->media.videoStream->time_base);
@@ -258,7 +388,25 @@ static void* ll_arena_allocator(size_t size, void* caller_data){
     return aa_alloc((ArenaAllocator*)caller_data,size);
 }
 
-bool prepare_project(Project* project, MyProject* myProject, Vulkanizer* vulkanizer, enum AVSampleFormat expectedSampleFormat, size_t fifo_size, ArenaAllocator* aa){
+AVChannelLayout project_channel_layout(const Project* project){
+    switch(project->settings.channelLayout){
+        case VFX_CHANNELS_MONO:   return (AVChannelLayout)AV_CHANNEL_LAYOUT_MONO;
+        case VFX_CHANNELS_STEREO: return (AVChannelLayout)AV_CHANNEL_LAYOUT_STEREO;
+        case VFX_CHANNELS_5_1:    return (AVChannelLayout)AV_CHANNEL_LAYOUT_5POINT1;
+        case VFX_CHANNELS_7_1:    return (AVChannelLayout)AV_CHANNEL_LAYOUT_7POINT1;
+        default: return project->settings.stereo ? (AVChannelLayout)AV_CHANNEL_LAYOUT_STEREO : (AVChannelLayout)AV_CHANNEL_LAYOUT_MONO;
+    }
+}
+
+static void freeMyLayer(Vulkanizer* vulkanizer, MyLayer* layer);
+
+// opens every media and allocates layer fifos, media of audio only projects (vulkanizer == NULL) gets no images
+static bool prepare_layers(Project* project, MyProject* myProject, Vulkanizer* vulkanizer, enum AVSampleFormat expectedSampleFormat, size_t fifo_size, ArenaAllocator* aa){
+    AVChannelLayout ch_layout = project_channel_layout(project);
+    MediaResampleOptions resample = {
+        .filterLength = project->settings.resamplerFilterLength,
+        .soxr = project->settings.resampler == VFX_RESAMPLER_SOXR,
+    };
     for(Layer* layer = project->layers; layer != NULL; layer = layer->next){
         MyLayer myLayer = {0};
         myLayer.volume = layer->volume.initialValue;
@@ -268,7 +416,7 @@ bool prepare_project(Project* project, MyProject* myProject, Vulkanizer* vulkani
             MyMedia myMedia = {0};
     
             // ffmpeg init
-            if(!ffmpegMediaInit(mediaInstance->filename, project->settings.sampleRate, project->settings.stereo, expectedSampleFormat, &myMedia.media)){
+            if(!ffmpegMediaInit(mediaInstance->filename, project->settings.sampleRate, &ch_layout, expectedSampleFormat, &resample, &myMedia.media)){
                 fprintf(stderr, "Couldn't initialize ffmpeg media at %s!\n", mediaInstance->filename);
                 return false;
             }
@@ -278,25 +426,49 @@ bool prepare_project(Project* project, MyProject* myProject, Vulkanizer* vulkani
             myMedia.hasVideo = myMedia.media.videoStream != NULL;
             if(myMedia.hasAudio) hasAudio = true;
             
-            if(myMedia.hasVideo){
-                if(!Vulkanizer_init_image_for_media(vulkanizer, myMedia.media.videoCodecContext->width, myMedia.media.videoCodecContext->height, &myMedia.mediaImage, &myMedia.mediaImageMemory, &myMedia.mediaImageView, &myMedia.mediaImageStride, &myMedia.mediaDescriptorSet, &myMedia.mediaImageData)) return false;
+            if(vulkanizer != NULL && myMedia.hasVideo && myMedia.media.isImage){
+                // stills never change so they live on gpu only and skip per frame upload
+                if(!Vulkanizer_init_immutable_image_for_media(vulkanizer, &myMedia.media.tempFrame.video, &myMedia.mediaImage, &myMedia.mediaImageMemory, &myMedia.mediaImageView, &myMedia.mediaDescriptorSet, &myMedia.mediaDescriptorPool)) return false;
+            }else if(vulkanizer != NULL && myMedia.hasVideo){
+                if(!Vulkanizer_init_image_for_media(vulkanizer, myMedia.media.videoCodecContext->width, myMedia.media.videoCodecContext->height, &myMedia.mediaImage, &myMedia.mediaImageMemory, &myMedia.mediaImageView, &myMedia.mediaImageStride, &myMedia.mediaDescriptorSet, &myMedia.mediaDescriptorPool, &myMedia.mediaImageData, &myMedia.mediaMips)) return false;
             }
             ll_push(&myLayer.myMedias, myMedia, ll_arena_allocator, aa);
         }
-        if(hasAudio) myLayer.audioFifo = av_audio_fifo_alloc(expectedSampleFormat, project->settings.stereo ? 2 : 1, fifo_size);
+        if(hasAudio){
+            myLayer.audioFifo = av_audio_fifo_alloc(expectedSampleFormat, ch_layout.nb_channels, fifo_size);
+            if(!time_stretch_init(&myLayer.args.timeStretch, ch_layout.nb_channels, project->settings.sampleRate, expectedSampleFormat)){
+                // layer isn't on myProject->myLayers yet so project uninit won't see it
+                freeMyLayer(vulkanizer, &myLayer);
+                return false;
+            }
+        }
         ll_push(&myProject->myLayers, myLayer, ll_arena_allocator, aa);
     }
     myProject->myLayers_fifo_fmt = expectedSampleFormat;
     myProject->myLayers_fifo_frame_size = fifo_size;
-    myProject->myLayers_fifo_ch_layout = project->settings.stereo ? (AVChannelLayout)AV_CHANNEL_LAYOUT_STEREO : (AVChannelLayout)AV_CHANNEL_LAYOUT_MONO;
+    myProject->myLayers_fifo_ch_layout = ch_layout;
+    return true;
+}
+
+static bool prepare_timeline(Project* project, MyProject* myProject, bool audioOnly);
+
+bool prepare_project(Project* project, MyProject* myProject, Vulkanizer* vulkanizer, enum AVSampleFormat expectedSampleFormat, size_t fifo_size, ArenaAllocator* aa){
+    if(!prepare_layers(project, myProject, vulkanizer, expectedSampleFormat, fifo_size, aa)) return false;
+    // every media image goes out in one submission instead of waiting for each one separately
+    if(!Vulkanizer_flush_media_uploads(vulkanizer)) return false;
 
     size_t vfxModules_count = 0;
+    VulkanizerVfxsRef vfxsToInit = {0};
     for(VfxModule* module = project->vfxModules; module != NULL; module = module->next){
         MyVfx vfx = {0};
-        if(!Vulkanizer_init_vfx(vulkanizer, module, &vfx.vfx)) return false;
-        ll_push(&myProject->myVfxs, vfx, ll_arena_allocator, aa);
+        vfx.vfx.module = module;
+        MyVfx* myVfx = ll_push(&myProject->myVfxs, vfx, ll_arena_allocator, aa);
+        da_append(&vfxsToInit, &myVfx->vfx);
         vfxModules_count++;
     }
+    bool vfxsInitialized = Vulkanizer_init_vfxs(vulkanizer, &vfxsToInit);
+    da_free(vfxsToInit);
+    if(!vfxsInitialized) return false;
 
     //creating rest of inputs needed + type checking
     size_t layer_id = 0;
@@ -351,6 +523,31 @@ bool prepare_project(Project* project, MyProject* myProject, Vulkanizer* vulkani
         }
     }
 
+    // sized for the worst case of every instance in a layer being active at once
+    myProject->pushConstantsSize = 0;
+    for(Layer* layer = project->layers; layer != NULL; layer = layer->next){
+        size_t layerPushConstantsSize = 0;
+        for(VfxInstance* vfx = layer->vfxInstances; vfx != NULL; vfx = vfx->next){
+            MyVfx* myVfx = ll_at(myProject->myVfxs, vfx->vfx_index);
+            layerPushConstantsSize += myVfx->vfx.module->pushContantsSize;
+        }
+        if(layerPushConstantsSize > myProject->pushConstantsSize) myProject->pushConstantsSize = layerPushConstantsSize;
+    }
+    if(myProject->pushConstantsSize > 0){
+        myProject->pushConstants = aa_alloc(aa, myProject->pushConstantsSize);
+        memset(myProject->pushConstants, 0, myProject->pushConstantsSize);
+    }
+
+    return prepare_timeline(project, myProject, false);
+}
+
+bool prepare_project_audio(Project* project, MyProject* myProject, enum AVSampleFormat expectedSampleFormat, size_t fifo_size, ArenaAllocator* aa){
+    if(!prepare_layers(project, myProject, NULL, expectedSampleFormat, fifo_size, aa)) return false;
+    return prepare_timeline(project, myProject, true);
+}
+
+// resolves slices with -1 duration, project duration and positions every layer at its first slice
+static bool prepare_timeline(Project* project, MyProject* myProject, bool audioOnly){
     myProject->time = 0;
     myProject->duration = 0;
 
@@ -364,6 +561,10 @@ bool prepare_project(Project* project, MyProject* myProject, Vulkanizer* vulkani
 
             double layerDuration = 0;
             for(Slice* slice = layer->slices; slice != NULL; slice = slice->next){
+                if(slice->media_index != EMPTY_MEDIA && (slice->speed <= 0 || slice->speedEnd <= 0)){
+                    fprintf(stderr, "Slice speed has to be above 0, got %g to %g\n", slice->speed, slice->speedEnd);
+                    return false;
+                }
                 if(slice->duration == -1){
                     if(slice->media_index == EMPTY_MEDIA){
                         fprintf(stderr, "You cannot have duration of -1 in Empty media\n");
@@ -379,7 +580,8 @@ bool prepare_project(Project* project, MyProject* myProject, Vulkanizer* vulkani
                         return false;
                     }
 
-                    slice->duration = media->duration - slice->offset;
+                    // ramp plays rest of media in time it would take at its average speed
+                    slice->duration = 2*(media->duration - slice->offset) / (slice->speed + slice->speedEnd);
                 }
                 layerDuration += slice->duration;
             }
@@ -391,10 +593,11 @@ bool prepare_project(Project* project, MyProject* myProject, Vulkanizer* vulkani
         Layer* layer = project->layers;
         MyLayer* myLayer = myProject->myLayers;
         for(; myLayer != NULL; myLayer = myLayer->next, layer = layer->next){
-            if(!updateSlice(myLayer->myMedias,layer->slices, myLayer->args.currentSlice, &myLayer->args.currentMediaIndex, &myLayer->args.checkDuration)) return false;
+            if(!updateSlice(myLayer->myMedias,layer->slices, myLayer->args.currentSlice, &myLayer->args.currentMediaIndex, &myLayer->args.checkDuration, !audioOnly, true)) return false;
+            Slice* slice = ll_at(layer->slices, myLayer->args.currentSlice);
+            resetSliceAudio(&myLayer->args, slice, 0);
             if(myLayer->args.currentMediaIndex == EMPTY_MEDIA) continue;
             MyMedia* myMedia = ll_at(myLayer->myMedias, myLayer->args.currentMediaIndex);
-            Slice* slice = ll_at(layer->slices, myLayer->args.currentSlice);
             if(myMedia->hasVideo) myLayer->args.lastVideoPts = slice->offset / av_q2d(myMedia->media.videoStream->time_base);
             printf("[FVFX] Processing Layer %s Slice 1!\n", hrp_name(&myLayer->args));
         }
@@ -402,7 +605,7 @@ bool prepare_project(Project* project, MyProject* myProject, Vulkanizer* vulkani
     return true;
 }
 
-int process_project(VkCommandBuffer cmd, Project* project, MyProject* myProject, Vulkanizer* vulkanizer, void* push_constants_buf, VkImageView outComposedImageView, bool* enoughSamplesOUT){
+int process_project(VkCommandBuffer cmd, Project* project, MyProject* myProject, Vulkanizer* vulkanizer, VkImageView outComposedImageView, bool* enoughSamplesOUT){
     *enoughSamplesOUT = true;
     size_t finishedCount = 0;
     size_t i = 0;
@@ -418,97 +621,198 @@ int process_project(VkCommandBuffer cmd, Project* project, MyProject* myProject,
         myLayer->volume = VfxLayerSoundParameter_Evaluate(&layer->volume, myProject->time);
         myLayer->pan = VfxLayerSoundParameter_Evaluate(&layer->pan, myProject->time);
         myProject->vulkanizerVfxInstances.count = 0;
+        size_t push_constants_offset = 0;
         for(VfxInstance* vfx = layer->vfxInstances; vfx != NULL; vfx = vfx->next){
             if((vfx->duration != -1) && !(myProject->time > vfx->offset && myProject->time < vfx->offset + vfx->duration)) continue;
 
-            if(vfx->inputs != NULL) VfxInstance_Update(myProject->myVfxs, vfx, myProject->time, push_constants_buf);
             MyVfx* myVfx = ll_at(myProject->myVfxs, vfx->vfx_index);
-            da_append(&myProject->vulkanizerVfxInstances, ((VulkanizerVfxInstance){.vfx = &myVfx->vfx, .push_constants_data = push_constants_buf, .push_constants_size = myVfx->vfx.module->pushContantsSize}));
+            void* push_constants_data = myProject->pushConstants + push_constants_offset;
+            push_constants_offset += myVfx->vfx.module->pushContantsSize;
+            assert(push_constants_offset <= myProject->pushConstantsSize);
+
+            if(vfx->inputs != NULL) VfxInstance_Update(myProject->myVfxs, vfx, myProject->time, push_constants_data);
+            float renderScale = vfx->renderScale > 0 ? vfx->renderScale : myVfx->vfx.module->renderScale;
+            da_append(&myProject->vulkanizerVfxInstances, ((VulkanizerVfxInstance){.vfx = &myVfx->vfx, .push_constants_data = push_constants_data, .push_constants_size = myVfx->vfx.module->pushContantsSize, .renderScale = renderScale}));
         }
 
-        int e = getFrame(cmd, vulkanizer, project, layer->slices, myLayer->myMedias, &myProject->vulkanizerVfxInstances, &myLayer->frame, myLayer->audioFifo, &myLayer->args, outComposedImageView);
+        int e = getFrame(cmd, vulkanizer, project, myProject, myLayer, layer->slices, myLayer->myMedias, &myProject->vulkanizerVfxInstances, &myLayer->frame, &myLayer->args, &myLayer->layerCache, outComposedImageView);
         
         MyMedia* myMedia = ll_at(myLayer->myMedias, myLayer->args.currentMediaIndex);
-        if(myLayer->audioFifo && (myLayer->args.currentMediaIndex == EMPTY_MEDIA || (myLayer->args.currentMediaIndex != EMPTY_MEDIA && !myMedia->hasAudio))){
-            av_audio_fifo_add_silence(myLayer->audioFifo, myProject->myLayers_fifo_fmt, &myProject->myLayers_fifo_ch_layout, project->settings.sampleRate / project->settings.fps);
+        bool feedsFifo = myLayer->audioFifo && !myProject->audioDetached;
+        if(feedsFifo && (myLayer->args.currentMediaIndex == EMPTY_MEDIA || (myLayer->args.currentMediaIndex != EMPTY_MEDIA && !myMedia->hasAudio))){
+            av_audio_fifo_add_silence(myLayer->audioFifo, myProject->myLayers_fifo_fmt, &myProject->myLayers_fifo_ch_layout, project->settings.sampleRate / project->settings.fps, &myLayer->audioSilence);
         }
 
-        if(myLayer->audioFifo && myLayer->args.currentMediaIndex != EMPTY_MEDIA && av_audio_fifo_size(myLayer->audioFifo) < myProject->myLayers_fifo_frame_size) *enoughSamplesOUT = false;
+        if(feedsFifo && myLayer->args.currentMediaIndex != EMPTY_MEDIA && av_audio_fifo_size(myLayer->audioFifo) < myProject->myLayers_fifo_frame_size) *enoughSamplesOUT = false;
         if(e == -GET_FRAME_ERR) return 1;
-        if(e == -GET_FRAME_FINISHED) {printf("[FVFX] Layer %s finished\n", hrp_name(&myLayer->args));myLayer->finished = true; finishedCount++; continue;}
+        if(e == -GET_FRAME_FINISHED) {printf("[FVFX] Layer %s finished\n", hrp_name(&myLayer->args));myLayer->finished = true; finishedCount++; Vulkanizer_layer_cache_release(vulkanizer, &myLayer->layerCache); continue;}
         if(e == -GET_FRAME_SKIP) continue;
     }
     myProject->time += 1.0 / project->settings.fps;
     return finishedCount == layers_count ? PROCESS_PROJECT_FINISHED : PROCESS_PROJECT_CONTINUE;
 }
 
-bool project_seek(Project* project, MyProject* myProject, double time_seconds) {
-    myProject->time = time_seconds;
+// moves layer cursor frameDuration forward on its slices, decoding audio or writing silence where there is none
+static int getLayerAudio(Project* project, MyProject* myProject, Slice* slices, MyLayer* myLayer, GetVideoFrameArgs* args, double frameDuration){
+    while(true){
+        Slice* slice = ll_at(slices, args->currentSlice);
+        if(slice == NULL) return -GET_FRAME_FINISHED;
+
+        double until = args->localTime + frameDuration;
+        if(until > args->checkDuration) until = args->checkDuration;
+        if(until > args->localTime) frameDuration -= until - args->localTime;
+        args->localTime = until;
+
+        if(myLayer->audioFifo){
+            MyMedia* myMedia = args->currentMediaIndex == EMPTY_MEDIA ? NULL : ll_at(myLayer->myMedias, args->currentMediaIndex);
+            // media without audio or whose audio ends early is mixed as silence so layer stays in place
+            if(myMedia == NULL || !getAudioUntil(project, slice, myMedia, myLayer->audioFifo, args, until)) padAudioSilence(project, myProject, myLayer, args, until);
+        }
 
-    size_t i = 0;
+        if(args->localTime < args->checkDuration) return 0;
+
+        args->currentSlice++;
+        if(ll_at(slices, args->currentSlice) == NULL) return -GET_FRAME_FINISHED;
+        // detached audio runs on its own thread, video path already reports slices and hrp isn't thread safe
+        if(!myProject->audioDetached) printf("[FVFX] Processing Layer %s Slice %zu!\n", hrp_name(args),args->currentSlice+1);
+        args->localTime = 0;
+        args->audioLocalTime = 0;
+        if(!updateSlice(myLayer->myMedias, slices, args->currentSlice, &args->currentMediaIndex, &args->checkDuration, false, true)) return -GET_FRAME_ERR;
+        resetSliceAudio(args, ll_at(slices, args->currentSlice), 0);
+    }
+}
+
+int process_project_audio(Project* project, MyProject* myProject, bool* enoughSamplesOUT){
+    *enoughSamplesOUT = true;
+    size_t finishedCount = 0;
+    size_t layers_count = 0;
     Layer* layer = project->layers;
-    MyLayer* myLayer = myProject->myLayers;
-    for(; myLayer != NULL; myLayer = myLayer->next, layer = layer->next){
-        myLayer->args.currentSlice = 0;
-        myLayer->args.currentMediaIndex = EMPTY_MEDIA;
-        myLayer->args.checkDuration = 0;
-        myLayer->args.localTime = 0;
-        myLayer->args.video_skip_count = 0;
-        myLayer->args.times_to_catch_up_target_framerate = 0;
-        myLayer->finished = false;
-
-        if(myLayer->audioFifo) av_audio_fifo_reset(myLayer->audioFifo);
-
-        double accumulatedTime = 0.0;
-        bool sliceFound = false;
-        size_t slice_index = 0;
-        for(Slice* slice = layer->slices; slice != NULL; slice = slice->next, slice_index++){
-            double sliceStart = accumulatedTime;
-            double sliceEnd = accumulatedTime + slice->duration;
-
-            if (time_seconds >= sliceStart && time_seconds < sliceEnd) {
-                myLayer->args.currentSlice = slice_index;
-                myLayer->args.currentMediaIndex = slice->media_index;
-                myLayer->args.checkDuration = slice->duration;
-                myLayer->args.localTime = time_seconds - sliceStart;
-
-                if (myLayer->args.currentMediaIndex != EMPTY_MEDIA) {
-                    MyMedia* media = ll_at(myLayer->myMedias,myLayer->args.currentMediaIndex);
-
-                    if (!media->media.isImage) {
-                        if(!ffmpegMediaSeek(&media->media, slice->offset + myLayer->args.localTime)) {
-                            fprintf(stderr, "ffmpegMediaSeek failed while seeking layer %zu media %zu\n", i, myLayer->args.currentMediaIndex);
-                            return false;
-                        }
+    for(MyLayer* myLayer = myProject->myLayers; myLayer != NULL; myLayer = myLayer->next, layer = layer->next){
+        layers_count++;
+        if(myLayer->finished) {
+            finishedCount++;
+            continue;
+        }
+        myLayer->volume = VfxLayerSoundParameter_Evaluate(&layer->volume, myProject->time);
+        myLayer->pan = VfxLayerSoundParameter_Evaluate(&layer->pan, myProject->time);
 
-                        if (media->hasVideo) {
-                            myLayer->args.lastVideoPts = (slice->offset + myLayer->args.localTime) / av_q2d(media->media.videoStream->time_base);
-                        }
+        int e = getLayerAudio(project, myProject, layer->slices, myLayer, &myLayer->args, 1.0 / project->settings.fps);
+        if(e == -GET_FRAME_ERR) return -1;
+        if(myLayer->audioFifo && av_audio_fifo_size(myLayer->audioFifo) < (int)myProject->myLayers_fifo_frame_size) *enoughSamplesOUT = false;
+        if(e == -GET_FRAME_FINISHED) {printf("[FVFX] Layer %s finished\n", hrp_name(&myLayer->args));myLayer->finished = true; finishedCount++;}
+    }
+    myProject->time += 1.0 / project->settings.fps;
+    return finishedCount == layers_count ? PROCESS_PROJECT_FINISHED : PROCESS_PROJECT_CONTINUE;
+}
+
+// positions layer cursor at time_seconds, only demuxers asked for are touched, returns false when media seek fails
+static bool seekLayer(Layer* layer, MyLayer* myLayer, GetVideoFrameArgs* args, bool* finished, size_t layerIndex, double time_seconds, bool seekVideo, bool seekAudio){
+    args->currentSlice = 0;
+    args->currentMediaIndex = EMPTY_MEDIA;
+    args->checkDuration = 0;
+    args->localTime = 0;
+    args->audioLocalTime = 0;
+    args->video_skip_count = 0;
+    args->times_to_catch_up_target_framerate = 0;
+    *finished = false;
+
+    if(seekAudio && myLayer->audioFifo) av_audio_fifo_reset(myLayer->audioFifo);
+
+    double accumulatedTime = 0.0;
+    size_t slice_index = 0;
+    for(Slice* slice = layer->slices; slice != NULL; slice = slice->next, slice_index++){
+        double sliceStart = accumulatedTime;
+        double sliceEnd = accumulatedTime + slice->duration;
+
+        if (time_seconds >= sliceStart && time_seconds < sliceEnd) {
+            args->currentSlice = slice_index;
+            args->currentMediaIndex = slice->media_index;
+            args->checkDuration = slice->duration;
+            args->localTime = time_seconds - sliceStart;
+            args->audioLocalTime = args->localTime;
+            double mediaTime = slice_media_time(slice, args->localTime);
+            resetSliceAudio(args, slice, mediaTime);
+
+            if (args->currentMediaIndex != EMPTY_MEDIA) {
+                MyMedia* media = ll_at(myLayer->myMedias,args->currentMediaIndex);
+
+                if (!media->media.isImage) {
+                    if(!seekMedia(media, slice->offset + mediaTime, seekVideo, seekAudio)) {
+                        fprintf(stderr, "ffmpegMediaSeek failed while seeking layer %zu media %zu\n", layerIndex, args->currentMediaIndex);
+                        return false;
                     }
-                }
 
-                sliceFound = true;
-                break;
+                    if (media->hasVideo) {
+                        args->lastVideoPts = (slice->offset + mediaTime) / av_q2d(media->media.videoStream->time_base);
+                    }
+                }
             }
 
-            accumulatedTime = sliceEnd;
+            return true;
         }
 
-        if (!sliceFound) {
-            myLayer->finished = true;
-            myLayer->args.currentSlice = slice_index;
-            myLayer->args.currentMediaIndex = EMPTY_MEDIA;
-            myLayer->args.localTime = 0;
-        }
+        accumulatedTime = sliceEnd;
+    }
+
+    *finished = true;
+    args->currentSlice = slice_index;
+    args->currentMediaIndex = EMPTY_MEDIA;
+    args->localTime = 0;
+    return true;
+}
+
+bool project_seek(Project* project, MyProject* myProject, double time_seconds) {
+    myProject->time = time_seconds;
+
+    size_t i = 0;
+    Layer* layer = project->layers;
+    for(MyLayer* myLayer = myProject->myLayers; myLayer != NULL; myLayer = myLayer->next, layer = layer->next, i++){
+        if(!seekLayer(layer, myLayer, &myLayer->args, &myLayer->finished, i, time_seconds, true, !myProject->audioDetached)) return false;
+    }
+
+    return true;
+}
+
+void project_detach_audio(MyProject* myProject){
+    myProject->audioDetached = true;
+    for(MyLayer* myLayer = myProject->myLayers; myLayer != NULL; myLayer = myLayer->next){
+        // audio cursor starts where video one is, time stretch moves over since only audio cursor uses it from now on
+        myLayer->audioArgs = myLayer->args;
+        myLayer->audioFinished = myLayer->finished;
+        memset(&myLayer->args.timeStretch, 0, sizeof(myLayer->args.timeStretch));
     }
+}
 
+int project_layer_audio(Project* project, MyProject* myProject, Layer* layer, MyLayer* myLayer, double frameDuration){
+    assert(myProject->audioDetached);
+    if(myLayer->audioFinished) return PROCESS_PROJECT_FINISHED;
+    int e = getLayerAudio(project, myProject, layer->slices, myLayer, &myLayer->audioArgs, frameDuration);
+    if(e == -GET_FRAME_ERR) return -1;
+    if(e == -GET_FRAME_FINISHED){
+        myLayer->audioFinished = true;
+        return PROCESS_PROJECT_FINISHED;
+    }
+    return PROCESS_PROJECT_CONTINUE;
+}
+
+bool project_seek_audio(Project* project, MyProject* myProject, double time_seconds) {
+    assert(myProject->audioDetached);
+    size_t i = 0;
+    Layer* layer = project->layers;
+    for(MyLayer* myLayer = myProject->myLayers; myLayer != NULL; myLayer = myLayer->next, layer = layer->next, i++){
+        if(!myLayer->audioFifo) continue;
+        if(!seekLayer(layer, myLayer, &myLayer->audioArgs, &myLayer->audioFinished, i, time_seconds, false, true)) return false;
+    }
     return true;
 }
 
-static void freeMyMedia(VkDevice device, VkDescriptorPool descriptorPool, MyMedia* media) {
+static void freeMyMedia(Vulkanizer* vulkanizer, MyMedia* media) {
     if (!media) return;
 
     ffmpegMediaUninit(&media->media);
+    // audio only projects never created any images
+    if (!vulkanizer) return;
+    VkDevice device = vulkanizer->device;
 
     // Free Vulkan image resources
     if (media->mediaImageView)
@@ -518,35 +822,46 @@ static void freeMyMedia(VkDevice device, VkDescriptorPool descriptorPool, MyMedi
     if (media->mediaImageMemory)
         vkFreeMemory(device, media->mediaImageMemory, NULL);
     if (media->mediaDescriptorSet)
-        vkFreeDescriptorSets(device, descriptorPool, 1, &media->mediaDescriptorSet);
+        Vulkanizer_free_descriptor_set(vulkanizer, media->mediaDescriptorPool, media->mediaDescriptorSet);
+    if (media->mediaMips.stagingBuffer)
+        vkDestroyBuffer(device, media->mediaMips.stagingBuffer, NULL);
+    if (media->mediaMips.stagingMemory)
+        vkFreeMemory(device, media->mediaMips.stagingMemory, NULL);
 }
 
-static void freeMyMedias(VkDevice device, VkDescriptorPool descriptorPool, MyMedia* medias) {
+static void freeMyMedias(Vulkanizer* vulkanizer, MyMedia* medias) {
     if (!medias) return;
 
     for(MyMedia* myMedia = medias; myMedia != NULL; myMedia = myMedia->next)
-        freeMyMedia(device, descriptorPool, myMedia);
+        freeMyMedia(vulkanizer, myMedia);
 }
 
-static void freeMyLayer(VkDevice device, VkDescriptorPool descriptorPool, MyLayer* layer) {
+static void freeMyLayer(Vulkanizer* vulkanizer, MyLayer* layer) {
     if (!layer) return;
 
     // Free media collection
-    freeMyMedias(device, descriptorPool, layer->myMedias);
+    freeMyMedias(vulkanizer, layer->myMedias);
 
     // Free audio FIFO
     if (layer->audioFifo)
         av_audio_fifo_free(layer->audioFifo);
+    audio_silence_free(&layer->audioSilence);
+    time_stretch_uninit(&layer->args.timeStretch);
+    time_stretch_uninit(&layer->audioArgs.timeStretch);
 }
 
-static void freeMyLayers(VkDevice device, VkDescriptorPool descriptorPool, MyLayer* layers) {
+static void freeMyLayers(Vulkanizer* vulkanizer, MyLayer* layers) {
     if (!layers) return;
 
     for(MyLayer* myLayer = layers; myLayer != NULL; myLayer = myLayer->next)
-        freeMyLayer(device, descriptorPool, myLayer);
+        freeMyLayer(vulkanizer, myLayer);
 }
 
 static void freeVulkanizerVfx(VkDevice device, VulkanizerVfx* vfx){
+    spirv_program_free(vfx->cpuProgram);
+    vfx->cpuProgram = NULL;
+    // vfx running on cpu never got a pipeline
+    if(vfx->pipeline == NULL) return;
     vkDestroyPipelineLayout(device, vfx->pipelineLayout, NULL);
     vkDestroyPipeline(device, vfx->pipeline, NULL);
 }
@@ -561,8 +876,13 @@ static void freeMyVfxs(VkDevice device, MyVfx* vfxs) {
 void project_uninit(Vulkanizer* vulkanizer, MyProject* myProject, ArenaAllocator* aa){
     if (!myProject) return;
 
-    freeMyLayers(vulkanizer->device, vulkanizer->descriptorPool, myProject->myLayers);
-    freeMyVfxs(vulkanizer->device, myProject->myVfxs);
+    if (vulkanizer) {
+        for(MyLayer* myLayer = myProject->myLayers; myLayer != NULL; myLayer = myLayer->next)
+            Vulkanizer_layer_cache_release(vulkanizer, &myLayer->layerCache);
+    }
+
+    freeMyLayers(vulkanizer, myProject->myLayers);
+    if (vulkanizer) freeMyVfxs(vulkanizer->device, myProject->myVfxs);
     aa_reset(aa);
 
     *myProject = (MyProject){0};
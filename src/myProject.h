@@ -5,6 +5,8 @@
 #include "vulkanizer.h"
 #include <libavutil/audio_fifo.h>
 #include "arena_alloc.h"
+#include "ffmpeg_helper.h"
+#include "time_stretch.h"
 
 typedef struct MyMedia MyMedia;
 
@@ -18,7 +20,9 @@ struct MyMedia{
     VkImageView mediaImageView;
     size_t mediaImageStride;
     void* mediaImageData;
+    VulkanizerMediaMips mediaMips;
     VkDescriptorSet mediaDescriptorSet;
+    VkDescriptorPool mediaDescriptorPool;
     double duration;
     MyMedia* next;
 };
@@ -39,12 +43,16 @@ enum {
 
 typedef struct{
     double localTime;
+    double audioLocalTime; // end of audio already written to layer fifo, audio has its own demuxer so it's tracked separately
     double checkDuration;
     size_t currentSlice;
     size_t currentMediaIndex;
     size_t video_skip_count;
     size_t times_to_catch_up_target_framerate;
     int64_t lastVideoPts;
+    // slices not playing at 1x send their audio through timeStretch, audioMediaTime is end of what it got so far
+    TimeStretch timeStretch;
+    double audioMediaTime;
 } GetVideoFrameArgs;
 
 typedef struct MyLayer MyLayer;
@@ -52,11 +60,19 @@ typedef struct MyLayer MyLayer;
 struct MyLayer{
     MyMedia* myMedias;
     AVAudioFifo* audioFifo;
+    AudioSilence audioSilence;
     Frame frame;
     GetVideoFrameArgs args;
     bool finished;
+    // once audio is detached, thread that owns it walks slices with this cursor and args only follows video
+    GetVideoFrameArgs audioArgs;
+    bool audioFinished;
     double volume;
     double pan;
+    // gains last mixed buffer ended at, next buffer ramps from them to current volume/pan
+    float mixGains[MIX_AUDIO_MAX_CHANNELS];
+    bool mixGainsSet;
+    VulkanizerLayerCache layerCache;
     MyLayer* next;
 };
 
@@ -67,8 +83,13 @@ typedef struct{
     size_t myLayers_fifo_frame_size;
     MyVfx* myVfxs;
     VulkanizerVfxInstances vulkanizerVfxInstances;
+    // every active vfx instance of a layer gets its own slice so their parameters dont alias
+    uint8_t* pushConstants;
+    size_t pushConstantsSize;
     double time;
     double duration;
+    // audio is decoded by another thread (preview audio engine), process_project leaves layer fifos and audio demuxers alone
+    bool audioDetached;
 } MyProject;
 
 enum {
@@ -77,8 +98,26 @@ enum {
 };
 
 bool prepare_project(Project* project, MyProject* myProject, Vulkanizer* vulkanizer, enum AVSampleFormat expectedSampleFormat, size_t fifo_size, ArenaAllocator* aa);
-int process_project(VkCommandBuffer cmd, Project* project, MyProject* myProject, Vulkanizer* vulkanizer, void* push_constants_buf, VkImageView outComposedImageView, bool* enoughSamplesOUT);
+int process_project(VkCommandBuffer cmd, Project* project, MyProject* myProject, Vulkanizer* vulkanizer, VkImageView outComposedImageView, bool* enoughSamplesOUT);
 bool project_seek(Project* project, MyProject* myProject, double time_seconds);
+// map time inside slice on timeline to media time after slice offset and back, following slice speed ramp
+double slice_media_time(const Slice* slice, double localTime);
+double slice_local_time(const Slice* slice, double mediaTime);
+// speakers everything is mixed and encoded to, from channelLayout setting or stereo flag when it's default
+AVChannelLayout project_channel_layout(const Project* project);
+// vulkanizer is NULL for projects made by prepare_project_audio
 void project_uninit(Vulkanizer* vulkanizer, MyProject* myProject, ArenaAllocator* aa);
 
+// audio only versions, no vulkanizer, vfx or video decoding involved
+bool prepare_project_audio(Project* project, MyProject* myProject, enum AVSampleFormat expectedSampleFormat, size_t fifo_size, ArenaAllocator* aa);
+// returns -1 when decoding fails
+int process_project_audio(Project* project, MyProject* myProject, bool* enoughSamplesOUT);
+
+// hands layer audio over to another thread, call right after prepare_project before anything was processed
+void project_detach_audio(MyProject* myProject);
+// detached audio only, called from thread that owns it
+// moves audio cursor of layer frameDuration forward into its fifo, returns -1 when decoding fails and PROCESS_PROJECT_FINISHED once layer has no more slices
+int project_layer_audio(Project* project, MyProject* myProject, Layer* layer, MyLayer* myLayer, double frameDuration);
+bool project_seek_audio(Project* project, MyProject* myProject, double time_seconds);
+
 #endif
\ No newline at end of file
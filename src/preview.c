@@ -14,38 +14,147 @@
 #include "loader.h"
 #include "ll.h"
 #include "fvfx_helper.h"
+#include "audio_engine.h"
+#include "waveform.h"
+
+void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
+{
+    (void)pInput;
+    // only copies what audio engine thread already mixed, never touches layer fifos
+    audio_engine_pull((AudioEngine*)pDevice->pUserData, pOutput, frameCount);
+}
 
 typedef struct{
     Project* project;
     MyProject* myProject;
-    uint8_t** tempAudioBuf;
-    enum AVSampleFormat out_audio_format;
-    bool* paused;
-    float* global_volume;
-} MiniaudioUserData;
+    float* scratch; // engine block of interleaved frames
+} PreviewAudio;
+
+// engine thread, decodes one more block of every layer whose ring has room, layer fifo only stages what ring can't take yet
+static bool preview_produce_audio(void* arg, AudioEngine* engine){
+    PreviewAudio* audio = arg;
+    Project* project = audio->project;
+    double blockDuration = (double)engine->blockFrames / project->settings.sampleRate;
+    bool produced = false;
+
+    size_t index = 0;
+    Layer* layer = project->layers;
+    for(MyLayer* myLayer = audio->myProject->myLayers; myLayer != NULL; myLayer = myLayer->next, layer = layer->next){
+        if(!myLayer->audioFifo) continue;
+        AudioEngineLayer* engineLayer = &engine->layers[index++];
+
+        if(!myLayer->audioFinished && av_audio_fifo_size(myLayer->audioFifo) == 0 && audio_ring_writable(&engineLayer->ring) >= engine->blockFrames){
+            if(project_layer_audio(project, audio->myProject, layer, myLayer, blockDuration) < 0){
+                fprintf(stderr, "[FVFX] Couldn't decode audio of layer %zu, it stays silent until next seek\n", index - 1);
+                myLayer->audioFinished = true;
+            }
+            produced = true;
+        }
 
-void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
-{
-    (void)pInput;
-    memset(pOutput, 0, frameCount*sizeof(float)*pDevice->playback.channels);
-
-    MiniaudioUserData* data = (MiniaudioUserData*)pDevice->pUserData;
-    if(*data->paused) return;
-    Project* project = data->project;
-    MyLayer* myLayers = data->myProject->myLayers;
-    uint8_t** tempAudioBuf = data->tempAudioBuf;
-
-    mix_all_layers(
-        (uint8_t **)&pOutput,
-        tempAudioBuf,myLayers,
-        frameCount,
-        AV_SAMPLE_FMT_FLT,
-        project
-    );
-    
-    for(size_t i = 0; i < frameCount;i++){
-        ((float*)pOutput)[i*2 + 0] *= *data->global_volume;
-        ((float*)pOutput)[i*2 + 1] *= *data->global_volume;
+        while(true){
+            size_t count = av_audio_fifo_size(myLayer->audioFifo);
+            size_t writable = audio_ring_writable(&engineLayer->ring);
+            if(count > writable) count = writable;
+            if(count > engine->blockFrames) count = engine->blockFrames;
+            if(count == 0) break;
+            int read = av_audio_fifo_read(myLayer->audioFifo, (void**)&audio->scratch, count);
+            if(read <= 0) break;
+            audio_ring_write(&engineLayer->ring, audio->scratch, read);
+        }
+
+        // stored after samples so engine never sees layer ended before its tail is queued
+        atomic_store(&engineLayer->ended, myLayer->audioFinished && av_audio_fifo_size(myLayer->audioFifo) == 0);
+    }
+    return produced;
+}
+
+static void preview_seek_audio(void* arg, AudioEngine* engine, double time){
+    (void)engine;
+    PreviewAudio* audio = arg;
+    if(!project_seek_audio(audio->project, audio->myProject, time)) fprintf(stderr, "[FVFX] Couldn't seek audio to %.2fs\n", time);
+}
+
+// main thread only publishes automation, everything audio is decoded and mixed on engine thread
+static void preview_publish_audio(AudioEngine* engine, MyProject* myProject){
+    size_t index = 0;
+    for(MyLayer* myLayer = myProject->myLayers; myLayer != NULL; myLayer = myLayer->next){
+        if(!myLayer->audioFifo) continue;
+        AudioEngineLayer* layer = &engine->layers[index++];
+        atomic_store(&layer->volume, (float)myLayer->volume);
+        atomic_store(&layer->pan, (float)myLayer->pan);
+    }
+}
+
+static size_t preview_audio_layers_count(MyProject* myProject){
+    size_t count = 0;
+    for(MyLayer* myLayer = myProject->myLayers; myLayer != NULL; myLayer = myLayer->next){
+        if(myLayer->audioFifo) count++;
+    }
+    return count;
+}
+
+// waveforms get built for every media that is heard in some layer
+static bool preview_start_waveforms(WaveformCache* cache, Project* project, MyProject* myProject){
+    const char** filenames = NULL;
+    size_t count = 0;
+    for(Layer* layer = project->layers; layer != NULL; layer = layer->next){
+        for(MediaInstance* mediaInstance = layer->mediaInstances; mediaInstance != NULL; mediaInstance = mediaInstance->next) count++;
+    }
+    if(count > 0){
+        filenames = malloc(count*sizeof(*filenames));
+        if(filenames == NULL) return false;
+    }
+
+    count = 0;
+    Layer* layer = project->layers;
+    for(MyLayer* myLayer = myProject->myLayers; myLayer != NULL; myLayer = myLayer->next, layer = layer->next){
+        MediaInstance* mediaInstance = layer->mediaInstances;
+        for(MyMedia* myMedia = myLayer->myMedias; myMedia != NULL; myMedia = myMedia->next, mediaInstance = mediaInstance->next){
+            if(myMedia->hasAudio) filenames[count++] = mediaInstance->filename;
+        }
+    }
+
+    bool result = waveform_cache_start(cache, filenames, count);
+    free(filenames);
+    return result;
+}
+
+// one lane per audio layer, slices whose waveform isn't built yet stay empty
+static void preview_draw_waveforms(WaveformCache* cache, Project* project, MyProject* myProject, float x, float y, float width, float height){
+    size_t lanes = preview_audio_layers_count(myProject);
+    if(lanes == 0 || myProject->duration <= 0) return;
+    float laneHeight = height / lanes;
+    double secondsPerPixel = myProject->duration / width;
+
+    size_t lane = 0;
+    Layer* layer = project->layers;
+    for(MyLayer* myLayer = myProject->myLayers; myLayer != NULL; myLayer = myLayer->next, layer = layer->next){
+        if(!myLayer->audioFifo) continue;
+        float center = y + laneHeight*lane + laneHeight/2;
+        lane++;
+
+        double sliceStart = 0;
+        for(Slice* slice = layer->slices; slice != NULL; sliceStart += slice->duration, slice = slice->next){
+            if(slice->media_index == EMPTY_MEDIA) continue;
+            MediaInstance* mediaInstance = ll_at(layer->mediaInstances, slice->media_index);
+            if(mediaInstance == NULL) continue;
+            Waveform* waveform = waveform_cache_find(cache, mediaInstance->filename);
+            if(waveform == NULL) continue;
+
+            size_t firstPixel = (size_t)(sliceStart / secondsPerPixel);
+            size_t lastPixel = (size_t)((sliceStart + slice->duration) / secondsPerPixel);
+            if(lastPixel > (size_t)width) lastPixel = (size_t)width;
+            for(size_t px = firstPixel; px < lastPixel; px++){
+                double localTime = px*secondsPerPixel - sliceStart;
+                double from = slice->offset + slice_media_time(slice, localTime);
+                double to = slice->offset + slice_media_time(slice, localTime + secondsPerPixel);
+                float min, max;
+                if(!waveform_range(waveform, from, to, &min, &max)) continue;
+                float top = center - max*laneHeight/2;
+                float bottom = center - min*laneHeight/2;
+                dd_rect(x + px, top, 1, bottom - top > 1 ? bottom - top : 1, 0xFF707070);
+            }
+        }
     }
 }
 
@@ -138,8 +247,21 @@ static bool pointInsideRect(float x, float y, Rect rect){
     );
 }
 
-#define PREVIEW_WIDTH_SCALER (0.75)
-#define PREVIEW_HEIGHT_SCALER (0.75)
+#define PREVIEW_DEFAULT_SCALE (0.75f)
+#define PREVIEW_MIN_SCALE (0.125f)
+
+// shrinks whole output uniformly, vfx only see renderArea/mediaArea so they behave the same as in render
+static void preview_apply_proxy_scale(Project_Settings* settings){
+    float scale = settings->previewScale > 0.0f ? settings->previewScale : PREVIEW_DEFAULT_SCALE;
+    if(scale > 1.0f) scale = 1.0f;
+    if(scale < PREVIEW_MIN_SCALE) scale = PREVIEW_MIN_SCALE;
+
+    // keeping sizes even so half resolution passes line up with output pixels
+    size_t width = (size_t)(settings->width*scale + 0.5f) & ~(size_t)1;
+    size_t height = (size_t)(settings->height*scale + 0.5f) & ~(size_t)1;
+    settings->width = width > 0 ? width : 2;
+    settings->height = height > 0 ? height : 2;
+}
 
 #define FA_REALLOC(optr, osize, new_size) realloc(optr, new_size)
 #define fa_reserve(da, extra) \
@@ -195,9 +317,7 @@ int preview(Project* project, const char* project_filename, int argc, const char
     currently_used_aa = aa_;
     if(!vulkan_init_with_window("FVFX", 640, 480)) return 1;
 
-    // TODO: optimize this byh even more
-    project->settings.width *= PREVIEW_WIDTH_SCALER;
-    project->settings.height *= PREVIEW_HEIGHT_SCALER;
+    preview_apply_proxy_scale(&project->settings);
 
     VkCommandBuffer cmd;
     if(vkAllocateCommandBuffers(device,&(VkCommandBufferAllocateInfo){
@@ -220,7 +340,8 @@ int preview(Project* project, const char* project_filename, int argc, const char
     if(vkCreateSemaphore(device, &(VkSemaphoreCreateInfo){.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO}, NULL, &readyToSwapYourChainSemaphore) != VK_SUCCESS) return 1;
 
     Vulkanizer vulkanizer = {0};
-    if(!Vulkanizer_init(device, descriptorPool, project->settings.width, project->settings.height, &vulkanizer, currently_used_aa)) return 1;
+    if(!Vulkanizer_init(device, project->settings.width, project->settings.height, &vulkanizer, currently_used_aa)) return 1;
+    vulkanizer.workingFormat = project->settings.workingFormat;
 
     if(!dd_init(device, swapchainImageFormat, descriptorPool)) return 1;
 
@@ -229,8 +350,8 @@ int preview(Project* project, const char* project_filename, int argc, const char
 
     MyProject myProject = {0};
     if(!prepare_project(project, &myProject, &vulkanizer, out_audio_format, out_audio_frame_size, currently_used_aa)) return 1;
+    project_detach_audio(&myProject);
 
-    void* push_constants_buf = calloc(256, sizeof(uint8_t));
 
     VkImage          outComposedImage;
     VkDeviceMemory   outComposedImageMemory;
@@ -325,25 +446,39 @@ int preview(Project* project, const char* project_filename, int argc, const char
     bool paused = false;
     float global_volume = 1.0;
 
+    AVChannelLayout ch_layout = project_channel_layout(project);
     uint8_t** tempAudioBuf;
     int tempAudioBufLineSize;
-    av_samples_alloc_array_and_samples(&tempAudioBuf,&tempAudioBufLineSize, project->settings.stereo ? 2 : 1, out_audio_frame_size, out_audio_format, 0);
+    av_samples_alloc_array_and_samples(&tempAudioBuf,&tempAudioBufLineSize, ch_layout.nb_channels, out_audio_frame_size, out_audio_format, 0);
+
+    WaveformCache waveforms;
+    if(!preview_start_waveforms(&waveforms, project, &myProject)) return 1;
+
+    AudioGraph audioGraph;
+    if(!audio_graph_init(&audioGraph, project, &myProject, &ch_layout, project->settings.sampleRate, out_audio_format, out_audio_frame_size)) return 1;
+
+    PreviewAudio previewAudio = {
+        .project = project,
+        .myProject = &myProject,
+        .scratch = (float*)tempAudioBuf[0],
+    };
+    AudioEngineProducer audioProducer = {
+        .produce = preview_produce_audio,
+        .seek = preview_seek_audio,
+        .arg = &previewAudio,
+    };
+    AudioEngine audioEngine;
+    if(!audio_engine_start(&audioEngine, &audioGraph, project->settings.sampleRate, out_audio_frame_size, audioProducer)) return 1;
 
     //miniaudio init
     ma_device audio_device;
     ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
     deviceConfig.playback.format   = ma_format_f32;
-    deviceConfig.playback.channels = project->settings.stereo ? 2 : 1;
+    // miniaudio folds surround down itself when device has fewer speakers
+    deviceConfig.playback.channels = ch_layout.nb_channels;
     deviceConfig.sampleRate        = project->settings.sampleRate;
     deviceConfig.dataCallback      = data_callback;
-    deviceConfig.pUserData         = &(MiniaudioUserData){
-        .project = project,
-        .myProject = &myProject,
-        .tempAudioBuf = tempAudioBuf,
-        .out_audio_format = out_audio_format,
-        .paused = &paused,
-        .global_volume = &global_volume,
-    };
+    deviceConfig.pUserData         = &audioEngine;
 
     if (ma_device_init(NULL, &deviceConfig, &audio_device) != MA_SUCCESS) {
         printf("Failed to open playback device.\n");
@@ -436,6 +571,7 @@ int preview(Project* project, const char* project_filename, int argc, const char
 
         if(input.keys[KEY_MOUSE_LEFT].isDown && pointInsideRect(input.mouse_x, input.mouse_y, timelineRect)){
             project_seek(project, &myProject,((double)input.mouse_x - timelineRect.x)/timelineRect.width*myProject.duration);
+            audio_engine_flush(&audioEngine, myProject.time);
             scrubbed = true;
         }
 
@@ -444,6 +580,7 @@ int preview(Project* project, const char* project_filename, int argc, const char
         dd_begin();
 
         dd_rect(timelineRect.x, timelineRect.y, timelineRect.width, timelineRect.height, 0xFF101010);
+        preview_draw_waveforms(&waveforms, project, &myProject, timelineRect.x, timelineRect.y, timelineRect.width, timelineRect.height);
 
         dd_rect((myProject.time / myProject.duration)*swapchainExtent.width,timeline_y,5,timeline_height, 0xFFFF0000);
 
@@ -493,28 +630,37 @@ int preview(Project* project, const char* project_filename, int argc, const char
                 add_toast("Failed to hotreload", 3);
                 goto hotReloadedAFTER;
             }
-            new_project.settings.width *= PREVIEW_WIDTH_SCALER;
-            new_project.settings.height *= PREVIEW_HEIGHT_SCALER;
+            preview_apply_proxy_scale(&new_project.settings);
 
             vulkanizer.aa = currently_used_aa;
             vulkanizer.videoOutWidth = new_project.settings.width;
             vulkanizer.videoOutHeight = new_project.settings.height;
+            vulkanizer.workingFormat = new_project.settings.workingFormat;
 
             size_t new_out_audio_frame_size = project->settings.sampleRate/100;
-            if(!prepare_project(&new_project, &new_myProject, &vulkanizer, out_audio_format, new_out_audio_frame_size, currently_used_aa)) {
+            AVChannelLayout new_ch_layout = project_channel_layout(&new_project);
+            AudioGraph newAudioGraph;
+            if(!prepare_project(&new_project, &new_myProject, &vulkanizer, out_audio_format, new_out_audio_frame_size, currently_used_aa) ||
+               !audio_graph_init(&newAudioGraph, &new_project, &new_myProject, &new_ch_layout, new_project.settings.sampleRate, out_audio_format, new_out_audio_frame_size)) {
                 project_uninit(&vulkanizer, &new_myProject, currently_used_aa);
                 project_loader_clean(&new_project,currently_used_aa);
                 vulkanizer.aa = previousAllocator;
                 vulkanizer.videoOutWidth = project->settings.width;
                 vulkanizer.videoOutHeight = project->settings.height;
+                vulkanizer.workingFormat = project->settings.workingFormat;
                 aa_reset(currently_used_aa);
                 currently_used_aa = previousAllocator;
                 add_toast("Failed to hotreload", 3);
                 goto hotReloadedAFTER;
             }
+            project_detach_audio(&new_myProject);
 
             ma_device_stop(&audio_device);
             ma_device_uninit(&audio_device);
+            audio_engine_stop(&audioEngine);
+            audio_graph_uninit(&audioGraph);
+            memcpy(&audioGraph, &newAudioGraph, sizeof(newAudioGraph));
+            waveform_cache_stop(&waveforms);
             double time = myProject.time;
             vulkanizer.aa = previousAllocator;
             project_uninit(&vulkanizer, &myProject, previousAllocator);
@@ -570,21 +716,18 @@ int preview(Project* project, const char* project_filename, int argc, const char
             vkCmdTransitionImage(tempCmd, outComposedImage, VK_IMAGE_LAYOUT_UNDEFINED,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
             vkCmdEndSingleTime(tempCmd);
 
-            av_samples_alloc_array_and_samples(&tempAudioBuf,&tempAudioBufLineSize, project->settings.stereo ? 2 : 1, out_audio_frame_size, out_audio_format, 0);
+            av_samples_alloc_array_and_samples(&tempAudioBuf,&tempAudioBufLineSize, audioGraph.channels, out_audio_frame_size, out_audio_format, 0);
+
+            previewAudio.scratch = (float*)tempAudioBuf[0];
+            if(!audio_engine_start(&audioEngine, &audioGraph, project->settings.sampleRate, out_audio_frame_size, audioProducer)) return 1;
+            if(!preview_start_waveforms(&waveforms, project, &myProject)) return 1;
             
             deviceConfig = ma_device_config_init(ma_device_type_playback);
             deviceConfig.playback.format   = ma_format_f32;
-            deviceConfig.playback.channels = project->settings.stereo ? 2 : 1;
+            deviceConfig.playback.channels = audioGraph.channels;
             deviceConfig.sampleRate        = project->settings.sampleRate;
             deviceConfig.dataCallback      = data_callback;
-            deviceConfig.pUserData         = &(MiniaudioUserData){
-                .project = project,
-                .myProject = &myProject,
-                .tempAudioBuf = tempAudioBuf,
-                .out_audio_format = out_audio_format,
-                .paused = &paused,
-                .global_volume = &global_volume,
-            };
+            deviceConfig.pUserData         = &audioEngine;
 
             if (ma_device_init(NULL, &deviceConfig, &audio_device) != MA_SUCCESS) {
                 printf("Failed to open playback device.\n");
@@ -599,11 +742,15 @@ int preview(Project* project, const char* project_filename, int argc, const char
 
             if(time < myProject.duration) {
                 project_seek(project, &myProject, time);
+                audio_engine_flush(&audioEngine, time);
             }
         hotReloadedAFTER:
             paused = initialPaused;
         }
 
+        atomic_store(&audioEngine.paused, paused);
+        atomic_store(&audioEngine.masterGain, global_volume);
+
         vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, swapchainHasImageSemaphore, NULL, &imageIndex);
         
         vkResetCommandBuffer(cmd, 0);
@@ -615,7 +762,7 @@ int preview(Project* project, const char* project_filename, int argc, const char
         });
 
         if(paused == false || scrubbed || hotReloaded){
-            Vulkanizer_reset_pool();
+            Vulkanizer_reset_pool(&vulkanizer);
     
             vkCmdTransitionImage(
                 cmd,
@@ -646,9 +793,11 @@ int preview(Project* project, const char* project_filename, int argc, const char
             vkCmdEndRendering(cmd);
     
             bool enoughSamples;
-            int result = process_project(cmd, project, &myProject, &vulkanizer, push_constants_buf, outComposedImageView, &enoughSamples);
+            int result = process_project(cmd, project, &myProject, &vulkanizer, outComposedImageView, &enoughSamples);
+            preview_publish_audio(&audioEngine, &myProject);
             if(result == PROCESS_PROJECT_FINISHED) {
                 if(!project_seek(project, &myProject,0)) break;
+                audio_engine_flush(&audioEngine, 0);
             }
     
             vkCmdTransitionImage(
@@ -725,6 +874,9 @@ int preview(Project* project, const char* project_filename, int argc, const char
 
     ma_device_stop(&audio_device);
     ma_device_uninit(&audio_device);
+    audio_engine_stop(&audioEngine);
+    audio_graph_uninit(&audioGraph);
+    waveform_cache_stop(&waveforms);
 
     return 0;
 }
\ No newline at end of file
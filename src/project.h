@@ -7,12 +7,17 @@
 #include "arena_alloc.h"
 
 #define EMPTY_MEDIA (-1)
+#define AUDIO_BUS_MASTER (-1)
 
 typedef struct Slice Slice;
 struct Slice{
     size_t media_index;
     double offset;
-    double duration;
+    double duration; // time slice takes on timeline
+    // playback speed moves linearly from speed to speedEnd over slice, 2 plays media twice as fast
+    double speed;
+    double speedEnd;
+    bool preservePitch; // time stretch audio instead of resampling it like tape
     Slice* next;
 };
 
@@ -57,10 +62,24 @@ struct VfxInstance{
     size_t vfx_index;
     double offset;
     double duration;
+    double renderScale; // 0 means use module default
     VfxInstanceInput* inputs;
     VfxInstance* next;
 };
 
+typedef struct AudioEffectInstance AudioEffectInstance;
+struct AudioEffectInstance{
+    AudioEffect effect;
+    AudioEffectInstance* next;
+};
+
+typedef struct AudioBus AudioBus;
+struct AudioBus{
+    double volume;
+    AudioEffectInstance* effects;
+    AudioBus* next;
+};
+
 typedef struct Layer Layer;
 struct Layer{
     MediaInstance* mediaInstances;
@@ -68,6 +87,8 @@ struct Layer{
     VfxInstance* vfxInstances;
     VfxLayerSoundParameter volume;
     VfxLayerSoundParameter pan;
+    AudioEffectInstance* audioEffects;
+    size_t audioBus; // AUDIO_BUS_MASTER or index of project audio bus
     Layer* next;
 };
 
@@ -76,6 +97,7 @@ struct Project{
     Project_Settings settings;
     Layer* layers;
     VfxModule* vfxModules;
+    AudioBus* audioBuses;
     ArenaAllocator* aa;
 };
 
@@ -323,6 +323,21 @@ struct VfxInput{
     VfxInput* next;
 };
 
+// where module output can be non transparent, lets compositing skip rest of the screen
+typedef enum{
+    VFX_BOUNDS_FULL = 0,  // may draw anywhere
+    VFX_BOUNDS_INSIDE,    // only draws where its input isn't transparent
+    VFX_BOUNDS_FIT,       // aspect fits media into output like fit.fvfx
+    VFX_BOUNDS_TRANSLATE, // moves and scales input like translate.fvfx
+} VfxBoundsKind;
+
+typedef struct{
+    VfxBoundsKind kind;
+    // push constant offsets of vec2 inputs used by VFX_BOUNDS_TRANSLATE
+    size_t offsetInput;
+    size_t scaleInput;
+} VfxBounds;
+
 typedef struct VfxModule VfxModule;
 struct VfxModule{
     const char* filepath;
@@ -332,6 +347,8 @@ struct VfxModule{
     VfxInput* inputs;
     size_t pushContantsSize;
     bool hasDefaultValues;
+    float renderScale; // from RenderScale metadata, 0 means full resolution
+    VfxBounds bounds; // from Bounds metadata
     VfxModule *next;
 };
 
@@ -348,6 +365,31 @@ typedef enum{
     .w = ((float)(((c) >> 24) & 0xFF) / 255.0f)  \
 })
 
+// precision of intermediate vfx targets, final composite is always 8 bit
+typedef enum{
+    VFX_WORKING_FORMAT_RGBA8 = 0,
+    VFX_WORKING_FORMAT_RGBA16F, // no banding across long chains, twice the bandwidth
+    VFX_WORKING_FORMAT_RGB10A2, // same bandwidth as RGBA8, alpha only has 4 levels
+    VFX_WORKING_FORMAT_COUNT
+} VfxWorkingFormat;
+
+// engine used when media sample rate differs from project one
+typedef enum{
+    VFX_RESAMPLER_SWR = 0,
+    VFX_RESAMPLER_SOXR, // needs ffmpeg built with libsoxr, falls back to swr otherwise
+    VFX_RESAMPLER_COUNT
+} VfxResampler;
+
+// speakers of mix and output, media get up or downmixed to it when decoded
+typedef enum{
+    VFX_CHANNELS_DEFAULT = 0, // stereo or mono following stereo flag
+    VFX_CHANNELS_MONO,
+    VFX_CHANNELS_STEREO,
+    VFX_CHANNELS_5_1,
+    VFX_CHANNELS_7_1,
+    VFX_CHANNELS_COUNT
+} VfxChannelLayout;
+
 typedef struct{
     const char* outputFilename;
     size_t width;
@@ -356,8 +398,66 @@ typedef struct{
     float sampleRate;
     bool hasAudio;
     bool stereo;
+    VfxChannelLayout channelLayout; // overrides stereo when set
+    float previewScale; // resolution multiplier used by preview, 0 means default
+    VfxWorkingFormat workingFormat;
+    VfxResampler resampler;
+    size_t resamplerFilterLength; // taps of swr filter, longer is cleaner and slower, 0 means ffmpeg default (32)
 } Project_Settings;
 
+typedef enum{
+    AUDIO_EFFECT_GAIN = 0,
+    AUDIO_EFFECT_EQ_PEAK,
+    AUDIO_EFFECT_EQ_LOW_SHELF,
+    AUDIO_EFFECT_EQ_HIGH_SHELF,
+    AUDIO_EFFECT_EQ_LOW_CUT,  // 12 dB/oct high pass, gain is ignored
+    AUDIO_EFFECT_EQ_HIGH_CUT, // 12 dB/oct low pass, gain is ignored
+    AUDIO_EFFECT_COMPRESSOR,  // channels are linked so stereo image doesn't shift
+    AUDIO_EFFECT_COUNT
+} AudioEffectType;
+
+typedef struct{
+    AudioEffectType type;
+    union{
+        struct{
+            double db;
+        } gain;
+        struct{
+            double frequency;
+            double gainDb;
+            double q;
+        } eq;
+        struct{
+            double thresholdDb;
+            double ratio;
+            double attackMs;
+            double releaseMs;
+            double makeupDb;
+        } compressor;
+    } as;
+} AudioEffect;
+
+static inline AudioEffect AudioGain(double db){
+    return (AudioEffect){
+        .type = AUDIO_EFFECT_GAIN,
+        .as.gain.db = db,
+    };
+}
+
+static inline AudioEffect AudioEq(AudioEffectType type, double frequency, double gain_db, double q){
+    return (AudioEffect){
+        .type = type,
+        .as.eq = {frequency, gain_db, q},
+    };
+}
+
+static inline AudioEffect AudioCompressor(double threshold_db, double ratio, double attack_ms, double release_ms, double makeup_db){
+    return (AudioEffect){
+        .type = AUDIO_EFFECT_COMPRESSOR,
+        .as.compressor = {threshold_db, ratio, attack_ms, release_ms, makeup_db},
+    };
+}
+
 typedef struct Project Project;
 typedef struct Layer Layer;
 typedef struct VfxInstance VfxInstance;
@@ -377,6 +477,12 @@ typedef struct{
     void (*vfx_instance_set_arg)(Project* project, VfxInstance* vfx_instance, size_t input_index, VfxInputArg input_value);
     void (*vfx_instance_add_automation_key)(Project* project, VfxInstance* vfx_instance, size_t input_index, VfxAutomationKeyType automation_key_type, double automation_duration, VfxInputArg target_value);
     size_t (*vfx_get_input_index)(Project* project, size_t vfx_index, const char* input_name);
+    bool (*vfx_instance_set_render_scale)(Project* project, VfxInstance* vfx_instance, double render_scale); // renders effect at fraction of output resolution in (0, 1], overrides module RenderScale, returns false on invalid scale
+    size_t (*project_add_audio_bus)(Project* project, double volume); // returns bus index, layers routed to bus are summed and processed together before master
+    void (*layer_set_audio_bus)(Project* project, Layer* layer, size_t bus_index);
+    void (*layer_add_audio_effect)(Project* project, Layer* layer, AudioEffect effect); // effects run in order they were added, before layer volume and pan
+    void (*audio_bus_add_effect)(Project* project, size_t bus_index, AudioEffect effect);
+    void (*layer_add_slice_speed)(Project* project, Layer* layer, size_t media_index, double media_start_from, double slice_duration, double speed_start, double speed_end, bool preserve_pitch); // speed ramps linearly from start to end over slice_duration of timeline, -1 duration plays rest of media
 } Module;
 
 EXPORT_FN bool project_init(Module* module, int argc, const char** argv); // for dlls
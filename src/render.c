@@ -13,8 +13,328 @@
 #include "ll.h"
 #include "fvfx_helper.h"
 
+// how many composed frames can wait for the encoder before rendering blocks
+#define READBACK_RING_SIZE 3
+
+typedef struct{
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    void* mapped;
+    uint64_t timelineValue;
+
+    bool hasAudio;
+    uint8_t** audioBuf;
+    int audioBufLineSize;
+} ReadbackSlot;
+
+typedef struct{
+    ReadbackSlot slots[READBACK_RING_SIZE];
+    size_t head;  // next slot filled by render loop
+    size_t tail;  // next slot consumed by encoder
+    size_t count; // slots waiting for encoder
+    bool finished;
+
+    void* mutex;
+    void* slotFilled;
+    void* slotFreed;
+
+    VkSemaphore timeline;
+    MediaRenderContext* renderContext;
+    size_t videoFrameSize;
+    size_t audioFrameSize;
+} ReadbackRing;
+
+static bool ReadbackSlot_init(ReadbackSlot* slot, size_t videoFrameSize, int channels, size_t audioFrameSize, enum AVSampleFormat audioFormat){
+    // cached memory makes cpu reads fast, not every device exposes it though
+    if(!vkCreateBufferEX(device, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+            videoFrameSize, &slot->buffer, &slot->memory)){
+        if(slot->buffer) vkDestroyBuffer(device, slot->buffer, NULL);
+        slot->buffer = NULL;
+        if(!vkCreateBufferEX(device, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                videoFrameSize, &slot->buffer, &slot->memory)) return false;
+    }
+    if(vkMapMemory(device, slot->memory, 0, videoFrameSize, 0, &slot->mapped) != VK_SUCCESS) return false;
+
+    if(av_samples_alloc_array_and_samples(&slot->audioBuf, &slot->audioBufLineSize, channels, audioFrameSize, audioFormat, 0) < 0) return false;
+
+    return true;
+}
+
+static int encoder_thread(void* arg){
+    ReadbackRing* ring = arg;
+
+    while(true){
+        platform_mutex_lock(ring->mutex);
+        while(ring->count == 0 && !ring->finished) platform_cond_wait(ring->slotFilled, ring->mutex);
+        if(ring->count == 0){
+            platform_mutex_unlock(ring->mutex);
+            break;
+        }
+        ReadbackSlot* slot = &ring->slots[ring->tail];
+        platform_mutex_unlock(ring->mutex);
+
+        vkWaitSemaphores(device, &(VkSemaphoreWaitInfo){
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &ring->timeline,
+            .pValues = &slot->timelineValue,
+        }, UINT64_MAX);
+
+        vkInvalidateMappedMemoryRanges(device, 1, &(VkMappedMemoryRange){
+            .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+            .memory = slot->memory,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+        });
+
+        ffmpegMediaRenderPassFrame(ring->renderContext, &(RenderFrame){
+            .type = RENDER_FRAME_TYPE_VIDEO,
+            .data = slot->mapped,
+            .size = ring->videoFrameSize,
+        });
+
+        if(slot->hasAudio){
+            ffmpegMediaRenderPassFrame(ring->renderContext, &(RenderFrame){
+                .type = RENDER_FRAME_TYPE_AUDIO,
+                .data = slot->audioBuf,
+                .size = ring->audioFrameSize,
+            });
+        }
+
+        platform_mutex_lock(ring->mutex);
+        ring->tail = (ring->tail + 1) % READBACK_RING_SIZE;
+        ring->count--;
+        platform_cond_signal(ring->slotFreed);
+        platform_mutex_unlock(ring->mutex);
+    }
+
+    return 0;
+}
+
+// mixes and encodes whatever is still sitting in layer fifos, then pushes silence through graph until limiter lookahead is out too
+static void render_drain_audio(MediaRenderContext* renderContext, MyLayer* myLayers, AudioGraph* graph, uint8_t** composedAudioBuf, uint8_t** tempAudioBuf, size_t out_audio_frame_size, enum AVSampleFormat out_audio_format){
+    if (graph->layersCount == 0) return;
+    size_t tail = 0;
+    while (true) {
+        bool audioLeft = false;
+        for(MyLayer* myLayer = myLayers; myLayer != NULL; myLayer = myLayer->next){
+            if(!myLayer->audioFifo) continue;
+            if (av_audio_fifo_size(myLayer->audioFifo) > 0) {
+                audioLeft = true;
+                break;
+            }
+        }
+        if (!audioLeft) {
+            if (tail >= audio_graph_latency(graph)) break;
+            tail += out_audio_frame_size;
+        }
+        av_samples_set_silence(
+            composedAudioBuf,
+            0,
+            out_audio_frame_size,
+            graph->channels,
+            out_audio_format
+        );
+        mix_all_layers(
+            composedAudioBuf,
+            tempAudioBuf,
+            myLayers,
+            out_audio_frame_size,
+            out_audio_format,
+            graph,
+            1.0f
+        );
+        ffmpegMediaRenderPassFrame(renderContext, &(RenderFrame){
+            .type = RENDER_FRAME_TYPE_AUDIO,
+            .data = composedAudioBuf,
+            .size = out_audio_frame_size,
+        });
+    }
+}
+
+// drains audio still sitting in layer fifos, closes output and prints stats
+static void render_finish(MediaRenderContext* renderContext, Vulkanizer* vulkanizer, MyLayer* myLayers, AudioGraph* graph, uint8_t** composedAudioBuf, uint8_t** tempAudioBuf, size_t out_audio_frame_size, enum AVSampleFormat out_audio_format){
+    render_drain_audio(renderContext, myLayers, graph, composedAudioBuf, tempAudioBuf, out_audio_frame_size, out_audio_format);
+    ffmpegMediaRenderFinish(renderContext);
+    printf("[FVFX] Finished rendering!\n");
+    if(!vulkanizer->cpu) Vulkanizer_print_target_stats(vulkanizer);
+    size_t layerCacheHits = 0;
+    size_t layerCacheMisses = 0;
+    for(MyLayer* myLayer = myLayers; myLayer != NULL; myLayer = myLayer->next){
+        layerCacheHits += myLayer->layerCache.hits;
+        layerCacheMisses += myLayer->layerCache.misses;
+    }
+    printf("[FVFX] Layer frames rendered %zu, reused %zu\n", layerCacheMisses, layerCacheHits);
+
+}
+
+// used when no vulkan device is available, vfx run as built in cpu code or through the spir-v interpreter
+static int render_on_cpu(Project* project, ArenaAllocator* aa){
+    Vulkanizer vulkanizer = {0};
+    if(!Vulkanizer_init_cpu(project->settings.width, project->settings.height, &vulkanizer, aa)) return 1;
+
+    AVChannelLayout ch_layout = project_channel_layout(project);
+    MediaRenderContext renderContext = {0};
+    if(!ffmpegMediaRenderInit(project->settings.outputFilename, project->settings.width, project->settings.height, project->settings.fps, project->settings.sampleRate, &ch_layout, project->settings.hasAudio, &renderContext)){
+        fprintf(stderr, "Couldn't initialize ffmpeg media renderer!\n");
+        return 1;
+    }
+
+    enum AVSampleFormat out_audio_format = renderContext.audioCodecContext->sample_fmt;
+    size_t out_audio_frame_size = renderContext.audioCodecContext->frame_size;
+
+    MyProject myProject = {0};
+    if(!prepare_project(project, &myProject, &vulkanizer, out_audio_format, out_audio_frame_size, aa)) return 1;
+
+    AudioGraph audioGraph;
+    if(!audio_graph_init(&audioGraph, project, &myProject, &ch_layout, project->settings.sampleRate, out_audio_format, out_audio_frame_size)) return 1;
+    // limiter lookahead delays the mix, dropping that much keeps audio in sync with video
+    if(audioGraph.layersCount && !ffmpegMediaRenderSkipAudio(&renderContext, audio_graph_latency(&audioGraph))) return 1;
+
+    uint8_t** tempAudioBuf;
+    int tempAudioBufLineSize;
+    av_samples_alloc_array_and_samples(&tempAudioBuf,&tempAudioBufLineSize, ch_layout.nb_channels, out_audio_frame_size, out_audio_format, 0);
+
+    uint8_t** composedAudioBuf;
+    int composedAudioBufLineSize;
+    av_samples_alloc_array_and_samples(&composedAudioBuf,&composedAudioBufLineSize, ch_layout.nb_channels, out_audio_frame_size, out_audio_format, 0);
+
+    uint64_t startTime = platform_get_time_nanos();
+    size_t framesRendered = 0;
+
+    MyLayer* myLayers = myProject.myLayers;
+    while(true){
+        CpuCompositor_clear(&vulkanizer.cpuCompositor);
+
+        bool enoughSamples;
+        int result = process_project(NULL, project, &myProject, &vulkanizer, NULL, &enoughSamples);
+        if(result == PROCESS_PROJECT_FINISHED) break;
+
+        ffmpegMediaRenderPassFrame(&renderContext, &(RenderFrame){
+            .type = RENDER_FRAME_TYPE_VIDEO,
+            .data = vulkanizer.cpuCompositor.composed.pixels,
+            .size = project->settings.width * project->settings.height * sizeof(uint32_t),
+        });
+        framesRendered++;
+
+        if(enoughSamples){
+            av_samples_set_silence(composedAudioBuf, 0, out_audio_frame_size, ch_layout.nb_channels, out_audio_format);
+            mix_all_layers(
+                composedAudioBuf,
+                tempAudioBuf,
+                myLayers,
+                out_audio_frame_size,
+                out_audio_format,
+                &audioGraph,
+                1.0f
+            );
+            ffmpegMediaRenderPassFrame(&renderContext, &(RenderFrame){
+                .type = RENDER_FRAME_TYPE_AUDIO,
+                .data = composedAudioBuf,
+                .size = out_audio_frame_size,
+            });
+        }
+    }
+
+    double seconds = (double)(platform_get_time_nanos() - startTime) / 1e9;
+    printf("[FVFX] Cpu compositing: %zu frames in %.2fs (%.2f fps)\n", framesRendered, seconds, seconds > 0 ? framesRendered / seconds : 0.0);
+
+    render_finish(&renderContext, &vulkanizer, myLayers, &audioGraph, composedAudioBuf, tempAudioBuf, out_audio_frame_size, out_audio_format);
+    audio_graph_uninit(&audioGraph);
+
+    return 0;
+}
+
+// true when every layer that is still playing has a whole encoder frame queued
+static bool render_layers_have_samples(MyLayer* myLayers, size_t samples){
+    for(MyLayer* myLayer = myLayers; myLayer != NULL; myLayer = myLayer->next){
+        if(!myLayer->audioFifo || myLayer->finished) continue;
+        if(av_audio_fifo_size(myLayer->audioFifo) < (int)samples) return false;
+    }
+    return true;
+}
+
+int render_audio_only(Project* project, ArenaAllocator* aa){
+    if(!project->settings.hasAudio){
+        fprintf(stderr, "Project has audio disabled, nothing to render!\n");
+        return 1;
+    }
+
+    AVChannelLayout ch_layout = project_channel_layout(project);
+    MediaRenderContext renderContext = {0};
+    if(!ffmpegMediaRenderInitAudio(project->settings.outputFilename, project->settings.sampleRate, &ch_layout, &renderContext)){
+        fprintf(stderr, "Couldn't initialize ffmpeg media renderer!\n");
+        return 1;
+    }
+
+    enum AVSampleFormat out_audio_format = renderContext.audioCodecContext->sample_fmt;
+    size_t out_audio_frame_size = renderContext.audioCodecContext->frame_size;
+    // pcm encoders take frames of any size
+    if(out_audio_frame_size == 0) out_audio_frame_size = 1024;
+
+    MyProject myProject = {0};
+    if(!prepare_project_audio(project, &myProject, out_audio_format, out_audio_frame_size, aa)) return 1;
+
+    AudioGraph audioGraph;
+    if(!audio_graph_init(&audioGraph, project, &myProject, &ch_layout, project->settings.sampleRate, out_audio_format, out_audio_frame_size)) return 1;
+    // limiter lookahead delays the mix, dropping that much keeps audio in sync with video
+    if(audioGraph.layersCount && !ffmpegMediaRenderSkipAudio(&renderContext, audio_graph_latency(&audioGraph))) return 1;
+
+    uint8_t** tempAudioBuf;
+    int tempAudioBufLineSize;
+    av_samples_alloc_array_and_samples(&tempAudioBuf,&tempAudioBufLineSize, ch_layout.nb_channels, out_audio_frame_size, out_audio_format, 0);
+
+    uint8_t** composedAudioBuf;
+    int composedAudioBufLineSize;
+    av_samples_alloc_array_and_samples(&composedAudioBuf,&composedAudioBufLineSize, ch_layout.nb_channels, out_audio_frame_size, out_audio_format, 0);
+
+    uint64_t startTime = platform_get_time_nanos();
+
+    MyLayer* myLayers = myProject.myLayers;
+    while(true){
+        bool enoughSamples;
+        int result = process_project_audio(project, &myProject, &enoughSamples);
+        if(result < 0) return 1;
+        if(result == PROCESS_PROJECT_FINISHED) break;
+
+        // nothing paces output here so every whole encoder frame goes out right away
+        while(enoughSamples){
+            av_samples_set_silence(composedAudioBuf, 0, out_audio_frame_size, ch_layout.nb_channels, out_audio_format);
+            mix_all_layers(
+                composedAudioBuf,
+                tempAudioBuf,
+                myLayers,
+                out_audio_frame_size,
+                out_audio_format,
+                &audioGraph,
+                1.0f
+            );
+            ffmpegMediaRenderPassFrame(&renderContext, &(RenderFrame){
+                .type = RENDER_FRAME_TYPE_AUDIO,
+                .data = composedAudioBuf,
+                .size = out_audio_frame_size,
+            });
+            enoughSamples = render_layers_have_samples(myLayers, out_audio_frame_size);
+        }
+    }
+
+    render_drain_audio(&renderContext, myLayers, &audioGraph, composedAudioBuf, tempAudioBuf, out_audio_frame_size, out_audio_format);
+    ffmpegMediaRenderFinish(&renderContext);
+    audio_graph_uninit(&audioGraph);
+
+    double seconds = (double)(platform_get_time_nanos() - startTime) / 1e9;
+    printf("[FVFX] Finished rendering %.2fs of audio in %.2fs!\n", myProject.time, seconds);
+
+    return 0;
+}
+
 int render(Project* project, ArenaAllocator* aa){
-    if(!vulkan_init_headless()) return 1;
+    if(!vulkan_init_headless()){
+        printf("[FVFX] No usable vulkan device, falling back to cpu compositing\n");
+        return render_on_cpu(project, aa);
+    }
 
     VkCommandBuffer cmd;
     if(vkAllocateCommandBuffers(device,&(VkCommandBufferAllocateInfo){
@@ -24,19 +344,27 @@ int render(Project* project, ArenaAllocator* aa){
         .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
         .commandBufferCount = 1,
     },&cmd) != VK_SUCCESS) return 1;
-        
-    VkFence inFlightFence;
-    if(vkCreateFence(device, &(VkFenceCreateInfo){
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
-    }, NULL, &inFlightFence) != VK_SUCCESS) return 1;
+
+    // signaled with frame number once gpu is done with it
+    VkSemaphore frameTimeline;
+    if(vkCreateSemaphore(device, &(VkSemaphoreCreateInfo){
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &(VkSemaphoreTypeCreateInfo){
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+        },
+    }, NULL, &frameTimeline) != VK_SUCCESS) return 1;
+    uint64_t frameValue = 0;
 
     Vulkanizer vulkanizer = {0};
-    if(!Vulkanizer_init(device, descriptorPool, project->settings.width, project->settings.height, &vulkanizer, aa)) return 1;
+    if(!Vulkanizer_init(device, project->settings.width, project->settings.height, &vulkanizer, aa)) return 1;
+    vulkanizer.workingFormat = project->settings.workingFormat;
 
     //init renderer
+    AVChannelLayout ch_layout = project_channel_layout(project);
     MediaRenderContext renderContext = {0};
-    if(!ffmpegMediaRenderInit(project->settings.outputFilename, project->settings.width, project->settings.height, project->settings.fps, project->settings.sampleRate, project->settings.stereo, project->settings.hasAudio, &renderContext)){
+    if(!ffmpegMediaRenderInit(project->settings.outputFilename, project->settings.width, project->settings.height, project->settings.fps, project->settings.sampleRate, &ch_layout, project->settings.hasAudio, &renderContext)){
         fprintf(stderr, "Couldn't initialize ffmpeg media renderer!\n");
         return 1;
     }
@@ -47,41 +375,70 @@ int render(Project* project, ArenaAllocator* aa){
     MyProject myProject = {0};
     if(!prepare_project(project, &myProject, &vulkanizer, out_audio_format, out_audio_frame_size, aa)) return 1;
 
+    AudioGraph audioGraph;
+    if(!audio_graph_init(&audioGraph, project, &myProject, &ch_layout, project->settings.sampleRate, out_audio_format, out_audio_frame_size)) return 1;
+    // limiter lookahead delays the mix, dropping that much keeps audio in sync with video
+    if(audioGraph.layersCount && !ffmpegMediaRenderSkipAudio(&renderContext, audio_graph_latency(&audioGraph))) return 1;
+
     uint8_t** tempAudioBuf;
     int tempAudioBufLineSize;
-    av_samples_alloc_array_and_samples(&tempAudioBuf,&tempAudioBufLineSize, project->settings.stereo ? 2 : 1, out_audio_frame_size, out_audio_format, 0);
+    av_samples_alloc_array_and_samples(&tempAudioBuf,&tempAudioBufLineSize, ch_layout.nb_channels, out_audio_frame_size, out_audio_format, 0);
 
     uint8_t** composedAudioBuf;
     int composedAudioBufLineSize;
-    av_samples_alloc_array_and_samples(&composedAudioBuf,&composedAudioBufLineSize, project->settings.stereo ? 2 : 1, out_audio_frame_size, out_audio_format, 0);
-
-    void* push_constants_buf = calloc(256, sizeof(uint8_t));
+    av_samples_alloc_array_and_samples(&composedAudioBuf,&composedAudioBufLineSize, ch_layout.nb_channels, out_audio_frame_size, out_audio_format, 0);
 
     VkImage outComposedImage;
     VkDeviceMemory outComposedImageMemory;
     VkImageView outComposedImageView;
-    size_t outComposedImage_stride;
-    void* outComposedImage_mapped;
-    uint32_t* outComposedVideoFrame = malloc(project->settings.width*project->settings.height*sizeof(uint32_t));
-
-    if(!createMyImage(device, &outComposedImage, 
-        project->settings.width, project->settings.height, 
-        &outComposedImageMemory, 
-        &outComposedImageView, 
-        &outComposedImage_stride, 
-        &outComposedImage_mapped,
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    )) return 1;
+
+    // never touched by cpu, frames leave gpu through readback ring
+    if(!vkCreateImageEX(device, project->settings.width, project->settings.height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &outComposedImage, &outComposedImageMemory)) return 1;
+    if(!vkCreateImageViewEX(device, outComposedImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, &outComposedImageView)) return 1;
 
     VkCommandBuffer tempCmd = vkCmdBeginSingleTime();
     vkCmdTransitionImage(tempCmd, outComposedImage, VK_IMAGE_LAYOUT_UNDEFINED,VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
     vkCmdEndSingleTime(tempCmd);
 
+    ReadbackRing ring = {
+        .timeline = frameTimeline,
+        .renderContext = &renderContext,
+        .videoFrameSize = project->settings.width*project->settings.height*sizeof(uint32_t),
+        .audioFrameSize = out_audio_frame_size,
+        .mutex = platform_mutex_create(),
+        .slotFilled = platform_cond_create(),
+        .slotFreed = platform_cond_create(),
+    };
+    if(!ring.mutex || !ring.slotFilled || !ring.slotFreed) return 1;
+    for(size_t i = 0; i < READBACK_RING_SIZE; i++){
+        if(!ReadbackSlot_init(&ring.slots[i], ring.videoFrameSize, ch_layout.nb_channels, out_audio_frame_size, out_audio_format)){
+            fprintf(stderr, "Couldn't allocate readback buffers!\n");
+            return 1;
+        }
+    }
+
+    void* encoder = platform_thread_create(encoder_thread, &ring);
+    if(encoder == NULL){
+        fprintf(stderr, "Couldn't start encoder thread!\n");
+        return 1;
+    }
+
     MyLayer* myLayers = myProject.myLayers;
     while(true){
-        vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
-        vkResetFences(device, 1, &inFlightFence);
+        // media images are written by cpu while recording so only one frame is on gpu at a time
+        vkWaitSemaphores(device, &(VkSemaphoreWaitInfo){
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &frameTimeline,
+            .pValues = &frameValue,
+        }, UINT64_MAX);
+
+        platform_mutex_lock(ring.mutex);
+        while(ring.count == READBACK_RING_SIZE) platform_cond_wait(ring.slotFreed, ring.mutex);
+        ReadbackSlot* slot = &ring.slots[ring.head];
+        platform_mutex_unlock(ring.mutex);
         
         vkResetCommandBuffer(cmd, 0);
         vkBeginCommandBuffer(cmd,&(VkCommandBufferBeginInfo){
@@ -91,7 +448,7 @@ int render(Project* project, ArenaAllocator* aa){
             .pInheritanceInfo = NULL,
         });
 
-        Vulkanizer_reset_pool();
+        Vulkanizer_reset_pool(&vulkanizer);
 
         vkCmdTransitionImage(
             cmd,
@@ -122,94 +479,86 @@ int render(Project* project, ArenaAllocator* aa){
         vkCmdEndRendering(cmd);
 
         bool enoughSamples;
-        int result = process_project(cmd, project, &myProject, &vulkanizer, push_constants_buf, outComposedImageView, &enoughSamples);
+        int result = process_project(cmd, project, &myProject, &vulkanizer, outComposedImageView, &enoughSamples);
         if(result == PROCESS_PROJECT_FINISHED) break;
 
         vkCmdTransitionImage(
             cmd,
             outComposedImage,
             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 
+            VK_IMAGE_ASPECT_COLOR_BIT
+        );
+
+        vkCmdCopyImageToBuffer(cmd, outComposedImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &(VkBufferImageCopy){
+            .bufferOffset = 0,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .layerCount = 1},
+            .imageExtent = {.width = project->settings.width, .height = project->settings.height, .depth = 1},
+        });
+
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &(VkMemoryBarrier){
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        }, 0, NULL, 0, NULL);
+
+        vkCmdTransitionImage(
+            cmd,
+            outComposedImage,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 
             VK_IMAGE_LAYOUT_GENERAL, 
             VK_IMAGE_ASPECT_COLOR_BIT
         );
 
         vkEndCommandBuffer(cmd);
 
+        frameValue++;
         vkQueueSubmit(graphicsQueue, 1, &(VkSubmitInfo){
             .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = &(VkTimelineSemaphoreSubmitInfo){
+                .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+                .signalSemaphoreValueCount = 1,
+                .pSignalSemaphoreValues = &frameValue,
+            },
             .commandBufferCount = 1,
             .pCommandBuffers = &cmd,
-        }, inFlightFence);
-        vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
-
-        for(size_t y = 0; y < project->settings.height; y++){
-            memcpy(
-                ((uint8_t*)outComposedVideoFrame) + y*project->settings.width*sizeof(uint32_t),
-                ((uint8_t*)outComposedImage_mapped) + y*outComposedImage_stride,
-                project->settings.width*sizeof(uint32_t)
-            );
-        }
-
-        ffmpegMediaRenderPassFrame(&renderContext, &(RenderFrame){
-            .type = RENDER_FRAME_TYPE_VIDEO,
-            .data = outComposedVideoFrame,
-            .size = project->settings.width * project->settings.height * sizeof(outComposedVideoFrame[0]),
-        });
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &frameTimeline,
+        }, NULL);
+        slot->timelineValue = frameValue;
 
+        // mixing on cpu while gpu renders, encoder picks both up in order
+        slot->hasAudio = enoughSamples;
         if(enoughSamples){
-            av_samples_set_silence(composedAudioBuf, 0, out_audio_frame_size, project->settings.stereo ? 2 : 1, out_audio_format);
+            av_samples_set_silence(slot->audioBuf, 0, out_audio_frame_size, ch_layout.nb_channels, out_audio_format);
             mix_all_layers(
-                composedAudioBuf,
+                slot->audioBuf,
                 tempAudioBuf,
                 myLayers,
                 out_audio_frame_size,
                 out_audio_format,
-                project
+                &audioGraph,
+                1.0f
             );
-            ffmpegMediaRenderPassFrame(&renderContext, &(RenderFrame){
-                .type = RENDER_FRAME_TYPE_AUDIO,
-                .data = composedAudioBuf,
-                .size = out_audio_frame_size,
-            });
         }
-    }
 
-    printf("[FVFX] Draining leftover audio\n");
-    bool audioLeft = true;
-    while (audioLeft) {
-        audioLeft = false;
-        for(MyLayer* myLayer = myLayers; myLayer != NULL; myLayer = myLayer->next){
-            if(!myLayer->audioFifo) continue;
-            if (av_audio_fifo_size(myLayer->audioFifo) > 0) {
-                audioLeft = true;
-                break;
-            }
-        }
-        if (!audioLeft) break;
-        av_samples_set_silence(
-            composedAudioBuf,
-            0,
-            out_audio_frame_size,
-            project->settings.stereo ? 2 : 1,
-            out_audio_format
-        );
-        mix_all_layers(
-            composedAudioBuf,
-            tempAudioBuf,
-            myLayers,
-            out_audio_frame_size,
-            out_audio_format,
-            project
-        );
-        ffmpegMediaRenderPassFrame(&renderContext, &(RenderFrame){
-            .type = RENDER_FRAME_TYPE_AUDIO,
-            .data = composedAudioBuf,
-            .size = out_audio_frame_size,
-        });
+        platform_mutex_lock(ring.mutex);
+        ring.head = (ring.head + 1) % READBACK_RING_SIZE;
+        ring.count++;
+        platform_cond_signal(ring.slotFilled);
+        platform_mutex_unlock(ring.mutex);
     }
 
-    ffmpegMediaRenderFinish(&renderContext);
-    printf("[FVFX] Finished rendering!\n");
+    platform_mutex_lock(ring.mutex);
+    ring.finished = true;
+    platform_cond_broadcast(ring.slotFilled);
+    platform_mutex_unlock(ring.mutex);
+    platform_thread_join(encoder);
+
+    render_finish(&renderContext, &vulkanizer, myLayers, &audioGraph, composedAudioBuf, tempAudioBuf, out_audio_frame_size, out_audio_format);
+    audio_graph_uninit(&audioGraph);
 
     return 0;
 }
\ No newline at end of file
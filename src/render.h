@@ -4,5 +4,7 @@
 #include "project.h"
 #include "arena_alloc.h"
 int render(Project* project, ArenaAllocator* aa);
+// only slices, volume/pan automation and mixing, never initializes vulkan
+int render_audio_only(Project* project, ArenaAllocator* aa);
 
 #endif
\ No newline at end of file
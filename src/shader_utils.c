@@ -83,8 +83,11 @@ bool extractVFXModuleMetaData(String_View sv, VfxModule* out, ArenaAllocator* aa
 
     String_Builder sb = {0};
     size_t push_constant_offset = 0;
+    String_View boundsOffsetName = {0};
+    String_View boundsScaleName = {0};
 
     out->inputs = NULL;
+    out->bounds = (VfxBounds){0};
     while(sv.data[0] != '*' && sv.data[1] != '/' && sv.count > 0){
         String_View leftSide = sv_chop_by_delim(&sv, ':');
         sv = sv_trim_left(sv);
@@ -110,6 +113,39 @@ bool extractVFXModuleMetaData(String_View sv, VfxModule* out, ArenaAllocator* aa
             sb_append_null(&sb);
             out->author = aa_strdup(aa, sb.items);
         }
+        else if(sv_eq(leftSide, sv_from_cstr("RenderScale"))){
+            sb.count = 0;
+            sb_append_buf(&sb, arg.data, arg.count);
+            sb_append_null(&sb);
+            if(sscanf(sb.items, "%f", &out->renderScale) != 1 || out->renderScale <= 0.0f || out->renderScale > 1.0f){
+                printf("RenderScale has to be in (0, 1] range got "SV_Fmt"\n", SV_Arg(arg));
+                da_free(sb);
+                return false;
+            }
+        }
+        else if(sv_eq(leftSide, sv_from_cstr("Bounds"))){
+            String_View boundsArg = sv_trim_left(arg);
+            String_View boundsKind = sv_trim(sv_chop_by_delim(&boundsArg, ' '));
+
+                 if(sv_eq(boundsKind, sv_from_cstr("full"))) out->bounds.kind = VFX_BOUNDS_FULL;
+            else if(sv_eq(boundsKind, sv_from_cstr("inside"))) out->bounds.kind = VFX_BOUNDS_INSIDE;
+            else if(sv_eq(boundsKind, sv_from_cstr("fit"))) out->bounds.kind = VFX_BOUNDS_FIT;
+            else if(sv_eq(boundsKind, sv_from_cstr("translate"))){
+                out->bounds.kind = VFX_BOUNDS_TRANSLATE;
+                boundsOffsetName = sv_trim(sv_chop_by_delim(&boundsArg, ' '));
+                boundsScaleName = sv_trim(boundsArg);
+                if(boundsOffsetName.count == 0 || boundsScaleName.count == 0){
+                    printf("Bounds translate expects names of offset and scale inputs\n");
+                    da_free(sb);
+                    return false;
+                }
+            }
+            else{
+                printf("Unknown bounds: "SV_Fmt"\n", SV_Arg(boundsKind));
+                da_free(sb);
+                return false;
+            }
+        }
         else if(sv_eq(leftSide, sv_from_cstr("Input"))){
             String_View inputArg = sv_trim_left(arg);
             String_View inputType = sv_trim(sv_chop_by_delim(&inputArg, ' '));
@@ -202,6 +238,28 @@ bool extractVFXModuleMetaData(String_View sv, VfxModule* out, ArenaAllocator* aa
     }
 
     da_free(sb);
+
+    // inputs can be declared after Bounds so they get resolved once everything is parsed
+    if(out->bounds.kind == VFX_BOUNDS_TRANSLATE){
+        bool foundOffset = false;
+        bool foundScale = false;
+        for(VfxInput* input = out->inputs; input != NULL; input = input->next){
+            if(input->type != VFX_VEC2) continue;
+            if(sv_eq(boundsOffsetName, sv_from_cstr(input->name))){
+                out->bounds.offsetInput = input->push_constant_offset;
+                foundOffset = true;
+            }
+            if(sv_eq(boundsScaleName, sv_from_cstr(input->name))){
+                out->bounds.scaleInput = input->push_constant_offset;
+                foundScale = true;
+            }
+        }
+        if(!foundOffset || !foundScale){
+            printf("Bounds translate needs vec2 inputs named "SV_Fmt" and "SV_Fmt"\n", SV_Arg(boundsOffsetName), SV_Arg(boundsScaleName));
+            return false;
+        }
+    }
+
     return true;
 }
 
@@ -218,17 +276,8 @@ bool preprocessVFXModule(String_Builder* sb, VfxModule* module){
     sb_append_cstr(&newSB, prepend);
 
 
-    /*
-    
-    layout (push_constant) uniform constants
-    {
-        mat4 projView;
-        SpriteDrawBuffer spriteDrawBuffer;
-    } Input;
-    
-    */
-        
-    sb_append_cstr(&newSB, "layout (push_constant) uniform constants\n{\n");
+    // one slice of per frame parameter buffer, std430 like push constants were so offsets stay the same
+    sb_append_cstr(&newSB, "layout (std430, set = 1, binding = 0) readonly buffer constants\n{\n");
     sb_append_cstr(&newSB,"vec2 renderArea;\n");
     sb_append_cstr(&newSB,"vec2 mediaArea;\n");
 
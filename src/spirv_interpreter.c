@@ -0,0 +1,1671 @@
+#include "spirv_interpreter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#define FA_REALLOC(optr, osize, new_size) realloc(optr, new_size)
+#define fa_reserve(da, extra) \
+   do {\
+      if((da)->count + extra >= (da)->capacity) {\
+          void* _da_old_ptr;\
+          size_t _da_old_capacity = (da)->capacity;\
+          (void)_da_old_capacity;\
+          (void)_da_old_ptr;\
+          (da)->capacity = (da)->capacity*2+extra;\
+          _da_old_ptr = (da)->items;\
+          (da)->items = FA_REALLOC(_da_old_ptr, _da_old_capacity*sizeof(*(da)->items), (da)->capacity*sizeof(*(da)->items));\
+          assert((da)->items && "Ran out of memory");\
+      }\
+   } while(0)
+#define fa_push(da, value) \
+   do {\
+        fa_reserve(da, 1);\
+        (da)->items[(da)->count++]=value;\
+   } while(0)
+
+#define SPIRV_MAGIC 0x07230203
+#define SPIRV_NONE UINT32_MAX
+
+// subset of spirv opcodes glslang emits for fvfx fragment shaders
+enum{
+    OP_NOP = 0,
+    OP_UNDEF = 1,
+    OP_SOURCE_CONTINUED = 2,
+    OP_SOURCE = 3,
+    OP_SOURCE_EXTENSION = 4,
+    OP_NAME = 5,
+    OP_MEMBER_NAME = 6,
+    OP_STRING = 7,
+    OP_LINE = 8,
+    OP_EXTENSION = 10,
+    OP_EXT_INST_IMPORT = 11,
+    OP_EXT_INST = 12,
+    OP_MEMORY_MODEL = 14,
+    OP_ENTRY_POINT = 15,
+    OP_EXECUTION_MODE = 16,
+    OP_CAPABILITY = 17,
+    OP_TYPE_VOID = 19,
+    OP_TYPE_BOOL = 20,
+    OP_TYPE_INT = 21,
+    OP_TYPE_FLOAT = 22,
+    OP_TYPE_VECTOR = 23,
+    OP_TYPE_MATRIX = 24,
+    OP_TYPE_IMAGE = 25,
+    OP_TYPE_SAMPLER = 26,
+    OP_TYPE_SAMPLED_IMAGE = 27,
+    OP_TYPE_ARRAY = 28,
+    OP_TYPE_STRUCT = 30,
+    OP_TYPE_POINTER = 32,
+    OP_TYPE_FUNCTION = 33,
+    OP_CONSTANT_TRUE = 41,
+    OP_CONSTANT_FALSE = 42,
+    OP_CONSTANT = 43,
+    OP_CONSTANT_COMPOSITE = 44,
+    OP_CONSTANT_NULL = 46,
+    OP_SPEC_CONSTANT_TRUE = 48,
+    OP_SPEC_CONSTANT_FALSE = 49,
+    OP_SPEC_CONSTANT = 50,
+    OP_SPEC_CONSTANT_COMPOSITE = 51,
+    OP_FUNCTION = 54,
+    OP_FUNCTION_PARAMETER = 55,
+    OP_FUNCTION_END = 56,
+    OP_FUNCTION_CALL = 57,
+    OP_VARIABLE = 59,
+    OP_LOAD = 61,
+    OP_STORE = 62,
+    OP_COPY_MEMORY = 63,
+    OP_ACCESS_CHAIN = 65,
+    OP_IN_BOUNDS_ACCESS_CHAIN = 66,
+    OP_DECORATE = 71,
+    OP_MEMBER_DECORATE = 72,
+    OP_VECTOR_EXTRACT_DYNAMIC = 77,
+    OP_VECTOR_INSERT_DYNAMIC = 78,
+    OP_VECTOR_SHUFFLE = 79,
+    OP_COMPOSITE_CONSTRUCT = 80,
+    OP_COMPOSITE_EXTRACT = 81,
+    OP_COMPOSITE_INSERT = 82,
+    OP_COPY_OBJECT = 83,
+    OP_TRANSPOSE = 84,
+    OP_SAMPLED_IMAGE = 86,
+    OP_IMAGE_SAMPLE_IMPLICIT_LOD = 87,
+    OP_IMAGE_SAMPLE_EXPLICIT_LOD = 88,
+    OP_IMAGE_FETCH = 95,
+    OP_IMAGE = 100,
+    OP_IMAGE_QUERY_SIZE_LOD = 103,
+    OP_IMAGE_QUERY_SIZE = 104,
+    OP_IMAGE_QUERY_LEVELS = 106,
+    OP_CONVERT_F_TO_U = 109,
+    OP_CONVERT_F_TO_S = 110,
+    OP_CONVERT_S_TO_F = 111,
+    OP_CONVERT_U_TO_F = 112,
+    OP_U_CONVERT = 113,
+    OP_S_CONVERT = 114,
+    OP_F_CONVERT = 115,
+    OP_BITCAST = 124,
+    OP_S_NEGATE = 126,
+    OP_F_NEGATE = 127,
+    OP_I_ADD = 128,
+    OP_F_ADD = 129,
+    OP_I_SUB = 130,
+    OP_F_SUB = 131,
+    OP_I_MUL = 132,
+    OP_F_MUL = 133,
+    OP_U_DIV = 134,
+    OP_S_DIV = 135,
+    OP_F_DIV = 136,
+    OP_U_MOD = 137,
+    OP_S_REM = 138,
+    OP_S_MOD = 139,
+    OP_F_REM = 140,
+    OP_F_MOD = 141,
+    OP_VECTOR_TIMES_SCALAR = 142,
+    OP_MATRIX_TIMES_SCALAR = 143,
+    OP_VECTOR_TIMES_MATRIX = 144,
+    OP_MATRIX_TIMES_VECTOR = 145,
+    OP_MATRIX_TIMES_MATRIX = 146,
+    OP_OUTER_PRODUCT = 147,
+    OP_DOT = 148,
+    OP_ANY = 154,
+    OP_ALL = 155,
+    OP_IS_NAN = 156,
+    OP_IS_INF = 157,
+    OP_LOGICAL_EQUAL = 164,
+    OP_LOGICAL_NOT_EQUAL = 165,
+    OP_LOGICAL_OR = 166,
+    OP_LOGICAL_AND = 167,
+    OP_LOGICAL_NOT = 168,
+    OP_SELECT = 169,
+    OP_I_EQUAL = 170,
+    OP_I_NOT_EQUAL = 171,
+    OP_U_GREATER_THAN = 172,
+    OP_S_GREATER_THAN = 173,
+    OP_U_GREATER_THAN_EQUAL = 174,
+    OP_S_GREATER_THAN_EQUAL = 175,
+    OP_U_LESS_THAN = 176,
+    OP_S_LESS_THAN = 177,
+    OP_U_LESS_THAN_EQUAL = 178,
+    OP_S_LESS_THAN_EQUAL = 179,
+    OP_F_ORD_EQUAL = 180,
+    OP_F_UNORD_EQUAL = 181,
+    OP_F_ORD_NOT_EQUAL = 182,
+    OP_F_UNORD_NOT_EQUAL = 183,
+    OP_F_ORD_LESS_THAN = 184,
+    OP_F_UNORD_LESS_THAN = 185,
+    OP_F_ORD_GREATER_THAN = 186,
+    OP_F_UNORD_GREATER_THAN = 187,
+    OP_F_ORD_LESS_THAN_EQUAL = 188,
+    OP_F_UNORD_LESS_THAN_EQUAL = 189,
+    OP_F_ORD_GREATER_THAN_EQUAL = 190,
+    OP_F_UNORD_GREATER_THAN_EQUAL = 191,
+    OP_SHIFT_RIGHT_LOGICAL = 194,
+    OP_SHIFT_RIGHT_ARITHMETIC = 195,
+    OP_SHIFT_LEFT_LOGICAL = 196,
+    OP_BITWISE_OR = 197,
+    OP_BITWISE_XOR = 198,
+    OP_BITWISE_AND = 199,
+    OP_NOT = 200,
+    OP_DPDX = 207,
+    OP_DPDY = 208,
+    OP_FWIDTH = 209,
+    OP_DPDX_FINE = 210,
+    OP_DPDY_FINE = 211,
+    OP_FWIDTH_FINE = 212,
+    OP_DPDX_COARSE = 213,
+    OP_DPDY_COARSE = 214,
+    OP_FWIDTH_COARSE = 215,
+    OP_PHI = 245,
+    OP_LOOP_MERGE = 246,
+    OP_SELECTION_MERGE = 247,
+    OP_LABEL = 248,
+    OP_BRANCH = 249,
+    OP_BRANCH_CONDITIONAL = 250,
+    OP_SWITCH = 251,
+    OP_KILL = 252,
+    OP_RETURN = 253,
+    OP_RETURN_VALUE = 254,
+    OP_UNREACHABLE = 255,
+    OP_NO_LINE = 317,
+    OP_MODULE_PROCESSED = 330,
+    OP_DECORATE_ID = 332,
+    OP_TERMINATE_INVOCATION = 4416,
+    OP_DECORATE_STRING = 5632,
+    OP_MEMBER_DECORATE_STRING = 5633,
+};
+
+// GLSL.std.450 extended instructions
+enum{
+    GLSL_ROUND = 1,
+    GLSL_ROUND_EVEN = 2,
+    GLSL_TRUNC = 3,
+    GLSL_F_ABS = 4,
+    GLSL_S_ABS = 5,
+    GLSL_F_SIGN = 6,
+    GLSL_S_SIGN = 7,
+    GLSL_FLOOR = 8,
+    GLSL_CEIL = 9,
+    GLSL_FRACT = 10,
+    GLSL_RADIANS = 11,
+    GLSL_DEGREES = 12,
+    GLSL_SIN = 13,
+    GLSL_COS = 14,
+    GLSL_TAN = 15,
+    GLSL_ASIN = 16,
+    GLSL_ACOS = 17,
+    GLSL_ATAN = 18,
+    GLSL_SINH = 19,
+    GLSL_COSH = 20,
+    GLSL_TANH = 21,
+    GLSL_ASINH = 22,
+    GLSL_ACOSH = 23,
+    GLSL_ATANH = 24,
+    GLSL_ATAN2 = 25,
+    GLSL_POW = 26,
+    GLSL_EXP = 27,
+    GLSL_LOG = 28,
+    GLSL_EXP2 = 29,
+    GLSL_LOG2 = 30,
+    GLSL_SQRT = 31,
+    GLSL_INVERSE_SQRT = 32,
+    GLSL_F_MIN = 37,
+    GLSL_U_MIN = 38,
+    GLSL_S_MIN = 39,
+    GLSL_F_MAX = 40,
+    GLSL_U_MAX = 41,
+    GLSL_S_MAX = 42,
+    GLSL_F_CLAMP = 43,
+    GLSL_U_CLAMP = 44,
+    GLSL_S_CLAMP = 45,
+    GLSL_F_MIX = 46,
+    GLSL_STEP = 48,
+    GLSL_SMOOTH_STEP = 49,
+    GLSL_FMA = 50,
+    GLSL_LDEXP = 53,
+    GLSL_LENGTH = 66,
+    GLSL_DISTANCE = 67,
+    GLSL_CROSS = 68,
+    GLSL_NORMALIZE = 69,
+    GLSL_FACE_FORWARD = 70,
+    GLSL_REFLECT = 71,
+    GLSL_REFRACT = 72,
+    GLSL_N_MIN = 79,
+    GLSL_N_MAX = 80,
+    GLSL_N_CLAMP = 81,
+};
+
+enum{
+    DECORATION_ARRAY_STRIDE = 6,
+    DECORATION_MATRIX_STRIDE = 7,
+    DECORATION_BUILT_IN = 11,
+    DECORATION_LOCATION = 30,
+    DECORATION_OFFSET = 35,
+};
+
+enum{
+    STORAGE_UNIFORM_CONSTANT = 0,
+    STORAGE_INPUT = 1,
+    STORAGE_UNIFORM = 2,
+    STORAGE_OUTPUT = 3,
+    STORAGE_PRIVATE = 6,
+    STORAGE_FUNCTION = 7,
+    STORAGE_PUSH_CONSTANT = 9,
+    STORAGE_STORAGE_BUFFER = 12,
+};
+
+#define BUILT_IN_FRAG_COORD 15
+#define EXECUTION_MODEL_FRAGMENT 4
+
+#define IMAGE_OPERAND_BIAS 0x1
+#define IMAGE_OPERAND_LOD 0x2
+#define IMAGE_OPERAND_GRAD 0x4
+#define IMAGE_OPERAND_CONST_OFFSET 0x8
+#define IMAGE_OPERAND_OFFSET 0x10
+
+typedef enum{
+    SPIRV_TYPE_NONE = 0,
+    SPIRV_TYPE_VOID,
+    SPIRV_TYPE_BOOL,
+    SPIRV_TYPE_INT,
+    SPIRV_TYPE_FLOAT,
+    SPIRV_TYPE_VECTOR,
+    SPIRV_TYPE_MATRIX,
+    SPIRV_TYPE_ARRAY,
+    SPIRV_TYPE_STRUCT,
+    SPIRV_TYPE_POINTER,
+    SPIRV_TYPE_FUNCTION,
+    SPIRV_TYPE_OPAQUE, // images and samplers, there is only imageIN so they carry no data
+} SpirvTypeKind;
+
+typedef struct{
+    SpirvTypeKind kind;
+    uint32_t count;          // scalar components after flattening, composites live in consecutive registers
+    uint32_t element;        // vector component, matrix column, array element, pointee
+    uint32_t length;         // vector size, matrix columns, array length, struct members
+    const uint32_t* members; // struct member types
+} SpirvType;
+
+typedef struct{
+    uint32_t structType;
+    uint32_t member;
+    uint32_t offset;
+    uint32_t matrixStride;
+} SpirvMemberLayout;
+
+typedef struct{
+    SpirvMemberLayout* items;
+    size_t count;
+    size_t capacity;
+} SpirvMemberLayouts;
+
+typedef struct{
+    uint32_t* items;
+    size_t count;
+    size_t capacity;
+} SpirvWords;
+
+typedef struct{
+    uint32_t slot;
+    uint32_t value;
+} SpirvInit;
+
+typedef struct{
+    SpirvInit* items;
+    size_t count;
+    size_t capacity;
+} SpirvInits;
+
+struct SpirvProgram{
+    uint32_t* words;
+    size_t wordCount;
+    uint32_t bound;
+    SpirvType* types;      // indexed by type id
+    uint32_t* valueType;   // type of every value id
+    uint32_t* regOffset;   // first register of every value id
+    uint32_t* labelPc;     // word offset of every OpLabel
+    uint32_t* functionPc;  // word offset of every OpFunction
+    SpirvWords regInit;    // constants and variable pointers, their registers never change while running
+    uint32_t memoryCount;  // every variable gets its own slots, glsl has no recursion
+    SpirvWords pushOffsets; // byte offset of every flattened push constant component
+    SpirvInits privateInits;
+    uint32_t entry;
+    uint32_t glsl;
+    // memory slots of shader interface, SPIRV_NONE when shader doesn't declare them
+    uint32_t uvSlot;
+    uint32_t fragCoordSlot;
+    uint32_t outColorSlot;
+    uint32_t pushSlot;
+};
+
+// one scalar for every lane, same register holds floats, ints and bools (0/1)
+typedef union{
+    float f[SPIRV_LANES];
+    int32_t i[SPIRV_LANES];
+    uint32_t u[SPIRV_LANES];
+} SpirvLanes;
+
+struct SpirvState{
+    const SpirvProgram* program;
+    SpirvLanes* regs;
+    size_t regsCapacity;
+    SpirvLanes* memory;
+    size_t memoryCapacity;
+    uint32_t prevBlock[SPIRV_LANES]; // for OpPhi
+    uint32_t killed;
+    SpirvTexture texture;
+};
+
+static uint32_t spirv_type_count(const SpirvProgram* program, uint32_t type){
+    return type < program->bound ? program->types[type].count : 0;
+}
+
+// flattened offset of index-th element of *type, moves *type to that element
+static uint32_t spirv_element_offset(const SpirvProgram* program, uint32_t* type, uint32_t index){
+    const SpirvType* t = &program->types[*type];
+    if(t->kind == SPIRV_TYPE_STRUCT){
+        uint32_t offset = 0;
+        for(uint32_t i = 0; i < index && i < t->length; i++) offset += program->types[t->members[i]].count;
+        if(index < t->length) *type = t->members[index];
+        return offset;
+    }
+    *type = t->element;
+    return index * program->types[t->element].count;
+}
+
+static SpirvMemberLayout* spirv_member_layout(SpirvMemberLayouts* layouts, uint32_t structType, uint32_t member){
+    for(size_t i = 0; i < layouts->count; i++){
+        if(layouts->items[i].structType == structType && layouts->items[i].member == member) return &layouts->items[i];
+    }
+    fa_push(layouts, ((SpirvMemberLayout){.structType = structType, .member = member}));
+    return &layouts->items[layouts->count - 1];
+}
+
+// same offsets gpu reads push constants from, taken from Offset/ArrayStride/MatrixStride decorations
+static bool spirv_push_layout(SpirvProgram* program, SpirvMemberLayouts* layouts, const uint32_t* arrayStrides, uint32_t type, uint32_t base, uint32_t matrixStride){
+    const SpirvType* t = &program->types[type];
+    switch(t->kind){
+        case SPIRV_TYPE_BOOL:
+        case SPIRV_TYPE_INT:
+        case SPIRV_TYPE_FLOAT:
+            fa_push(&program->pushOffsets, base);
+            return true;
+        case SPIRV_TYPE_VECTOR:
+            for(uint32_t i = 0; i < t->length; i++) fa_push(&program->pushOffsets, base + i*(uint32_t)sizeof(uint32_t));
+            return true;
+        case SPIRV_TYPE_MATRIX:
+            for(uint32_t i = 0; i < t->length; i++){
+                if(!spirv_push_layout(program, layouts, arrayStrides, t->element, base + i*matrixStride, 0)) return false;
+            }
+            return true;
+        case SPIRV_TYPE_ARRAY:
+            for(uint32_t i = 0; i < t->length; i++){
+                if(!spirv_push_layout(program, layouts, arrayStrides, t->element, base + i*arrayStrides[type], matrixStride)) return false;
+            }
+            return true;
+        case SPIRV_TYPE_STRUCT:
+            for(uint32_t i = 0; i < t->length; i++){
+                SpirvMemberLayout* layout = spirv_member_layout(layouts, type, i);
+                if(!spirv_push_layout(program, layouts, arrayStrides, t->members[i], base + layout->offset, layout->matrixStride)) return false;
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+typedef enum{
+    SPIRV_OP_UNSUPPORTED = 0,
+    SPIRV_OP_VALUE,     // <result type> <result id> ...
+    SPIRV_OP_STATEMENT,
+} SpirvOpKind;
+
+static SpirvOpKind spirv_body_op_kind(uint32_t op){
+    if(op >= OP_VECTOR_EXTRACT_DYNAMIC && op <= OP_TRANSPOSE) return SPIRV_OP_VALUE;
+    if(op >= OP_CONVERT_F_TO_U && op <= OP_F_CONVERT) return SPIRV_OP_VALUE;
+    if(op >= OP_S_NEGATE && op <= OP_DOT) return SPIRV_OP_VALUE;
+    if(op >= OP_ANY && op <= OP_IS_INF) return SPIRV_OP_VALUE;
+    if(op >= OP_LOGICAL_EQUAL && op <= OP_F_UNORD_GREATER_THAN_EQUAL) return SPIRV_OP_VALUE;
+    if(op >= OP_SHIFT_RIGHT_LOGICAL && op <= OP_NOT) return SPIRV_OP_VALUE;
+    if(op >= OP_DPDX && op <= OP_FWIDTH_COARSE) return SPIRV_OP_VALUE;
+    switch(op){
+        case OP_UNDEF:
+        case OP_EXT_INST:
+        case OP_FUNCTION_CALL:
+        case OP_FUNCTION_PARAMETER:
+        case OP_VARIABLE:
+        case OP_LOAD:
+        case OP_ACCESS_CHAIN:
+        case OP_IN_BOUNDS_ACCESS_CHAIN:
+        case OP_SAMPLED_IMAGE:
+        case OP_IMAGE_SAMPLE_IMPLICIT_LOD:
+        case OP_IMAGE_SAMPLE_EXPLICIT_LOD:
+        case OP_IMAGE_FETCH:
+        case OP_IMAGE:
+        case OP_IMAGE_QUERY_SIZE_LOD:
+        case OP_IMAGE_QUERY_SIZE:
+        case OP_IMAGE_QUERY_LEVELS:
+        case OP_BITCAST:
+        case OP_PHI:
+            return SPIRV_OP_VALUE;
+        case OP_NOP:
+        case OP_LINE:
+        case OP_NO_LINE:
+        case OP_STORE:
+        case OP_COPY_MEMORY:
+        case OP_LOOP_MERGE:
+        case OP_SELECTION_MERGE:
+        case OP_LABEL:
+        case OP_BRANCH:
+        case OP_BRANCH_CONDITIONAL:
+        case OP_SWITCH:
+        case OP_KILL:
+        case OP_TERMINATE_INVOCATION:
+        case OP_RETURN:
+        case OP_RETURN_VALUE:
+        case OP_UNREACHABLE:
+        case OP_FUNCTION_END:
+            return SPIRV_OP_STATEMENT;
+        default:
+            return SPIRV_OP_UNSUPPORTED;
+    }
+}
+
+static bool spirv_ext_supported(uint32_t inst){
+    if(inst >= GLSL_ROUND && inst <= GLSL_INVERSE_SQRT) return true;
+    if(inst >= GLSL_F_MIN && inst <= GLSL_F_MIX) return true;
+    if(inst >= GLSL_STEP && inst <= GLSL_FMA) return true;
+    if(inst >= GLSL_LENGTH && inst <= GLSL_REFRACT) return true;
+    if(inst >= GLSL_N_MIN && inst <= GLSL_N_CLAMP) return true;
+    return inst == GLSL_LDEXP;
+}
+
+static uint32_t spirv_alloc_regs(SpirvProgram* program, uint32_t id, uint32_t type){
+    program->valueType[id] = type;
+    program->regOffset[id] = (uint32_t)program->regInit.count;
+    uint32_t count = spirv_type_count(program, type);
+    fa_reserve(&program->regInit, count);
+    memset(program->regInit.items + program->regInit.count, 0, count*sizeof(uint32_t));
+    program->regInit.count += count;
+    return program->regOffset[id];
+}
+
+static bool spirv_program_parse(SpirvProgram* program, const char* name){
+    const uint32_t* words = program->words;
+    bool ok = false;
+
+    uint32_t* locations = malloc(program->bound*sizeof(uint32_t));
+    uint32_t* builtIns = malloc(program->bound*sizeof(uint32_t));
+    uint32_t* arrayStrides = calloc(program->bound, sizeof(uint32_t));
+    SpirvMemberLayouts layouts = {0};
+    if(locations == NULL || builtIns == NULL || arrayStrides == NULL){
+        fprintf(stderr, "%s: ran out of memory loading spirv\n", name);
+        goto defer;
+    }
+    memset(locations, 0xFF, program->bound*sizeof(uint32_t));
+    memset(builtIns, 0xFF, program->bound*sizeof(uint32_t));
+
+    for(size_t pc = 5; pc < program->wordCount;){
+        const uint32_t* inst = words + pc;
+        uint32_t op = inst[0] & 0xFFFF;
+        uint32_t wordCount = inst[0] >> 16;
+        if(wordCount == 0 || pc + wordCount > program->wordCount){
+            fprintf(stderr, "%s: malformed spirv\n", name);
+            goto defer;
+        }
+        switch(op){
+            case OP_CAPABILITY:
+            case OP_EXTENSION:
+            case OP_MEMORY_MODEL:
+            case OP_EXECUTION_MODE:
+            case OP_SOURCE:
+            case OP_SOURCE_CONTINUED:
+            case OP_SOURCE_EXTENSION:
+            case OP_NAME:
+            case OP_MEMBER_NAME:
+            case OP_STRING:
+            case OP_MODULE_PROCESSED:
+            case OP_DECORATE_ID:
+            case OP_DECORATE_STRING:
+            case OP_MEMBER_DECORATE_STRING:
+                break;
+            case OP_EXT_INST_IMPORT:
+                if(strncmp((const char*)(inst + 2), "GLSL.std.450", (wordCount - 2)*sizeof(uint32_t)) == 0) program->glsl = inst[1];
+                break;
+            case OP_ENTRY_POINT:
+                if(inst[1] != EXECUTION_MODEL_FRAGMENT){
+                    fprintf(stderr, "%s: only fragment shaders can be interpreted\n", name);
+                    goto defer;
+                }
+                program->entry = inst[2];
+                break;
+            case OP_DECORATE:
+                if(inst[1] >= program->bound || wordCount < 4) break;
+                if(inst[2] == DECORATION_LOCATION) locations[inst[1]] = inst[3];
+                if(inst[2] == DECORATION_BUILT_IN) builtIns[inst[1]] = inst[3];
+                if(inst[2] == DECORATION_ARRAY_STRIDE) arrayStrides[inst[1]] = inst[3];
+                break;
+            case OP_MEMBER_DECORATE:
+                if(wordCount < 5) break;
+                if(inst[3] == DECORATION_OFFSET) spirv_member_layout(&layouts, inst[1], inst[2])->offset = inst[4];
+                if(inst[3] == DECORATION_MATRIX_STRIDE) spirv_member_layout(&layouts, inst[1], inst[2])->matrixStride = inst[4];
+                break;
+
+            case OP_TYPE_VOID:
+                program->types[inst[1]] = (SpirvType){.kind = SPIRV_TYPE_VOID};
+                break;
+            case OP_TYPE_BOOL:
+                program->types[inst[1]] = (SpirvType){.kind = SPIRV_TYPE_BOOL, .count = 1};
+                break;
+            case OP_TYPE_INT:
+            case OP_TYPE_FLOAT:
+                if(inst[2] != 32){
+                    fprintf(stderr, "%s: only 32 bit numbers can be interpreted\n", name);
+                    goto defer;
+                }
+                program->types[inst[1]] = (SpirvType){.kind = op == OP_TYPE_INT ? SPIRV_TYPE_INT : SPIRV_TYPE_FLOAT, .count = 1};
+                break;
+            case OP_TYPE_VECTOR:
+            case OP_TYPE_MATRIX:
+                program->types[inst[1]] = (SpirvType){
+                    .kind = op == OP_TYPE_VECTOR ? SPIRV_TYPE_VECTOR : SPIRV_TYPE_MATRIX,
+                    .count = spirv_type_count(program, inst[2]) * inst[3],
+                    .element = inst[2],
+                    .length = inst[3],
+                };
+                break;
+            case OP_TYPE_IMAGE:
+            case OP_TYPE_SAMPLER:
+            case OP_TYPE_SAMPLED_IMAGE:
+                program->types[inst[1]] = (SpirvType){.kind = SPIRV_TYPE_OPAQUE, .count = 1};
+                break;
+            case OP_TYPE_ARRAY: {
+                uint32_t length = program->regInit.items[program->regOffset[inst[3]]];
+                program->types[inst[1]] = (SpirvType){
+                    .kind = SPIRV_TYPE_ARRAY,
+                    .count = spirv_type_count(program, inst[2]) * length,
+                    .element = inst[2],
+                    .length = length,
+                };
+                break;
+            }
+            case OP_TYPE_STRUCT: {
+                uint32_t count = 0;
+                for(uint32_t i = 2; i < wordCount; i++){
+                    if(inst[i] >= program->bound) goto malformed;
+                    count += spirv_type_count(program, inst[i]);
+                }
+                program->types[inst[1]] = (SpirvType){
+                    .kind = SPIRV_TYPE_STRUCT,
+                    .count = count,
+                    .length = wordCount - 2,
+                    .members = inst + 2,
+                };
+                break;
+            }
+            case OP_TYPE_POINTER:
+                if(inst[3] >= program->bound) goto malformed;
+                program->types[inst[1]] = (SpirvType){.kind = SPIRV_TYPE_POINTER, .count = 1, .element = inst[3]};
+                break;
+            case OP_TYPE_FUNCTION:
+                program->types[inst[1]] = (SpirvType){.kind = SPIRV_TYPE_FUNCTION};
+                break;
+
+            case OP_CONSTANT_TRUE:
+            case OP_CONSTANT_FALSE:
+            case OP_SPEC_CONSTANT_TRUE:
+            case OP_SPEC_CONSTANT_FALSE: {
+                uint32_t reg = spirv_alloc_regs(program, inst[2], inst[1]);
+                program->regInit.items[reg] = op == OP_CONSTANT_TRUE || op == OP_SPEC_CONSTANT_TRUE;
+                break;
+            }
+            case OP_CONSTANT:
+            case OP_SPEC_CONSTANT: {
+                uint32_t reg = spirv_alloc_regs(program, inst[2], inst[1]);
+                program->regInit.items[reg] = wordCount > 3 ? inst[3] : 0;
+                break;
+            }
+            case OP_CONSTANT_COMPOSITE:
+            case OP_SPEC_CONSTANT_COMPOSITE: {
+                uint32_t reg = spirv_alloc_regs(program, inst[2], inst[1]);
+                for(uint32_t i = 3; i < wordCount; i++){
+                    if(inst[i] >= program->bound) goto malformed;
+                    uint32_t count = spirv_type_count(program, program->valueType[inst[i]]);
+                    memcpy(program->regInit.items + reg, program->regInit.items + program->regOffset[inst[i]], count*sizeof(uint32_t));
+                    reg += count;
+                }
+                break;
+            }
+            case OP_CONSTANT_NULL:
+                spirv_alloc_regs(program, inst[2], inst[1]);
+                break;
+
+            case OP_VARIABLE: {
+                uint32_t storage = inst[3];
+                uint32_t pointee = program->types[inst[1]].element;
+                uint32_t slot = program->memoryCount;
+                uint32_t count = spirv_type_count(program, pointee);
+                program->memoryCount += count > 0 ? count : 1;
+                uint32_t reg = spirv_alloc_regs(program, inst[2], inst[1]);
+                program->regInit.items[reg] = slot;
+
+                switch(storage){
+                    case STORAGE_FUNCTION:
+                        break;
+                    case STORAGE_PRIVATE:
+                        if(wordCount > 4) fa_push(&program->privateInits, ((SpirvInit){.slot = slot, .value = inst[4]}));
+                        break;
+                    case STORAGE_UNIFORM_CONSTANT:
+                        if(program->types[pointee].kind != SPIRV_TYPE_OPAQUE){
+                            fprintf(stderr, "%s: only imageIN can be bound when interpreting\n", name);
+                            goto defer;
+                        }
+                        break;
+                    case STORAGE_INPUT:
+                        if(locations[inst[2]] == 0) program->uvSlot = slot;
+                        else if(builtIns[inst[2]] == BUILT_IN_FRAG_COORD) program->fragCoordSlot = slot;
+                        else{
+                            fprintf(stderr, "%s: unsupported fragment shader input\n", name);
+                            goto defer;
+                        }
+                        break;
+                    case STORAGE_OUTPUT:
+                        if(locations[inst[2]] != 0){
+                            fprintf(stderr, "%s: unsupported fragment shader output\n", name);
+                            goto defer;
+                        }
+                        program->outColorSlot = slot;
+                        break;
+                    // vfx parameters live in storage buffer on gpu (Uniform + BufferBlock before spirv 1.3), layout is the same
+                    case STORAGE_UNIFORM:
+                    case STORAGE_STORAGE_BUFFER:
+                    case STORAGE_PUSH_CONSTANT:
+                        if(program->pushSlot != SPIRV_NONE){
+                            fprintf(stderr, "%s: only one parameter block can be bound when interpreting\n", name);
+                            goto defer;
+                        }
+                        program->pushSlot = slot;
+                        if(!spirv_push_layout(program, &layouts, arrayStrides, pointee, 0, 0)){
+                            fprintf(stderr, "%s: unsupported push constant layout\n", name);
+                            goto defer;
+                        }
+                        break;
+                    default:
+                        fprintf(stderr, "%s: uses storage class %u which interpreter can't bind\n", name, storage);
+                        goto defer;
+                }
+                break;
+            }
+
+            case OP_FUNCTION:
+                program->functionPc[inst[2]] = (uint32_t)pc;
+                program->valueType[inst[2]] = inst[1];
+                break;
+            case OP_LABEL:
+                program->labelPc[inst[1]] = (uint32_t)pc;
+                break;
+
+            default:
+                switch(spirv_body_op_kind(op)){
+                    case SPIRV_OP_UNSUPPORTED:
+                        fprintf(stderr, "%s: spirv opcode %u is not supported by interpreter\n", name, op);
+                        goto defer;
+                    case SPIRV_OP_VALUE:
+                        if(wordCount < 3) goto malformed;
+                        if(op == OP_EXT_INST && (wordCount < 5 || inst[3] != program->glsl || !spirv_ext_supported(inst[4]))){
+                            fprintf(stderr, "%s: extended instruction %u is not supported by interpreter\n", name, wordCount >= 5 ? inst[4] : 0);
+                            goto defer;
+                        }
+                        spirv_alloc_regs(program, inst[2], inst[1]);
+                        break;
+                    case SPIRV_OP_STATEMENT:
+                        break;
+                }
+        }
+        pc += wordCount;
+    }
+
+    if(program->entry == 0 || program->functionPc[program->entry] == 0){
+        fprintf(stderr, "%s: spirv has no fragment entry point\n", name);
+        goto defer;
+    }
+    if(program->outColorSlot == SPIRV_NONE){
+        fprintf(stderr, "%s: shader never writes outColor\n", name);
+        goto defer;
+    }
+
+    ok = true;
+    goto defer;
+
+malformed:
+    fprintf(stderr, "%s: malformed spirv\n", name);
+defer:
+    free(locations);
+    free(builtIns);
+    free(arrayStrides);
+    free(layouts.items);
+    return ok;
+}
+
+SpirvProgram* spirv_program_load(const uint32_t* spirv, size_t spirvSize, const char* name){
+    size_t wordCount = spirvSize / sizeof(uint32_t);
+    if(wordCount < 5 || spirv[0] != SPIRV_MAGIC){
+        fprintf(stderr, "%s: not a spirv module\n", name);
+        return NULL;
+    }
+
+    SpirvProgram* program = calloc(1, sizeof(*program));
+    if(program == NULL) return NULL;
+    program->wordCount = wordCount;
+    program->bound = spirv[3];
+    program->uvSlot = SPIRV_NONE;
+    program->fragCoordSlot = SPIRV_NONE;
+    program->outColorSlot = SPIRV_NONE;
+    program->pushSlot = SPIRV_NONE;
+
+    program->words = malloc(wordCount*sizeof(uint32_t));
+    program->types = calloc(program->bound, sizeof(SpirvType));
+    program->valueType = calloc(program->bound, sizeof(uint32_t));
+    program->regOffset = calloc(program->bound, sizeof(uint32_t));
+    program->labelPc = calloc(program->bound, sizeof(uint32_t));
+    program->functionPc = calloc(program->bound, sizeof(uint32_t));
+    if(program->words == NULL || program->types == NULL || program->valueType == NULL ||
+       program->regOffset == NULL || program->labelPc == NULL || program->functionPc == NULL){
+        fprintf(stderr, "%s: ran out of memory loading spirv\n", name);
+        spirv_program_free(program);
+        return NULL;
+    }
+    memcpy(program->words, spirv, wordCount*sizeof(uint32_t));
+
+    if(!spirv_program_parse(program, name)){
+        spirv_program_free(program);
+        return NULL;
+    }
+    return program;
+}
+
+void spirv_program_free(SpirvProgram* program){
+    if(program == NULL) return;
+    free(program->words);
+    free(program->types);
+    free(program->valueType);
+    free(program->regOffset);
+    free(program->labelPc);
+    free(program->functionPc);
+    free(program->regInit.items);
+    free(program->pushOffsets.items);
+    free(program->privateInits.items);
+    free(program);
+}
+
+bool spirv_state_reserve(SpirvState** state, const SpirvProgram* program){
+    if(*state == NULL){
+        *state = calloc(1, sizeof(**state));
+        if(*state == NULL) return false;
+    }
+    SpirvState* s = *state;
+    s->program = program;
+
+    if(s->regsCapacity < program->regInit.count){
+        SpirvLanes* regs = realloc(s->regs, program->regInit.count*sizeof(SpirvLanes));
+        if(regs == NULL) return false;
+        s->regs = regs;
+        s->regsCapacity = program->regInit.count;
+    }
+    if(s->memoryCapacity < program->memoryCount){
+        SpirvLanes* memory = realloc(s->memory, program->memoryCount*sizeof(SpirvLanes));
+        if(memory == NULL) return false;
+        s->memory = memory;
+        s->memoryCapacity = program->memoryCount;
+    }
+    return true;
+}
+
+void spirv_state_free(SpirvState* state){
+    if(state == NULL) return;
+    free(state->regs);
+    free(state->memory);
+    free(state);
+}
+
+static inline void lanes_splat(SpirvLanes* dst, uint32_t value){
+    for(uint32_t l = 0; l < SPIRV_LANES; l++) dst->u[l] = value;
+}
+
+void spirv_state_begin(SpirvState* state, const void* pushConstants, size_t pushConstantsSize, const SpirvTexture* texture){
+    const SpirvProgram* program = state->program;
+    state->texture = *texture;
+
+    for(size_t i = 0; i < program->regInit.count; i++) lanes_splat(&state->regs[i], program->regInit.items[i]);
+    memset(state->memory, 0, program->memoryCount*sizeof(SpirvLanes));
+
+    if(program->pushSlot == SPIRV_NONE) return;
+    for(size_t i = 0; i < program->pushOffsets.count; i++){
+        uint32_t offset = program->pushOffsets.items[i];
+        uint32_t value = 0;
+        if(pushConstants != NULL && offset + sizeof(value) <= pushConstantsSize) memcpy(&value, (const uint8_t*)pushConstants + offset, sizeof(value));
+        lanes_splat(&state->memory[program->pushSlot + i], value);
+    }
+}
+
+static inline SpirvLanes* spirv_reg(SpirvState* s, uint32_t id){
+    return s->regs + s->program->regOffset[id];
+}
+
+static inline uint32_t spirv_count(const SpirvProgram* program, uint32_t id){
+    return program->types[program->valueType[id]].count;
+}
+
+// scalars get broadcast so componentwise ops can take them directly
+static inline const SpirvLanes* spirv_operand(SpirvState* s, uint32_t id, uint32_t component){
+    const SpirvProgram* program = s->program;
+    return s->regs + program->regOffset[id] + (component < spirv_count(program, id) ? component : 0);
+}
+
+static inline void lanes_store(SpirvLanes* dst, const SpirvLanes* value, uint32_t mask){
+    if(mask == SPIRV_ALL_LANES){
+        *dst = *value;
+        return;
+    }
+    for(uint32_t l = 0; l < SPIRV_LANES; l++){
+        if((mask >> l) & 1) dst->u[l] = value->u[l];
+    }
+}
+
+static inline void spirv_copy(SpirvLanes* dst, const SpirvLanes* src, uint32_t count, uint32_t mask){
+    for(uint32_t c = 0; c < count; c++) lanes_store(dst + c, src + c, mask);
+}
+
+static inline uint32_t first_lane(uint32_t mask){
+    uint32_t l = 0;
+    while(!((mask >> l) & 1)) l++;
+    return l;
+}
+
+static inline float spirv_clampf(float x, float lo, float hi){
+    return fminf(fmaxf(x, lo), hi);
+}
+
+static inline uint32_t spirv_f_to_u(float f){
+    if(!(f > 0.0f)) return 0;
+    if(f >= 4294967040.0f) return UINT32_MAX;
+    return (uint32_t)f;
+}
+
+static inline int32_t spirv_f_to_s(float f){
+    if(f != f) return 0;
+    if(f <= -2147483648.0f) return INT32_MIN;
+    if(f >= 2147483520.0f) return INT32_MAX;
+    return (int32_t)f;
+}
+
+static inline int32_t spirv_s_div(int32_t a, int32_t b){
+    if(b == 0 || (a == INT32_MIN && b == -1)) return 0;
+    return a / b;
+}
+
+static inline int32_t spirv_s_rem(int32_t a, int32_t b){
+    if(b == 0 || (a == INT32_MIN && b == -1)) return 0;
+    return a % b;
+}
+
+static inline int32_t spirv_s_mod(int32_t a, int32_t b){
+    int32_t m = spirv_s_rem(a, b);
+    if(m != 0 && ((m < 0) != (b < 0))) m += b;
+    return m;
+}
+
+static inline float spirv_smoothstep(float edge0, float edge1, float x){
+    float t = spirv_clampf((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+    return t*t*(3.0f - 2.0f*t);
+}
+
+static inline float spirv_sign(float x){
+    return (float)((x > 0.0f) - (x < 0.0f));
+}
+
+// componentwise op, r = expr for every component of result reading a/b/t from operands starting at word `first`,
+// all lanes get computed so it vectorizes, only active ones are stored
+#define SPIRV_MAP(first, expr) \
+    do{ \
+        SpirvLanes* dst = spirv_reg(s, words[2]); \
+        uint32_t count = spirv_count(p, words[2]); \
+        uint32_t ia = (first); \
+        uint32_t ib = ia + 1 < wordCount ? ia + 1 : ia; \
+        uint32_t it = ia + 2 < wordCount ? ia + 2 : ia; \
+        for(uint32_t c = 0; c < count; c++){ \
+            const SpirvLanes* a = spirv_operand(s, words[ia], c); \
+            const SpirvLanes* b = spirv_operand(s, words[ib], c); \
+            const SpirvLanes* t = spirv_operand(s, words[it], c); \
+            SpirvLanes r; \
+            (void)a; (void)b; (void)t; \
+            for(uint32_t l = 0; l < SPIRV_LANES; l++){ expr; } \
+            lanes_store(dst + c, &r, mask); \
+        } \
+    }while(0)
+
+static void spirv_dot(SpirvState* s, uint32_t a, uint32_t b, uint32_t count, SpirvLanes* out){
+    for(uint32_t l = 0; l < SPIRV_LANES; l++) out->f[l] = 0.0f;
+    for(uint32_t c = 0; c < count; c++){
+        const SpirvLanes* x = spirv_operand(s, a, c);
+        const SpirvLanes* y = spirv_operand(s, b, c);
+        for(uint32_t l = 0; l < SPIRV_LANES; l++) out->f[l] += x->f[l]*y->f[l];
+    }
+}
+
+static void spirv_exec_ext(SpirvState* s, const uint32_t* words, uint32_t wordCount, uint32_t mask){
+    const SpirvProgram* p = s->program;
+    SpirvLanes* dst = spirv_reg(s, words[2]);
+    uint32_t count = spirv_count(p, words[2]);
+
+    switch(words[4]){
+        case GLSL_ROUND:       SPIRV_MAP(5, r.f[l] = roundf(a->f[l])); break;
+        case GLSL_ROUND_EVEN:  SPIRV_MAP(5, r.f[l] = nearbyintf(a->f[l])); break;
+        case GLSL_TRUNC:       SPIRV_MAP(5, r.f[l] = truncf(a->f[l])); break;
+        case GLSL_F_ABS:       SPIRV_MAP(5, r.f[l] = fabsf(a->f[l])); break;
+        case GLSL_S_ABS:       SPIRV_MAP(5, r.u[l] = a->i[l] < 0 ? 0u - a->u[l] : a->u[l]); break;
+        case GLSL_F_SIGN:      SPIRV_MAP(5, r.f[l] = spirv_sign(a->f[l])); break;
+        case GLSL_S_SIGN:      SPIRV_MAP(5, r.i[l] = (a->i[l] > 0) - (a->i[l] < 0)); break;
+        case GLSL_FLOOR:       SPIRV_MAP(5, r.f[l] = floorf(a->f[l])); break;
+        case GLSL_CEIL:        SPIRV_MAP(5, r.f[l] = ceilf(a->f[l])); break;
+        case GLSL_FRACT:       SPIRV_MAP(5, r.f[l] = a->f[l] - floorf(a->f[l])); break;
+        case GLSL_RADIANS:     SPIRV_MAP(5, r.f[l] = a->f[l] * 0.017453292519943295f); break;
+        case GLSL_DEGREES:     SPIRV_MAP(5, r.f[l] = a->f[l] * 57.29577951308232f); break;
+        case GLSL_SIN:         SPIRV_MAP(5, r.f[l] = sinf(a->f[l])); break;
+        case GLSL_COS:         SPIRV_MAP(5, r.f[l] = cosf(a->f[l])); break;
+        case GLSL_TAN:         SPIRV_MAP(5, r.f[l] = tanf(a->f[l])); break;
+        case GLSL_ASIN:        SPIRV_MAP(5, r.f[l] = asinf(a->f[l])); break;
+        case GLSL_ACOS:        SPIRV_MAP(5, r.f[l] = acosf(a->f[l])); break;
+        case GLSL_ATAN:        SPIRV_MAP(5, r.f[l] = atanf(a->f[l])); break;
+        case GLSL_SINH:        SPIRV_MAP(5, r.f[l] = sinhf(a->f[l])); break;
+        case GLSL_COSH:        SPIRV_MAP(5, r.f[l] = coshf(a->f[l])); break;
+        case GLSL_TANH:        SPIRV_MAP(5, r.f[l] = tanhf(a->f[l])); break;
+        case GLSL_ASINH:       SPIRV_MAP(5, r.f[l] = asinhf(a->f[l])); break;
+        case GLSL_ACOSH:       SPIRV_MAP(5, r.f[l] = acoshf(a->f[l])); break;
+        case GLSL_ATANH:       SPIRV_MAP(5, r.f[l] = atanhf(a->f[l])); break;
+        case GLSL_ATAN2:       SPIRV_MAP(5, r.f[l] = atan2f(a->f[l], b->f[l])); break;
+        case GLSL_POW:         SPIRV_MAP(5, r.f[l] = powf(a->f[l], b->f[l])); break;
+        case GLSL_EXP:         SPIRV_MAP(5, r.f[l] = expf(a->f[l])); break;
+        case GLSL_LOG:         SPIRV_MAP(5, r.f[l] = logf(a->f[l])); break;
+        case GLSL_EXP2:        SPIRV_MAP(5, r.f[l] = exp2f(a->f[l])); break;
+        case GLSL_LOG2:        SPIRV_MAP(5, r.f[l] = log2f(a->f[l])); break;
+        case GLSL_SQRT:        SPIRV_MAP(5, r.f[l] = sqrtf(a->f[l])); break;
+        case GLSL_INVERSE_SQRT: SPIRV_MAP(5, r.f[l] = 1.0f / sqrtf(a->f[l])); break;
+        case GLSL_N_MIN:
+        case GLSL_F_MIN:       SPIRV_MAP(5, r.f[l] = b->f[l] < a->f[l] ? b->f[l] : a->f[l]); break;
+        case GLSL_U_MIN:       SPIRV_MAP(5, r.u[l] = b->u[l] < a->u[l] ? b->u[l] : a->u[l]); break;
+        case GLSL_S_MIN:       SPIRV_MAP(5, r.i[l] = b->i[l] < a->i[l] ? b->i[l] : a->i[l]); break;
+        case GLSL_N_MAX:
+        case GLSL_F_MAX:       SPIRV_MAP(5, r.f[l] = a->f[l] < b->f[l] ? b->f[l] : a->f[l]); break;
+        case GLSL_U_MAX:       SPIRV_MAP(5, r.u[l] = a->u[l] < b->u[l] ? b->u[l] : a->u[l]); break;
+        case GLSL_S_MAX:       SPIRV_MAP(5, r.i[l] = a->i[l] < b->i[l] ? b->i[l] : a->i[l]); break;
+        case GLSL_N_CLAMP:
+        case GLSL_F_CLAMP:     SPIRV_MAP(5, r.f[l] = spirv_clampf(a->f[l], b->f[l], t->f[l])); break;
+        case GLSL_U_CLAMP:     SPIRV_MAP(5, r.u[l] = a->u[l] < b->u[l] ? b->u[l] : (a->u[l] > t->u[l] ? t->u[l] : a->u[l])); break;
+        case GLSL_S_CLAMP:     SPIRV_MAP(5, r.i[l] = a->i[l] < b->i[l] ? b->i[l] : (a->i[l] > t->i[l] ? t->i[l] : a->i[l])); break;
+        case GLSL_F_MIX:       SPIRV_MAP(5, r.f[l] = a->f[l] + (b->f[l] - a->f[l]) * t->f[l]); break;
+        case GLSL_STEP:        SPIRV_MAP(5, r.f[l] = b->f[l] < a->f[l] ? 0.0f : 1.0f); break;
+        case GLSL_SMOOTH_STEP: SPIRV_MAP(5, r.f[l] = spirv_smoothstep(a->f[l], b->f[l], t->f[l])); break;
+        case GLSL_FMA:         SPIRV_MAP(5, r.f[l] = a->f[l] * b->f[l] + t->f[l]); break;
+        case GLSL_LDEXP:       SPIRV_MAP(5, r.f[l] = ldexpf(a->f[l], b->i[l])); break;
+        case GLSL_LENGTH: {
+            SpirvLanes r;
+            spirv_dot(s, words[5], words[5], spirv_count(p, words[5]), &r);
+            for(uint32_t l = 0; l < SPIRV_LANES; l++) r.f[l] = sqrtf(r.f[l]);
+            lanes_store(dst, &r, mask);
+            break;
+        }
+        case GLSL_DISTANCE: {
+            SpirvLanes r = {0};
+            for(uint32_t c = 0; c < spirv_count(p, words[5]); c++){
+                const SpirvLanes* a = spirv_operand(s, words[5], c);
+                const SpirvLanes* b = spirv_operand(s, words[6], c);
+                for(uint32_t l = 0; l < SPIRV_LANES; l++) r.f[l] += (a->f[l] - b->f[l])*(a->f[l] - b->f[l]);
+            }
+            for(uint32_t l = 0; l < SPIRV_LANES; l++) r.f[l] = sqrtf(r.f[l]);
+            lanes_store(dst, &r, mask);
+            break;
+        }
+        case GLSL_NORMALIZE: {
+            SpirvLanes length;
+            spirv_dot(s, words[5], words[5], count, &length);
+            for(uint32_t l = 0; l < SPIRV_LANES; l++) length.f[l] = 1.0f / sqrtf(length.f[l]);
+            SPIRV_MAP(5, r.f[l] = a->f[l] * length.f[l]);
+            break;
+        }
+        case GLSL_CROSS: {
+            const SpirvLanes* a[3];
+            const SpirvLanes* b[3];
+            for(uint32_t c = 0; c < 3; c++){
+                a[c] = spirv_operand(s, words[5], c);
+                b[c] = spirv_operand(s, words[6], c);
+            }
+            SpirvLanes r[3];
+            for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                r[0].f[l] = a[1]->f[l]*b[2]->f[l] - a[2]->f[l]*b[1]->f[l];
+                r[1].f[l] = a[2]->f[l]*b[0]->f[l] - a[0]->f[l]*b[2]->f[l];
+                r[2].f[l] = a[0]->f[l]*b[1]->f[l] - a[1]->f[l]*b[0]->f[l];
+            }
+            spirv_copy(dst, r, 3, mask);
+            break;
+        }
+        case GLSL_FACE_FORWARD: {
+            SpirvLanes d;
+            spirv_dot(s, words[7], words[6], count, &d);
+            SPIRV_MAP(5, r.f[l] = d.f[l] < 0.0f ? a->f[l] : -a->f[l]);
+            break;
+        }
+        case GLSL_REFLECT: {
+            SpirvLanes d;
+            spirv_dot(s, words[6], words[5], count, &d);
+            SPIRV_MAP(5, r.f[l] = a->f[l] - 2.0f*d.f[l]*b->f[l]);
+            break;
+        }
+        case GLSL_REFRACT: {
+            SpirvLanes d, k;
+            const SpirvLanes* eta = spirv_operand(s, words[7], 0);
+            spirv_dot(s, words[6], words[5], count, &d);
+            for(uint32_t l = 0; l < SPIRV_LANES; l++) k.f[l] = 1.0f - eta->f[l]*eta->f[l]*(1.0f - d.f[l]*d.f[l]);
+            SPIRV_MAP(5, r.f[l] = k.f[l] < 0.0f ? 0.0f : eta->f[l]*a->f[l] - (eta->f[l]*d.f[l] + sqrtf(k.f[l]))*b->f[l]);
+            break;
+        }
+    }
+}
+
+static void spirv_exec_sample(SpirvState* s, const uint32_t* words, uint32_t wordCount, uint32_t mask, bool fetch){
+    const SpirvLanes* u = spirv_operand(s, words[4], 0);
+    const SpirvLanes* v = spirv_operand(s, words[4], 1);
+    SpirvLanes* dst = spirv_reg(s, words[2]);
+
+    // textureOffset, offsets are in texels
+    const SpirvLanes* offsetX = NULL;
+    const SpirvLanes* offsetY = NULL;
+    if(!fetch && wordCount > 5){
+        uint32_t operands = words[5];
+        uint32_t next = 6;
+        if(operands & IMAGE_OPERAND_BIAS) next++;
+        if(operands & IMAGE_OPERAND_LOD) next++;
+        if(operands & IMAGE_OPERAND_GRAD) next += 2;
+        if((operands & (IMAGE_OPERAND_CONST_OFFSET | IMAGE_OPERAND_OFFSET)) && next < wordCount){
+            offsetX = spirv_operand(s, words[next], 0);
+            offsetY = spirv_operand(s, words[next], 1);
+        }
+    }
+
+    const SpirvTexture* texture = &s->texture;
+    for(uint32_t l = 0; l < SPIRV_LANES; l++){
+        if(!((mask >> l) & 1)) continue;
+        float rgba[4];
+        if(fetch){
+            texture->fetch(texture->user, u->i[l], v->i[l], rgba);
+        }else{
+            float su = u->f[l];
+            float sv = v->f[l];
+            if(offsetX != NULL){
+                su += (float)offsetX->i[l] / texture->width;
+                sv += (float)offsetY->i[l] / texture->height;
+            }
+            texture->sample(texture->user, su, sv, rgba);
+        }
+        for(uint32_t c = 0; c < 4; c++) dst[c].f[l] = rgba[c];
+    }
+}
+
+// every op that doesn't change control flow
+static void spirv_exec_op(SpirvState* s, const uint32_t* words, uint32_t op, uint32_t wordCount, uint32_t mask){
+    const SpirvProgram* p = s->program;
+
+    switch(op){
+        case OP_NOP:
+        case OP_LINE:
+        case OP_NO_LINE:
+        case OP_UNDEF:
+        case OP_SAMPLED_IMAGE:
+        case OP_IMAGE:
+        case OP_FUNCTION_PARAMETER:
+            break;
+
+        case OP_VARIABLE:
+            if(wordCount > 4){
+                SpirvLanes* slot = s->memory + spirv_operand(s, words[2], 0)->u[0];
+                spirv_copy(slot, spirv_reg(s, words[4]), spirv_count(p, words[4]), mask);
+            }
+            break;
+        case OP_LOAD: {
+            const SpirvLanes* pointer = spirv_operand(s, words[3], 0);
+            SpirvLanes* dst = spirv_reg(s, words[2]);
+            uint32_t count = spirv_count(p, words[2]);
+            for(uint32_t c = 0; c < count; c++){
+                for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                    if((mask >> l) & 1) dst[c].u[l] = s->memory[pointer->u[l] + c].u[l];
+                }
+            }
+            break;
+        }
+        case OP_STORE: {
+            const SpirvLanes* pointer = spirv_operand(s, words[1], 0);
+            const SpirvLanes* src = spirv_reg(s, words[2]);
+            uint32_t count = spirv_count(p, words[2]);
+            for(uint32_t c = 0; c < count; c++){
+                for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                    if((mask >> l) & 1) s->memory[pointer->u[l] + c].u[l] = src[c].u[l];
+                }
+            }
+            break;
+        }
+        case OP_COPY_MEMORY: {
+            const SpirvLanes* target = spirv_operand(s, words[1], 0);
+            const SpirvLanes* source = spirv_operand(s, words[2], 0);
+            uint32_t count = spirv_type_count(p, p->types[p->valueType[words[1]]].element);
+            for(uint32_t c = 0; c < count; c++){
+                for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                    if((mask >> l) & 1) s->memory[target->u[l] + c].u[l] = s->memory[source->u[l] + c].u[l];
+                }
+            }
+            break;
+        }
+        case OP_ACCESS_CHAIN:
+        case OP_IN_BOUNDS_ACCESS_CHAIN: {
+            uint32_t type = p->types[p->valueType[words[3]]].element;
+            SpirvLanes r = *spirv_operand(s, words[3], 0);
+            for(uint32_t i = 4; i < wordCount; i++){
+                const SpirvLanes* index = spirv_operand(s, words[i], 0);
+                const SpirvType* t = &p->types[type];
+                if(t->kind == SPIRV_TYPE_STRUCT){
+                    // struct indices are always constants
+                    uint32_t offset = spirv_element_offset(p, &type, index->u[0]);
+                    for(uint32_t l = 0; l < SPIRV_LANES; l++) r.u[l] += offset;
+                }else{
+                    // out of bounds indices get clamped so interpreter never leaves variable
+                    int32_t last = t->length > 0 ? (int32_t)t->length - 1 : 0;
+                    uint32_t stride = spirv_type_count(p, t->element);
+                    for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                        int32_t element = index->i[l] < 0 ? 0 : (index->i[l] > last ? last : index->i[l]);
+                        r.u[l] += (uint32_t)element*stride;
+                    }
+                    type = t->element;
+                }
+            }
+            lanes_store(spirv_reg(s, words[2]), &r, mask);
+            break;
+        }
+
+        case OP_PHI: {
+            SpirvLanes* dst = spirv_reg(s, words[2]);
+            uint32_t count = spirv_count(p, words[2]);
+            for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                if(!((mask >> l) & 1)) continue;
+                for(uint32_t i = 3; i + 1 < wordCount; i += 2){
+                    if(words[i + 1] != s->prevBlock[l]) continue;
+                    const SpirvLanes* src = spirv_reg(s, words[i]);
+                    for(uint32_t c = 0; c < count; c++) dst[c].u[l] = src[c].u[l];
+                    break;
+                }
+            }
+            break;
+        }
+
+        case OP_COPY_OBJECT:
+        case OP_BITCAST:
+        case OP_U_CONVERT:
+        case OP_S_CONVERT:
+        case OP_F_CONVERT:
+            spirv_copy(spirv_reg(s, words[2]), spirv_reg(s, words[3]), spirv_count(p, words[2]), mask);
+            break;
+        case OP_COMPOSITE_CONSTRUCT: {
+            SpirvLanes* dst = spirv_reg(s, words[2]);
+            for(uint32_t i = 3; i < wordCount; i++){
+                uint32_t count = spirv_count(p, words[i]);
+                spirv_copy(dst, spirv_reg(s, words[i]), count, mask);
+                dst += count;
+            }
+            break;
+        }
+        case OP_COMPOSITE_EXTRACT: {
+            uint32_t type = p->valueType[words[3]];
+            uint32_t offset = 0;
+            for(uint32_t i = 4; i < wordCount; i++) offset += spirv_element_offset(p, &type, words[i]);
+            spirv_copy(spirv_reg(s, words[2]), spirv_reg(s, words[3]) + offset, spirv_count(p, words[2]), mask);
+            break;
+        }
+        case OP_COMPOSITE_INSERT: {
+            SpirvLanes* dst = spirv_reg(s, words[2]);
+            spirv_copy(dst, spirv_reg(s, words[4]), spirv_count(p, words[2]), mask);
+            uint32_t type = p->valueType[words[4]];
+            uint32_t offset = 0;
+            for(uint32_t i = 5; i < wordCount; i++) offset += spirv_element_offset(p, &type, words[i]);
+            spirv_copy(dst + offset, spirv_reg(s, words[3]), spirv_count(p, words[3]), mask);
+            break;
+        }
+        case OP_VECTOR_SHUFFLE: {
+            SpirvLanes* dst = spirv_reg(s, words[2]);
+            uint32_t firstCount = spirv_count(p, words[3]);
+            SpirvLanes zero = {0};
+            for(uint32_t i = 5; i < wordCount; i++){
+                uint32_t component = words[i];
+                const SpirvLanes* src = &zero;
+                if(component < firstCount) src = spirv_reg(s, words[3]) + component;
+                else if(component != 0xFFFFFFFF) src = spirv_reg(s, words[4]) + (component - firstCount);
+                lanes_store(dst + (i - 5), src, mask);
+            }
+            break;
+        }
+        case OP_VECTOR_EXTRACT_DYNAMIC: {
+            const SpirvLanes* vector = spirv_reg(s, words[3]);
+            const SpirvLanes* index = spirv_operand(s, words[4], 0);
+            uint32_t last = spirv_count(p, words[3]) - 1;
+            SpirvLanes r;
+            for(uint32_t l = 0; l < SPIRV_LANES; l++) r.u[l] = vector[index->u[l] > last ? last : index->u[l]].u[l];
+            lanes_store(spirv_reg(s, words[2]), &r, mask);
+            break;
+        }
+        case OP_VECTOR_INSERT_DYNAMIC: {
+            SpirvLanes* dst = spirv_reg(s, words[2]);
+            uint32_t count = spirv_count(p, words[2]);
+            spirv_copy(dst, spirv_reg(s, words[3]), count, mask);
+            const SpirvLanes* component = spirv_operand(s, words[4], 0);
+            const SpirvLanes* index = spirv_operand(s, words[5], 0);
+            for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                if(((mask >> l) & 1) && index->u[l] < count) dst[index->u[l]].u[l] = component->u[l];
+            }
+            break;
+        }
+        case OP_TRANSPOSE: {
+            SpirvLanes* dst = spirv_reg(s, words[2]);
+            const SpirvLanes* src = spirv_reg(s, words[3]);
+            const SpirvType* type = &p->types[p->valueType[words[2]]];
+            uint32_t rows = p->types[type->element].count;
+            uint32_t srcRows = type->length;
+            for(uint32_t c = 0; c < type->length; c++){
+                for(uint32_t r = 0; r < rows; r++) lanes_store(dst + c*rows + r, src + r*srcRows + c, mask);
+            }
+            break;
+        }
+
+        case OP_CONVERT_F_TO_U: SPIRV_MAP(3, r.u[l] = spirv_f_to_u(a->f[l])); break;
+        case OP_CONVERT_F_TO_S: SPIRV_MAP(3, r.i[l] = spirv_f_to_s(a->f[l])); break;
+        case OP_CONVERT_S_TO_F: SPIRV_MAP(3, r.f[l] = (float)a->i[l]); break;
+        case OP_CONVERT_U_TO_F: SPIRV_MAP(3, r.f[l] = (float)a->u[l]); break;
+
+        case OP_S_NEGATE: SPIRV_MAP(3, r.u[l] = 0u - a->u[l]); break;
+        case OP_F_NEGATE: SPIRV_MAP(3, r.f[l] = -a->f[l]); break;
+        case OP_I_ADD:    SPIRV_MAP(3, r.u[l] = a->u[l] + b->u[l]); break;
+        case OP_F_ADD:    SPIRV_MAP(3, r.f[l] = a->f[l] + b->f[l]); break;
+        case OP_I_SUB:    SPIRV_MAP(3, r.u[l] = a->u[l] - b->u[l]); break;
+        case OP_F_SUB:    SPIRV_MAP(3, r.f[l] = a->f[l] - b->f[l]); break;
+        case OP_I_MUL:    SPIRV_MAP(3, r.u[l] = a->u[l] * b->u[l]); break;
+        case OP_VECTOR_TIMES_SCALAR:
+        case OP_MATRIX_TIMES_SCALAR:
+        case OP_F_MUL:    SPIRV_MAP(3, r.f[l] = a->f[l] * b->f[l]); break;
+        case OP_U_DIV:    SPIRV_MAP(3, r.u[l] = b->u[l] ? a->u[l] / b->u[l] : 0); break;
+        case OP_S_DIV:    SPIRV_MAP(3, r.i[l] = spirv_s_div(a->i[l], b->i[l])); break;
+        case OP_F_DIV:    SPIRV_MAP(3, r.f[l] = a->f[l] / b->f[l]); break;
+        case OP_U_MOD:    SPIRV_MAP(3, r.u[l] = b->u[l] ? a->u[l] % b->u[l] : 0); break;
+        case OP_S_REM:    SPIRV_MAP(3, r.i[l] = spirv_s_rem(a->i[l], b->i[l])); break;
+        case OP_S_MOD:    SPIRV_MAP(3, r.i[l] = spirv_s_mod(a->i[l], b->i[l])); break;
+        case OP_F_REM:    SPIRV_MAP(3, r.f[l] = fmodf(a->f[l], b->f[l])); break;
+        case OP_F_MOD:    SPIRV_MAP(3, r.f[l] = a->f[l] - b->f[l]*floorf(a->f[l] / b->f[l])); break;
+
+        case OP_VECTOR_TIMES_MATRIX: {
+            SpirvLanes* dst = spirv_reg(s, words[2]);
+            uint32_t rows = spirv_count(p, words[3]);
+            const SpirvLanes* matrix = spirv_reg(s, words[4]);
+            const SpirvLanes* vector = spirv_reg(s, words[3]);
+            for(uint32_t c = 0; c < spirv_count(p, words[2]); c++){
+                SpirvLanes r = {0};
+                for(uint32_t i = 0; i < rows; i++){
+                    for(uint32_t l = 0; l < SPIRV_LANES; l++) r.f[l] += vector[i].f[l]*matrix[c*rows + i].f[l];
+                }
+                lanes_store(dst + c, &r, mask);
+            }
+            break;
+        }
+        case OP_MATRIX_TIMES_VECTOR: {
+            SpirvLanes* dst = spirv_reg(s, words[2]);
+            uint32_t rows = spirv_count(p, words[2]);
+            uint32_t columns = spirv_count(p, words[4]);
+            const SpirvLanes* matrix = spirv_reg(s, words[3]);
+            const SpirvLanes* vector = spirv_reg(s, words[4]);
+            for(uint32_t row = 0; row < rows; row++){
+                SpirvLanes r = {0};
+                for(uint32_t c = 0; c < columns; c++){
+                    for(uint32_t l = 0; l < SPIRV_LANES; l++) r.f[l] += matrix[c*rows + row].f[l]*vector[c].f[l];
+                }
+                lanes_store(dst + row, &r, mask);
+            }
+            break;
+        }
+        case OP_MATRIX_TIMES_MATRIX: {
+            SpirvLanes* dst = spirv_reg(s, words[2]);
+            const SpirvType* leftType = &p->types[p->valueType[words[3]]];
+            const SpirvType* rightType = &p->types[p->valueType[words[4]]];
+            uint32_t rows = p->types[leftType->element].count;
+            uint32_t inner = leftType->length;
+            const SpirvLanes* left = spirv_reg(s, words[3]);
+            const SpirvLanes* right = spirv_reg(s, words[4]);
+            for(uint32_t c = 0; c < rightType->length; c++){
+                for(uint32_t row = 0; row < rows; row++){
+                    SpirvLanes r = {0};
+                    for(uint32_t i = 0; i < inner; i++){
+                        for(uint32_t l = 0; l < SPIRV_LANES; l++) r.f[l] += left[i*rows + row].f[l]*right[c*inner + i].f[l];
+                    }
+                    lanes_store(dst + c*rows + row, &r, mask);
+                }
+            }
+            break;
+        }
+        case OP_OUTER_PRODUCT: {
+            SpirvLanes* dst = spirv_reg(s, words[2]);
+            uint32_t rows = spirv_count(p, words[3]);
+            uint32_t columns = spirv_count(p, words[4]);
+            const SpirvLanes* a = spirv_reg(s, words[3]);
+            const SpirvLanes* b = spirv_reg(s, words[4]);
+            for(uint32_t c = 0; c < columns; c++){
+                for(uint32_t row = 0; row < rows; row++){
+                    SpirvLanes r;
+                    for(uint32_t l = 0; l < SPIRV_LANES; l++) r.f[l] = a[row].f[l]*b[c].f[l];
+                    lanes_store(dst + c*rows + row, &r, mask);
+                }
+            }
+            break;
+        }
+        case OP_DOT: {
+            SpirvLanes r;
+            spirv_dot(s, words[3], words[4], spirv_count(p, words[3]), &r);
+            lanes_store(spirv_reg(s, words[2]), &r, mask);
+            break;
+        }
+
+        case OP_ANY:
+        case OP_ALL: {
+            const SpirvLanes* vector = spirv_reg(s, words[3]);
+            SpirvLanes r;
+            for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                uint32_t any = 0;
+                uint32_t all = 1;
+                for(uint32_t c = 0; c < spirv_count(p, words[3]); c++){
+                    any |= vector[c].u[l] != 0;
+                    all &= vector[c].u[l] != 0;
+                }
+                r.u[l] = op == OP_ANY ? any : all;
+            }
+            lanes_store(spirv_reg(s, words[2]), &r, mask);
+            break;
+        }
+        case OP_IS_NAN: SPIRV_MAP(3, r.u[l] = isnan(a->f[l]) != 0); break;
+        case OP_IS_INF: SPIRV_MAP(3, r.u[l] = isinf(a->f[l]) != 0); break;
+
+        case OP_LOGICAL_EQUAL:     SPIRV_MAP(3, r.u[l] = (a->u[l] != 0) == (b->u[l] != 0)); break;
+        case OP_LOGICAL_NOT_EQUAL: SPIRV_MAP(3, r.u[l] = (a->u[l] != 0) != (b->u[l] != 0)); break;
+        case OP_LOGICAL_OR:        SPIRV_MAP(3, r.u[l] = (a->u[l] | b->u[l]) != 0); break;
+        case OP_LOGICAL_AND:       SPIRV_MAP(3, r.u[l] = a->u[l] != 0 && b->u[l] != 0); break;
+        case OP_LOGICAL_NOT:       SPIRV_MAP(3, r.u[l] = a->u[l] == 0); break;
+        case OP_SELECT:            SPIRV_MAP(3, r.u[l] = a->u[l] ? b->u[l] : t->u[l]); break;
+        case OP_I_EQUAL:           SPIRV_MAP(3, r.u[l] = a->u[l] == b->u[l]); break;
+        case OP_I_NOT_EQUAL:       SPIRV_MAP(3, r.u[l] = a->u[l] != b->u[l]); break;
+        case OP_U_GREATER_THAN:    SPIRV_MAP(3, r.u[l] = a->u[l] > b->u[l]); break;
+        case OP_S_GREATER_THAN:    SPIRV_MAP(3, r.u[l] = a->i[l] > b->i[l]); break;
+        case OP_U_GREATER_THAN_EQUAL: SPIRV_MAP(3, r.u[l] = a->u[l] >= b->u[l]); break;
+        case OP_S_GREATER_THAN_EQUAL: SPIRV_MAP(3, r.u[l] = a->i[l] >= b->i[l]); break;
+        case OP_U_LESS_THAN:       SPIRV_MAP(3, r.u[l] = a->u[l] < b->u[l]); break;
+        case OP_S_LESS_THAN:       SPIRV_MAP(3, r.u[l] = a->i[l] < b->i[l]); break;
+        case OP_U_LESS_THAN_EQUAL: SPIRV_MAP(3, r.u[l] = a->u[l] <= b->u[l]); break;
+        case OP_S_LESS_THAN_EQUAL: SPIRV_MAP(3, r.u[l] = a->i[l] <= b->i[l]); break;
+        case OP_F_ORD_EQUAL:       SPIRV_MAP(3, r.u[l] = a->f[l] == b->f[l]); break;
+        case OP_F_UNORD_EQUAL:     SPIRV_MAP(3, r.u[l] = !(a->f[l] < b->f[l] || a->f[l] > b->f[l])); break;
+        case OP_F_ORD_NOT_EQUAL:   SPIRV_MAP(3, r.u[l] = a->f[l] < b->f[l] || a->f[l] > b->f[l]); break;
+        case OP_F_UNORD_NOT_EQUAL: SPIRV_MAP(3, r.u[l] = !(a->f[l] == b->f[l])); break;
+        case OP_F_ORD_LESS_THAN:   SPIRV_MAP(3, r.u[l] = a->f[l] < b->f[l]); break;
+        case OP_F_UNORD_LESS_THAN: SPIRV_MAP(3, r.u[l] = !(a->f[l] >= b->f[l])); break;
+        case OP_F_ORD_GREATER_THAN:   SPIRV_MAP(3, r.u[l] = a->f[l] > b->f[l]); break;
+        case OP_F_UNORD_GREATER_THAN: SPIRV_MAP(3, r.u[l] = !(a->f[l] <= b->f[l])); break;
+        case OP_F_ORD_LESS_THAN_EQUAL:   SPIRV_MAP(3, r.u[l] = a->f[l] <= b->f[l]); break;
+        case OP_F_UNORD_LESS_THAN_EQUAL: SPIRV_MAP(3, r.u[l] = !(a->f[l] > b->f[l])); break;
+        case OP_F_ORD_GREATER_THAN_EQUAL:   SPIRV_MAP(3, r.u[l] = a->f[l] >= b->f[l]); break;
+        case OP_F_UNORD_GREATER_THAN_EQUAL: SPIRV_MAP(3, r.u[l] = !(a->f[l] < b->f[l])); break;
+
+        case OP_SHIFT_RIGHT_LOGICAL:    SPIRV_MAP(3, r.u[l] = a->u[l] >> (b->u[l] & 31)); break;
+        case OP_SHIFT_RIGHT_ARITHMETIC: SPIRV_MAP(3, r.i[l] = a->i[l] >> (b->u[l] & 31)); break;
+        case OP_SHIFT_LEFT_LOGICAL:     SPIRV_MAP(3, r.u[l] = a->u[l] << (b->u[l] & 31)); break;
+        case OP_BITWISE_OR:  SPIRV_MAP(3, r.u[l] = a->u[l] | b->u[l]); break;
+        case OP_BITWISE_XOR: SPIRV_MAP(3, r.u[l] = a->u[l] ^ b->u[l]); break;
+        case OP_BITWISE_AND: SPIRV_MAP(3, r.u[l] = a->u[l] & b->u[l]); break;
+        case OP_NOT:         SPIRV_MAP(3, r.u[l] = ~a->u[l]); break;
+
+        // lanes form 4x2 block, pairs of columns and both rows act as gpu quads
+        case OP_DPDX:
+        case OP_DPDX_FINE:
+        case OP_DPDX_COARSE:
+            SPIRV_MAP(3, r.f[l] = a->f[l | 1] - a->f[l & ~1u]);
+            break;
+        case OP_DPDY:
+        case OP_DPDY_FINE:
+        case OP_DPDY_COARSE:
+            SPIRV_MAP(3, r.f[l] = a->f[(l % SPIRV_BLOCK_WIDTH) + SPIRV_BLOCK_WIDTH] - a->f[l % SPIRV_BLOCK_WIDTH]);
+            break;
+        case OP_FWIDTH:
+        case OP_FWIDTH_FINE:
+        case OP_FWIDTH_COARSE:
+            SPIRV_MAP(3, r.f[l] = fabsf(a->f[l | 1] - a->f[l & ~1u]) + fabsf(a->f[(l % SPIRV_BLOCK_WIDTH) + SPIRV_BLOCK_WIDTH] - a->f[l % SPIRV_BLOCK_WIDTH]));
+            break;
+
+        case OP_EXT_INST:
+            spirv_exec_ext(s, words, wordCount, mask);
+            break;
+        case OP_IMAGE_SAMPLE_IMPLICIT_LOD:
+        case OP_IMAGE_SAMPLE_EXPLICIT_LOD:
+            spirv_exec_sample(s, words, wordCount, mask, false);
+            break;
+        case OP_IMAGE_FETCH:
+            spirv_exec_sample(s, words, wordCount, mask, true);
+            break;
+        case OP_IMAGE_QUERY_SIZE:
+        case OP_IMAGE_QUERY_SIZE_LOD: {
+            // cpu textures have no mips
+            SpirvLanes* dst = spirv_reg(s, words[2]);
+            SpirvLanes size[2];
+            lanes_splat(&size[0], (uint32_t)s->texture.width);
+            lanes_splat(&size[1], (uint32_t)s->texture.height);
+            spirv_copy(dst, size, spirv_count(p, words[2]) < 2 ? spirv_count(p, words[2]) : 2, mask);
+            break;
+        }
+        case OP_IMAGE_QUERY_LEVELS: {
+            SpirvLanes levels;
+            lanes_splat(&levels, 1);
+            lanes_store(spirv_reg(s, words[2]), &levels, mask);
+            break;
+        }
+    }
+}
+
+static uint32_t spirv_exec(SpirvState* s, uint32_t pc, uint32_t mask, uint32_t stop, uint32_t callResult);
+
+static uint32_t spirv_exec_branch(SpirvState* s, uint32_t target, uint32_t mask, uint32_t stop, uint32_t from, uint32_t callResult){
+    for(uint32_t l = 0; l < SPIRV_LANES; l++){
+        if((mask >> l) & 1) s->prevBlock[l] = from;
+    }
+    if(target == stop) return mask;
+    return spirv_exec(s, s->program->labelPc[target], mask, stop, callResult);
+}
+
+// runs lanes in mask from pc until they branch to stop label or leave the function, returns lanes that reached stop.
+// lanes that split up on a branch run separately until they meet again at its merge block,
+// each lane only ever touches its own registers so any group of lanes standing at same label can continue together
+static uint32_t spirv_exec(SpirvState* s, uint32_t pc, uint32_t mask, uint32_t stop, uint32_t callResult){
+    const SpirvProgram* p = s->program;
+    uint32_t block = 0;
+    uint32_t merge = 0;
+    uint32_t loopMerge = 0;
+
+    for(;;){
+        const uint32_t* words = p->words + pc;
+        uint32_t op = words[0] & 0xFFFF;
+        uint32_t wordCount = words[0] >> 16;
+        pc += wordCount;
+
+        uint32_t target;
+        switch(op){
+            case OP_LABEL:
+                block = words[1];
+                merge = 0;
+                continue;
+            case OP_SELECTION_MERGE:
+                merge = words[1];
+                continue;
+            case OP_LOOP_MERGE:
+                merge = words[1];
+                loopMerge = words[1];
+                continue;
+
+            case OP_BRANCH:
+                target = words[1];
+                break;
+            case OP_BRANCH_CONDITIONAL: {
+                const SpirvLanes* condition = spirv_operand(s, words[1], 0);
+                uint32_t taken = 0;
+                for(uint32_t l = 0; l < SPIRV_LANES; l++) taken |= (condition->u[l] != 0) << l;
+                taken &= mask;
+                if(taken == mask){
+                    target = words[2];
+                    break;
+                }
+                if(taken == 0){
+                    target = words[3];
+                    break;
+                }
+
+                uint32_t join = merge ? merge : (loopMerge ? loopMerge : stop);
+                mask = spirv_exec_branch(s, words[2], taken, join, block, callResult) |
+                       spirv_exec_branch(s, words[3], mask & ~taken, join, block, callResult);
+                if(mask == 0 || join == stop) return mask;
+                pc = p->labelPc[join];
+                continue;
+            }
+            case OP_SWITCH: {
+                const SpirvLanes* selector = spirv_operand(s, words[1], 0);
+                uint32_t targets[SPIRV_LANES];
+                for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                    targets[l] = words[2];
+                    for(uint32_t i = 3; i + 1 < wordCount; i += 2){
+                        if(selector->u[l] == words[i]){
+                            targets[l] = words[i + 1];
+                            break;
+                        }
+                    }
+                }
+
+                uint32_t caseTarget = targets[first_lane(mask)];
+                uint32_t pending = mask;
+                for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                    if(((mask >> l) & 1) && targets[l] == caseTarget) pending &= ~(1u << l);
+                }
+                if(pending == 0){
+                    target = caseTarget;
+                    break;
+                }
+
+                uint32_t join = merge ? merge : (loopMerge ? loopMerge : stop);
+                uint32_t reached = spirv_exec_branch(s, caseTarget, mask & ~pending, join, block, callResult);
+                while(pending){
+                    caseTarget = targets[first_lane(pending)];
+                    uint32_t group = 0;
+                    for(uint32_t l = 0; l < SPIRV_LANES; l++){
+                        if(((pending >> l) & 1) && targets[l] == caseTarget) group |= 1u << l;
+                    }
+                    pending &= ~group;
+                    reached |= spirv_exec_branch(s, caseTarget, group, join, block, callResult);
+                }
+
+                mask = reached;
+                if(mask == 0 || join == stop) return mask;
+                pc = p->labelPc[join];
+                continue;
+            }
+
+            case OP_FUNCTION_CALL: {
+                uint32_t functionPc = p->functionPc[words[3]];
+                functionPc += p->words[functionPc] >> 16;
+                for(uint32_t arg = 4; (p->words[functionPc] & 0xFFFF) == OP_FUNCTION_PARAMETER && arg < wordCount; arg++){
+                    uint32_t param = p->words[functionPc + 2];
+                    spirv_copy(spirv_reg(s, param), spirv_reg(s, words[arg]), spirv_count(p, param), mask);
+                    functionPc += p->words[functionPc] >> 16;
+                }
+                spirv_exec(s, functionPc, mask, 0, words[2]);
+                mask &= ~s->killed;
+                if(mask == 0) return 0;
+                continue;
+            }
+            case OP_RETURN_VALUE:
+                if(callResult != 0) spirv_copy(spirv_reg(s, callResult), spirv_reg(s, words[1]), spirv_count(p, words[1]), mask);
+                return 0;
+            case OP_KILL:
+            case OP_TERMINATE_INVOCATION:
+                s->killed |= mask;
+                return 0;
+            case OP_RETURN:
+            case OP_UNREACHABLE:
+            case OP_FUNCTION_END:
+                return 0;
+
+            default:
+                spirv_exec_op(s, words, op, wordCount, mask);
+                continue;
+        }
+
+        // whole group takes the same branch
+        for(uint32_t l = 0; l < SPIRV_LANES; l++){
+            if((mask >> l) & 1) s->prevBlock[l] = block;
+        }
+        if(target == stop) return mask;
+        pc = p->labelPc[target];
+    }
+}
+
+uint32_t spirv_run(SpirvState* state, const float fragCoord[2][SPIRV_LANES], const float uv[2][SPIRV_LANES], float colorOut[4][SPIRV_LANES]){
+    const SpirvProgram* program = state->program;
+
+    if(program->uvSlot != SPIRV_NONE){
+        memcpy(state->memory[program->uvSlot].f, uv[0], sizeof(state->memory[0].f));
+        memcpy(state->memory[program->uvSlot + 1].f, uv[1], sizeof(state->memory[0].f));
+    }
+    if(program->fragCoordSlot != SPIRV_NONE){
+        memcpy(state->memory[program->fragCoordSlot].f, fragCoord[0], sizeof(state->memory[0].f));
+        memcpy(state->memory[program->fragCoordSlot + 1].f, fragCoord[1], sizeof(state->memory[0].f));
+        for(uint32_t l = 0; l < SPIRV_LANES; l++){
+            state->memory[program->fragCoordSlot + 2].f[l] = 0.0f;
+            state->memory[program->fragCoordSlot + 3].f[l] = 1.0f;
+        }
+    }
+    memset(&state->memory[program->outColorSlot], 0, 4*sizeof(SpirvLanes));
+    for(size_t i = 0; i < program->privateInits.count; i++){
+        const SpirvInit* init = &program->privateInits.items[i];
+        spirv_copy(&state->memory[init->slot], spirv_reg(state, init->value), spirv_count(program, init->value), SPIRV_ALL_LANES);
+    }
+
+    state->killed = 0;
+    uint32_t entryPc = program->functionPc[program->entry];
+    spirv_exec(state, entryPc + (program->words[entryPc] >> 16), SPIRV_ALL_LANES, 0, 0);
+
+    for(uint32_t c = 0; c < 4; c++) memcpy(colorOut[c], state->memory[program->outColorSlot + c].f, sizeof(colorOut[c]));
+    return SPIRV_ALL_LANES & ~state->killed;
+}
@@ -0,0 +1,41 @@
+#ifndef FVFX_SPIRV_INTERPRETER
+#define FVFX_SPIRV_INTERPRETER
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// pixels shaded together, laid out as 4x2 block so derivatives work (lane = row*4 + column)
+#define SPIRV_LANES 8
+#define SPIRV_BLOCK_WIDTH 4
+#define SPIRV_BLOCK_HEIGHT 2
+#define SPIRV_ALL_LANES ((1u << SPIRV_LANES) - 1)
+
+// texture bound to set 0 binding 0 (imageIN)
+typedef struct{
+    void* user;
+    size_t width;
+    size_t height;
+    void (*sample)(void* user, float u, float v, float rgbaOut[4]);
+    void (*fetch)(void* user, int32_t x, int32_t y, float rgbaOut[4]);
+} SpirvTexture;
+
+// fragment shader module preprocessed for interpretation, immutable so it can be shared by all threads
+typedef struct SpirvProgram SpirvProgram;
+// registers and variables of one thread
+typedef struct SpirvState SpirvState;
+
+// spirvSize is in bytes, prints reason and returns NULL when module uses something interpreter doesn't support
+SpirvProgram* spirv_program_load(const uint32_t* spirv, size_t spirvSize, const char* name);
+void spirv_program_free(SpirvProgram* program);
+
+// (re)allocates *state so it fits program, cheap when it already does
+bool spirv_state_reserve(SpirvState** state, const SpirvProgram* program);
+void spirv_state_free(SpirvState* state);
+// has to be called before running batches with new push constants or texture
+void spirv_state_begin(SpirvState* state, const void* pushConstants, size_t pushConstantsSize, const SpirvTexture* texture);
+
+// shades one block, returns lanes that weren't discarded
+uint32_t spirv_run(SpirvState* state, const float fragCoord[2][SPIRV_LANES], const float uv[2][SPIRV_LANES], float colorOut[4][SPIRV_LANES]);
+
+#endif
@@ -0,0 +1,87 @@
+#define NOB_STRIP_PREFIX
+#include "nob.h"
+
+#include "thread_pool.h"
+#include "engine/platform.h"
+
+#include <stdlib.h>
+
+static int thread_pool_worker(void* arg){
+    ThreadPool* pool = arg;
+
+    platform_mutex_lock(pool->mutex);
+    while(true){
+        while(pool->jobs.head == pool->jobs.count && !pool->stopping) platform_cond_wait(pool->jobAvailable, pool->mutex);
+        if(pool->jobs.head == pool->jobs.count) break;
+
+        ThreadPoolJob job = pool->jobs.items[pool->jobs.head++];
+        if(pool->jobs.head == pool->jobs.count) pool->jobs.head = pool->jobs.count = 0;
+        platform_mutex_unlock(pool->mutex);
+
+        job.proc(job.arg);
+
+        platform_mutex_lock(pool->mutex);
+        pool->pending--;
+        if(pool->pending == 0) platform_cond_broadcast(pool->jobsDone);
+    }
+    platform_mutex_unlock(pool->mutex);
+
+    if(pool->workerExit) pool->workerExit(pool->workerExitArg);
+    return 0;
+}
+
+bool thread_pool_init(ThreadPool* pool, size_t threads_count, ThreadPoolJobProc workerExit, void* workerExitArg){
+    *pool = (ThreadPool){0};
+    pool->workerExit = workerExit;
+    pool->workerExitArg = workerExitArg;
+    if(threads_count == 0) threads_count = platform_get_cpu_count();
+
+    pool->mutex = platform_mutex_create();
+    pool->jobAvailable = platform_cond_create();
+    pool->jobsDone = platform_cond_create();
+    if(!pool->mutex || !pool->jobAvailable || !pool->jobsDone) return false;
+
+    pool->threads = calloc(threads_count, sizeof(*pool->threads));
+    if(!pool->threads) return false;
+
+    for(size_t i = 0; i < threads_count; i++){
+        pool->threads[i] = platform_thread_create(thread_pool_worker, pool);
+        if(pool->threads[i] == NULL) break;
+        pool->threads_count++;
+    }
+
+    return pool->threads_count > 0;
+}
+
+void thread_pool_push(ThreadPool* pool, ThreadPoolJobProc proc, void* arg){
+    platform_mutex_lock(pool->mutex);
+    da_append(&pool->jobs, ((ThreadPoolJob){.proc = proc, .arg = arg}));
+    pool->pending++;
+    platform_cond_signal(pool->jobAvailable);
+    platform_mutex_unlock(pool->mutex);
+}
+
+void thread_pool_wait(ThreadPool* pool){
+    platform_mutex_lock(pool->mutex);
+    while(pool->pending > 0) platform_cond_wait(pool->jobsDone, pool->mutex);
+    platform_mutex_unlock(pool->mutex);
+}
+
+void thread_pool_uninit(ThreadPool* pool){
+    if(pool->mutex){
+        platform_mutex_lock(pool->mutex);
+        pool->stopping = true;
+        platform_cond_broadcast(pool->jobAvailable);
+        platform_mutex_unlock(pool->mutex);
+    }
+
+    for(size_t i = 0; i < pool->threads_count; i++) platform_thread_join(pool->threads[i]);
+    free(pool->threads);
+    free(pool->jobs.items);
+
+    if(pool->jobsDone) platform_cond_destroy(pool->jobsDone);
+    if(pool->jobAvailable) platform_cond_destroy(pool->jobAvailable);
+    if(pool->mutex) platform_mutex_destroy(pool->mutex);
+
+    *pool = (ThreadPool){0};
+}
@@ -0,0 +1,42 @@
+#ifndef FVFX_THREAD_POOL
+#define FVFX_THREAD_POOL
+
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef void (*ThreadPoolJobProc)(void* arg);
+
+typedef struct{
+    ThreadPoolJobProc proc;
+    void* arg;
+} ThreadPoolJob;
+
+typedef struct{
+    ThreadPoolJob* items;
+    size_t count;
+    size_t capacity;
+    size_t head;
+} ThreadPoolJobs;
+
+typedef struct{
+    void** threads;
+    size_t threads_count;
+    void* mutex;
+    void* jobAvailable;
+    void* jobsDone;
+    ThreadPoolJobs jobs;
+    size_t pending;
+    bool stopping;
+    ThreadPoolJobProc workerExit;
+    void* workerExitArg;
+} ThreadPool;
+
+// threads_count == 0 means one worker per cpu core
+// workerExit (can be NULL) runs on every worker right before it exits, to free its thread locals
+bool thread_pool_init(ThreadPool* pool, size_t threads_count, ThreadPoolJobProc workerExit, void* workerExitArg);
+void thread_pool_push(ThreadPool* pool, ThreadPoolJobProc proc, void* arg);
+// blocks until every pushed job has finished
+void thread_pool_wait(ThreadPool* pool);
+void thread_pool_uninit(ThreadPool* pool);
+
+#endif
@@ -0,0 +1,256 @@
+#include "time_stretch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TIME_STRETCH_FRAME_MS 30
+#define TIME_STRETCH_TOLERANCE_MS 8
+// coarse search looks at every nth candidate using every nth sample, then refines around best one
+#define TIME_STRETCH_COARSE_STEP 4
+
+// first sample of channel and distance between its samples
+static float* channel_samples(uint8_t** buf, enum AVSampleFormat sample_fmt, size_t channels, size_t ch, size_t* stride){
+    if(sample_fmt == AV_SAMPLE_FMT_FLTP){
+        *stride = 1;
+        return (float*)buf[ch];
+    }
+    *stride = channels;
+    return (float*)buf[0] + ch;
+}
+
+bool time_stretch_init(TimeStretch* ts, size_t channels, double sampleRate, enum AVSampleFormat sample_fmt){
+    memset(ts, 0, sizeof(*ts));
+    if(channels == 0 || channels > MIX_AUDIO_MAX_CHANNELS){
+        fprintf(stderr, "[FVFX] Time stretch supports up to %d channels, got %zu\n", MIX_AUDIO_MAX_CHANNELS, channels);
+        return false;
+    }
+    if(sample_fmt != AV_SAMPLE_FMT_FLT && sample_fmt != AV_SAMPLE_FMT_FLTP){
+        fprintf(stderr, "[FVFX] Time stretch only works on float samples\n");
+        return false;
+    }
+    ts->channels = channels;
+    ts->sample_fmt = sample_fmt;
+    ts->speed = 1;
+    ts->preservePitch = true;
+    ts->natural = -1;
+
+    ts->hop = (size_t)(sampleRate * TIME_STRETCH_FRAME_MS / 2000.0 + 0.5);
+    if(ts->hop < TIME_STRETCH_COARSE_STEP) ts->hop = TIME_STRETCH_COARSE_STEP;
+    ts->frameLength = ts->hop*2;
+    ts->tolerance = (size_t)(sampleRate * TIME_STRETCH_TOLERANCE_MS / 1000.0 + 0.5);
+
+    // periodic hann, halves of neighbouring frames sum to exactly 1
+    ts->window = malloc(ts->frameLength*sizeof(float));
+    if(ts->window == NULL) goto fail;
+    for(size_t i = 0; i < ts->frameLength; i++) ts->window[i] = (float)(0.5 - 0.5*cos(2*M_PI*i/ts->frameLength));
+
+    ts->inputCapacity = ts->frameLength*4;
+    for(size_t ch = 0; ch < channels; ch++){
+        ts->input[ch] = malloc(ts->inputCapacity*sizeof(float));
+        ts->tail[ch] = calloc(ts->hop, sizeof(float));
+        if(ts->input[ch] == NULL || ts->tail[ch] == NULL) goto fail;
+    }
+    size_t outputPlanes = sample_fmt == AV_SAMPLE_FMT_FLTP ? channels : 1;
+    size_t outputPlaneSize = sample_fmt == AV_SAMPLE_FMT_FLTP ? ts->hop : ts->hop*channels;
+    for(size_t plane = 0; plane < outputPlanes; plane++){
+        ts->output[plane] = calloc(outputPlaneSize, sizeof(float));
+        if(ts->output[plane] == NULL) goto fail;
+    }
+    return true;
+fail:
+    fprintf(stderr, "[FVFX] Couldn't allocate time stretch buffers\n");
+    time_stretch_uninit(ts);
+    return false;
+}
+
+void time_stretch_uninit(TimeStretch* ts){
+    free(ts->window);
+    for(size_t ch = 0; ch < MIX_AUDIO_MAX_CHANNELS; ch++){
+        free(ts->input[ch]);
+        free(ts->tail[ch]);
+        free(ts->output[ch]);
+    }
+    memset(ts, 0, sizeof(*ts));
+}
+
+void time_stretch_reset(TimeStretch* ts, bool preservePitch){
+    ts->preservePitch = preservePitch;
+    ts->inputCount = 0;
+    ts->inputPos = 0;
+    ts->inputEnded = false;
+    ts->natural = -1;
+    ts->outputCount = 0;
+    ts->outputRead = 0;
+}
+
+static bool time_stretch_reserve(TimeStretch* ts, size_t count){
+    if(count <= ts->inputCapacity) return true;
+    size_t capacity = ts->inputCapacity*2;
+    if(capacity < count) capacity = count;
+    for(size_t ch = 0; ch < ts->channels; ch++){
+        float* grown = realloc(ts->input[ch], capacity*sizeof(float));
+        if(grown == NULL){
+            fprintf(stderr, "[FVFX] Couldn't grow time stretch input\n");
+            return false;
+        }
+        ts->input[ch] = grown;
+    }
+    ts->inputCapacity = capacity;
+    return true;
+}
+
+// moves input nothing will read anymore out of buffer so it doesn't grow with slice length
+static void time_stretch_drop_consumed(TimeStretch* ts){
+    size_t drop = (size_t)ts->inputPos;
+    if(ts->preservePitch){
+        drop = drop > ts->tolerance ? drop - ts->tolerance : 0;
+        if(ts->natural >= 0 && (size_t)ts->natural < drop) drop = (size_t)ts->natural;
+    }
+    if(drop > ts->inputCount) drop = ts->inputCount;
+    if(drop == 0) return;
+
+    for(size_t ch = 0; ch < ts->channels; ch++) memmove(ts->input[ch], ts->input[ch] + drop, (ts->inputCount - drop)*sizeof(float));
+    ts->inputCount -= drop;
+    ts->inputPos -= drop;
+    if(ts->natural >= 0) ts->natural -= drop;
+}
+
+bool time_stretch_push(TimeStretch* ts, uint8_t** data, size_t frames, size_t skip){
+    if(skip >= frames) return true;
+    frames -= skip;
+    time_stretch_drop_consumed(ts);
+    if(!time_stretch_reserve(ts, ts->inputCount + frames)) return false;
+
+    for(size_t ch = 0; ch < ts->channels; ch++){
+        size_t stride;
+        const float* src = channel_samples(data, ts->sample_fmt, ts->channels, ch, &stride) + skip*stride;
+        float* dst = ts->input[ch] + ts->inputCount;
+        for(size_t i = 0; i < frames; i++) dst[i] = src[i*stride];
+    }
+    ts->inputCount += frames;
+    return true;
+}
+
+bool time_stretch_end(TimeStretch* ts){
+    if(ts->inputEnded) return true;
+    time_stretch_drop_consumed(ts);
+    size_t padding = ts->frameLength + ts->tolerance*2 + (size_t)(ts->hop*ts->speed) + 2;
+    if(!time_stretch_reserve(ts, ts->inputCount + padding)) return false;
+    for(size_t ch = 0; ch < ts->channels; ch++) memset(ts->input[ch] + ts->inputCount, 0, padding*sizeof(float));
+    ts->inputCount += padding;
+    ts->inputEnded = true;
+    return true;
+}
+
+// how well hop frames at a continue the ones at b, normalized by energy at a so loud candidates don't win just for being loud
+static double time_stretch_similarity(TimeStretch* ts, size_t a, size_t b, size_t step){
+    double dot = 0;
+    double energy = 0;
+    for(size_t ch = 0; ch < ts->channels; ch++){
+        const float* x = ts->input[ch] + a;
+        const float* y = ts->input[ch] + b;
+        for(size_t i = 0; i < ts->hop; i += step){
+            dot += x[i]*y[i];
+            energy += x[i]*x[i];
+        }
+    }
+    return energy > 0 ? dot / sqrt(energy) : 0;
+}
+
+// candidate in lo..hi most similar to natural continuation of last frame, ties stay at center so silence isn't shifted around
+static size_t time_stretch_search(TimeStretch* ts, size_t natural, size_t lo, size_t center, size_t hi){
+    size_t best = center;
+    double bestScore = time_stretch_similarity(ts, center, natural, TIME_STRETCH_COARSE_STEP);
+    for(size_t candidate = lo; candidate <= hi; candidate += TIME_STRETCH_COARSE_STEP){
+        double score = time_stretch_similarity(ts, candidate, natural, TIME_STRETCH_COARSE_STEP);
+        if(score > bestScore){
+            bestScore = score;
+            best = candidate;
+        }
+    }
+
+    size_t fineLo = best > lo + TIME_STRETCH_COARSE_STEP - 1 ? best - (TIME_STRETCH_COARSE_STEP - 1) : lo;
+    size_t fineHi = best + TIME_STRETCH_COARSE_STEP - 1 < hi ? best + TIME_STRETCH_COARSE_STEP - 1 : hi;
+    size_t fineBest = best;
+    bestScore = time_stretch_similarity(ts, best, natural, 1);
+    for(size_t candidate = fineLo; candidate <= fineHi; candidate++){
+        if(candidate == best) continue;
+        double score = time_stretch_similarity(ts, candidate, natural, 1);
+        if(score > bestScore){
+            bestScore = score;
+            fineBest = candidate;
+        }
+    }
+    return fineBest;
+}
+
+static bool time_stretch_wsola(TimeStretch* ts){
+    size_t start;
+    if(ts->natural < 0){
+        start = (size_t)ts->inputPos;
+        if(start + ts->frameLength > ts->inputCount) return false;
+    }else{
+        size_t center = (size_t)(ts->inputPos + 0.5);
+        size_t lo = center > ts->tolerance ? center - ts->tolerance : 0;
+        size_t hi = center + ts->tolerance;
+        if(hi + ts->frameLength > ts->inputCount) return false;
+        start = time_stretch_search(ts, (size_t)ts->natural, lo, center, hi);
+    }
+
+    for(size_t ch = 0; ch < ts->channels; ch++){
+        size_t stride;
+        float* out = channel_samples(ts->output, ts->sample_fmt, ts->channels, ch, &stride);
+        const float* in = ts->input[ch] + start;
+        float* tail = ts->tail[ch];
+        for(size_t i = 0; i < ts->hop; i++){
+            // first frame has nothing to overlap with so it starts unwindowed instead of fading in
+            out[i*stride] = ts->natural < 0 ? in[i] : tail[i] + in[i]*ts->window[i];
+            tail[i] = in[ts->hop + i]*ts->window[ts->hop + i];
+        }
+    }
+    ts->natural = (ptrdiff_t)(start + ts->hop);
+    ts->inputPos += ts->hop*ts->speed;
+    return true;
+}
+
+static bool time_stretch_resample(TimeStretch* ts){
+    double last = ts->inputPos + (double)(ts->hop - 1)*ts->speed;
+    if((size_t)last + 1 >= ts->inputCount) return false;
+
+    for(size_t ch = 0; ch < ts->channels; ch++){
+        size_t stride;
+        float* out = channel_samples(ts->output, ts->sample_fmt, ts->channels, ch, &stride);
+        const float* in = ts->input[ch];
+        double pos = ts->inputPos;
+        for(size_t i = 0; i < ts->hop; i++, pos += ts->speed){
+            size_t index = (size_t)pos;
+            float frac = (float)(pos - index);
+            out[i*stride] = in[index] + (in[index + 1] - in[index])*frac;
+        }
+    }
+    ts->inputPos += ts->hop*ts->speed;
+    return true;
+}
+
+size_t time_stretch_pull(TimeStretch* ts, size_t maxFrames, uint8_t*** dataOut){
+    if(ts->outputRead == ts->outputCount){
+        ts->outputCount = 0;
+        ts->outputRead = 0;
+        if(ts->speed <= 0) ts->speed = 1;
+        bool made = ts->preservePitch ? time_stretch_wsola(ts) : time_stretch_resample(ts);
+        if(!made) return 0;
+        ts->outputCount = ts->hop;
+    }
+
+    size_t frames = ts->outputCount - ts->outputRead;
+    if(frames > maxFrames) frames = maxFrames;
+    if(ts->sample_fmt == AV_SAMPLE_FMT_FLTP){
+        for(size_t ch = 0; ch < ts->channels; ch++) ts->pulled[ch] = ts->output[ch] + ts->outputRead*sizeof(float);
+    }else{
+        ts->pulled[0] = ts->output[0] + ts->outputRead*ts->channels*sizeof(float);
+    }
+    ts->outputRead += frames;
+    *dataOut = ts->pulled;
+    return frames;
+}
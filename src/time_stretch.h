@@ -0,0 +1,47 @@
+#ifndef FVFX_TIME_STRETCH
+#define FVFX_TIME_STRETCH
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "ffmpeg_helper.h"
+
+// changes audio speed, wsola keeps pitch by overlap adding hop sized pieces of input picked where they line up best,
+// without preservePitch input is just resampled like tape running faster
+typedef struct{
+    size_t channels;
+    enum AVSampleFormat sample_fmt; // FLT or FLTP, of both pushed and pulled samples
+    bool preservePitch;
+    double speed; // input frames consumed per output frame, read every time new hop of output is made
+
+    // planar input, consumed part gets dropped on push
+    float* input[MIX_AUDIO_MAX_CHANNELS];
+    size_t inputCount;
+    size_t inputCapacity;
+    double inputPos; // where next hop should be taken from
+    bool inputEnded;
+
+    size_t frameLength;
+    size_t hop;       // output frames made at once, half of frameLength
+    size_t tolerance; // how far from inputPos wsola searches for best match
+    float* window;
+    ptrdiff_t natural; // input frame continuing last wsola frame, -1 before first one
+    float* tail[MIX_AUDIO_MAX_CHANNELS];
+
+    uint8_t* output[MIX_AUDIO_MAX_CHANNELS]; // one hop in sample_fmt
+    size_t outputCount;
+    size_t outputRead;
+    uint8_t* pulled[MIX_AUDIO_MAX_CHANNELS];
+} TimeStretch;
+
+bool time_stretch_init(TimeStretch* ts, size_t channels, double sampleRate, enum AVSampleFormat sample_fmt);
+void time_stretch_uninit(TimeStretch* ts);
+// forgets everything buffered, safe to call on zeroed TimeStretch
+void time_stretch_reset(TimeStretch* ts, bool preservePitch);
+// first skip frames of data are ignored
+bool time_stretch_push(TimeStretch* ts, uint8_t** data, size_t frames, size_t skip);
+// pads input with silence so everything pushed so far comes out
+bool time_stretch_end(TimeStretch* ts);
+// points dataOut at up to maxFrames of output and returns how many, 0 means more input is needed
+size_t time_stretch_pull(TimeStretch* ts, size_t maxFrames, uint8_t*** dataOut);
+
+#endif
@@ -2,9 +2,13 @@
 #include "engine/vulkan_createGraphicPipelines.h"
 #include "engine/vulkan_compileShader.h"
 #include "engine/vulkan_helpers.h"
+#include "engine/vulkan_globals.h"
+#include "engine/vulkan_internal.h"
 #include "engine/vulkan_buffer.h"
 #include "engine/vulkan_images.h"
 #include "shader_utils.h"
+#include "engine/platform.h"
+#include <math.h>
 
 #define FA_REALLOC(optr, osize, new_size) realloc(optr, new_size)
 #define fa_reserve(da, extra) \
@@ -26,34 +30,92 @@
         (da)->items[(da)->count++]=value;\
    } while(0)
 
-typedef struct{
-    int currentImage;
-    
-    VkImage image1;
-    VkDeviceMemory imageMemory1;
-    VkImageView imageView1;
-    size_t imageStride1;
-    void* imageMapped1;
-    VkDescriptorSet descriptorSet1;
-    
-    VkImage image2;
-    VkDeviceMemory imageMemory2;
-    VkImageView imageView2;
-    size_t imageStride2;
-    void* imageMapped2;
-    VkDescriptorSet descriptorSet2;
-} VulkanizerImagesOut;
+// first parameter buffer, doubled whenever a frame doesn't fit
+#define VULKANIZER_PARAMS_INITIAL_SIZE (64*1024)
 
-typedef struct{
-    VulkanizerImagesOut* items;
-    size_t count;
-    size_t capacity;
-    size_t used;
-    size_t item_size;
-} VulkanizerImagesOutPool;
+static bool Vulkanizer_create_params_buffer(Vulkanizer* vulkanizer, VkDeviceSize size, VulkanizerParamsBuffer* out){
+    *out = (VulkanizerParamsBuffer){.size = size};
+
+    if(!vkCreateBufferEX(vulkanizer->device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            size, &out->buffer, &out->memory)) return false;
+
+    if(vkMapMemory(vulkanizer->device, out->memory, 0, size, 0, (void**)&out->mapped) != VK_SUCCESS) return false;
+
+    if(vkCreateDescriptorPool(vulkanizer->device, &(VkDescriptorPoolCreateInfo){
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &(VkDescriptorPoolSize){
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+            .descriptorCount = 1,
+        },
+    }, NULL, &out->descriptorPool) != VK_SUCCESS){
+        fprintf(stderr, "Couldn't create parameters descriptor pool\n");
+        return false;
+    }
+
+    if(vkAllocateDescriptorSets(vulkanizer->device, &(VkDescriptorSetAllocateInfo){
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = out->descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &vulkanizer->paramsDescriptorSetLayout,
+    }, &out->descriptorSet) != VK_SUCCESS){
+        fprintf(stderr, "Couldn't allocate parameters descriptor set\n");
+        return false;
+    }
+
+    // whole size so range of every slice ends at the end of buffer, dynamic offset picks the slice
+    vkUpdateDescriptorSets(vulkanizer->device, 1, &(VkWriteDescriptorSet){
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = out->descriptorSet,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+        .pBufferInfo = &(VkDescriptorBufferInfo){
+            .buffer = out->buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        },
+    }, 0, NULL);
+
+    return true;
+}
+
+static void Vulkanizer_destroy_params_buffer(Vulkanizer* vulkanizer, VulkanizerParamsBuffer* params){
+    if(params->descriptorPool != NULL) vkDestroyDescriptorPool(vulkanizer->device, params->descriptorPool, NULL);
+    if(params->buffer != NULL) vkDestroyBuffer(vulkanizer->device, params->buffer, NULL);
+    if(params->memory != NULL) vkFreeMemory(vulkanizer->device, params->memory, NULL);
+    *params = (VulkanizerParamsBuffer){0};
+}
+
+// reserves slice for one pass, returned pointer stays valid until the next reset
+static uint8_t* Vulkanizer_reserve_params(Vulkanizer* vulkanizer, VkDeviceSize size, uint32_t* offsetOut){
+    VulkanizerParamsBuffer* params = &vulkanizer->params;
+    VkDeviceSize alignment = vulkanizer->paramsAlignment > 0 ? vulkanizer->paramsAlignment : 256;
+    VkDeviceSize offset = (params->used + alignment - 1) / alignment * alignment;
+
+    if(params->buffer == NULL || offset + size > params->size){
+        VkDeviceSize newSize = params->size > 0 ? params->size*2 : VULKANIZER_PARAMS_INITIAL_SIZE;
+        while(newSize < size) newSize *= 2;
+
+        // already recorded passes still point at old buffer
+        if(params->buffer != NULL) fa_push(&vulkanizer->retiredParams, *params);
+        if(!Vulkanizer_create_params_buffer(vulkanizer, newSize, params)){
+            Vulkanizer_destroy_params_buffer(vulkanizer, params);
+            return NULL;
+        }
+        offset = 0;
+    }
+
+    params->used = offset + size;
+    *offsetOut = (uint32_t)offset;
+    return params->mapped + offset;
+}
 
 static bool applyShadersOnFrame(
                             VkCommandBuffer cmd,
+                            Vulkanizer* vulkanizer,
                             size_t inWidth,
                             size_t inHeight,
                             size_t outWidth,
@@ -71,6 +133,17 @@ static bool applyShadersOnFrame(
         return false;
     }
 
+    float constants[4] = {
+        outWidth, outHeight,
+        inWidth, inHeight
+    };
+    uint32_t paramsOffset;
+    uint8_t* params = Vulkanizer_reserve_params(vulkanizer, sizeof(constants) + push_constants_size, &paramsOffset);
+    if(params == NULL) return false;
+    memcpy(params, constants, sizeof(constants));
+    if(push_constants_data != NULL && push_constants_size > 0) memcpy(params + sizeof(constants), push_constants_data, push_constants_size);
+    else memset(params + sizeof(constants), 0, push_constants_size);
+
     vkCmdBeginRenderingEX(cmd,
         .colorAttachment = outImageView,
         .clearColor = COL_EMPTY,
@@ -90,12 +163,7 @@ static bool applyShadersOnFrame(
 
     vkCmdBindPipeline(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS, vfx->pipeline);
     vkCmdBindDescriptorSets(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,vfx->pipelineLayout,0,1,inImageDescriptorSet,0,NULL);
-    float constants[4] = {
-        outWidth, outHeight,
-        inWidth, inHeight
-    };
-    vkCmdPushConstants(cmd, vfx->pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), constants);
-    if(push_constants_data != NULL && push_constants_size > 0) vkCmdPushConstants(cmd, vfx->pipelineLayout, VK_SHADER_STAGE_ALL, sizeof(constants), push_constants_size, push_constants_data);
+    vkCmdBindDescriptorSets(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,vfx->pipelineLayout,1,1,&vulkanizer->params.descriptorSet,1,&paramsOffset);
     vkCmdDraw(cmd, 6, 1, 0, 0);
     vkCmdEndRendering(cmd);
 
@@ -122,131 +190,382 @@ bool createMyImage(VkDevice device, VkImage* image, size_t width, size_t height,
     return true;
 }
 
-static bool init_output_image(
-    VkDevice device,
-    VkDescriptorPool descriptorPool,
+static const VkFormat workingFormats[VFX_WORKING_FORMAT_COUNT] = {
+    [VFX_WORKING_FORMAT_RGBA8] = VK_FORMAT_R8G8B8A8_UNORM,
+    [VFX_WORKING_FORMAT_RGBA16F] = VK_FORMAT_R16G16B16A16_SFLOAT,
+    [VFX_WORKING_FORMAT_RGB10A2] = VK_FORMAT_A2B10G10R10_UNORM_PACK32,
+};
 
-    size_t outWidth,
-    size_t outHeight,
+static size_t formatPixelSize(VkFormat format){
+    return format == VK_FORMAT_R16G16B16A16_SFLOAT ? 8 : 4;
+}
 
-    VkDescriptorSetLayout descriptorSetLayout,
-    VkSampler samplerLinear,
+static const char* workingFormatsNames[VFX_WORKING_FORMAT_COUNT] = {
+    [VFX_WORKING_FORMAT_RGBA8] = "RGBA8",
+    [VFX_WORKING_FORMAT_RGBA16F] = "RGBA16F",
+    [VFX_WORKING_FORMAT_RGB10A2] = "RGB10A2",
+};
 
-    VkImage* outImage1,
-    VkDeviceMemory* outImageMemory1,
-    VkImageView* outImageView1,
-    size_t* outImageStride1,
-    void** outImageMapped1,
-    VkDescriptorSet* outImageDescriptorSet1,
+VkFormat Vulkanizer_get_working_format(VfxWorkingFormat workingFormat){
+    if(workingFormat >= VFX_WORKING_FORMAT_COUNT) return workingFormats[VFX_WORKING_FORMAT_RGBA8];
+    return workingFormats[workingFormat];
+}
+
+// sets per descriptor pool, only combined image samplers are allocated from them
+#define VULKANIZER_DESCRIPTOR_POOL_SETS 64
+
+static bool Vulkanizer_add_descriptor_pool(Vulkanizer* vulkanizer){
+    VkDescriptorPool pool;
+    if(vkCreateDescriptorPool(vulkanizer->device, &(VkDescriptorPoolCreateInfo){
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+        .maxSets = VULKANIZER_DESCRIPTOR_POOL_SETS,
+        .poolSizeCount = 1,
+        .pPoolSizes = &(VkDescriptorPoolSize){
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = VULKANIZER_DESCRIPTOR_POOL_SETS,
+        },
+    }, NULL, &pool) != VK_SUCCESS){
+        fprintf(stderr, "Couldn't create descriptor pool\n");
+        return false;
+    }
+    fa_push(&vulkanizer->descriptorPools, pool);
+    vulkanizer->descriptorPoolsCurrent = vulkanizer->descriptorPools.count - 1;
+    return true;
+}
 
-    VkImage* outImage2,
-    VkDeviceMemory* outImageMemory2,
-    VkImageView* outImageView2,
-    size_t* outImageStride2,
-    void** outImageMapped2,
-    VkDescriptorSet* outImageDescriptorSet2
-){
+static bool Vulkanizer_allocate_descriptor_set(Vulkanizer* vulkanizer, VkDescriptorSet* descriptorSetOut, VkDescriptorPool* descriptorPoolOut){
     VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {0};
     descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptorSetAllocateInfo.descriptorPool = descriptorPool;
     descriptorSetAllocateInfo.descriptorSetCount = 1;
-    descriptorSetAllocateInfo.pSetLayouts = &descriptorSetLayout;
-
-    vkAllocateDescriptorSets(device,&descriptorSetAllocateInfo, outImageDescriptorSet1);
-    vkAllocateDescriptorSets(device,&descriptorSetAllocateInfo, outImageDescriptorSet2);
-
-    if(!createMyImage(device, outImage1,
-        outWidth,
-        outHeight,
-        outImageMemory1, outImageView1,
-        outImageStride1, 
-        outImageMapped1,
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    )) return false;
+    descriptorSetAllocateInfo.pSetLayouts = &vulkanizer->vfxDescriptorSetLayout;
 
-    if(!createMyImage(device, outImage2,
-        outWidth,
-        outHeight,
-        outImageMemory2, outImageView2, 
-        outImageStride2, 
-        outImageMapped2,
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    )) return false;
+    // starting from pool that worked last time, freed sets make room in older pools again
+    size_t poolsCount = vulkanizer->descriptorPools.count;
+    for(size_t i = 0; i < poolsCount; i++){
+        size_t index = (vulkanizer->descriptorPoolsCurrent + i) % poolsCount;
+        descriptorSetAllocateInfo.descriptorPool = vulkanizer->descriptorPools.items[index];
+        VkResult result = vkAllocateDescriptorSets(vulkanizer->device, &descriptorSetAllocateInfo, descriptorSetOut);
+        if(result == VK_SUCCESS){
+            vulkanizer->descriptorPoolsCurrent = index;
+            *descriptorPoolOut = descriptorSetAllocateInfo.descriptorPool;
+            return true;
+        }
+        if(result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) return false;
+    }
+
+    if(!Vulkanizer_add_descriptor_pool(vulkanizer)) return false;
+    descriptorSetAllocateInfo.descriptorPool = vulkanizer->descriptorPools.items[vulkanizer->descriptorPoolsCurrent];
+    if(vkAllocateDescriptorSets(vulkanizer->device, &descriptorSetAllocateInfo, descriptorSetOut) != VK_SUCCESS) return false;
+    *descriptorPoolOut = descriptorSetAllocateInfo.descriptorPool;
+    return true;
+}
+
+void Vulkanizer_free_descriptor_set(Vulkanizer* vulkanizer, VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet){
+    if(descriptorPool == NULL || descriptorSet == NULL) return;
+    vkFreeDescriptorSets(vulkanizer->device, descriptorPool, 1, &descriptorSet);
+}
+
+// targets not used for this many frames get their memory released
+#define VULKANIZER_TARGET_MAX_IDLE_FRAMES 120
+
+static void VulkanizerTarget_destroy(Vulkanizer* vulkanizer, VulkanizerTarget* target){
+    Vulkanizer_free_descriptor_set(vulkanizer, target->descriptorPool, target->descriptorSet);
+    if(target->view) vkDestroyImageView(vulkanizer->device, target->view, NULL);
+    if(target->image) vkDestroyImage(vulkanizer->device, target->image, NULL);
+    if(target->memory) vkFreeMemory(vulkanizer->device, target->memory, NULL);
+}
+
+static VulkanizerTarget* VulkanizerTarget_create(Vulkanizer* vulkanizer, size_t width, size_t height, VkFormat format){
+    VulkanizerTarget* target = calloc(1, sizeof(*target));
+    if(target == NULL) return NULL;
+    target->width = width;
+    target->height = height;
+    target->format = format;
+    target->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if(!vkCreateImageEX(vulkanizer->device, width, height, format, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &target->image, &target->memory)){
+        printf("Couldn't create image\n");
+        goto fail;
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(vulkanizer->device, target->image, &memRequirements);
+    target->size = memRequirements.size;
 
-    VkCommandBuffer tempCmd = vkCmdBeginSingleTime();
-    vkCmdTransitionImage(tempCmd,*outImage1, VK_IMAGE_LAYOUT_UNDEFINED,VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
-    vkCmdTransitionImage(tempCmd,*outImage2, VK_IMAGE_LAYOUT_UNDEFINED,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
-    vkCmdEndSingleTime(tempCmd);
+    if(!vkCreateImageViewEX(vulkanizer->device, target->image, format, VK_IMAGE_ASPECT_COLOR_BIT, &target->view)){
+        printf("Couldn't create image view\n");
+        goto fail;
+    }
+
+    if(!Vulkanizer_allocate_descriptor_set(vulkanizer, &target->descriptorSet, &target->descriptorPool)){
+        target->descriptorSet = NULL;
+        target->descriptorPool = NULL;
+        goto fail;
+    }
 
     {
         VkDescriptorImageInfo descriptorImageInfo = {0};
         VkWriteDescriptorSet writeDescriptorSet = {0};
 
-        descriptorImageInfo.sampler = samplerLinear;
+        descriptorImageInfo.sampler = vulkanizer->samplerLinear;
         descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        descriptorImageInfo.imageView = *outImageView1;
+        descriptorImageInfo.imageView = target->view;
 
         writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         writeDescriptorSet.descriptorCount = 1;
         writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        writeDescriptorSet.dstSet = *outImageDescriptorSet1;
+        writeDescriptorSet.dstSet = target->descriptorSet;
         writeDescriptorSet.dstBinding = 0;
         writeDescriptorSet.dstArrayElement = 0;
         writeDescriptorSet.pImageInfo = &descriptorImageInfo;
 
-        vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, NULL);
+        vkUpdateDescriptorSets(vulkanizer->device, 1, &writeDescriptorSet, 0, NULL);
+    }
+
+    return target;
+
+fail:
+    VulkanizerTarget_destroy(vulkanizer, target);
+    free(target);
+    return NULL;
+}
 
-        descriptorImageInfo.imageView = *outImageView2;
-        writeDescriptorSet.dstSet = *outImageDescriptorSet2;
-        vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, NULL);
+// narrowest scope that touches a target in given layout, source side of reads needs no access since only writes have to be made available
+static void layoutSyncScope(VkImageLayout layout, bool isSource, VkPipelineStageFlags2* stageOut, VkAccessFlags2* accessOut){
+    switch(layout){
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+            *stageOut = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+            *accessOut = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            *stageOut = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+            *accessOut = isSource ? VK_ACCESS_2_NONE : VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+            break;
+        default:
+            *stageOut = VK_PIPELINE_STAGE_2_NONE;
+            *accessOut = VK_ACCESS_2_NONE;
+            break;
     }
-    return true;
 }
 
-static VulkanizerImagesOut* VulkanizerImagesOutPool_get_avaliable(Vulkanizer* vulkanizer, VulkanizerImagesOutPool* pool){
-    if(pool->used < pool->count) return &pool->items[pool->used++];
-    fa_reserve(pool, 1);
-    VulkanizerImagesOut* out = &pool->items[pool->count++];
+static void Vulkanizer_flush_barriers(VkCommandBuffer cmd, Vulkanizer* vulkanizer){
+    VulkanizerBarriers* barriers = &vulkanizer->pendingBarriers;
+    if(barriers->count == 0) return;
 
-    //initalization
-    *out = (VulkanizerImagesOut){0};
-    if(!init_output_image(
-        vulkanizer->device,
-        vulkanizer->descriptorPool,
-        vulkanizer->videoOutWidth, vulkanizer->videoOutHeight,
-        vulkanizer->vfxDescriptorSetLayout,
-        vulkanizer->samplerLinear,
+    vkCmdPipelineBarrier2(cmd, &(VkDependencyInfo){
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount = barriers->count,
+        .pImageMemoryBarriers = barriers->items,
+    });
 
-        &out->image1,
-        &out->imageMemory1,
-        &out->imageView1,
-        &out->imageStride1,
-        &out->imageMapped1,
-        &out->descriptorSet1,
+    vulkanizer->targetStats.barriers++;
+    vulkanizer->targetStats.transitions += barriers->count;
+    barriers->count = 0;
+}
 
-        &out->image2,
-        &out->imageMemory2,
-        &out->imageView2,
-        &out->imageStride2,
-        &out->imageMapped2,
-        &out->descriptorSet2
-    )) return NULL;
+// only queues the transition, it takes effect at next Vulkanizer_flush_barriers
+static void VulkanizerTarget_transition(VkCommandBuffer cmd, Vulkanizer* vulkanizer, VulkanizerTarget* target, VkImageLayout newLayout){
+    // sampling the same image again needs no synchronization
+    if(target->layout == newLayout && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) return;
+
+    VulkanizerBarriers* barriers = &vulkanizer->pendingBarriers;
+    if(barriers->count == VULKANIZER_MAX_PENDING_BARRIERS) Vulkanizer_flush_barriers(cmd, vulkanizer);
+
+    VkImageMemoryBarrier2* barrier = &barriers->items[barriers->count++];
+    *barrier = (VkImageMemoryBarrier2){
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .oldLayout = target->layout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = target->image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+    layoutSyncScope(target->layout, true, &barrier->srcStageMask, &barrier->srcAccessMask);
+    layoutSyncScope(newLayout, false, &barrier->dstStageMask, &barrier->dstAccessMask);
 
-    return out;
+    target->layout = newLayout;
 }
 
-static void VulkanizerImagesOutPool_reset(VulkanizerImagesOutPool* pool){
-    pool->used = 0;
+// returned target has a pending transition to COLOR_ATTACHMENT_OPTIMAL, previous contents are discarded
+static VulkanizerTarget* Vulkanizer_acquire_target(VkCommandBuffer cmd, Vulkanizer* vulkanizer, size_t width, size_t height, VkFormat format){
+    VulkanizerTarget* target = NULL;
+    for(size_t i = 0; i < vulkanizer->targets.count; i++){
+        VulkanizerTarget* it = vulkanizer->targets.items[i];
+        if(it->inUse || it->pinned || it->width != width || it->height != height || it->format != format) continue;
+        target = it;
+        break;
+    }
+
+    if(target == NULL){
+        target = VulkanizerTarget_create(vulkanizer, width, height, format);
+        if(target == NULL) return NULL;
+        fa_push(&vulkanizer->targets, target);
+
+        VulkanizerTargetStats* stats = &vulkanizer->targetStats;
+        stats->targetsCreated++;
+        stats->allocatedBytes += target->size;
+        if(stats->allocatedBytes > stats->peakAllocatedBytes) stats->peakAllocatedBytes = stats->allocatedBytes;
+    }
+
+    target->inUse = true;
+    target->lastUsedFrame = vulkanizer->frameIndex;
+
+    VulkanizerTargetStats* stats = &vulkanizer->targetStats;
+    stats->liveBytes += target->size;
+    if(stats->liveBytes > stats->peakLiveBytes) stats->peakLiveBytes = stats->liveBytes;
+
+    // transitioning from the last known layout so the barrier waits for whoever sampled this target before
+    VulkanizerTarget_transition(cmd, vulkanizer, target, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+    return target;
+}
+
+// target can be handed out again to any pass recorded after this call
+static void Vulkanizer_release_target(Vulkanizer* vulkanizer, VulkanizerTarget* target){
+    assert(target->inUse);
+    target->inUse = false;
+    vulkanizer->targetStats.liveBytes -= target->size;
+}
+
+void Vulkanizer_layer_cache_release(Vulkanizer* vulkanizer, VulkanizerLayerCache* layerCache){
+    if(layerCache->target == NULL) return;
+    layerCache->target->pinned = false;
+    vulkanizer->targetStats.liveBytes -= layerCache->target->size;
+    layerCache->target = NULL;
+    layerCache->hash = 0;
+}
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size){
+    const uint8_t* bytes = data;
+    for(size_t i = 0; i < size; i++){
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+#define fnv1a_value(hash, value) fnv1a((hash), &(value), sizeof(value))
+
+// everything that affects pixels of layer result before compositing
+static uint64_t Vulkanizer_layer_hash(Vulkanizer* vulkanizer, VulkanizerVfxInstances* vfxInstances, VkImageView videoInView, Frame* frameIn, int64_t frameId){
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash = fnv1a_value(hash, videoInView);
+    hash = fnv1a_value(hash, frameId);
+    hash = fnv1a_value(hash, frameIn->video.width);
+    hash = fnv1a_value(hash, frameIn->video.height);
+    hash = fnv1a_value(hash, vulkanizer->videoOutWidth);
+    hash = fnv1a_value(hash, vulkanizer->videoOutHeight);
+    for(size_t i = 0; i < vfxInstances->count; i++){
+        VulkanizerVfxInstance* vfx = &vfxInstances->items[i];
+        hash = fnv1a_value(hash, vfx->vfx->pipeline);
+        hash = fnv1a_value(hash, vfx->renderScale);
+        if(vfx->push_constants_data != NULL) hash = fnv1a(hash, vfx->push_constants_data, vfx->push_constants_size);
+    }
+    return hash;
+}
+
+static VfxWorkingFormat Vulkanizer_stats_format(Vulkanizer* vulkanizer){
+    return vulkanizer->workingFormat < VFX_WORKING_FORMAT_COUNT ? vulkanizer->workingFormat : VFX_WORKING_FORMAT_RGBA8;
+}
+
+// called once frame that wrote timestamps has finished on gpu, cut short frames may miss their closing timestamp and are skipped
+static void Vulkanizer_collect_timestamps(Vulkanizer* vulkanizer){
+    uint32_t written = vulkanizer->timestampsWritten;
+    vulkanizer->timestampsWritten = 0;
+    if(written < 2) return;
+
+    uint64_t timestamps[VULKANIZER_MAX_TIMESTAMPS];
+    if(vkGetQueryPoolResults(vulkanizer->device, vulkanizer->timestampPool, 0, written, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) return;
+
+    uint64_t ticks = 0;
+    for(uint32_t i = 0; i + 1 < written; i += 2) ticks += timestamps[i+1] - timestamps[i];
+    VulkanizerFormatStats* formatStats = &vulkanizer->targetStats.formats[vulkanizer->timestampsFormat];
+    formatStats->gpuNanos += (uint64_t)(ticks*(double)physicalDeviceLimits.timestampPeriod);
+    formatStats->timedFrames++;
 }
 
-static VulkanizerImagesOutPool vulkanizerImagesOutPool = {0};
+void Vulkanizer_reset_pool(Vulkanizer* vulkanizer){
+    Vulkanizer_collect_timestamps(vulkanizer);
+    vulkanizer->frameIndex++;
+    vulkanizer->targetStats.formats[Vulkanizer_stats_format(vulkanizer)].frames++;
+    vulkanizer->targetStats.liveBytes = 0;
+
+    size_t kept = 0;
+    for(size_t i = 0; i < vulkanizer->targets.count; i++){
+        VulkanizerTarget* target = vulkanizer->targets.items[i];
+        target->inUse = false;
+        if(target->pinned){
+            vulkanizer->targetStats.liveBytes += target->size;
+            vulkanizer->targets.items[kept++] = target;
+            continue;
+        }
+        if(vulkanizer->frameIndex - target->lastUsedFrame > VULKANIZER_TARGET_MAX_IDLE_FRAMES){
+            vulkanizer->targetStats.allocatedBytes -= target->size;
+            vulkanizer->targetStats.targetsDestroyed++;
+            VulkanizerTarget_destroy(vulkanizer, target);
+            free(target);
+            continue;
+        }
+        vulkanizer->targets.items[kept++] = target;
+    }
+    vulkanizer->targets.count = kept;
+
+    vulkanizer->params.used = 0;
+    for(size_t i = 0; i < vulkanizer->retiredParams.count; i++){
+        Vulkanizer_destroy_params_buffer(vulkanizer, &vulkanizer->retiredParams.items[i]);
+    }
+    vulkanizer->retiredParams.count = 0;
+}
 
-bool Vulkanizer_init(VkDevice deviceIN, VkDescriptorPool descriptorPoolIN, size_t outWidth, size_t outHeight, Vulkanizer* vulkanizer, ArenaAllocator* aa){
+void Vulkanizer_print_target_stats(Vulkanizer* vulkanizer){
+    VulkanizerTargetStats* stats = &vulkanizer->targetStats;
+    printf("[FVFX] Intermediate targets: peak live %.2fMB, peak allocated %.2fMB, allocated %.2fMB (%zu created, %zu released)\n",
+        (double)stats->peakLiveBytes / (1024.0*1024.0),
+        (double)stats->peakAllocatedBytes / (1024.0*1024.0),
+        (double)stats->allocatedBytes / (1024.0*1024.0),
+        stats->targetsCreated,
+        stats->targetsDestroyed
+    );
+    printf("[FVFX] Barriers: %zu emitted for %zu target transitions\n", stats->barriers, stats->transitions);
+    // estimated traffic next to measured gpu time so working formats can be compared on the same project
+    for(size_t i = 0; i < VFX_WORKING_FORMAT_COUNT; i++){
+        VulkanizerFormatStats* formatStats = &stats->formats[i];
+        if(formatStats->frames == 0) continue;
+        printf("[FVFX] Working format %s: %zu frames, %zu passes, %.2fMB intermediate traffic per frame (%.2fMB total)",
+            workingFormatsNames[i],
+            formatStats->frames,
+            formatStats->passes,
+            (double)formatStats->passBytes / formatStats->frames / (1024.0*1024.0),
+            (double)formatStats->passBytes / (1024.0*1024.0)
+        );
+        if(formatStats->timedFrames > 0) printf(", layer passes %.3fms per frame on gpu (%zu frames measured)\n", (double)formatStats->gpuNanos / formatStats->timedFrames / 1e6, formatStats->timedFrames);
+        else printf(", gpu time not measured\n");
+    }
+}
+
+// vfx jobs compile shaders on pool workers, each of them keeps its own shaderc compiler
+static void Vulkanizer_worker_exit(void* arg){
+    (void)arg;
+    vkReleaseThreadCompiler();
+}
+
+bool Vulkanizer_init(VkDevice deviceIN, size_t outWidth, size_t outHeight, Vulkanizer* vulkanizer, ArenaAllocator* aa){
     vulkanizer->aa = aa;
     vulkanizer->device = deviceIN;
-    vulkanizer->descriptorPool = descriptorPoolIN;
+    if(!Vulkanizer_add_descriptor_pool(vulkanizer)) return false;
 
     if(vkCreateSampler(vulkanizer->device, &(VkSamplerCreateInfo){
         .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
@@ -267,6 +586,24 @@ bool Vulkanizer_init(VkDevice deviceIN, VkDescriptorPool descriptorPoolIN, size_
         .maxLod = VK_LOD_CLAMP_NONE,
     }, NULL, &vulkanizer->samplerLinear) != VK_SUCCESS) return false;
 
+    if(vkCreatePipelineCache(vulkanizer->device, &(VkPipelineCacheCreateInfo){
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+    }, NULL, &vulkanizer->pipelineCache) != VK_SUCCESS) return false;
+
+    // timing is optional, without timestamp support stats only report estimated traffic
+    if(physicalDeviceLimits.timestampComputeAndGraphics && physicalDeviceLimits.timestampPeriod > 0){
+        if(vkCreateQueryPool(vulkanizer->device, &(VkQueryPoolCreateInfo){
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = VULKANIZER_MAX_TIMESTAMPS,
+        }, NULL, &vulkanizer->timestampPool) != VK_SUCCESS) vulkanizer->timestampPool = NULL;
+    }
+
+    if(!thread_pool_init(&vulkanizer->threadPool, 0, Vulkanizer_worker_exit, NULL)){
+        fprintf(stderr, "Couldn't initialize thread pool\n");
+        return false;
+    }
+
     const char* vertexShaderSrc = 
         "#version 450\n"
         "layout(location = 0) out vec2 uv;\n"
@@ -308,6 +645,22 @@ bool Vulkanizer_init(VkDevice deviceIN, VkDescriptorPool descriptorPoolIN, size_
         return false;
     }
 
+    // vfx parameter blocks, bound with a different dynamic offset for every pass
+    if(vkCreateDescriptorSetLayout(vulkanizer->device, &(VkDescriptorSetLayoutCreateInfo){
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &(VkDescriptorSetLayoutBinding){
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+    }, NULL, &vulkanizer->paramsDescriptorSetLayout) != VK_SUCCESS){
+        printf("ERROR: Couldn't create parameters descriptor set layout\n");
+        return false;
+    }
+    vulkanizer->paramsAlignment = physicalDeviceLimits.minStorageBufferOffsetAlignment;
+
     VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
     if(!vkCreateGraphicPipeline(
         vulkanizer->vertexShader,fragmentShader, 
@@ -316,35 +669,140 @@ bool Vulkanizer_init(VkDevice deviceIN, VkDescriptorPool descriptorPoolIN, size_
         colorFormat,
         .descriptorSetLayoutCount = 1,
         .descriptorSetLayouts = &vulkanizer->vfxDescriptorSetLayout,
+        .pipelineCache = vulkanizer->pipelineCache,
     )) return false;
 
+    // all working formats are mandatory color attachment and linear filtered formats so no support query is needed
+    vulkanizer->workingPipelines[VFX_WORKING_FORMAT_RGBA8] = vulkanizer->defaultPipeline;
+    vulkanizer->workingPipelineLayouts[VFX_WORKING_FORMAT_RGBA8] = vulkanizer->defaultPipelineLayout;
+    for(size_t i = 0; i < VFX_WORKING_FORMAT_COUNT; i++){
+        if(workingFormats[i] == colorFormat) continue;
+        if(!vkCreateGraphicPipeline(
+            vulkanizer->vertexShader,fragmentShader, 
+            &vulkanizer->workingPipelines[i], 
+            &vulkanizer->workingPipelineLayouts[i],
+            workingFormats[i],
+            .descriptorSetLayoutCount = 1,
+            .descriptorSetLayouts = &vulkanizer->vfxDescriptorSetLayout,
+            .pipelineCache = vulkanizer->pipelineCache,
+        )) return false;
+    }
+
     vulkanizer->videoOutWidth = outWidth;
     vulkanizer->videoOutHeight = outHeight;
     
     return true;
 }
 
-bool Vulkanizer_init_image_for_media(Vulkanizer* vulkanizer, size_t width, size_t height, VkImage* imageOut, VkDeviceMemory* imageMemoryOut, VkImageView* imageViewOut, size_t* imageStrideOut, VkDescriptorSet* descriptorSetOut, void* imageDataOut){
-    if(!createMyImage(vulkanizer->device, imageOut,
-        width, 
-        height, 
-        imageMemoryOut, imageViewOut, 
-        imageStrideOut, 
-        imageDataOut,
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    )) return false;
+bool Vulkanizer_init_cpu(size_t outWidth, size_t outHeight, Vulkanizer* vulkanizer, ArenaAllocator* aa){
+    vulkanizer->aa = aa;
+    vulkanizer->cpu = true;
+    vulkanizer->videoOutWidth = outWidth;
+    vulkanizer->videoOutHeight = outHeight;
 
-    VkCommandBuffer tempCmd = vkCmdBeginSingleTime();
-    vkCmdTransitionImage(tempCmd, *imageOut, VK_IMAGE_LAYOUT_UNDEFINED,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
-    vkCmdEndSingleTime(tempCmd);
-    
-    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {0};
-    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptorSetAllocateInfo.descriptorPool = vulkanizer->descriptorPool;
-    descriptorSetAllocateInfo.descriptorSetCount = 1;
-    descriptorSetAllocateInfo.pSetLayouts = &vulkanizer->vfxDescriptorSetLayout;
-    if(vkAllocateDescriptorSets(vulkanizer->device, &descriptorSetAllocateInfo, descriptorSetOut) != VK_SUCCESS) return false;
+    if(!thread_pool_init(&vulkanizer->threadPool, 0, Vulkanizer_worker_exit, NULL)){
+        fprintf(stderr, "Couldn't initialize thread pool\n");
+        return false;
+    }
+
+    if(!CpuCompositor_init(&vulkanizer->cpuCompositor, outWidth, outHeight, &vulkanizer->threadPool)){
+        fprintf(stderr, "Couldn't initialize cpu compositor\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void cmdTransitionMips(VkCommandBuffer cmd, VkImage image, uint32_t baseMip, uint32_t mipCount, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage){
+    vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, NULL, 0, NULL, 1, &(VkImageMemoryBarrier){
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = srcAccess,
+        .dstAccessMask = dstAccess,
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = baseMip,
+            .levelCount = mipCount,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    });
+}
+
+// expects every mip level in TRANSFER_DST_OPTIMAL with level 0 filled, leaves all of them in SHADER_READ_ONLY_OPTIMAL
+// R8G8B8A8_UNORM optimal tiling is required by spec to support linear blits so no format query is needed
+static void cmdGenerateMips(VkCommandBuffer cmd, VkImage image, size_t width, size_t height, uint32_t mipLevels){
+    int32_t mipWidth = width;
+    int32_t mipHeight = height;
+    for(uint32_t i = 1; i < mipLevels; i++){
+        cmdTransitionMips(cmd, image, i - 1, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        int32_t nextWidth = mipWidth > 1 ? mipWidth / 2 : 1;
+        int32_t nextHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+        vkCmdBlitImage(cmd,
+            image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &(VkImageBlit){
+                .srcSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = i - 1, .layerCount = 1},
+                .srcOffsets = {{0, 0, 0}, {mipWidth, mipHeight, 1}},
+                .dstSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = i, .layerCount = 1},
+                .dstOffsets = {{0, 0, 0}, {nextWidth, nextHeight, 1}},
+            },
+            VK_FILTER_LINEAR);
+
+        cmdTransitionMips(cmd, image, i - 1, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+        mipWidth = nextWidth;
+        mipHeight = nextHeight;
+    }
+
+    cmdTransitionMips(cmd, image, mipLevels - 1, 1,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+// release on transfer queue and matching acquire on graphics one for mip level in TRANSFER_DST_OPTIMAL,
+// plain memory dependency is enough when both are the same family since batches are ordered by semaphore
+static void cmdTransferMipOwnership(VkCommandBuffer transferCmd, VkCommandBuffer graphicsCmd, VkImage image, uint32_t mip){
+    if(transferQueueFamily == graphicsQueueFamily) return;
+
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = 0,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = transferQueueFamily,
+        .dstQueueFamilyIndex = graphicsQueueFamily,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = mip,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+    vkCmdPipelineBarrier(transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(graphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+static bool allocate_media_descriptor_set(Vulkanizer* vulkanizer, VkImageView imageView, VkDescriptorSet* descriptorSetOut, VkDescriptorPool* descriptorPoolOut){
+    if(!Vulkanizer_allocate_descriptor_set(vulkanizer, descriptorSetOut, descriptorPoolOut)) return false;
 
     {
         VkDescriptorImageInfo descriptorImageInfo = {0};
@@ -352,7 +810,7 @@ bool Vulkanizer_init_image_for_media(Vulkanizer* vulkanizer, size_t width, size_
 
         descriptorImageInfo.sampler = vulkanizer->samplerLinear;
         descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        descriptorImageInfo.imageView = *imageViewOut;
+        descriptorImageInfo.imageView = imageView;
 
         writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         writeDescriptorSet.descriptorCount = 1;
@@ -367,17 +825,149 @@ bool Vulkanizer_init_image_for_media(Vulkanizer* vulkanizer, size_t width, size_
     return true;
 }
 
-void Vulkanizer_reset_pool(){
-    VulkanizerImagesOutPool_reset(&vulkanizerImagesOutPool);
+bool Vulkanizer_init_image_for_media(Vulkanizer* vulkanizer, size_t width, size_t height, VkImage* imageOut, VkDeviceMemory* imageMemoryOut, VkImageView* imageViewOut, size_t* imageStrideOut, VkDescriptorSet* descriptorSetOut, VkDescriptorPool* descriptorPoolOut, void* imageDataOut, VulkanizerMediaMips* mipsOut){
+    *mipsOut = (VulkanizerMediaMips){0};
+
+    // cpu compositor reads decoded frames directly
+    if(vulkanizer->cpu){
+        *(void**)imageDataOut = NULL;
+        *imageStrideOut = 0;
+        return true;
+    }
+
+    if(width <= vulkanizer->videoOutWidth && height <= vulkanizer->videoOutHeight){
+        if(!createMyImage(vulkanizer->device, imageOut,
+            width, 
+            height, 
+            imageMemoryOut, imageViewOut, 
+            imageStrideOut, 
+            imageDataOut,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        )) return false;
+
+        VkCommandBuffer batchCmd = vkGetBatchGraphicsCmd();
+        if(batchCmd == NULL) return false;
+        vkCmdTransitionImage(batchCmd, *imageOut, VK_IMAGE_LAYOUT_UNDEFINED,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+
+        return allocate_media_descriptor_set(vulkanizer, *imageViewOut, descriptorSetOut, descriptorPoolOut);
+    }
+
+    // only downscaled media pays for mip generation, levels below output size are what the sampler picks
+    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    uint32_t mipLevels = vkGetMipLevelsCount(width, height);
+    VkDeviceSize size = width*height*sizeof(uint32_t);
+
+    if(!vkCreateImageMipsEX(vulkanizer->device, width, height, mipLevels, format, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageOut, imageMemoryOut)){
+        printf("Couldn't create image\n");
+        return false;
+    }
+
+    if(!vkCreateImageViewMipsEX(vulkanizer->device, *imageOut, format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, imageViewOut)){
+        printf("Couldn't create image view\n");
+        return false;
+    }
+
+    if(!vkCreateBufferEX(vulkanizer->device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            size, &mipsOut->stagingBuffer, &mipsOut->stagingMemory)) return false;
+
+    if(vkMapMemory(vulkanizer->device, mipsOut->stagingMemory, 0, size, 0, (void**)imageDataOut) != VK_SUCCESS) return false;
+    *imageStrideOut = width*sizeof(uint32_t);
+
+    mipsOut->image = *imageOut;
+    mipsOut->width = width;
+    mipsOut->height = height;
+    mipsOut->mipLevels = mipLevels;
+
+    VkCommandBuffer batchCmd = vkGetBatchGraphicsCmd();
+    if(batchCmd == NULL) return false;
+    cmdTransitionMips(batchCmd, *imageOut, 0, mipLevels,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        0, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    return allocate_media_descriptor_set(vulkanizer, *imageViewOut, descriptorSetOut, descriptorPoolOut);
 }
 
-bool Vulkanizer_apply_vfx_on_frame_and_compose(VkCommandBuffer cmd, Vulkanizer* vulkanizer, VulkanizerVfxInstances* vfxInstances, VkImageView videoInView, void* videoInData, size_t videoInStride, VkDescriptorSet videoInDescriptorSet, Frame* frameIn, VkImageView composedOutView){
-    if(frameIn->type != FRAME_TYPE_VIDEO) return false;
+bool Vulkanizer_init_immutable_image_for_media(Vulkanizer* vulkanizer, VideoFrame* frame, VkImage* imageOut, VkDeviceMemory* imageMemoryOut, VkImageView* imageViewOut, VkDescriptorSet* descriptorSetOut, VkDescriptorPool* descriptorPoolOut){
+    if(vulkanizer->cpu) return true;
 
-    VulkanizerImagesOut* usedImages = VulkanizerImagesOutPool_get_avaliable(vulkanizer, &vulkanizerImagesOutPool);
-    if(usedImages == NULL) return false;
+    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    uint32_t mipLevels = vkGetMipLevelsCount(frame->width, frame->height);
+    VkDeviceSize size = frame->width*frame->height*sizeof(uint32_t);
 
-    for(int i = 0; i < frameIn->video.height; i++){
+    if(!vkCreateImageMipsEX(vulkanizer->device, frame->width, frame->height, mipLevels, format, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageOut, imageMemoryOut)){
+        printf("Couldn't create image\n");
+        return false;
+    }
+
+    if(!vkCreateImageViewMipsEX(vulkanizer->device, *imageOut, format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, imageViewOut)){
+        printf("Couldn't create image view\n");
+        return false;
+    }
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    if(!vkCreateBufferEX(vulkanizer->device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            size, &stagingBuffer, &stagingMemory)) return false;
+
+    void* stagingMapped;
+    if(vkMapMemory(vulkanizer->device, stagingMemory, 0, size, 0, &stagingMapped) != VK_SUCCESS){
+        vkDestroyBuffer(vulkanizer->device, stagingBuffer, NULL);
+        vkFreeMemory(vulkanizer->device, stagingMemory, NULL);
+        return false;
+    }
+    memcpy(stagingMapped, frame->data, size);
+    vkUnmapMemory(vulkanizer->device, stagingMemory);
+    fa_push(&vulkanizer->pendingStagings, ((VulkanizerStaging){.buffer = stagingBuffer, .memory = stagingMemory}));
+
+    VkCommandBuffer transferCmd = vkGetBatchTransferCmd();
+    VkCommandBuffer graphicsCmd = vkGetBatchGraphicsCmd();
+    if(transferCmd == NULL || graphicsCmd == NULL) return false;
+
+    // copy runs on transfer queue, blits for mips need graphics one
+    cmdTransitionMips(transferCmd, *imageOut, 0, 1,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    vkCmdCopyBufferToImage(transferCmd, stagingBuffer, *imageOut, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &(VkBufferImageCopy){
+        .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .layerCount = 1},
+        .imageExtent = {.width = frame->width, .height = frame->height, .depth = 1},
+    });
+    cmdTransferMipOwnership(transferCmd, graphicsCmd, *imageOut, 0);
+
+    if(mipLevels > 1){
+        cmdTransitionMips(graphicsCmd, *imageOut, 1, mipLevels - 1,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            0, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    }
+    cmdGenerateMips(graphicsCmd, *imageOut, frame->width, frame->height, mipLevels);
+
+    return allocate_media_descriptor_set(vulkanizer, *imageViewOut, descriptorSetOut, descriptorPoolOut);
+}
+
+bool Vulkanizer_flush_media_uploads(Vulkanizer* vulkanizer){
+    if(vulkanizer->cpu) return true;
+
+    bool ok = vkWaitTimelinePoint(vkSubmitBatch());
+    for(size_t i = 0; i < vulkanizer->pendingStagings.count; i++){
+        vkDestroyBuffer(vulkanizer->device, vulkanizer->pendingStagings.items[i].buffer, NULL);
+        vkFreeMemory(vulkanizer->device, vulkanizer->pendingStagings.items[i].memory, NULL);
+    }
+    vulkanizer->pendingStagings.count = 0;
+    return ok;
+}
+
+// uploads frame and runs whole vfx chain, returned target is acquired and in SHADER_READ_ONLY_OPTIMAL
+static VulkanizerTarget* Vulkanizer_render_layer(VkCommandBuffer cmd, Vulkanizer* vulkanizer, VulkanizerVfxInstances* vfxInstances, void* videoInData, size_t videoInStride, VulkanizerMediaMips* videoInMips, VkDescriptorSet videoInDescriptorSet, Frame* frameIn){
+    for(int i = 0; videoInData != NULL && i < frameIn->video.height; i++){
         memcpy(
             (uint8_t*)videoInData + videoInStride*i,
             (uint8_t*)frameIn->video.data + frameIn->video.width*sizeof(uint32_t)*i,
@@ -385,16 +975,28 @@ bool Vulkanizer_apply_vfx_on_frame_and_compose(VkCommandBuffer cmd, Vulkanizer*
         );
     }
 
-    vkCmdTransitionImage(
-        cmd, usedImages->currentImage == 0 ? usedImages->image1 : usedImages->image2, 
-        VK_IMAGE_LAYOUT_GENERAL, 
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 
-        VK_IMAGE_ASPECT_COLOR_BIT
-    );
+    if(videoInData != NULL && videoInMips != NULL && videoInMips->mipLevels > 0){
+        cmdTransitionMips(cmd, videoInMips->image, 0, videoInMips->mipLevels,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        vkCmdCopyBufferToImage(cmd, videoInMips->stagingBuffer, videoInMips->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &(VkBufferImageCopy){
+            .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .layerCount = 1},
+            .imageExtent = {.width = videoInMips->width, .height = videoInMips->height, .depth = 1},
+        });
+        cmdGenerateMips(cmd, videoInMips->image, videoInMips->width, videoInMips->height, videoInMips->mipLevels);
+    }
+
+    VfxWorkingFormat workingFormat = vulkanizer->workingFormat < VFX_WORKING_FORMAT_COUNT ? vulkanizer->workingFormat : VFX_WORKING_FORMAT_RGBA8;
+    VkFormat targetFormat = workingFormats[workingFormat];
+    size_t pixelSize = formatPixelSize(targetFormat);
+    VulkanizerTarget* current = Vulkanizer_acquire_target(cmd, vulkanizer, vulkanizer->videoOutWidth, vulkanizer->videoOutHeight, targetFormat);
+    if(current == NULL) return NULL;
 
     {
+        Vulkanizer_flush_barriers(cmd, vulkanizer);
         vkCmdBeginRenderingEX(cmd,
-            .colorAttachment = usedImages->currentImage == 0 ? usedImages->imageView1 : usedImages->imageView2,
+            .colorAttachment = current->view,
             .clearColor = COL_EMPTY,
             .renderArea = (
                 (VkExtent2D){.width = vulkanizer->videoOutWidth, .height= vulkanizer->videoOutHeight}
@@ -410,66 +1012,213 @@ bool Vulkanizer_apply_vfx_on_frame_and_compose(VkCommandBuffer cmd, Vulkanizer*
             .extent = (VkExtent2D){.width = vulkanizer->videoOutWidth, .height = vulkanizer->videoOutHeight},
         });
 
-        vkCmdBindPipeline(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanizer->defaultPipeline);
-        vkCmdBindDescriptorSets(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,vulkanizer->defaultPipelineLayout,0,1,&videoInDescriptorSet,0,NULL);
+        vkCmdBindPipeline(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanizer->workingPipelines[workingFormat]);
+        vkCmdBindDescriptorSets(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,vulkanizer->workingPipelineLayouts[workingFormat],0,1,&videoInDescriptorSet,0,NULL);
         vkCmdDraw(cmd, 6, 1, 0, 0);
         vkCmdEndRendering(cmd);
+
+        VulkanizerFormatStats* formatStats = &vulkanizer->targetStats.formats[workingFormat];
+        formatStats->passes++;
+        formatStats->passBytes += current->width*current->height*(pixelSize + sizeof(uint32_t));
     }
 
     for(size_t i = 0; i < vfxInstances->count; i++){
         VulkanizerVfxInstance* vfx = &vfxInstances->items[i];
         if(vfx->push_constants_data != NULL && vfx->push_constants_size != vfx->vfx->module->pushContantsSize){
             fprintf(stderr, "%zu %s Invalid push contants size expected %zu got %zu\n", i, vfx->vfx->module->name, vfx->vfx->module->pushContantsSize, vfx->push_constants_size);
-            return false;
+            Vulkanizer_release_target(vulkanizer, current);
+            return NULL;
         }
 
+        VulkanizerTarget_transition(cmd, vulkanizer, current, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-        vkCmdTransitionImage(
-            cmd, usedImages->currentImage == 0 ? usedImages->image1 : usedImages->image2, 
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
-            VK_IMAGE_ASPECT_COLOR_BIT
-        );
+        // reduced passes just render into a smaller target, the next pass or compositing upsamples it through the linear sampler
+        float renderScale = vfx->renderScale > 0.0f && vfx->renderScale < 1.0f ? vfx->renderScale : 1.0f;
+        size_t passWidth = (size_t)(vulkanizer->videoOutWidth*renderScale + 0.5f);
+        size_t passHeight = (size_t)(vulkanizer->videoOutHeight*renderScale + 0.5f);
+        if(passWidth == 0) passWidth = 1;
+        if(passHeight == 0) passHeight = 1;
 
-        vkCmdTransitionImage(
-            cmd, usedImages->currentImage == 1 ? usedImages->image1 : usedImages->image2, 
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 
-            VK_IMAGE_ASPECT_COLOR_BIT
-        );
+        VulkanizerTarget* next = Vulkanizer_acquire_target(cmd, vulkanizer, passWidth, passHeight, targetFormat);
+        if(next == NULL){
+            Vulkanizer_release_target(vulkanizer, current);
+            return NULL;
+        }
+
+        // input becoming readable and output becoming writable share one barrier
+        Vulkanizer_flush_barriers(cmd, vulkanizer);
 
-        if(!applyShadersOnFrame(
+        bool applied = applyShadersOnFrame(
                 cmd,
+                vulkanizer,
                 frameIn->video.width,
                 frameIn->video.height,
-                vulkanizer->videoOutWidth,
-                vulkanizer->videoOutHeight,
+                passWidth,
+                passHeight,
                 vfx->push_constants_data,
                 vfx->push_constants_size,
 
-                usedImages->currentImage == 0 ? &usedImages->descriptorSet1 : &usedImages->descriptorSet2,
-                usedImages->currentImage == 1 ? usedImages->imageView1 : usedImages->imageView2,
+                &current->descriptorSet,
+                next->view,
                 vfx->vfx
-            )) return false;
-        
-        usedImages->currentImage = 1 - usedImages->currentImage;
+            );
+
+        VulkanizerFormatStats* formatStats = &vulkanizer->targetStats.formats[workingFormat];
+        formatStats->passes++;
+        formatStats->passBytes += next->width*next->height*pixelSize + current->width*current->height*pixelSize;
+
+        Vulkanizer_release_target(vulkanizer, current);
+        current = next;
+        if(!applied){
+            Vulkanizer_release_target(vulkanizer, current);
+            return NULL;
+        }
+    }
+
+    VulkanizerTarget_transition(cmd, vulkanizer, current, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    Vulkanizer_flush_barriers(cmd, vulkanizer);
+
+    return current;
+}
+
+// output pixels layer can cover after its vfx chain, worked out from Bounds metadata of every vfx.
+// returns false when nothing of the layer is visible
+static bool Vulkanizer_layer_rect(Vulkanizer* vulkanizer, VulkanizerVfxInstances* vfxInstances, Frame* frameIn, size_t rectOut[4]){
+    // default pass stretches media over whole output, box is in uv space
+    float x0 = 0.0f, y0 = 0.0f, x1 = 1.0f, y1 = 1.0f;
+
+    for(size_t i = 0; i < vfxInstances->count; i++){
+        VulkanizerVfxInstance* vfx = &vfxInstances->items[i];
+        VfxBounds* bounds = &vfx->vfx->module->bounds;
+        switch(bounds->kind){
+            case VFX_BOUNDS_INSIDE:
+                break;
+            case VFX_BOUNDS_FIT: {
+                if(frameIn->video.width == 0 || frameIn->video.height == 0) break;
+                float renderAspect = (float)vulkanizer->videoOutWidth / vulkanizer->videoOutHeight;
+                float mediaAspect = (float)frameIn->video.width / frameIn->video.height;
+                float fx = mediaAspect > renderAspect ? 1.0f : mediaAspect / renderAspect;
+                float fy = mediaAspect > renderAspect ? renderAspect / mediaAspect : 1.0f;
+                // shader samples at (centered / f + 1) / 2
+                x0 = ((x0*2.0f - 1.0f)*fx + 1.0f)*0.5f;
+                x1 = ((x1*2.0f - 1.0f)*fx + 1.0f)*0.5f;
+                y0 = ((y0*2.0f - 1.0f)*fy + 1.0f)*0.5f;
+                y1 = ((y1*2.0f - 1.0f)*fy + 1.0f)*0.5f;
+                break;
+            }
+            case VFX_BOUNDS_TRANSLATE: {
+                if(vfx->push_constants_data == NULL){
+                    x0 = 0.0f; y0 = 0.0f; x1 = 1.0f; y1 = 1.0f;
+                    break;
+                }
+                float offset[2];
+                float scale[2];
+                memcpy(offset, (const uint8_t*)vfx->push_constants_data + bounds->offsetInput, sizeof(offset));
+                memcpy(scale, (const uint8_t*)vfx->push_constants_data + bounds->scaleInput, sizeof(scale));
+                // shader samples at (uv - 0.5) / scale + 0.5 + vec2(-offset.x, offset.y)
+                float ax = (x0 - 0.5f + offset[0])*scale[0] + 0.5f;
+                float bx = (x1 - 0.5f + offset[0])*scale[0] + 0.5f;
+                float ay = (y0 - 0.5f - offset[1])*scale[1] + 0.5f;
+                float by = (y1 - 0.5f - offset[1])*scale[1] + 0.5f;
+                x0 = fminf(ax, bx); x1 = fmaxf(ax, bx);
+                y0 = fminf(ay, by); y1 = fmaxf(ay, by);
+                break;
+            }
+            default:
+                x0 = 0.0f; y0 = 0.0f; x1 = 1.0f; y1 = 1.0f;
+                break;
+        }
+
+        x0 = fmaxf(x0, 0.0f); y0 = fmaxf(y0, 0.0f);
+        x1 = fminf(x1, 1.0f); y1 = fminf(y1, 1.0f);
+        if(!(x0 < x1 && y0 < y1)) return false;
+    }
+
+    // one pixel of padding for linear filtering bleeding over edges
+    float width = (float)vulkanizer->videoOutWidth;
+    float height = (float)vulkanizer->videoOutHeight;
+    float left = fmaxf(floorf(x0*width) - 1.0f, 0.0f);
+    float top = fmaxf(floorf(y0*height) - 1.0f, 0.0f);
+    float right = fminf(ceilf(x1*width) + 1.0f, width);
+    float bottom = fminf(ceilf(y1*height) + 1.0f, height);
+    if(!(left < right && top < bottom)) return false;
+
+    rectOut[0] = (size_t)left;
+    rectOut[1] = (size_t)top;
+    rectOut[2] = (size_t)(right - left);
+    rectOut[3] = (size_t)(bottom - top);
+    return true;
+}
+
+// every pass runs at full output resolution in RGBA8, renderScale and working format only apply on gpu
+static bool Vulkanizer_cpu_compose(Vulkanizer* vulkanizer, VulkanizerVfxInstances* vfxInstances, Frame* frameIn, size_t composeRect[4]){
+    CpuCompositor* compositor = &vulkanizer->cpuCompositor;
+    compositor->passes.count = 0;
+    for(size_t i = 0; i < vfxInstances->count; i++){
+        VulkanizerVfxInstance* vfx = &vfxInstances->items[i];
+        fa_push(&compositor->passes, ((CpuVfxPass){
+            .kind = vfx->vfx->cpuVfx,
+            .push_constants_data = vfx->push_constants_data,
+            .push_constants_size = vfx->vfx->module->pushContantsSize,
+            .program = vfx->vfx->cpuProgram,
+        }));
+    }
+    return CpuCompositor_compose_layer(compositor, &frameIn->video, (CpuRect){
+        .x = composeRect[0],
+        .y = composeRect[1],
+        .width = composeRect[2],
+        .height = composeRect[3],
+    });
+}
+
+static bool Vulkanizer_record_layer(VkCommandBuffer cmd, Vulkanizer* vulkanizer, VulkanizerVfxInstances* vfxInstances, VkImageView videoInView, void* videoInData, size_t videoInStride, VulkanizerMediaMips* videoInMips, VkDescriptorSet videoInDescriptorSet, Frame* frameIn, int64_t frameId, VulkanizerLayerCache* layerCache, VkImageView composedOutView){
+    if(frameIn->type != FRAME_TYPE_VIDEO) return false;
+
+    // layer moved off screen or scaled to nothing has no pixels to draw
+    size_t composeRect[4];
+    if(!Vulkanizer_layer_rect(vulkanizer, vfxInstances, frameIn, composeRect)) return true;
+
+    if(vulkanizer->cpu){
+        if(layerCache != NULL) layerCache->misses++;
+        return Vulkanizer_cpu_compose(vulkanizer, vfxInstances, frameIn, composeRect);
+    }
+
+    uint64_t hash = 0;
+    VulkanizerTarget* current = NULL;
+    if(layerCache != NULL){
+        hash = Vulkanizer_layer_hash(vulkanizer, vfxInstances, videoInView, frameIn, frameId);
+        if(layerCache->target != NULL && layerCache->hash == hash){
+            current = layerCache->target;
+            layerCache->hits++;
+        }else{
+            layerCache->misses++;
+            Vulkanizer_layer_cache_release(vulkanizer, layerCache);
+        }
+    }
+
+    if(current == NULL){
+        current = Vulkanizer_render_layer(cmd, vulkanizer, vfxInstances, videoInData, videoInStride, videoInMips, videoInDescriptorSet, frameIn);
+        if(current == NULL){
+            // recorded layouts have to match what the gpu sees even when the chain bailed out midway
+            Vulkanizer_flush_barriers(cmd, vulkanizer);
+            return false;
+        }
     }
 
     //compositing
-    vkCmdTransitionImage(
-        cmd, usedImages->currentImage == 0 ? usedImages->image1 : usedImages->image2, 
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
-        VK_IMAGE_ASPECT_COLOR_BIT
-    );
 
     {
+        // viewport stays full so uv matches the vfx chain, only covered part of the layer gets blended
+        VkRect2D scissor = {
+            .offset = {.x = (int32_t)composeRect[0], .y = (int32_t)composeRect[1]},
+            .extent = {.width = (uint32_t)composeRect[2], .height = (uint32_t)composeRect[3]},
+        };
+
         vkCmdBeginRenderingEX(cmd,
             .colorAttachment = composedOutView,
             .clearBackground = false,
-            .renderArea = (
-                (VkExtent2D){.width = vulkanizer->videoOutWidth, .height= vulkanizer->videoOutHeight}
-            )
+            .renderOffset = scissor.offset,
+            .renderArea = scissor.extent
         );
 
         vkCmdSetViewport(cmd, 0, 1, &(VkViewport){
@@ -477,53 +1226,174 @@ bool Vulkanizer_apply_vfx_on_frame_and_compose(VkCommandBuffer cmd, Vulkanizer*
             .height = vulkanizer->videoOutHeight
         });
             
-        vkCmdSetScissor(cmd, 0, 1, &(VkRect2D){
-            .extent = (VkExtent2D){.width = vulkanizer->videoOutWidth, .height = vulkanizer->videoOutHeight},
-        });
+        vkCmdSetScissor(cmd, 0, 1, &scissor);
 
         vkCmdBindPipeline(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS, vulkanizer->defaultPipeline);
-        vkCmdBindDescriptorSets(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,vulkanizer->defaultPipelineLayout,0,1,usedImages->currentImage == 0 ? &usedImages->descriptorSet1 : &usedImages->descriptorSet2,0,NULL);
+        vkCmdBindDescriptorSets(cmd,VK_PIPELINE_BIND_POINT_GRAPHICS,vulkanizer->defaultPipelineLayout,0,1,&current->descriptorSet,0,NULL);
         vkCmdDraw(cmd, 6, 1, 0, 0);
         vkCmdEndRendering(cmd);
+
+        // blending reads and writes 8 bit output on top of sampling intermediate
+        VulkanizerFormatStats* formatStats = &vulkanizer->targetStats.formats[Vulkanizer_stats_format(vulkanizer)];
+        formatStats->passes++;
+        double covered = (double)(composeRect[2]*composeRect[3]) / (double)(vulkanizer->videoOutWidth*vulkanizer->videoOutHeight);
+        formatStats->passBytes += (size_t)(covered*(current->width*current->height*formatPixelSize(current->format) + vulkanizer->videoOutWidth*vulkanizer->videoOutHeight*sizeof(uint32_t)*2));
     }
 
-    vkCmdTransitionImage(
-        cmd, usedImages->currentImage == 0 ? usedImages->image1 : usedImages->image2, 
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
-        VK_IMAGE_LAYOUT_GENERAL, 
-        VK_IMAGE_ASPECT_COLOR_BIT
-    );
+    if(layerCache == NULL){
+        Vulkanizer_release_target(vulkanizer, current);
+        return true;
+    }
+
+    // keeping result around, it stays counted as live until the cache lets go of it
+    if(layerCache->target != current){
+        current->inUse = false;
+        current->pinned = true;
+        layerCache->target = current;
+        layerCache->hash = hash;
+    }
+    current->lastUsedFrame = vulkanizer->frameIndex;
 
     return true;
 }
 
-bool Vulkanizer_init_vfx(Vulkanizer* vulkanizer, VfxModule* module, VulkanizerVfx* outVfx){
-    outVfx->module = module;
+bool Vulkanizer_apply_vfx_on_frame_and_compose(VkCommandBuffer cmd, Vulkanizer* vulkanizer, VulkanizerVfxInstances* vfxInstances, VkImageView videoInView, void* videoInData, size_t videoInStride, VulkanizerMediaMips* videoInMips, VkDescriptorSet videoInDescriptorSet, Frame* frameIn, int64_t frameId, VulkanizerLayerCache* layerCache, VkImageView composedOutView){
+    // layer is bracketed by timestamps, summed up per frame once it's done
+    bool timed = !vulkanizer->cpu && vulkanizer->timestampPool != NULL && vulkanizer->timestampsWritten + 2 <= VULKANIZER_MAX_TIMESTAMPS;
+    if(timed){
+        if(vulkanizer->timestampsWritten == 0){
+            vkCmdResetQueryPool(cmd, vulkanizer->timestampPool, 0, VULKANIZER_MAX_TIMESTAMPS);
+            vulkanizer->timestampsFormat = Vulkanizer_stats_format(vulkanizer);
+        }
+        vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, vulkanizer->timestampPool, vulkanizer->timestampsWritten++);
+    }
+    bool recorded = Vulkanizer_record_layer(cmd, vulkanizer, vfxInstances, videoInView, videoInData, videoInStride, videoInMips, videoInDescriptorSet, frameIn, frameId, layerCache, composedOutView);
+    if(timed) vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, vulkanizer->timestampPool, vulkanizer->timestampsWritten++);
+    return recorded;
+}
+
+typedef struct{
+    Vulkanizer* vulkanizer;
+    VulkanizerVfx* vfx;
+    bool ok;
+} VulkanizerVfxJob;
+
+static void Vulkanizer_count_push_constants(VfxModule* module){
+    module->pushContantsSize = 0;
+    for(VfxInput* input = module->inputs; input != NULL; input = input->next){
+        module->pushContantsSize += get_vfxInputTypeSize(input->type);
+    }
+}
+
+static bool Vulkanizer_compile_vfx_module(VfxModule* module, uint32_t** spirvOut, size_t* spirvSizeOut){
     String_Builder sb = {0};
     if(!read_entire_file(module->filepath, &sb)) return false;
-    if(!preprocessVFXModule(&sb, outVfx->module)) return false;
+    if(!preprocessVFXModule(&sb, module)){
+        sb_free(sb);
+        return false;
+    }
     sb_append_null(&sb);
 
+    bool compiled = vkCompileShaderToSpirv(sb.items, shaderc_fragment_shader, module->filepath, spirvOut, spirvSizeOut);
+    sb_free(sb);
+    return compiled;
+}
+
+static void Vulkanizer_init_vfx_job(void* arg){
+    VulkanizerVfxJob* job = arg;
+    Vulkanizer* vulkanizer = job->vulkanizer;
+    VulkanizerVfx* outVfx = job->vfx;
+    VfxModule* module = outVfx->module;
+    job->ok = false;
+
+    uint32_t* spirv;
+    size_t spirvSize;
+    if(!Vulkanizer_compile_vfx_module(module, &spirv, &spirvSize)) return;
+
     VkShaderModule fragmentShader;
-    if(!vkCompileShader(vulkanizer->device,sb.items,shaderc_fragment_shader,&fragmentShader)) return false;
+    bool compiled = vkCreateShaderModuleFromSpirv(vulkanizer->device, spirv, spirvSize, &fragmentShader);
+    free(spirv);
+    if(!compiled) return;
 
-    for(VfxInput* input = outVfx->module->inputs; input != NULL; input = input->next){
-        outVfx->module->pushContantsSize += get_vfxInputTypeSize(input->type);
-    }
+    Vulkanizer_count_push_constants(module);
 
-    VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    VkFormat colorFormat = Vulkanizer_get_working_format(vulkanizer->workingFormat);
+    VkDescriptorSetLayout setLayouts[] = {vulkanizer->vfxDescriptorSetLayout, vulkanizer->paramsDescriptorSetLayout};
 
-    if(!vkCreateGraphicPipeline(
+    job->ok = vkCreateGraphicPipeline(
         vulkanizer->vertexShader,fragmentShader, 
         &outVfx->pipeline, 
         &outVfx->pipelineLayout,
         colorFormat,
-        .pushConstantsSize = sizeof(float)*4 + outVfx->module->pushContantsSize,
-        .descriptorSetLayoutCount = 1,
-        .descriptorSetLayouts = &vulkanizer->vfxDescriptorSetLayout,
-    )) return false;
+        .descriptorSetLayoutCount = 2,
+        .descriptorSetLayouts = setLayouts,
+        .pipelineCache = vulkanizer->pipelineCache,
+    );
 
     vkDestroyShaderModule(vulkanizer->device, fragmentShader, NULL);
-    sb_free(sb);
-    return true;
-}
\ No newline at end of file
+}
+
+// built in cpu implementation when there is one, otherwise module's spirv gets interpreted
+static void Vulkanizer_init_cpu_vfx_job(void* arg){
+    VulkanizerVfxJob* job = arg;
+    VulkanizerVfx* outVfx = job->vfx;
+    VfxModule* module = outVfx->module;
+
+    Vulkanizer_count_push_constants(module);
+
+    outVfx->cpuVfx = cpu_vfx_kind_from_module(module);
+    if(outVfx->cpuVfx != CPU_VFX_NONE){
+        job->ok = true;
+        return;
+    }
+    job->ok = false;
+
+    uint32_t* spirv;
+    size_t spirvSize;
+    if(!Vulkanizer_compile_vfx_module(module, &spirv, &spirvSize)) return;
+
+    outVfx->cpuProgram = spirv_program_load(spirv, spirvSize, module->filepath);
+    free(spirv);
+    if(outVfx->cpuProgram == NULL) return;
+
+    outVfx->cpuVfx = CPU_VFX_SPIRV;
+    job->ok = true;
+}
+
+bool Vulkanizer_init_vfxs(Vulkanizer* vulkanizer, VulkanizerVfxsRef* vfxs){
+    if(vfxs->count == 0) return true;
+
+    uint64_t startTime = platform_get_time_nanos();
+
+    VulkanizerVfxJob* jobs = calloc(vfxs->count, sizeof(*jobs));
+    if(jobs == NULL) return false;
+
+    for(size_t i = 0; i < vfxs->count; i++){
+        jobs[i] = (VulkanizerVfxJob){.vulkanizer = vulkanizer, .vfx = vfxs->items[i]};
+        thread_pool_push(&vulkanizer->threadPool, vulkanizer->cpu ? Vulkanizer_init_cpu_vfx_job : Vulkanizer_init_vfx_job, &jobs[i]);
+    }
+    thread_pool_wait(&vulkanizer->threadPool);
+
+    bool ok = true;
+    for(size_t i = 0; i < vfxs->count; i++){
+        if(!jobs[i].ok){
+            fprintf(stderr, "Couldn't initialize vfx %s\n", vfxs->items[i]->module->filepath);
+            ok = false;
+        }
+    }
+    free(jobs);
+
+    if(ok) printf("[FVFX] Compiled %zu vfx modules in %.2fms\n", vfxs->count, (double)(platform_get_time_nanos() - startTime) / 1e6);
+
+    return ok;
+}
+
+bool Vulkanizer_init_vfx(Vulkanizer* vulkanizer, VfxModule* module, VulkanizerVfx* outVfx){
+    outVfx->module = module;
+    VulkanizerVfxsRef vfxs = {
+        .items = &outVfx,
+        .count = 1,
+        .capacity = 1,
+    };
+    return Vulkanizer_init_vfxs(vulkanizer, &vfxs);
+}
@@ -6,11 +6,15 @@
 #include <stddef.h>
 #include "shader_utils.h"
 #include "arena_alloc.h"
+#include "thread_pool.h"
+#include "cpu_compositor.h"
 
 typedef struct{
     VfxModule* module;
     VkPipeline pipeline;
     VkPipelineLayout pipelineLayout;
+    CpuVfxKind cpuVfx; // implementation used when vulkanizer runs on cpu
+    SpirvProgram* cpuProgram; // interpreted when cpuVfx is CPU_VFX_SPIRV
 } VulkanizerVfx;
 
 typedef struct{
@@ -19,25 +23,153 @@ typedef struct{
     size_t capacity;
 } VulkanizerVfxsRef;
 
+// intermediate render target used by vfx passes, only valid within a single frame
+typedef struct{
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    VkDescriptorSet descriptorSet;
+    VkDescriptorPool descriptorPool;
+    size_t width;
+    size_t height;
+    VkFormat format;
+    VkImageLayout layout;
+    VkDeviceSize size;
+    bool inUse;
+    bool pinned; // held by a layer cache across frames
+    size_t lastUsedFrame;
+} VulkanizerTarget;
+
+typedef struct{
+    VulkanizerTarget** items;
+    size_t count;
+    size_t capacity;
+} VulkanizerTargets;
+
+// what frames rendered in one working format cost, preview hot reload can switch between formats
+typedef struct{
+    size_t frames;
+    size_t passes;                // draws into intermediates and composited output
+    VkDeviceSize passBytes;       // estimated attachment writes plus texture reads of those draws
+    size_t timedFrames;           // frames whose layer passes got measured with gpu timestamps
+    uint64_t gpuNanos;            // measured time of layer passes in those frames
+} VulkanizerFormatStats;
+
+typedef struct{
+    VkDeviceSize liveBytes;       // bytes of targets acquired right now
+    VkDeviceSize peakLiveBytes;   // highest liveBytes seen within any frame
+    VkDeviceSize allocatedBytes;  // bytes of all targets currently backed by memory
+    VkDeviceSize peakAllocatedBytes;
+    size_t targetsCreated;
+    size_t targetsDestroyed;
+    size_t barriers;              // pipeline barriers emitted for intermediate targets
+    size_t transitions;           // image transitions carried by those barriers
+    VulkanizerFormatStats formats[VFX_WORKING_FORMAT_COUNT];
+} VulkanizerTargetStats;
+
+// max timestamps written within a frame, two per layer, layers past that just aren't timed
+#define VULKANIZER_MAX_TIMESTAMPS 256
+
+// max image barriers collected before they have to be flushed
+#define VULKANIZER_MAX_PENDING_BARRIERS 8
+
+// layout transitions between two passes, emitted together as a single barrier
+typedef struct{
+    VkImageMemoryBarrier2 items[VULKANIZER_MAX_PENDING_BARRIERS];
+    size_t count;
+} VulkanizerBarriers;
+
+typedef struct{
+    VkDescriptorPool* items;
+    size_t count;
+    size_t capacity;
+} VulkanizerDescriptorPools;
+
+// parameter blocks (renderArea, mediaArea and module inputs) of every vfx pass recorded within a frame,
+// each pass gets its own slice bound through dynamic offset of set 1
+typedef struct{
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    uint8_t* mapped;
+    VkDeviceSize size;
+    VkDeviceSize used;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+} VulkanizerParamsBuffer;
+
+typedef struct{
+    VulkanizerParamsBuffer* items;
+    size_t count;
+    size_t capacity;
+} VulkanizerParamsBuffers;
+
+// staging memory of uploads recorded into transfer batch, freed once batch completes
+typedef struct{
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+} VulkanizerStaging;
+
+typedef struct{
+    VulkanizerStaging* items;
+    size_t count;
+    size_t capacity;
+} VulkanizerStagings;
+
 typedef struct{
     ArenaAllocator* aa;
     VkDescriptorSetLayout vfxDescriptorSetLayout;
+    VkDescriptorSetLayout paramsDescriptorSetLayout;
     VkSampler samplerLinear;
     VkDevice device;
-    VkDescriptorPool descriptorPool;
+
+    // sets for targets and media, another pool is added once all existing ones are full
+    VulkanizerDescriptorPools descriptorPools;
+    size_t descriptorPoolsCurrent; // pool that served the last allocation
 
     VkShaderModule vertexShader;
     VkPipeline defaultPipeline;
     VkPipelineLayout defaultPipelineLayout;
 
+    // copies media into first intermediate, one per working format since pipelines are tied to attachment format
+    VkPipeline workingPipelines[VFX_WORKING_FORMAT_COUNT];
+    VkPipelineLayout workingPipelineLayouts[VFX_WORKING_FORMAT_COUNT];
+    // vfx pipelines are built for format set at the time they get initialized
+    VfxWorkingFormat workingFormat;
+
+    // kept for the whole lifetime so hot reloads can reuse already built pipelines
+    VkPipelineCache pipelineCache;
+    ThreadPool threadPool;
+
+    // targets are handed out per frame and returned as soon as the pass reading them is recorded
+    // so layers processed one after another end up aliasing the same few images
+    VulkanizerTargets targets;
+    VulkanizerTargetStats targetStats;
+    size_t frameIndex;
+    // brackets every layer recorded in a frame, read back once frame is done, NULL when graphics queue can't write timestamps
+    VkQueryPool timestampPool;
+    uint32_t timestampsWritten;
+    VfxWorkingFormat timestampsFormat;
+    VulkanizerBarriers pendingBarriers;
+
     size_t videoOutWidth;
     size_t videoOutHeight;
+
+    VulkanizerStagings pendingStagings;
+
+    VulkanizerParamsBuffer params;
+    VulkanizerParamsBuffers retiredParams; // outgrown within a frame, gpu may still read them until next reset
+    VkDeviceSize paramsAlignment;
+
+    // set when there is no vulkan device, vfx and compositing run on cpuCompositor and every vulkan handle stays NULL
+    bool cpu;
+    CpuCompositor cpuCompositor;
 } Vulkanizer;
 
 typedef struct {
     VulkanizerVfx* vfx;
     void* push_constants_data;
     size_t push_constants_size;
+    float renderScale; // fraction of output resolution this pass renders at, 0 means full
 } VulkanizerVfxInstance;
 
 typedef struct{
@@ -46,12 +178,47 @@ typedef struct{
     size_t capacity;
 } VulkanizerVfxInstances;
 
-bool Vulkanizer_init(VkDevice deviceIN, VkDescriptorPool descriptorPoolIN, size_t outWidth, size_t outHeight, Vulkanizer* vulkanizer, ArenaAllocator* aa);
-bool Vulkanizer_init_image_for_media(Vulkanizer* vulkanizer, size_t width, size_t height, VkImage* imageOut, VkDeviceMemory* imageMemoryOut, VkImageView* imageViewOut, size_t* imageStrideOut, VkDescriptorSet* descriptorSetOut, void* imageDataOut);
-bool Vulkanizer_apply_vfx_on_frame_and_compose(VkCommandBuffer cmd, Vulkanizer* vulkanizer, VulkanizerVfxInstances* vfxInstances, VkImageView videoInView, void* videoInData, size_t videoInStride, VkDescriptorSet videoInDescriptorSet, Frame* frameIn, VkImageView composedOutView);
-void Vulkanizer_reset_pool();
+// media larger than output is decoded into staging buffer and mipmapped on gpu every frame
+// so downscaling reads a fitting level instead of aliasing full resolution
+typedef struct{
+    VkImage image;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    size_t width;
+    size_t height;
+    uint32_t mipLevels; // 0 means media is sampled directly without mips
+} VulkanizerMediaMips;
+
+// remembers last rendered result of a layer so unchanged frames only need compositing
+typedef struct{
+    VulkanizerTarget* target;
+    uint64_t hash;
+    size_t hits;
+    size_t misses;
+} VulkanizerLayerCache;
+
+bool Vulkanizer_init(VkDevice deviceIN, size_t outWidth, size_t outHeight, Vulkanizer* vulkanizer, ArenaAllocator* aa);
+// fallback with the same interface, composited frames end up in vulkanizer->cpuCompositor.composed
+bool Vulkanizer_init_cpu(size_t outWidth, size_t outHeight, Vulkanizer* vulkanizer, ArenaAllocator* aa);
+bool Vulkanizer_init_image_for_media(Vulkanizer* vulkanizer, size_t width, size_t height, VkImage* imageOut, VkDeviceMemory* imageMemoryOut, VkImageView* imageViewOut, size_t* imageStrideOut, VkDescriptorSet* descriptorSetOut, VkDescriptorPool* descriptorPoolOut, void* imageDataOut, VulkanizerMediaMips* mipsOut);
+// uploads pixels once into device local mipmapped texture, pass NULL as videoInData when applying vfx on it
+bool Vulkanizer_init_immutable_image_for_media(Vulkanizer* vulkanizer, VideoFrame* frame, VkImage* imageOut, VkDeviceMemory* imageMemoryOut, VkImageView* imageViewOut, VkDescriptorSet* descriptorSetOut, VkDescriptorPool* descriptorPoolOut);
+// media images are only recorded into batches, has to be called before they get sampled
+bool Vulkanizer_flush_media_uploads(Vulkanizer* vulkanizer);
+// layerCache can be NULL, frameId has to change whenever pixels behind frameIn change
+// videoInData NULL means media image already holds the frame (immutable media), videoInMips can be NULL
+bool Vulkanizer_apply_vfx_on_frame_and_compose(VkCommandBuffer cmd, Vulkanizer* vulkanizer, VulkanizerVfxInstances* vfxInstances, VkImageView videoInView, void* videoInData, size_t videoInStride, VulkanizerMediaMips* videoInMips, VkDescriptorSet videoInDescriptorSet, Frame* frameIn, int64_t frameId, VulkanizerLayerCache* layerCache, VkImageView composedOutView);
+void Vulkanizer_layer_cache_release(Vulkanizer* vulkanizer, VulkanizerLayerCache* layerCache);
+// descriptorPool is the one handed out together with the set
+void Vulkanizer_free_descriptor_set(Vulkanizer* vulkanizer, VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet);
+// has to be called once per frame after the gpu finished with the previous one
+void Vulkanizer_reset_pool(Vulkanizer* vulkanizer);
+void Vulkanizer_print_target_stats(Vulkanizer* vulkanizer);
+VkFormat Vulkanizer_get_working_format(VfxWorkingFormat workingFormat);
 
 bool Vulkanizer_init_vfx(Vulkanizer* vulkanizer, VfxModule* module, VulkanizerVfx* outVfx);
+// every item has to have its module set, all of them get compiled in parallel
+bool Vulkanizer_init_vfxs(Vulkanizer* vulkanizer, VulkanizerVfxsRef* vfxs);
 
 bool createMyImage(VkDevice device, VkImage* image, size_t width, size_t height, VkDeviceMemory* imageMemory, VkImageView* imageView, size_t* imageStride, void** imageMapped, VkImageUsageFlagBits imageUsage, VkMemoryPropertyFlagBits memoryProperty);
 
@@ -0,0 +1,284 @@
+#define NOB_STRIP_PREFIX
+#include "nob.h"
+
+#include "waveform.h"
+#include "ffmpeg_media.h"
+#include "engine/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define WAVEFORM_CACHE_VERSION 1
+
+// start of every cache file, peaks of all levels follow right after it
+typedef struct{
+    char magic[4];
+    uint32_t version;
+    uint32_t sampleRate;
+    uint32_t baseSamples;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t level0Count;
+} WaveformCacheHeader;
+
+typedef struct{
+    WaveformPeak* items;
+    size_t count;
+    size_t capacity;
+} WaveformPeaks;
+
+// fills level offsets and counts, returns number of peaks in all levels together
+static size_t waveform_layout(Waveform* waveform, size_t level0Count){
+    size_t total = 0;
+    size_t count = level0Count;
+    waveform->levelsCount = 0;
+    while(waveform->levelsCount < WAVEFORM_MAX_LEVELS){
+        waveform->levelOffsets[waveform->levelsCount] = total;
+        waveform->levelCounts[waveform->levelsCount] = count;
+        waveform->levelsCount++;
+        total += count;
+        if(count <= 1) break;
+        count = (count + 1) / 2;
+    }
+    return total;
+}
+
+static bool waveform_source_info(const char* filename, uint64_t* sizeOut, int64_t* mtimeOut){
+    struct stat st;
+    if(stat(filename, &st) != 0) return false;
+    *sizeOut = (uint64_t)st.st_size;
+    *mtimeOut = (int64_t)st.st_mtime;
+    return true;
+}
+
+static void waveform_cache_path(const char* filename, char* out, size_t outSize){
+    // fnv-1a of source path, size and mtime in header tell whether file changed since
+    uint64_t hash = 14695981039346656037ull;
+    for(const char* c = filename; *c; c++){
+        hash ^= (uint8_t)*c;
+        hash *= 1099511628211ull;
+    }
+    snprintf(out, outSize, WAVEFORM_CACHE_DIR "/%016llx.peaks", (unsigned long long)hash);
+}
+
+static bool waveform_load(Waveform* waveform){
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    if(!waveform_source_info(waveform->filename, &sourceSize, &sourceMtime)) return false;
+
+    char path[64];
+    waveform_cache_path(waveform->filename, path, sizeof(path));
+    if(file_exists(path) != 1) return false;
+
+    String_Builder sb = {0};
+    if(!read_entire_file(path, &sb)) return false;
+    if(sb.count < sizeof(WaveformCacheHeader)) goto fail;
+
+    WaveformCacheHeader* header = (WaveformCacheHeader*)sb.items;
+    if(memcmp(header->magic, "FVWF", 4) != 0 || header->version != WAVEFORM_CACHE_VERSION) goto fail;
+    if(header->sampleRate != WAVEFORM_SAMPLE_RATE || header->baseSamples != WAVEFORM_BASE_SAMPLES) goto fail;
+    if(header->sourceSize != sourceSize || header->sourceMtime != sourceMtime) goto fail;
+
+    size_t total = waveform_layout(waveform, header->level0Count);
+    if(sb.count != sizeof(WaveformCacheHeader) + total*sizeof(WaveformPeak)) goto fail;
+
+    waveform->data = sb.items;
+    waveform->dataSize = sb.count;
+    waveform->peaks = (WaveformPeak*)(header + 1);
+    return true;
+fail:
+    sb_free(sb);
+    return false;
+}
+
+static void waveform_save(Waveform* waveform){
+    if(!mkdir_if_not_exists(WAVEFORM_CACHE_DIR)) return;
+    char path[64];
+    waveform_cache_path(waveform->filename, path, sizeof(path));
+    write_entire_file(path, waveform->data, waveform->dataSize);
+}
+
+static void waveform_push_peak(WaveformPeaks* peaks, float min, float max){
+    if(min < -1.0f) min = -1.0f;
+    if(max > 1.0f) max = 1.0f;
+    da_append(peaks, ((WaveformPeak){
+        .min = (int8_t)(min*127.0f - 0.5f),
+        .max = (int8_t)(max*127.0f + 0.5f),
+    }));
+}
+
+static bool waveform_build(WaveformCache* cache, Waveform* waveform){
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    if(!waveform_source_info(waveform->filename, &sourceSize, &sourceMtime)) return false;
+
+    Media media;
+    if(!ffmpegMediaInit(waveform->filename, WAVEFORM_SAMPLE_RATE, &(AVChannelLayout)AV_CHANNEL_LAYOUT_MONO, AV_SAMPLE_FMT_FLT, NULL, &media)) return false;
+    if(!media.audioStream){
+        ffmpegMediaUninit(&media);
+        return false;
+    }
+
+    WaveformPeaks level0 = {0};
+    float min = 0;
+    float max = 0;
+    size_t accumulated = 0;
+    Frame frame;
+    while(!atomic_load(&cache->cancel) && ffmpegMediaGetAudioFrame(&media, &frame)){
+        const float* samples = (const float*)frame.audio.data[0];
+        for(size_t i = 0; i < frame.audio.nb_samples; i++){
+            float sample = samples[i];
+            if(accumulated == 0 || sample < min) min = sample;
+            if(accumulated == 0 || sample > max) max = sample;
+            if(++accumulated == WAVEFORM_BASE_SAMPLES){
+                waveform_push_peak(&level0, min, max);
+                accumulated = 0;
+            }
+        }
+    }
+    if(accumulated > 0) waveform_push_peak(&level0, min, max);
+    ffmpegMediaUninit(&media);
+
+    if(atomic_load(&cache->cancel) || level0.count == 0){
+        da_free(level0);
+        return false;
+    }
+
+    size_t total = waveform_layout(waveform, level0.count);
+    waveform->dataSize = sizeof(WaveformCacheHeader) + total*sizeof(WaveformPeak);
+    waveform->data = malloc(waveform->dataSize);
+    if(waveform->data == NULL){
+        da_free(level0);
+        return false;
+    }
+
+    *(WaveformCacheHeader*)waveform->data = (WaveformCacheHeader){
+        .magic = {'F','V','W','F'},
+        .version = WAVEFORM_CACHE_VERSION,
+        .sampleRate = WAVEFORM_SAMPLE_RATE,
+        .baseSamples = WAVEFORM_BASE_SAMPLES,
+        .sourceSize = sourceSize,
+        .sourceMtime = sourceMtime,
+        .level0Count = level0.count,
+    };
+    waveform->peaks = (WaveformPeak*)((WaveformCacheHeader*)waveform->data + 1);
+    memcpy(waveform->peaks, level0.items, level0.count*sizeof(WaveformPeak));
+    da_free(level0);
+
+    for(size_t level = 1; level < waveform->levelsCount; level++){
+        const WaveformPeak* src = waveform->peaks + waveform->levelOffsets[level-1];
+        size_t srcCount = waveform->levelCounts[level-1];
+        WaveformPeak* dst = waveform->peaks + waveform->levelOffsets[level];
+        for(size_t i = 0; i < waveform->levelCounts[level]; i++){
+            WaveformPeak a = src[i*2];
+            WaveformPeak b = i*2 + 1 < srcCount ? src[i*2 + 1] : a;
+            dst[i] = (WaveformPeak){
+                .min = a.min < b.min ? a.min : b.min,
+                .max = a.max > b.max ? a.max : b.max,
+            };
+        }
+    }
+
+    return true;
+}
+
+static int waveform_thread(void* arg){
+    WaveformCache* cache = arg;
+    for(size_t i = 0; i < cache->count && !atomic_load(&cache->cancel); i++){
+        Waveform* waveform = &cache->items[i];
+        if(!waveform_load(waveform)){
+            uint64_t startTime = platform_get_time_nanos();
+            if(!waveform_build(cache, waveform)) continue;
+            printf("[FVFX] Built waveform of %s in %.2fs\n", waveform->filename, (double)(platform_get_time_nanos() - startTime) / 1e9);
+            waveform_save(waveform);
+        }
+        atomic_store_explicit(&waveform->ready, true, memory_order_release);
+    }
+    return 0;
+}
+
+bool waveform_cache_start(WaveformCache* cache, const char** filenames, size_t count){
+    memset(cache, 0, sizeof(*cache));
+    atomic_init(&cache->cancel, false);
+    cache->items = calloc(count ? count : 1, sizeof(*cache->items));
+    if(cache->items == NULL) return false;
+
+    for(size_t i = 0; i < count; i++){
+        bool duplicate = false;
+        for(size_t j = 0; j < cache->count; j++){
+            if(strcmp(cache->items[j].filename, filenames[i]) == 0){
+                duplicate = true;
+                break;
+            }
+        }
+        if(duplicate) continue;
+
+        Waveform* waveform = &cache->items[cache->count];
+        atomic_init(&waveform->ready, false);
+        waveform->filename = strdup(filenames[i]);
+        if(waveform->filename == NULL) goto fail;
+        cache->count++;
+    }
+
+    if(cache->count == 0) return true;
+    cache->thread = platform_thread_create(waveform_thread, cache);
+    if(cache->thread == NULL){
+        fprintf(stderr, "[FVFX] Couldn't start waveform thread\n");
+        goto fail;
+    }
+    return true;
+fail:
+    waveform_cache_stop(cache);
+    return false;
+}
+
+void waveform_cache_stop(WaveformCache* cache){
+    if(cache->thread){
+        atomic_store(&cache->cancel, true);
+        platform_thread_join(cache->thread);
+    }
+    for(size_t i = 0; i < cache->count; i++){
+        free(cache->items[i].filename);
+        free(cache->items[i].data);
+    }
+    free(cache->items);
+    memset(cache, 0, sizeof(*cache));
+}
+
+Waveform* waveform_cache_find(WaveformCache* cache, const char* filename){
+    for(size_t i = 0; i < cache->count; i++){
+        Waveform* waveform = &cache->items[i];
+        if(strcmp(waveform->filename, filename) != 0) continue;
+        return atomic_load_explicit(&waveform->ready, memory_order_acquire) ? waveform : NULL;
+    }
+    return NULL;
+}
+
+bool waveform_range(Waveform* waveform, double from, double to, float* minOut, float* maxOut){
+    if(from < 0) from = 0;
+    if(to <= from) return false;
+
+    // coarsest level whose peaks are still no wider than requested range
+    double baseFrom = from * WAVEFORM_SAMPLE_RATE / WAVEFORM_BASE_SAMPLES;
+    double baseTo = to * WAVEFORM_SAMPLE_RATE / WAVEFORM_BASE_SAMPLES;
+    size_t level = 0;
+    while(level + 1 < waveform->levelsCount && (double)(2ull << level) <= baseTo - baseFrom) level++;
+
+    size_t first = (size_t)(baseFrom / (double)(1ull << level));
+    size_t last = (size_t)(baseTo / (double)(1ull << level));
+    size_t count = waveform->levelCounts[level];
+    if(first >= count) return false;
+    if(last >= count) last = count - 1;
+
+    const WaveformPeak* peaks = waveform->peaks + waveform->levelOffsets[level];
+    int8_t min = peaks[first].min;
+    int8_t max = peaks[first].max;
+    for(size_t i = first + 1; i <= last; i++){
+        if(peaks[i].min < min) min = peaks[i].min;
+        if(peaks[i].max > max) max = peaks[i].max;
+    }
+    *minOut = min / 127.0f;
+    *maxOut = max / 127.0f;
+    return true;
+}
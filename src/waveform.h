@@ -0,0 +1,49 @@
+#ifndef FVFX_WAVEFORM
+#define FVFX_WAVEFORM
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// audio gets decoded as mono at this rate and every level 0 peak covers WAVEFORM_BASE_SAMPLES of it
+#define WAVEFORM_SAMPLE_RATE 16000
+#define WAVEFORM_BASE_SAMPLES 256
+#define WAVEFORM_MAX_LEVELS 40
+#define WAVEFORM_CACHE_DIR ".fvfx_cache"
+
+typedef struct{
+    int8_t min;
+    int8_t max;
+} WaveformPeak;
+
+// min/max pyramid of one audio stream, level n+1 merges pairs of level n
+typedef struct{
+    char* filename;
+    _Atomic bool ready; // set by builder thread once everything below can be read
+
+    void* data; // exactly what is stored in cache file, peaks point inside it
+    size_t dataSize;
+    WaveformPeak* peaks;
+    size_t levelsCount;
+    size_t levelOffsets[WAVEFORM_MAX_LEVELS];
+    size_t levelCounts[WAVEFORM_MAX_LEVELS];
+} Waveform;
+
+// builds waveforms on its own thread so render loop never waits for decoding
+typedef struct{
+    Waveform* items;
+    size_t count;
+    void* thread;
+    _Atomic bool cancel;
+} WaveformCache;
+
+// filenames are copied, duplicates get one waveform
+bool waveform_cache_start(WaveformCache* cache, const char** filenames, size_t count);
+void waveform_cache_stop(WaveformCache* cache);
+// returns NULL when there is no waveform for filename or it's not ready yet
+Waveform* waveform_cache_find(WaveformCache* cache, const char* filename);
+// peak of source between two times in seconds normalized to -1..1, returns false when range is outside of stream
+bool waveform_range(Waveform* waveform, double from, double to, float* minOut, float* maxOut);
+
+#endif